@@ -34,6 +34,8 @@ namespace paibot {
         int m_gradientSeed = 42;
         float m_optimizerTargetReduction = 0.6f;
         float m_optimizerGeometryTolerance = 0.1f;
+        float m_optimizerMaxGeometryTolerance = 1.0f;
+        float m_optimizerMaxColorTolerance = 2.0f;
         float m_optimizerSnapGrid = 15.0f;
         int m_seamlessTileSize = 1024;
         int m_bgSize = 1024;
@@ -70,6 +72,11 @@ namespace paibot {
         float getOptimizerTargetReduction() const;
         void setOptimizerGeometryTolerance(float tolerance);
         float getOptimizerGeometryTolerance() const;
+        // Caps the target mode may relax tolerances up to
+        void setOptimizerMaxGeometryTolerance(float tolerance);
+        float getOptimizerMaxGeometryTolerance() const;
+        void setOptimizerMaxColorTolerance(float tolerance);
+        float getOptimizerMaxColorTolerance() const;
         void setOptimizerSnapGrid(float grid);
         float getOptimizerSnapGrid() const;
 
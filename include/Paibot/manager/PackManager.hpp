@@ -2,6 +2,7 @@
 
 #include <Geode/Geode.hpp>
 #include <util/IntegrityLogger.hpp>
+#include <util/TileContainer.hpp>
 #include <vector>
 #include <string>
 #include <memory>
@@ -40,6 +41,9 @@ namespace paibot {
         std::string m_packsDirectory;
         bool m_integrityChecksEnabled = true;
         
+        // Mapped background containers keyed by "<packId>/<background>"
+        std::unordered_map<std::string, std::weak_ptr<TileContainer>> m_backgroundContainers;
+        
         PackManager();
         
     public:
@@ -50,6 +54,7 @@ namespace paibot {
         
         // Pack installation and management
         bool installPack(const std::string& packPath);
+        // Fails while a background of the pack is still open
         bool uninstallPack(const std::string& packId);
         bool activatePack(const std::string& packId);
         bool deactivatePack(const std::string& packId);
@@ -71,6 +76,10 @@ namespace paibot {
         PackInfo getPackInfo(const std::string& packId) const;
         bool isPackActive(const std::string& packId) const;
         
+        // Memory-maps backgrounds/<background>.pbtiles of an installed pack.
+        // Containers are shared while in use; tiles decode on first access.
+        std::shared_ptr<TileContainer> openBackground(const std::string& packId, const std::string& background);
+        
         // Configuration
         void setPacksDirectory(const std::string& directory);
         std::string getPacksDirectory() const { return m_packsDirectory; }
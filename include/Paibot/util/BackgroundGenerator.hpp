@@ -2,6 +2,11 @@
 
 #include <Geode/Geode.hpp>
 #include <util/IntegrityLogger.hpp>
+#include <util/PngWriter.hpp>
+#include <util/MipChain.hpp>
+#include <util/TextureAtlas.hpp>
+#include <util/TileContainer.hpp>
+#include <util/HeightField.hpp>
 #include <vector>
 #include <string>
 #include <memory>
@@ -40,6 +45,7 @@ namespace paibot {
         int octaves = 4;
         float persistence = 0.5f;
         float lacunarity = 2.0f;
+        float normalStrength = 4.0f;        // Slope scale of the derived normal map
         int version = 1; // For preset versioning
         
         // Geometrization settings
@@ -48,6 +54,18 @@ namespace paibot {
         float simplificationTolerance = 0.5f; // Polygon simplification tolerance
         int targetResolution = 512;         // Target resolution for geometric patterns
         bool optimizeForTiling = true;      // Optimize patterns for seamless tiling
+        
+        // Export settings
+        bool fastExport = false;            // Fast deflate level for quick iteration exports
+    };
+    
+    // Maps derived from a procedural heightfield. Parallax layers are ordered
+    // back to front; the back layer uses the fewest octaves (smoothest).
+    struct TileLayers {
+        MipLevel normalMap;
+        std::vector<MipLevel> parallax;
+        
+        bool isEmpty() const { return normalMap.isEmpty() && parallax.empty(); }
     };
     
     struct TileSet {
@@ -55,10 +73,28 @@ namespace paibot {
         std::vector<std::vector<int>> edgePatterns;  // Edge compatibility matrix
         int tileSize;
         float deltaE;  // Seamlessness measure
+        
+        // Downscale pyramids per tile, built lazily on first use and shared by copies
+        mutable std::shared_ptr<TileMipCache> mipCache;
+        
+        // Set when loaded from a .pbtiles file; `tiles` then holds nullptr and
+        // pixels are decoded from the container on first access
+        std::shared_ptr<TileContainer> container;
+        
+        // Normal map and parallax layers (procedural sets only)
+        std::shared_ptr<const TileLayers> layers;
+        
         bool isEmpty() const { return tiles.empty(); }
         bool isValid() const { return !isEmpty() && tileSize > 0; }
     };
     
+    // All tiles of a set packed into one texture; frames are in points, per tile index
+    struct TileAtlasTexture {
+        cocos2d::CCTexture2D* texture = nullptr;  // autoreleased
+        std::vector<cocos2d::CCRect> frames;
+        bool isValid() const { return texture != nullptr && !frames.empty(); }
+    };
+    
     struct WangTileValidation {
         bool hasValidBorders = true;
         bool hasVisualCuts = false;
@@ -130,6 +166,8 @@ namespace paibot {
         cocos2d::CCImage* generatePerlinNoise(int size, float scale, int octaves);
         cocos2d::CCImage* generateSimplexNoise(int size, float scale, int octaves);
         cocos2d::CCImage* generateWorleyNoise(int size, float scale);
+        // Normal map of `heightfield` plus the parallax layers cut off during the octave build
+        std::shared_ptr<const TileLayers> generateLayers(const HeightField& heightfield, std::vector<MipLevel> parallax);
         cocos2d::CCImage* applyColorPalette(cocos2d::CCImage* heightmap, 
                                             const std::vector<cocos2d::ccColor3B>& palette);
         
@@ -137,10 +175,10 @@ namespace paibot {
         TileSet generateWangTiles();
         std::vector<cocos2d::CCImage*> createCompatibleTiles(int count);
         bool checkEdgeCompatibility(cocos2d::CCImage* tile1, cocos2d::CCImage* tile2, int edge);
-        std::vector<std::vector<int>> generateTileLayout(int width, int height);
+        std::vector<std::vector<int>> generateTileLayout(const TileSet& tileSet, int width, int height);
         cocos2d::ccColor3B blendColors(const cocos2d::ccColor3B& c1, const cocos2d::ccColor3B& c2, float factor);
-        bool placeTileRecursive(std::vector<std::vector<int>>& layout, int x, int y, int width, int height, int tileCount, std::mt19937& rng);
-        bool isTileCompatibleAtPosition(const std::vector<std::vector<int>>& layout, int x, int y, int width, int height, int tileIdx);
+        bool placeTileRecursive(const TileSet& tileSet, std::vector<std::vector<int>>& layout, int x, int y, int width, int height, int tileCount, std::mt19937& rng);
+        bool isTileCompatibleAtPosition(const TileSet& tileSet, const std::vector<std::vector<int>>& layout, int x, int y, int width, int height, int tileIdx);
         
         // Geometrization mode - convert images to geometric patterns
         TileSet generateGeometrization();
@@ -161,22 +199,37 @@ namespace paibot {
         cocos2d::CCImage* applyHannWindow(cocos2d::CCImage* image);
         cocos2d::CCImage* mirrorEdges(cocos2d::CCImage* image, int borderSize);
         
+        // Mip pyramids (thumbnails, previews and texture upload read from these)
+        // Chain of one tile, built (and a container tile's pixels released)
+        // on first request
+        const MipChain* getMipChain(const TileSet& tileSet, size_t tileIndex);
+        MipLevel getTileImage(const TileSet& tileSet, size_t tileIndex, int size);
+        cocos2d::CCTexture2D* createTileTexture(const TileSet& tileSet, size_t tileIndex, int size);
+        // Atlas of `tiles` only; frames follow their order
+        TileAtlasTexture createTileAtlas(const TileSet& tileSet, const std::vector<size_t>& tiles, int tileSize);
+        
         // Preview and export
         cocos2d::CCNode* createTilePreview(const TileSet& tileSet, int previewCols = 3, int previewRows = 3);
         void measureDeltaE(const TileSet& tileSet);
         std::string generateExportJSON(const TileSet& tileSet);
         
         // Enhanced export functionality
-        void exportPresetJson(const std::string& path);
         void exportSpritesheet(const std::string& path);
+        void exportTilePngs(const std::string& directory);
+        void exportLayers(const std::string& directory);
         void generateThumbnail(const std::string& path);
-        void exportCompatibilityMatrix(const std::string& path);
+        bool exportTileContainer(const std::string& path);
+        
+        // Binary tile set import (lazy, memory mapped)
+        bool importTileContainer(const std::string& path);
+        bool importTileContainer(std::shared_ptr<TileContainer> container);
         
         // Utility methods for export
         std::string backgroundTypeToString(BackgroundType type);
         std::string noiseTypeToString(NoiseType type);
         std::string getCurrentTimestamp();
         std::string calculatePresetHash();
+        PngWriteOptions getPngWriteOptions() const;
         
         // Operation management
         std::string generateOperationId() const;
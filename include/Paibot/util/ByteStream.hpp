@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace paibot {
+    // Little-endian serialization helpers for the binary formats written by the
+    // mod. Readers never throw: reading past the end sets a sticky failure flag
+    // and yields zeros, so callers check `ok()` once after parsing a record.
+    class ByteWriter {
+    protected:
+        std::vector<uint8_t>& m_out;
+
+    public:
+        explicit ByteWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+        void u8(uint8_t value) { m_out.push_back(value); }
+
+        void u16(uint16_t value) {
+            m_out.push_back(static_cast<uint8_t>(value));
+            m_out.push_back(static_cast<uint8_t>(value >> 8));
+        }
+
+        void u32(uint32_t value) {
+            for (int i = 0; i < 4; ++i) {
+                m_out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+            }
+        }
+
+        void u64(uint64_t value) {
+            for (int i = 0; i < 8; ++i) {
+                m_out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+            }
+        }
+
+        void i32(int32_t value) { u32(static_cast<uint32_t>(value)); }
+
+        void f32(float value) {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            u32(bits);
+        }
+
+        void bytes(const void* data, size_t size) {
+            const auto* p = static_cast<const uint8_t*>(data);
+            m_out.insert(m_out.end(), p, p + size);
+        }
+
+        void string(const std::string& value) {
+            u32(static_cast<uint32_t>(value.size()));
+            bytes(value.data(), value.size());
+        }
+
+        size_t size() const { return m_out.size(); }
+    };
+
+    class ByteReader {
+    protected:
+        const uint8_t* m_data;
+        size_t m_size;
+        size_t m_pos = 0;
+        bool m_ok = true;
+
+        const uint8_t* take(size_t count) {
+            if (!m_ok || count > m_size - m_pos) {
+                m_ok = false;
+                return nullptr;
+            }
+            const uint8_t* p = m_data + m_pos;
+            m_pos += count;
+            return p;
+        }
+
+    public:
+        ByteReader(const uint8_t* data, size_t size) : m_data(data), m_size(data ? size : 0) {}
+
+        uint8_t u8() {
+            const uint8_t* p = take(1);
+            return p ? p[0] : 0;
+        }
+
+        uint16_t u16() {
+            const uint8_t* p = take(2);
+            return p ? static_cast<uint16_t>(p[0] | (p[1] << 8)) : 0;
+        }
+
+        uint32_t u32() {
+            const uint8_t* p = take(4);
+            if (!p) {
+                return 0;
+            }
+            return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+                   (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+        }
+
+        uint64_t u64() {
+            uint64_t lo = u32();
+            uint64_t hi = u32();
+            return lo | (hi << 32);
+        }
+
+        int32_t i32() { return static_cast<int32_t>(u32()); }
+
+        float f32() {
+            uint32_t bits = u32();
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        const uint8_t* bytes(size_t size) { return take(size); }
+
+        std::string string() {
+            uint32_t length = u32();
+            const uint8_t* p = take(length);
+            return p ? std::string(reinterpret_cast<const char*>(p), length) : std::string();
+        }
+
+        void seek(size_t position) {
+            if (position > m_size) {
+                m_ok = false;
+            } else {
+                m_pos = position;
+            }
+        }
+
+        size_t position() const { return m_pos; }
+        size_t remaining() const { return m_size - m_pos; }
+        bool ok() const { return m_ok; }
+    };
+}
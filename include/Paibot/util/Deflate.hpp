@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace paibot {
+    enum class DeflateLevel {
+        Store,      // No compression, fastest possible
+        Fast,       // Short hash chains, meant for iteration exports
+        Default,
+        Best
+    };
+
+    // Minimal RFC 1950/1951 codec used by the PNG writer and tile containers.
+    // Blocks are encoded independently (no shared dictionary) so callers can
+    // compress disjoint ranges on different threads and concatenate them.
+    class Deflate {
+    public:
+        // Checksums (zlib-compatible)
+        static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+        static uint32_t adler32(const uint8_t* data, size_t size, uint32_t adler = 1);
+        static uint32_t adler32Combine(uint32_t adlerA, uint32_t adlerB, size_t sizeB);
+
+        // Two-byte zlib stream header for the given level
+        static void writeZlibHeader(std::vector<uint8_t>& out, DeflateLevel level);
+        static void writeZlibTrailer(std::vector<uint8_t>& out, uint32_t adler);
+
+        // Raw deflate of one independent segment appended to `out`. When `last`
+        // is false the segment ends with a sync flush (empty stored block) so it
+        // stays byte aligned and can be followed by another segment.
+        static void compressSegment(const uint8_t* data, size_t size, DeflateLevel level,
+                                    bool last, std::vector<uint8_t>& out);
+
+        // Complete zlib stream in one call
+        static std::vector<uint8_t> compress(const uint8_t* data, size_t size, DeflateLevel level);
+
+        // Inflates a complete zlib stream and verifies its Adler-32. Output is
+        // capped at `maxSize` (and reserved up front); returns false on
+        // malformed or truncated input, or as soon as the output would grow
+        // past the cap.
+        static bool decompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t maxSize);
+    };
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace paibot {
+    // Row-major heights normalized to [0, 1]
+    struct HeightField {
+        int width = 0;
+        int height = 0;
+        std::vector<float> values;
+
+        bool isEmpty() const { return width <= 0 || height <= 0 || values.empty(); }
+    };
+
+    struct OctaveNoiseParams {
+        int size = 0;
+        float scale = 0.1f;         // base frequency
+        int octaves = 4;
+        float persistence = 0.5f;   // amplitude factor per octave
+        float lacunarity = 2.0f;    // frequency factor per octave
+        uint32_t seed = 0;
+    };
+
+    // Octave noise evaluated once into a single running sum. A heightfield
+    // limited to the first k octaves (a low-pass version of the full one) is
+    // normalized out as the sum passes k, so it costs one pass instead of a
+    // regeneration and no per-octave buffer is kept. Each octave is
+    // separable (sin(x) * cos(y)), so it is built from one row and one
+    // column table rather than per-pixel trigonometry.
+    class OctaveStack {
+    protected:
+        int m_size = 0;
+        std::vector<float> m_sum;   // every octave once build returns
+        std::vector<float> m_amplitudeSums;
+
+        HeightField normalize(int octaveCount) const;
+
+    public:
+        // onCutoff(k, heights) runs for each k in `cutoffs` (ascending,
+        // repeats allowed) with the heights of octaves [0, k), clamped to the
+        // available octaves
+        void build(const OctaveNoiseParams& params, const std::vector<int>& cutoffs = {},
+                   const std::function<void(int, HeightField&&)>& onCutoff = {});
+        void clear();
+
+        int getSize() const { return m_size; }
+        int getOctaveCount() const { return static_cast<int>(m_amplitudeSums.size()); }
+
+        // Heights from every octave
+        HeightField compose() const;
+    };
+
+    class NormalMap {
+    public:
+        // 3x3 Sobel normals as RGBA8 (OpenGL convention, green up). `wrap`
+        // samples across the borders so normals of seamless tiles stay seamless.
+        // `strength` scales slopes; at 1 a height change of 1 over the whole
+        // field tilts the normal by 45 degrees.
+        static void fromHeightField(const HeightField& field, float strength, bool wrap, std::vector<uint8_t>& rgba);
+    };
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+namespace paibot {
+    // CIE L*a*b* (D65), L in [0, 100]
+    struct LabColor {
+        float l = 0.0f;
+        float a = 0.0f;
+        float b = 0.0f;
+
+        static LabColor fromRgb(uint8_t r, uint8_t g, uint8_t b);
+        // 0xRRGGBB
+        static LabColor fromPacked(uint32_t rgb) {
+            return fromRgb(static_cast<uint8_t>(rgb >> 16), static_cast<uint8_t>(rgb >> 8), static_cast<uint8_t>(rgb));
+        }
+
+        // CIEDE2000 colour difference; around 1 is the smallest visible step
+        static float deltaE2000(const LabColor& x, const LabColor& y);
+    };
+}
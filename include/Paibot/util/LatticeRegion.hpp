@@ -0,0 +1,88 @@
+#pragma once
+
+#include <util/RectMerge.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace paibot {
+    struct LatticePoint {
+        int32_t x = 0;
+        int32_t y = 0;
+
+        bool operator==(const LatticePoint& other) const = default;
+    };
+
+    // Closed rectilinear ring without repeated or collinear vertices. Outer
+    // rings run counter-clockwise, holes clockwise (interior on the left).
+    using LatticeRing = std::vector<LatticePoint>;
+
+    struct LatticePolygon {
+        LatticeRing outer;
+        std::vector<LatticeRing> holes;
+    };
+
+    // Rectilinear point set on the integer lattice, kept as horizontal bands
+    // of sorted, disjoint x-intervals. Booleans are a sweep over the merged
+    // band boundaries of both operands, with a two-pointer walk over the
+    // intervals of each slab. Everything is integer, so results are exact.
+    // Bands with equal intervals that touch are merged, which makes the
+    // representation canonical: equal sets compare equal.
+    class LatticeRegion {
+    protected:
+        struct Band {
+            int32_t y0 = 0;
+            int32_t y1 = 0;
+            uint32_t begin = 0;   // into m_xs: x0, x1, x0, x1, ...
+            uint32_t end = 0;
+        };
+        std::vector<Band> m_bands;   // ascending, non-overlapping in y
+        std::vector<int32_t> m_xs;
+
+        enum class Op { Union, Difference, Intersection };
+        static LatticeRegion combine(const LatticeRegion& a, const LatticeRegion& b, Op op);
+        // Appends a band, merging it into the previous one when they touch
+        // and have the same intervals
+        void pushBand(int32_t y0, int32_t y1, const std::vector<int32_t>& xs);
+
+    public:
+        static LatticeRegion fromRects(const std::vector<GridRect>& rects);
+        // Nonzero winding over the rings, any orientation mix
+        static LatticeRegion fromRings(const std::vector<LatticeRing>& rings);
+
+        bool empty() const { return m_bands.empty(); }
+        int64_t area() const;
+        bool operator==(const LatticeRegion& other) const;
+
+        LatticeRegion unite(const LatticeRegion& other) const { return combine(*this, other, Op::Union); }
+        LatticeRegion subtract(const LatticeRegion& other) const { return combine(*this, other, Op::Difference); }
+        LatticeRegion intersect(const LatticeRegion& other) const { return combine(*this, other, Op::Intersection); }
+
+        // Boundary traced into rings, holes assigned to the outer ring that
+        // contains them. Regions touching only at a corner stay separate.
+        std::vector<LatticePolygon> polygons() const;
+        // The region with every hole filled
+        LatticeRegion withoutHoles() const;
+
+        // Disjoint rectangles covering the region exactly: intervals of each
+        // band, grown upwards through bands that repeat them. Both sweep
+        // directions are tried and the one with fewer rectangles kept.
+        std::vector<GridRect> decompose() const;
+        // Rectangles of the horizontal sweep only
+        std::vector<GridRect> bandRects() const;
+
+        // Cells of the compressed grid partitionMinimum works on; larger
+        // regions are refused
+        static constexpr int64_t kMaxPartitionCells = int64_t{1} << 22;
+
+        // Partition into the fewest rectangles. Chords join facing concave
+        // vertices; a maximum set of non-crossing chords is the complement
+        // of a minimum vertex cover of the horizontal/vertical crossing graph
+        // (König), found with a Hopcroft-Karp matching. Those chords are cut,
+        // and every concave vertex left gets one cut to the nearest boundary
+        // or cut. False, with `out` untouched, when the region is over
+        // kMaxPartitionCells or `deadline` passes first.
+        bool partitionMinimum(std::vector<GridRect>& out, std::chrono::steady_clock::time_point deadline) const;
+    };
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <util/ObjectRecords.hpp>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace paibot {
+    // Decompressed level string: "<header>;<object>;<object>;..." where the
+    // header holds level settings (kS38 colour channels, kA* options) and
+    // every object is an editor object string.
+    //
+    // Parsing does not copy: the header and object strings are views into
+    // the caller's buffer, which must outlive the ParsedLevel.
+    struct ParsedLevel {
+        std::string_view header;
+        std::vector<std::string_view> objects;   // indexed by record sourceIndex
+        ObjectRecords records;
+        // Channel colours from kS38 as 0xRRGGBB
+        std::unordered_map<int32_t, uint32_t> channelColors;
+        // Channels set or copied by a trigger, and kS38 channels that copy
+        // another one (see OptimizerConfig::animatedChannels)
+        std::unordered_set<int32_t> animatedChannels;
+    };
+
+    class LevelString {
+    public:
+        static bool isTriggerId(int32_t objectId);
+
+        // False when an object string is malformed; `out` then holds the
+        // objects before it
+        static bool parse(std::string_view text, ParsedLevel& out);
+
+        // Header plus one object string per record. Records with a source are
+        // written as the original string; generated ones are built from
+        // their template object.
+        static std::string encode(const ParsedLevel& level, const ObjectRecords& records);
+    };
+}
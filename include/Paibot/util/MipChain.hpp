@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace paibot {
+    struct MipLevel {
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> rgba;   // tightly packed RGBA8
+
+        bool isEmpty() const { return width <= 0 || height <= 0 || rgba.empty(); }
+    };
+
+    // Downscale pyramid for one image. Level 0 is the source, every further
+    // level halves both sides with a 2x2 box filter. Arbitrary sizes are
+    // produced from the nearest larger level with a separable Lanczos-3 filter,
+    // so callers never resample from full resolution.
+    class MipChain {
+    protected:
+        std::vector<MipLevel> m_levels;
+        bool m_wrap = true;
+
+    public:
+        // Builds levels down to `minSize` on the shorter side. `wrap` makes the
+        // Lanczos filter sample across edges, which is right for seamless tiles.
+        void build(const uint8_t* rgba, int width, int height, int minSize = 1, bool wrap = true);
+        void clear() { m_levels.clear(); }
+
+        size_t getLevelCount() const { return m_levels.size(); }
+        const MipLevel& getLevel(size_t index) const { return m_levels[index]; }
+        bool isEmpty() const { return m_levels.empty(); }
+
+        // Smallest level whose sides are both >= the requested size (level 0 if none)
+        const MipLevel& nearestLevel(int width, int height) const;
+
+        // Exact-size image taken from the nearest level, Lanczos-filtered if needed
+        MipLevel resampleTo(int width, int height) const;
+
+        // Filters (SSE2 when available, scalar otherwise)
+        static void downsampleBox2x(const MipLevel& src, MipLevel& dst);
+        static void resampleLanczos3(const MipLevel& src, int width, int height, bool wrap, MipLevel& dst);
+    };
+
+    // Mip chains for the tiles of a TileSet, shared by copies of the set
+    // (preview, thumbnail and texture upload all read from it). Each chain is
+    // built the first time its tile is asked for, so memory goes only to
+    // tiles that are actually shown.
+    struct TileMipCache {
+        struct Slot {
+            MipChain chain;
+            std::once_flag built;
+        };
+        std::unique_ptr<Slot[]> slots;
+        size_t count = 0;
+        std::once_flag sized;
+    };
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <util/SpatialHash.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace paibot {
+    enum class ObjectKind : uint8_t {
+        Solid,
+        Hazard,
+        Decoration,
+        Trigger,
+        Other
+    };
+
+    enum ObjectFlags : uint8_t {
+        ObjectHidden = 1 << 0,
+        ObjectLocked = 1 << 1,   // on a locked editor layer
+        ObjectFlipX = 1 << 2,
+        ObjectFlipY = 1 << 3,
+        ObjectOpaque = 1 << 4    // hides everything under its hitbox rect
+    };
+
+    enum TriggerActivation : uint8_t {
+        TriggerSpawned = 1 << 0,
+        TriggerTouched = 1 << 1,
+        TriggerMulti = 1 << 2
+    };
+
+    // Trigger settings the optimizer reasons about
+    struct TriggerParams {
+        int32_t target = 0;         // colour channel (colour trigger) or group
+        float duration = 0.0f;
+        uint32_t color = 0;         // 0xRRGGBB
+        float opacity = 1.0f;
+        int32_t copyColorId = 0;
+        bool blending = false;
+        bool activate = true;       // toggle trigger: on or off
+        uint8_t activation = 0;     // TriggerActivation bits, 0 = fires when passed
+        int32_t order = 0;          // placement order (unique ID); same-x triggers fire in this order
+
+        bool sameEffect(const TriggerParams& other) const {
+            return target == other.target && duration == other.duration && color == other.color &&
+                   opacity == other.opacity && copyColorId == other.copyColorId &&
+                   blending == other.blending && activate == other.activate;
+        }
+    };
+
+    // A single object, used to append to or read from ObjectRecords
+    struct ObjectRecord {
+        float x = 0.0f;             // centre of the hitbox, world units
+        float y = 0.0f;
+        float width = 0.0f;         // unrotated hitbox size, scale applied
+        float height = 0.0f;
+        float rotation = 0.0f;      // degrees, clockwise
+        float scaleX = 1.0f;
+        float scaleY = 1.0f;
+        int32_t objectId = 0;
+        int32_t colorId = 0;
+        int32_t detailColorId = 0;
+        int32_t zOrder = 0;
+        int16_t zLayer = 0;
+        int16_t editorLayer = 0;
+        uint64_t groups = 0;        // groupSignature() of the group IDs
+        ObjectKind kind = ObjectKind::Other;
+        uint8_t flags = 0;
+        int32_t sourceIndex = -1;   // input object this record leaves untouched, -1 when generated
+        int32_t templateIndex = -1; // input object a generated record copies its remaining properties from
+        std::optional<TriggerParams> trigger;
+    };
+
+    // Optimizer snapshot as parallel arrays, one entry per object. Passes read
+    // only the columns they need, and records carry no engine pointers, so
+    // the whole pipeline runs without the game. Objects are created from the
+    // records only when a result is applied.
+    struct ObjectRecords {
+        // Storage per record across all columns
+        static constexpr size_t kRowBytes = 7 * sizeof(float) + 7 * sizeof(int32_t) + 2 * sizeof(int16_t) +
+                                            sizeof(uint64_t) + sizeof(ObjectKind) + sizeof(uint8_t);
+
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> width;
+        std::vector<float> height;
+        std::vector<float> rotation;
+        std::vector<float> scaleX;
+        std::vector<float> scaleY;
+        std::vector<int32_t> objectId;
+        std::vector<int32_t> colorId;
+        std::vector<int32_t> detailColorId;
+        std::vector<int32_t> zOrder;
+        std::vector<int16_t> zLayer;
+        std::vector<int16_t> editorLayer;
+        std::vector<uint64_t> groups;
+        std::vector<ObjectKind> kind;
+        std::vector<uint8_t> flags;
+        std::vector<int32_t> sourceIndex;
+        std::vector<int32_t> templateIndex;
+        // Triggers only: index into triggerParams, -1 otherwise
+        std::vector<int32_t> triggerIndex;
+        std::vector<TriggerParams> triggerParams;
+
+        size_t size() const { return x.size(); }
+        bool empty() const { return x.empty(); }
+        void reserve(size_t count);
+        void clear();
+
+        void push(const ObjectRecord& record);
+        // Copies record `index` of `other` to the end
+        void append(const ObjectRecords& other, size_t index);
+        void append(const ObjectRecords& other);
+        // The given records, in the given order
+        ObjectRecords select(const std::vector<uint32_t>& indices) const;
+        ObjectRecord get(size_t index) const;
+
+        bool hasFlag(size_t index, ObjectFlags flag) const { return (flags[index] & flag) != 0; }
+        bool isGenerated(size_t index) const { return sourceIndex[index] < 0; }
+        const TriggerParams* getTrigger(size_t index) const {
+            return triggerIndex[index] >= 0 ? &triggerParams[triggerIndex[index]] : nullptr;
+        }
+
+        // World-space bounds, accounting for rotation
+        Aabb bounds(size_t index) const;
+        void collectBounds(std::vector<Aabb>& out) const;
+
+        // Order-independent 64-bit signature of a list of group IDs
+        static uint64_t groupSignature(const short* groupIds, size_t count);
+    };
+}
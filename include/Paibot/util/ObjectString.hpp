@@ -0,0 +1,54 @@
+#pragma once
+
+#include <util/ObjectRecords.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace paibot {
+    // Editor object strings: "1,211,2,15,3,15,..." as key/value pairs
+    namespace ObjectKey {
+        constexpr int32_t Id = 1;
+        constexpr int32_t X = 2;
+        constexpr int32_t Y = 3;
+        constexpr int32_t FlipX = 4;
+        constexpr int32_t FlipY = 5;
+        constexpr int32_t Rotation = 6;
+        constexpr int32_t EditorLayer = 20;
+        constexpr int32_t Color = 21;
+        constexpr int32_t DetailColor = 22;
+        constexpr int32_t ZLayer = 24;
+        constexpr int32_t ZOrder = 25;
+        constexpr int32_t Scale = 32;
+        constexpr int32_t ScaleX = 128;
+        constexpr int32_t ScaleY = 129;
+    }
+
+    using ObjectFields = std::vector<std::pair<int32_t, std::string_view>>;
+
+    // Splits one object string. Values point into `text`. Returns false on a
+    // non-numeric key or an odd number of tokens.
+    bool parseObjectString(std::string_view text, ObjectFields& out);
+
+    // Shortest decimal form with at most three fractional digits
+    void appendNumber(std::string& out, float value);
+
+    // Object string of a template object with the fields a record carries
+    // replaced. The template is split once, so creating many objects from
+    // one template only writes the record fields per object.
+    class ObjectStringTemplate {
+    protected:
+        // Template fields the records do not override, pre-joined
+        std::string m_tail;
+
+    public:
+        ObjectStringTemplate() = default;
+        explicit ObjectStringTemplate(std::string_view text);
+
+        // Appends the object string for record `index`
+        void format(const ObjectRecords& records, size_t index, std::string& out) const;
+    };
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Geode/Geode.hpp>
+#include <util/ObjectRecords.hpp>
+#include <util/ObjectString.hpp>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace paibot {
+    // Applies an optimization result to the editor a little at a time. Each
+    // frame creates replacement objects in batches, then deletes the
+    // originals, until the frame budget is used up. New objects are built
+    // from cached per-template object strings and created with one
+    // createObjectsFromString call per batch.
+    //
+    // Editor undo is bypassed; the optimizer snapshot reverts the whole
+    // apply as one step.
+    class OptimizerApplyTask : public cocos2d::CCNode {
+    protected:
+        static constexpr size_t kBatchSize = 256;
+
+        ObjectRecords m_records;
+        // Sources may be deleted while the task waits for its frames
+        std::vector<geode::WeakRef<GameObject>> m_sources;
+        std::vector<geode::Ref<GameObject>> m_removals;
+        std::vector<uint32_t> m_creations;    // generated record indices
+        size_t m_nextCreation = 0;
+        size_t m_nextRemoval = 0;
+        float m_budgetMs = 4.0f;
+
+        std::unordered_map<int32_t, ObjectStringTemplate> m_templates;
+        std::string m_batch;
+        std::vector<GameObject*> m_created;
+
+        geode::Ref<geode::Notification> m_progress;
+        std::function<void(const std::vector<GameObject*>&)> m_onFinished;
+
+        const ObjectStringTemplate& templateFor(int32_t templateIndex);
+        void createBatch();
+        void removeBatch();
+        void finish();
+
+    public:
+        // `sources` maps record source indices to the selected objects
+        static OptimizerApplyTask* create(ObjectRecords records, std::vector<geode::WeakRef<GameObject>> sources,
+                                          float budgetMs);
+        bool init(ObjectRecords records, std::vector<geode::WeakRef<GameObject>> sources, float budgetMs);
+
+        // Receives every object created by the task when it completes
+        void setOnFinished(std::function<void(const std::vector<GameObject*>&)> callback) { m_onFinished = std::move(callback); }
+
+        // Runs until done; the task removes itself from its parent
+        void start(cocos2d::CCNode* host);
+        void update(float dt) override;
+
+        size_t getTotalSteps() const { return m_creations.size() + m_removals.size(); }
+        size_t getDoneSteps() const { return m_nextCreation + m_nextRemoval; }
+        bool isDone() const { return getDoneSteps() >= getTotalSteps(); }
+    };
+}
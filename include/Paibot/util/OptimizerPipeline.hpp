@@ -0,0 +1,221 @@
+#pragma once
+
+#include <util/ObjectRecords.hpp>
+#include <util/OptimizerTypes.hpp>
+#include <util/SceneRaster.hpp>
+#include <compare>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace paibot {
+    enum class OptimizerLogLevel {
+        Debug,
+        Info,
+        Warn,
+        Error
+    };
+
+    struct OptimizerConfig {
+        OptimizationMode mode = OptimizationMode::VanillaSafe;
+        OptimizeOptions options;
+        FusionRules rules;
+        float snapGrid = 15.0f;
+        float geometryTolerance = 0.1f;
+        float colorTolerance = 1.0f;
+        int canonicalObjectId = 211;   // replacement skin when keepExactSkins is off
+        bool preserveHitboxes = true;  // never remove objects that collide
+        // Current colour of each channel (0xRRGGBB), used to compare channels
+        // under rules.allowColorMerging. Channels missing here never merge.
+        std::unordered_map<int32_t, uint32_t> channelColors;
+        // Channels that a colour or copy trigger anywhere in the level
+        // changes or reads, or that copy another channel. Their colour at run
+        // time is not the one above, so they never merge.
+        std::unordered_set<int32_t> animatedChannels;
+        // Whole-level runs: width of an x-chunk, and the least width of the
+        // band at its right border that is optimized again with the next
+        // chunk. The band grows to the longest piece the caps allow, so
+        // chunks should be wider than that.
+        float chunkWidth = 6000.0f;
+        float chunkOverlap = 60.0f;
+        // Receives the pass diagnostics; the pipeline does not log on its own
+        std::function<void(OptimizerLogLevel, const std::string&)> logger;
+        // Called after each chunk of runChunked with (done, total)
+        std::function<void(size_t, size_t)> progress;
+        // runToTarget: fraction of objects to remove, and how far the
+        // geometry and colour tolerances may be relaxed to get there, in
+        // relaxSteps even steps. The colour tolerance only relaxes under
+        // rules.allowColorMerging.
+        float targetReduction = 0.0f;
+        float maxGeometryTolerance = 0.1f;
+        float maxColorTolerance = 1.0f;
+        int relaxSteps = 3;
+    };
+
+    // Partition an object belongs to; only objects with equal keys may fuse
+    struct ClusterKey {
+        int32_t colorId = 0;        // representative of the colour class
+        int32_t detailColorId = 0;
+        int16_t zLayer = 0;         // z fields are zero under allowZGroupMerging
+        int32_t zOrder = 0;
+        ObjectKind kind = ObjectKind::Other;
+
+        auto operator<=>(const ClusterKey& other) const = default;
+    };
+
+    // Connected set of touching records within one partition. Clusters share
+    // no objects, so each one can be optimized on its own.
+    struct ObjectCluster {
+        ClusterKey key;
+        std::vector<uint32_t> members;  // record indices, ascending
+    };
+
+    // Occurrences of one repeated motif
+    struct PatternGroup {
+        uint64_t hash = 0;
+        size_t objectsPerInstance = 0;
+        // Record indices per occurrence, each in canonical order
+        std::vector<std::vector<uint32_t>> instances;
+    };
+
+    struct PatternReport {
+        std::vector<PatternGroup> groups;   // largest saving first
+        size_t repeatedObjects = 0;         // objects in second and later occurrences
+        size_t savedObjects = 0;            // with one definition + one reference per occurrence
+        size_t savedBytes = 0;              // savedObjects in record storage
+    };
+
+    // Shared motif for runtime instancing: members relative to the anchor
+    // (minimum member centre), placed once per anchor
+    struct InstanceDefinition {
+        uint32_t id = 0;
+        ObjectRecords members;
+        std::vector<std::pair<float, float>> anchors;
+    };
+
+    // A trigger removed by coalesceTriggers and why that is safe
+    struct TriggerRewrite {
+        int32_t removed = -1;       // sourceIndex of the removed trigger
+        int32_t provenBy = -1;      // sourceIndex of the trigger that makes it redundant
+        std::string reason;
+    };
+
+    // One pass application of runToTarget
+    struct PassStep {
+        std::string pass;
+        float geometryTolerance = 0.0f;
+        float colorTolerance = 0.0f;
+        size_t objectsBefore = 0;
+        size_t objectsAfter = 0;
+        double milliseconds = 0.0;   // pass plus its ΔE check
+        bool accepted = true;        // false when the ΔE check rejected it
+    };
+
+    struct TargetReport {
+        float target = 0.0f;
+        float achieved = 0.0f;
+        bool reached = false;
+        std::vector<PassStep> steps;
+        DeltaEStats deltaE;          // of the result against the input
+    };
+
+    struct PipelineResult {
+        ObjectRecords records;
+        std::vector<TriggerRewrite> triggerRewrites;
+        PatternReport patterns;
+        std::vector<InstanceDefinition> instances;  // GeodeRuntime mode only
+        std::vector<StageStats> stages;             // in pass order, chunks folded together
+    };
+
+    // The optimizer passes, run over an ObjectRecords snapshot. Free of Geode
+    // so the editor, command line tools and tests share one implementation.
+    // Passes are const and keep no per-run state, so clusters can be
+    // optimized concurrently; the logger must be thread-safe.
+    class OptimizerPipeline {
+    protected:
+        OptimizerConfig m_config;
+
+        void log(OptimizerLogLevel level, const std::string& message) const;
+        using ClusterPass = std::function<ObjectRecords(const ObjectRecords&, const ObjectCluster&)>;
+        // `pass` over every cluster of `input` on the worker pool; results
+        // are concatenated in cluster order. Clustering is added to `stages`.
+        ObjectRecords forEachCluster(const ObjectRecords& input, const ClusterPass& pass,
+                                     size_t* clusterCount = nullptr, std::vector<StageStats>* stages = nullptr) const;
+        // Shared sweep behind mergeLines (`rotated`) and mergeSegments (quarter turns)
+        ObjectRecords mergeCollinear(const ObjectRecords& records, bool rotated) const;
+
+    public:
+        // Unscaled size of a canonical block, used to scale replacement skins
+        static constexpr float kBlockSize = 30.0f;
+        static constexpr int32_t kColorTriggerId = 899;
+        static constexpr int32_t kAlphaTriggerId = 1007;
+        static constexpr int32_t kToggleTriggerId = 1049;
+        static constexpr int32_t kBackgroundChannel = 1000;
+
+        explicit OptimizerPipeline(OptimizerConfig config);
+
+        // Skins that fill their whole hitbox rect with an opaque texture
+        static bool isOpaqueSkin(int32_t objectId);
+
+        const OptimizerConfig& getConfig() const { return m_config; }
+
+        // Clusters the input and optimizes the clusters on the worker pool.
+        // The result is the same for any thread count.
+        PipelineResult run(const ObjectRecords& input) const;
+        // run() over fixed-width x-chunks for whole levels, so the pass
+        // working set stays the size of one chunk. Patterns are still found
+        // over the whole result.
+        PipelineResult runChunked(const ObjectRecords& input) const;
+        // run() without the pattern passes; trigger rewrites are appended,
+        // and so are the stages when `stages` is given
+        ObjectRecords optimizeRecords(const ObjectRecords& records, std::vector<TriggerRewrite>& triggerRewrites,
+                                      std::vector<StageStats>* stages = nullptr) const;
+        // Passes one at a time, cheapest per saved object first, each kept
+        // only if the ΔE check passes. Stops once targetReduction is reached;
+        // until then tolerances are relaxed step by step up to their caps.
+        PipelineResult runToTarget(const ObjectRecords& input, TargetReport& report) const;
+        // Members of a cluster, recoloured to one channel of its colour class
+        ObjectRecords selectCluster(const ObjectRecords& input, const ObjectCluster& cluster) const;
+        // Every pass after clustering, for one cluster of `input`
+        ObjectRecords optimizeCluster(const ObjectRecords& input, const ObjectCluster& cluster,
+                                      std::vector<StageStats>* stages = nullptr) const;
+
+        ObjectRecords normalizeObjects(const ObjectRecords& records) const;
+        ObjectRecords mergeGeometric(const ObjectRecords& records) const;
+        // Connected motifs of two or more objects that occur more than once.
+        // Runs on the whole result, since repeats sit in different clusters.
+        PatternReport findPatterns(const ObjectRecords& records) const;
+        ObjectRecords polygonize(const ObjectRecords& records) const;
+        // Drops colour/alpha/toggle triggers that provably change nothing
+        ObjectRecords coalesceTriggers(const ObjectRecords& records, std::vector<TriggerRewrite>* rewrites = nullptr) const;
+
+        // Geometric merging with fusion rules
+        ObjectRecords mergeLines(const ObjectRecords& records) const;
+        ObjectRecords mergeMosaics(const ObjectRecords& records) const;
+        ObjectRecords mergeSegments(const ObjectRecords& records) const;
+        // Drops objects fully hidden by opaque objects drawn above them. Runs
+        // over the whole input, since occluders live in other clusters.
+        ObjectRecords mergeOverlaps(const ObjectRecords& records) const;
+        // Clusters ordered by key, then by first member
+        std::vector<ObjectCluster> groupByColorAndZGroup(const ObjectRecords& records) const;
+        // Representative channel for each channel used by `records`
+        std::unordered_map<int32_t, int32_t> buildColorClasses(const ObjectRecords& records) const;
+        ObjectRecords mergeAdjacentBlocks(const ObjectRecords& records) const;
+
+        // Pattern recognition
+        std::vector<InstanceDefinition> createInstances(const ObjectRecords& records, const PatternReport& patterns) const;
+        ObjectRecords createCustomObjects(const ObjectRecords& records) const;
+
+        // Validation. The difference is measured on flat-colour renders of
+        // the changed regions, at a quarter of the snap grid per pixel.
+        DeltaEStats measureDeltaE(const ObjectRecords& before, const ObjectRecords& after) const;
+        float calculateDeltaE(const ObjectRecords& before, const ObjectRecords& after) const;
+        bool validateOptimization(const ObjectRecords& original, const ObjectRecords& optimized) const;
+        // Same checks with an already measured difference
+        bool validateOptimization(const ObjectRecords& original, const ObjectRecords& optimized,
+                                  const DeltaEStats& deltaE) const;
+        bool canFuse(const ObjectRecords& records, size_t a, size_t b) const;
+    };
+}
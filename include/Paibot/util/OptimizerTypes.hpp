@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace paibot {
+    enum class OptimizationMode {
+        VanillaSafe,     // Only use vanilla GD objects
+        GeodeRuntime     // Use Geode runtime optimizations
+    };
+
+    // One stage of an optimization run. Per-cluster passes run on several
+    // threads; their time is summed over clusters (`workerTime`).
+    struct StageStats {
+        std::string name;
+        double milliseconds = 0.0;
+        size_t objectsIn = 0;
+        size_t objectsOut = 0;
+        uint64_t allocations = 0;     // heap allocations during the stage
+        uint64_t peakBytes = 0;       // heap high-water mark above the stage start
+        bool workerTime = false;
+        bool memoryCounted = false;   // false: the host does not count allocations
+    };
+
+    struct OptimizationStats {
+        int objectsBefore = 0;
+        int objectsAfter = 0;
+        float reductionPercentage = 0.0f;
+        float deltaE = 0.0f;      // Mean CIEDE2000 over changed pixels
+        float deltaEP99 = 0.0f;   // 99th percentile of the same pixels
+        float processingTime = 0.0f;
+        std::string operationId;  // Unique ID for logging
+        std::vector<StageStats> stages;
+    };
+
+    // Scope & options for optimization run
+    struct OptimizeOptions {
+        // Scope
+        bool useSelectionOnly = true;   // false -> whole level, in x-chunks
+
+        // Inclusion filters
+        bool includeRotated = false;
+        bool includeNonUniformScale = false;
+        bool includeHidden = false;
+        bool includeLocked = false;
+
+        // Object kinds
+        bool includeTiles = true;
+        bool includeWalls = true;
+        bool includeDecorRects = false;
+
+        // Behavior
+        bool keepExactSkins = true;           // if false, use canonical rectangular tile
+        bool respectHoles = true;             // if false, fill holes of same cluster
+        float colorTolerance = 0.0f;          // 0 = exact ccColor3B match
+        int maxWidthCells = 256;              // limit per piece to avoid huge scales
+        int maxHeightCells = 256;
+        bool exactPartition = false;          // fewest rectangles in polygonize; for final passes
+        float exactPartitionBudgetMs = 50.0f; // per cluster, then greedy cuts
+        bool forceGridSnap = true;            // snap to grid for generated rectangles
+        bool verboseLog = true;               // print detailed report to log
+    };
+
+    // Fusion rules validation
+    struct FusionRules {
+        bool allowColorMerging = true;
+        bool allowZGroupMerging = false;
+        float minValidArea = 1.0f;
+        bool rejectCorruptPolygons = true;
+    };
+}
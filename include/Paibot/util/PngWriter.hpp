@@ -0,0 +1,52 @@
+#pragma once
+
+#include <util/Deflate.hpp>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace paibot {
+    enum class PngFilter {
+        None = 0,
+        Sub = 1,
+        Up = 2,
+        Average = 3,
+        Paeth = 4,
+        Adaptive = 5    // pick the cheapest filter per row (minimum sum of absolute residuals)
+    };
+
+    struct PngWriteOptions {
+        PngFilter filter = PngFilter::Adaptive;
+        DeflateLevel level = DeflateLevel::Default;
+        int rowsPerBlock = 0;       // 0 = choose so each block holds ~1 MB of scanlines
+        bool multithreaded = true;  // compress independent row blocks on the WorkerPool
+    };
+
+    struct PngWriteStats {
+        size_t rawBytes = 0;
+        size_t compressedBytes = 0;
+        int blocks = 0;
+    };
+
+    // Streaming RGBA8 PNG encoder. Scanlines are pulled from a callback in row
+    // blocks, filtered and deflated, then written out as IDAT chunks, so peak
+    // memory is a few row blocks regardless of image size. Row blocks are
+    // deflated independently (pigz style) which lets them run in parallel.
+    class PngWriter {
+    public:
+        // Fills `rgba` (width * 4 bytes) with scanline `y`. Called from worker
+        // threads when multithreading is enabled, so it must be thread safe.
+        using RowSource = std::function<void(int y, uint8_t* rgba)>;
+
+        static bool write(const std::string& path, int width, int height, const RowSource& source,
+                          const PngWriteOptions& options = {}, PngWriteStats* stats = nullptr);
+
+        // Writes a tightly packed RGBA8 buffer
+        static bool writeRGBA(const std::string& path, int width, int height, const uint8_t* rgba,
+                              const PngWriteOptions& options = {}, PngWriteStats* stats = nullptr);
+
+        // Applies a PNG filter to one row. `prev` may be null for the first row.
+        static void filterRow(PngFilter filter, const uint8_t* row, const uint8_t* prev,
+                              size_t stride, uint8_t* out);
+    };
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace paibot {
+    // Axis-aligned rectangle in grid cells (x right, y up)
+    struct GridRect {
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+
+        int64_t area() const { return static_cast<int64_t>(width) * height; }
+        bool operator==(const GridRect& other) const = default;
+    };
+
+    // Dense cell bitmap over a bounded region, one byte per cell
+    class OccupancyGrid {
+    protected:
+        int m_width = 0;
+        int m_height = 0;
+        std::vector<uint8_t> m_cells;
+
+    public:
+        OccupancyGrid() = default;
+        OccupancyGrid(int width, int height) { reset(width, height); }
+
+        void reset(int width, int height);
+        int getWidth() const { return m_width; }
+        int getHeight() const { return m_height; }
+
+        bool test(int x, int y) const { return m_cells[static_cast<size_t>(y) * m_width + x] != 0; }
+        void set(int x, int y) { m_cells[static_cast<size_t>(y) * m_width + x] = 1; }
+        void fill(const GridRect& rect, bool value);
+        bool isFull(const GridRect& rect) const;
+        size_t count() const;
+    };
+
+    class RectMerge {
+    public:
+        // Covers every set cell with disjoint rectangles no larger than
+        // maxWidth x maxHeight, consuming the grid. Each round sweeps the rows
+        // keeping a column run-length histogram; a monotonic stack yields the
+        // maximal rectangle ending at every row, and those are accepted largest
+        // first while they still fit. Output order is deterministic.
+        static std::vector<GridRect> extractGreedy(OccupancyGrid& grid, int maxWidth, int maxHeight);
+    };
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <util/ObjectRecords.hpp>
+#include <util/OptimizerPipeline.hpp>
+#include <util/SpatialHash.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+namespace paibot {
+    // One cluster of an optimization result, as it sits in the level after
+    // the result was applied
+    struct OptimizedRegion {
+        ClusterKey key;
+        Aabb bounds;
+        uint64_t signature = 0;   // order independent hash of the members
+        uint32_t objects = 0;
+    };
+
+    struct IncrementalResult {
+        PipelineResult result;
+        size_t affectedRegions = 0;   // regions replaced, see RegionCache::affected
+        size_t reusedClusters = 0;    // clusters whose signature still matched
+        size_t rerunClusters = 0;     // clusters optimized again
+        size_t recordsInPlay = 0;     // records near the dirty boxes
+    };
+
+    // Optimized regions of an area the user keeps optimized. After edits,
+    // only the clusters around the edited boxes are looked at again, and of
+    // those only the ones whose signature changed go back through the passes.
+    // Triggers are not tracked: coalescing needs the whole timeline, so
+    // updates pass them through and they wait for a full run.
+    class RegionCache {
+    protected:
+        std::vector<OptimizedRegion> m_regions;
+        SpatialHash m_index;   // over region bounds
+        std::unordered_set<uint64_t> m_signatures;
+
+        void addClusters(const OptimizerPipeline& pipeline, const ObjectRecords& records);
+        void reindex();
+
+    public:
+        static uint64_t signature(const ObjectRecords& records, const std::vector<uint32_t>& members);
+
+        void clear();
+        bool empty() const { return m_regions.empty(); }
+        size_t size() const { return m_regions.size(); }
+        const std::vector<OptimizedRegion>& getRegions() const { return m_regions; }
+
+        // Regions of a freshly applied result
+        void reset(const OptimizerPipeline& pipeline, const ObjectRecords& optimized);
+
+        // Regions touching any of `dirty`, and the regions whose bounds
+        // overlap those, transitively: the regions an update replaces
+        std::vector<uint32_t> affected(const std::vector<Aabb>& dirty) const;
+        // `dirty` plus the bounds of the affected regions: the objects an
+        // update needs to see
+        std::vector<Aabb> area(const std::vector<Aabb>& dirty) const;
+
+        // `records` is the current state around the edits, typically every
+        // object touching area(dirty). Records away
+        // from the edits pass through unchanged and in order; the rest are
+        // re-clustered, and clusters that no longer match a cached region are
+        // optimized again. The cache then describes the new result.
+        IncrementalResult update(const OptimizerPipeline& pipeline, const ObjectRecords& records,
+                                 const std::vector<Aabb>& dirty);
+    };
+}
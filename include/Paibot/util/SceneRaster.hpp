@@ -0,0 +1,36 @@
+#pragma once
+
+#include <util/ObjectRecords.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+namespace paibot {
+    struct DeltaEStats {
+        float mean = 0.0f;
+        float p99 = 0.0f;
+        float max = 0.0f;
+        size_t pixels = 0;   // compared pixels (inside changed objects)
+        size_t tiles = 0;
+    };
+
+    struct RasterSettings {
+        float pixelSize = 7.5f;              // world units per pixel
+        int tilePixels = 256;                // tile edge; tiles are rendered independently
+        uint32_t background = 0x287DFF;      // 0xRRGGBB
+        uint32_t defaultColor = 0xFFFFFF;    // channels without a known colour
+        const std::unordered_map<int32_t, uint32_t>* channelColors = nullptr;
+    };
+
+    // Flat-colour software renderer for optimizer validation. Objects are
+    // drawn as oriented rects in their channel colour, back to front by
+    // z-layer/order, into low resolution CIE Lab tiles. Only pixels inside
+    // changed objects are compared, so a tile renders just the area around
+    // its changes and the objects drawn over it.
+    class SceneRaster {
+    public:
+        // Changes are records of `after` without a source plus records of
+        // `before` whose source is gone. Tiles are rendered on the worker pool.
+        static DeltaEStats compare(const ObjectRecords& before, const ObjectRecords& after, const RasterSettings& settings);
+    };
+}
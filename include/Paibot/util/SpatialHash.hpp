@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace paibot {
+    struct Aabb {
+        float minX = 0.0f;
+        float minY = 0.0f;
+        float maxX = 0.0f;
+        float maxY = 0.0f;
+
+        // Closed-interval test, so boxes that share an edge count as touching
+        bool touches(const Aabb& other, float margin = 0.0f) const {
+            return minX <= other.maxX + margin && other.minX <= maxX + margin &&
+                   minY <= other.maxY + margin && other.minY <= maxY + margin;
+        }
+        Aabb expanded(float margin) const { return {minX - margin, minY - margin, maxX + margin, maxY + margin}; }
+    };
+
+    // Uniform grid over object bounds, hashed into a flat bucket table. Built
+    // in one counting-sort pass: count entries per bucket, prefix sum, scatter
+    // indices. Queries are const and allocation free, so passes running on
+    // several threads can share one index.
+    //
+    // An object is entered once in every bucket its cells hash to; a query
+    // reports it only from the first overlapped cell of the query range,
+    // which removes duplicates without a visited set. Objects spanning more than
+    // kMaxCellsPerObject cells live in a separate list scanned by every query.
+    class SpatialHash {
+    public:
+        static constexpr int kMaxCellsPerObject = 64;
+
+        void build(const std::vector<Aabb>& boxes, float cellSize);
+        void clear();
+
+        size_t size() const { return m_boxes.size(); }
+        float getCellSize() const { return m_cellSize; }
+        const Aabb& getBox(uint32_t index) const { return m_boxes[index]; }
+
+        // fn(index) for every object whose box touches `box`
+        template <class Fn>
+        void forEachInBox(const Aabb& box, Fn&& fn) const {
+            if (m_boxes.empty()) {
+                return;
+            }
+            for (uint32_t index : m_oversized) {
+                if (m_boxes[index].touches(box)) {
+                    fn(index);
+                }
+            }
+            if (m_bucketMask == 0) {
+                return;
+            }
+            const int qx0 = cellOf(box.minX), qy0 = cellOf(box.minY);
+            const int qx1 = cellOf(box.maxX), qy1 = cellOf(box.maxY);
+            for (int cy = qy0; cy <= qy1; ++cy) {
+                for (int cx = qx0; cx <= qx1; ++cx) {
+                    const uint32_t bucket = bucketOf(cx, cy);
+                    for (uint32_t i = m_offsets[bucket]; i < m_offsets[bucket + 1]; ++i) {
+                        const uint32_t index = m_entries[i];
+                        const auto& cells = m_cells[index];
+                        // Skip hash collisions and report each object from one cell only
+                        if (cx < cells.x0 || cx > cells.x1 || cy < cells.y0 || cy > cells.y1 ||
+                            cx != std::max(qx0, cells.x0) || cy != std::max(qy0, cells.y0)) {
+                            continue;
+                        }
+                        if (m_boxes[index].touches(box)) {
+                            fn(index);
+                        }
+                    }
+                }
+            }
+        }
+
+        void queryBox(const Aabb& box, std::vector<uint32_t>& out) const;
+        // Objects touching `index` within `margin`, excluding itself
+        void queryNeighbours(uint32_t index, float margin, std::vector<uint32_t>& out) const;
+
+    protected:
+        struct CellRange {
+            int x0, y0, x1, y1;
+        };
+
+        float m_cellSize = 1.0f;
+        float m_invCellSize = 1.0f;
+        std::vector<Aabb> m_boxes;
+        std::vector<CellRange> m_cells;
+        std::vector<uint32_t> m_offsets;   // bucket -> first entry, size buckets + 1
+        std::vector<uint32_t> m_entries;   // object indices grouped by bucket
+        std::vector<uint32_t> m_oversized;
+        uint32_t m_bucketMask = 0;
+
+        int cellOf(float value) const { return static_cast<int>(std::floor(value * m_invCellSize)); }
+        uint32_t bucketOf(int cx, int cy) const {
+            const uint64_t h = static_cast<uint64_t>(static_cast<uint32_t>(cx)) * 0x9E3779B97F4A7C15ull ^
+                               static_cast<uint64_t>(static_cast<uint32_t>(cy)) * 0xC2B2AE3D27D4EB4Full;
+            return static_cast<uint32_t>(h >> 32) & m_bucketMask;
+        }
+    };
+}
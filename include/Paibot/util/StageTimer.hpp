@@ -0,0 +1,51 @@
+#pragma once
+
+#include <util/OptimizerTypes.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace paibot {
+    // Heap counters for stage reports. They only move when the host routes
+    // its allocation functions through record*() and enables them:
+    // paibot-opt does, the mod leaves the game's allocator alone.
+    class MemoryCounters {
+    public:
+        static void setEnabled(bool enabled);
+        static bool enabled();
+
+        // Called from the host's operator new / operator delete
+        static void recordAllocation(size_t bytes);
+        static void recordFree(size_t bytes);
+
+        // Process-wide, and for the calling thread only
+        static uint64_t allocations(bool thread);
+        static int64_t bytesInUse(bool thread);
+        // Highest bytesInUse since the last resetPeak
+        static int64_t peakBytes(bool thread);
+        static void resetPeak(bool thread);
+    };
+
+    // Measures one stage from construction to finish(). Inside a worker
+    // pool job, where nested work stays on the thread, only the calling
+    // thread's heap is counted; elsewhere the stage owns the process.
+    class StageTimer {
+    protected:
+        std::chrono::steady_clock::time_point m_start;
+        bool m_thread = false;
+        uint64_t m_allocations = 0;
+        int64_t m_bytes = 0;
+
+    public:
+        StageTimer();
+        StageStats finish(const char* name, size_t objectsIn, size_t objectsOut) const;
+    };
+
+    // Appends `stage`, or folds it into the stage of the same name: times,
+    // counts and allocations add up, the peak is the larger one
+    void addStage(std::vector<StageStats>& stages, const StageStats& stage);
+    // JSON array, one stage object per line, each line prefixed by `indent`
+    std::string stagesToJson(const std::vector<StageStats>& stages, const std::string& indent);
+}
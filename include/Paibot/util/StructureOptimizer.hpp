@@ -1,84 +1,114 @@
 #pragma once
 
 #include <Geode/Geode.hpp>
+#include <util/ObjectRecords.hpp>
+#include <util/OptimizerApplyTask.hpp>
+#include <util/OptimizerPipeline.hpp>
+#include <util/OptimizerTypes.hpp>
+#include <util/RegionCache.hpp>
+#include <util/SpatialHash.hpp>
+#include <unordered_map>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <memory>
 
 namespace paibot {
-    enum class OptimizationMode {
-        VanillaSafe,     // Only use vanilla GD objects
-        GeodeRuntime     // Use Geode runtime optimizations
-    };
-    
-    struct OptimizationStats {
-        int objectsBefore = 0;
-        int objectsAfter = 0;
-        float reductionPercentage = 0.0f;
-        float deltaE = 0.0f;      // Visual difference measure
-        float processingTime = 0.0f;
-        std::string operationId;  // Unique ID for logging
-    };
-    
-    // Scope & options for optimization run
-    struct OptimizeOptions {
-        // Scope
-        bool useSelectionOnly = true;   // false -> whole scene (not yet wired)
-        
-        // Inclusion filters
-        bool includeRotated = false;
-        bool includeNonUniformScale = false;
-        bool includeHidden = false;
-        bool includeLocked = false;
-        
-        // Object kinds
-        bool includeTiles = true;
-        bool includeWalls = true;
-        bool includeDecorRects = false;
-
-        // Behavior
-        bool keepExactSkins = true;           // if false, use canonical rectangular tile
-        bool respectHoles = true;             // if false, fill holes of same cluster
-        float colorTolerance = 0.0f;          // 0 = exact ccColor3B match
-        int maxWidthCells = 256;              // limit per piece to avoid huge scales
-        int maxHeightCells = 256;
-        bool forceGridSnap = true;            // snap to grid for generated rectangles
-        bool verboseLog = true;               // print detailed report to log
-    };
-    
     class StructureOptimizer {
     protected:
         OptimizationMode m_mode = OptimizationMode::VanillaSafe;
         
-        // Snapshot for undo functionality
-        std::vector<GameObject*> m_originalSnapshot;
+        // Value snapshot for revert: the editor save string of every
+        // affected object, packed into one arena. The weak reference tells
+        // whether the object still exists.
+        struct SnapshotEntry {
+            uint32_t offset = 0;
+            uint32_t length = 0;
+            geode::WeakRef<GameObject> object;
+        };
+        std::string m_snapshotArena;
+        std::vector<SnapshotEntry> m_snapshot;
+        // Objects placed by applyOptimization since the snapshot
+        std::vector<geode::WeakRef<GameObject>> m_snapshotAdded;
         bool m_hasSnapshot = false;
         
+        std::string_view snapshotString(const SnapshotEntry& entry) const {
+            return std::string_view(m_snapshotArena).substr(entry.offset, entry.length);
+        }
+        
         OptimizationStats m_lastStats;
-        std::vector<GameObject*> m_previewObjects;
+        PatternReport m_lastPatterns;
+        std::vector<InstanceDefinition> m_instanceDefinitions;
+        std::vector<TriggerRewrite> m_triggerRewrites;
+        // Per-pass steps of the last selection run
+        TargetReport m_lastTarget;
+        ObjectRecords m_previewRecords;
         bool m_isPreviewActive = false;
+        // Whole preview in one draw node on the object layer: one vertex
+        // buffer, one draw call, no per-object nodes
+        geode::Ref<cocos2d::CCDrawNode> m_previewNode;
+        static constexpr int kPreviewZOrder = 9999;
         OptimizeOptions m_options;
         
-        // Fusion rules validation
-        struct FusionRules {
-            bool allowColorMerging = true;
-            bool allowZGroupMerging = false;
-            float minValidArea = 1.0f;
-            bool rejectCorruptPolygons = true;
-        } m_fusionRules;
+        // Selection snapshot the passes run on. Records refer back to the
+        // selection by index; objects are only created again on apply. The
+        // user may delete or undo a source before then.
+        ObjectRecords m_records;
+        std::vector<geode::WeakRef<GameObject>> m_sourceObjects;
+        std::unordered_map<GameObject*, uint32_t> m_sourceLookup;
+        
+        // Neighbour index over m_records, built once per optimizeSelection
+        SpatialHash m_spatialIndex;
+        
+        // Tuning (setters below, snap grid comes from BrushManager)
+        int m_targetCount = 100;
+        float m_geometryTolerance = 0.1f;
+        float m_colorTolerance = 1.0f;
+        float m_snapGrid = 15.0f;
+        // Target mode: reduction to reach and the tolerance caps it may
+        // relax to (from BrushManager)
+        float m_targetReduction = 0.6f;
+        float m_maxGeometryTolerance = 1.0f;
+        float m_maxColorTolerance = 2.0f;
+        bool m_preserveGroupIDs = true;
+        bool m_preserveZOrder = true;
+        bool m_preserveChannels = true;
+        bool m_noTouchHitboxes = true;
+        
+        FusionRules m_fusionRules;
+        
+        // Clusters of the last result, and boxes edited since, for
+        // reoptimizeDirty
+        RegionCache m_regionCache;
+        std::vector<Aabb> m_dirtyBoxes;
+        
+        // Apply in progress; runs on the editor over several frames
+        geode::Ref<OptimizerApplyTask> m_applyTask;
+        float m_applyBudgetMs = 4.0f;
+        
+        OptimizerConfig makePipelineConfig() const;
         
     public:
         static StructureOptimizer* create();
         bool init();
+        ~StructureOptimizer();
         
         // Configuration - now reads from BrushManager
         void updateFromBrushManager();
         void setOptimizationMode(OptimizationMode mode);
         void setPreserveOptions(bool groupIDs, bool zOrder, bool channels, bool hitboxes);
+        void setTargetCount(int count);
+        void setGeometryTolerance(float tolerance);
+        void setColorTolerance(float deltaE);
+        // Editor time spent applying results per frame
+        void setApplyBudget(float milliseconds);
         
         // Snapshot management for undo/revert
         void createSnapshot(const std::vector<GameObject*>& objects);
         bool hasSnapshot() const { return m_hasSnapshot; }
+        size_t getSnapshotBytes() const { return m_snapshotArena.size() + m_snapshot.size() * sizeof(SnapshotEntry); }
+        // Restores removed and modified objects and deletes added ones in
+        // one batch; work is proportional to the snapshot, not the level
         void revertToSnapshot();
         void clearSnapshot();
         
@@ -92,39 +122,48 @@ namespace paibot {
         
         // Main optimization pipeline with integrity checks
         OptimizationStats optimizeSelection(const std::vector<GameObject*>& objects);
+        // Selection, or the whole level when options.useSelectionOnly is off
         OptimizationStats optimizeActiveSelection();
-        void showPreview(const std::vector<GameObject*>& optimized);
+        // Every object of the level, optimized in x-chunks
+        OptimizationStats optimizeLevel();
+        // Incremental updates: mark what an edit touches (before deleting
+        // or moving an object, and again after moving it), then re-run the
+        // passes for the clusters around those boxes only
+        void markDirty(GameObject* obj);
+        void markDirty(const geode::prelude::CCRect& rect);
+        bool hasDirtyRegions() const { return !m_dirtyBoxes.empty(); }
+        OptimizationStats reoptimizeDirty();
+        // Overlay of the result: merged pieces green, removed objects red,
+        // untouched objects outlined
+        void showPreview(const ObjectRecords& optimized);
         void hidePreview();
+        // Starts a frame-budgeted apply of the preview; returns immediately
         void applyOptimization();
+        bool isApplying() const { return m_applyTask && !m_applyTask->isDone(); }
         
-        // Optimization algorithms with validation
-        std::vector<GameObject*> normalizeObjects(const std::vector<GameObject*>& objects);
-        std::vector<GameObject*> mergeGeometric(const std::vector<GameObject*>& objects);
-        std::vector<GameObject*> findPatterns(const std::vector<GameObject*>& objects);
-        std::vector<GameObject*> polygonize(const std::vector<GameObject*>& objects);
-        std::vector<GameObject*> coalesceTriggers(const std::vector<GameObject*>& objects);
-        
-        // Geometric merging with fusion rules
-        std::vector<GameObject*> mergeLines(const std::vector<GameObject*>& objects);
-        std::vector<GameObject*> mergeMosaics(const std::vector<GameObject*>& objects);
-        std::vector<GameObject*> mergeSegments(const std::vector<GameObject*>& objects);
-        std::vector<GameObject*> mergeOverlaps(const std::vector<GameObject*>& objects);
-        std::vector<GameObject*> groupByColorAndZGroup(const std::vector<GameObject*>& objects);
-        std::vector<GameObject*> mergeAdjacentBlocks(const std::vector<GameObject*>& objects);
-        
-        // Pattern recognition
-        std::vector<GameObject*> createInstances(const std::vector<GameObject*>& objects);
-        std::vector<GameObject*> createCustomObjects(const std::vector<GameObject*>& objects);
+        // Selection <-> records
+        const ObjectRecords& extractRecords(const std::vector<GameObject*>& objects);
+        const ObjectRecords& getRecords() const { return m_records; }
+        // Originals for untouched records, new (autoreleased) objects otherwise
+        std::vector<GameObject*> materialize(const ObjectRecords& records) const;
         
         // Validation with integrity checks
-        float calculateDeltaE(const std::vector<GameObject*>& before, const std::vector<GameObject*>& after);
-        bool validateOptimization(const std::vector<GameObject*>& original, const std::vector<GameObject*>& optimized);
         bool validatePolygon(const std::vector<geode::prelude::CCPoint>& vertices);
         bool validateFusion(GameObject* obj1, GameObject* obj2);
         
+        // Spatial queries over the extracted selection (cell size = optimizer snap grid)
+        void buildSpatialIndex(const ObjectRecords& records);
+        std::vector<GameObject*> queryBox(const geode::prelude::CCRect& rect) const;
+        std::vector<GameObject*> queryNeighbours(GameObject* obj, float margin = 0.0f) const;
+        
         // Statistics and logging
         OptimizationStats getLastStats() const;
+        const PatternReport& getLastPatterns() const { return m_lastPatterns; }
+        const std::vector<InstanceDefinition>& getInstanceDefinitions() const { return m_instanceDefinitions; }
+        const std::vector<TriggerRewrite>& getTriggerRewrites() const { return m_triggerRewrites; }
         std::string generateReport() const;
+        // The last stats with every stage, for tracking across releases
+        std::string generateReportJson() const;
         std::string generateUniqueOperationId() const;
     };
 }
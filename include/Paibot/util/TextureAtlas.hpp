@@ -0,0 +1,49 @@
+#pragma once
+
+#include <util/MipChain.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace paibot {
+    struct AtlasRect {
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    // Shelf packer: rectangles are placed left to right on horizontal shelves,
+    // a new shelf opens when the current one is full. Feed it tallest-first.
+    class ShelfPacker {
+    protected:
+        int m_width;
+        int m_height;
+        int m_shelfY = 0;
+        int m_shelfHeight = 0;
+        int m_cursorX = 0;
+
+    public:
+        ShelfPacker(int width, int height) : m_width(width), m_height(height) {}
+        bool pack(int width, int height, AtlasRect& out);
+    };
+
+    // Packed RGBA atlas of equally treated images. `rects` hold the placement of
+    // each input image (without padding) in the same order as the inputs.
+    struct TextureAtlasImage {
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> rgba;
+        std::vector<AtlasRect> rects;
+
+        bool isEmpty() const { return rgba.empty(); }
+    };
+
+    class TextureAtlas {
+    public:
+        // Packs the images into the smallest power-of-two atlas up to maxSize.
+        // Each image gets a `padding` pixel gutter filled with wrapped texels so
+        // bilinear sampling of seamless tiles does not bleed into neighbours.
+        static bool build(const std::vector<const MipLevel*>& images, int padding, int maxSize,
+                          TextureAtlasImage& out);
+    };
+}
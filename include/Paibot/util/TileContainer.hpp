@@ -0,0 +1,113 @@
+#pragma once
+
+#include <util/Deflate.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace paibot {
+    // Binary tile set container (`.pbtiles`), little-endian:
+    //
+    //   header    magic "PBTILES\0", version, tile count/dimensions, deltaE,
+    //             offset+size of every section below, CRC-32 of the header
+    //   settings  opaque blob owned by the generator (versioned by the caller)
+    //   edges     edgePatterns: per tile a count followed by int32 values
+    //   compat    per tile and edge (top, right, bottom, left) a bitset over
+    //             all tiles that may sit on that side
+    //   tiles     one zlib stream of RGBA8 rows per tile
+    //   index     per tile: offset, compressed size, raw size, CRC-32, width, height
+    //
+    // Tiles are compressed independently so the reader can decode any one of
+    // them without touching the rest of the file.
+    constexpr uint32_t kTileContainerVersion = 1;
+
+    struct TileContainerSource {
+        int tileWidth = 0;
+        int tileHeight = 0;
+        size_t tileCount = 0;
+        float deltaE = 0.0f;
+        std::vector<uint8_t> settings;
+        std::vector<std::vector<int>> edgePatterns;
+        // Fills scanline `y` of tile `index` with `tileWidth` RGBA8 pixels
+        std::function<void(size_t index, int y, uint8_t* rgba)> readRow;
+    };
+
+    class TileContainerWriter {
+    public:
+        // Tiles are compressed on the worker pool a wave at a time, so peak
+        // memory stays around one raw tile per thread.
+        static bool write(const std::string& path, const TileContainerSource& source,
+                          DeflateLevel level = DeflateLevel::Default);
+    };
+
+    class TileContainer {
+    public:
+        struct TileEntry {
+            uint64_t offset = 0;
+            uint32_t compressedSize = 0;
+            uint32_t rawSize = 0;
+            uint32_t crc = 0;
+            uint32_t width = 0;
+            uint32_t height = 0;
+        };
+
+        using TilePixels = std::shared_ptr<const std::vector<uint8_t>>;
+
+        // Maps the file read-only and validates the header, section bounds and
+        // index. Tile data is not touched until first requested.
+        static std::shared_ptr<TileContainer> open(const std::string& path);
+
+        ~TileContainer();
+        TileContainer(const TileContainer&) = delete;
+        TileContainer& operator=(const TileContainer&) = delete;
+
+        size_t getTileCount() const { return m_entries.size(); }
+        int getTileWidth() const { return m_tileWidth; }
+        int getTileHeight() const { return m_tileHeight; }
+        float getDeltaE() const { return m_deltaE; }
+        const std::vector<uint8_t>& getSettings() const { return m_settings; }
+        const std::vector<std::vector<int>>& getEdgePatterns() const { return m_edgePatterns; }
+        const TileEntry& getEntry(size_t index) const { return m_entries[index]; }
+        const std::string& getPath() const { return m_path; }
+
+        // Whether tile `other` may be placed on `edge` (0 top, 1 right, 2 bottom, 3 left) of `tile`
+        bool isCompatible(size_t tile, int edge, size_t other) const;
+
+        // Decodes on first access (thread-safe) and keeps the pixels resident
+        // until released. Returns null when the chunk fails its checksum.
+        TilePixels getTile(size_t index);
+        void releaseTile(size_t index);
+        void releaseAll();
+        bool isResident(size_t index) const;
+        size_t getResidentBytes() const;
+
+    protected:
+        struct TileSlot {
+            mutable std::mutex mutex;
+            TilePixels pixels;
+        };
+
+        std::string m_path;
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+        void* m_mapping = nullptr;  // platform handle(s), see TileContainer.cpp
+
+        int m_tileWidth = 0;
+        int m_tileHeight = 0;
+        float m_deltaE = 0.0f;
+        std::vector<uint8_t> m_settings;
+        std::vector<std::vector<int>> m_edgePatterns;
+        std::vector<uint64_t> m_compatibility;
+        size_t m_compatWords = 0;
+        std::vector<TileEntry> m_entries;
+        std::unique_ptr<TileSlot[]> m_slots;
+
+        TileContainer() = default;
+        bool map(const std::string& path);
+        void unmap();
+        bool parse();
+    };
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace paibot {
+    // Shared fixed-size thread pool for CPU-bound generator/optimizer work.
+    // Kept free of Geode headers so the heavy passes can also run headlessly.
+    class WorkerPool {
+    private:
+        static WorkerPool* s_instance;
+
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+
+        // Current job (only one parallelFor runs at a time)
+        const std::function<void(size_t)>* m_job = nullptr;
+        size_t m_jobCount = 0;
+        std::atomic<size_t> m_nextIndex{0};
+        size_t m_activeWorkers = 0;
+        uint64_t m_generation = 0;
+        bool m_stopping = false;
+        std::mutex m_submitMutex;
+
+        explicit WorkerPool(unsigned threadCount);
+        void workerLoop();
+        void drainJob(const std::function<void(size_t)>& job, size_t count);
+
+    public:
+        static WorkerPool* get();
+        static void destroy();
+
+        ~WorkerPool();
+
+        // Number of threads that take part in a parallelFor, including the caller
+        unsigned getThreadCount() const { return static_cast<unsigned>(m_threads.size()) + 1; }
+
+        // Runs fn(i) for every i in [0, count). Indices are handed out dynamically so
+        // callers that care about balance should order them largest-first. Nested calls
+        // from inside a job run serially on the calling worker.
+        void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+        // True on a thread running a parallelFor job, where further calls run serially
+        static bool insideJob();
+    };
+}
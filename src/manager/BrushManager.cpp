@@ -54,6 +54,8 @@ void BrushManager::loadSettings() {
         m_gradientSeed = static_cast<int>(mod->getSettingValue<int64_t>("gradient-seed"));
         setOptimizerTargetReduction(mod->getSettingValue<double>("optimizer-target-reduction"));
         setOptimizerGeometryTolerance(mod->getSettingValue<double>("optimizer-geometry-tolerance"));
+        setOptimizerMaxGeometryTolerance(mod->getSettingValue<double>("optimizer-max-geometry-tolerance"));
+        setOptimizerMaxColorTolerance(mod->getSettingValue<double>("optimizer-max-color-tolerance"));
         setOptimizerSnapGrid(mod->getSettingValue<double>("optimizer-snap-grid"));
         m_seamlessTileSize = static_cast<int>(mod->getSettingValue<int64_t>("seamless-tile-size"));
         m_bgSize = static_cast<int>(mod->getSettingValue<int64_t>("bg-size"));
@@ -80,6 +82,8 @@ void BrushManager::saveSettings() {
     mod->setSavedValue("gradient-seed", m_gradientSeed);
     mod->setSavedValue("optimizer-target-reduction", m_optimizerTargetReduction);
     mod->setSavedValue("optimizer-geometry-tolerance", m_optimizerGeometryTolerance);
+    mod->setSavedValue("optimizer-max-geometry-tolerance", m_optimizerMaxGeometryTolerance);
+    mod->setSavedValue("optimizer-max-color-tolerance", m_optimizerMaxColorTolerance);
     mod->setSavedValue("optimizer-snap-grid", m_optimizerSnapGrid);
     mod->setSavedValue("seamless-tile-size", m_seamlessTileSize);
     mod->setSavedValue("bg-size", m_bgSize);
@@ -241,6 +245,22 @@ float BrushManager::getOptimizerGeometryTolerance() const {
     return m_optimizerGeometryTolerance;
 }
 
+void BrushManager::setOptimizerMaxGeometryTolerance(float tolerance) {
+    m_optimizerMaxGeometryTolerance = std::clamp(tolerance, 0.01f, 5.0f);
+}
+
+float BrushManager::getOptimizerMaxGeometryTolerance() const {
+    return m_optimizerMaxGeometryTolerance;
+}
+
+void BrushManager::setOptimizerMaxColorTolerance(float tolerance) {
+    m_optimizerMaxColorTolerance = std::clamp(tolerance, 0.0f, 10.0f);
+}
+
+float BrushManager::getOptimizerMaxColorTolerance() const {
+    return m_optimizerMaxColorTolerance;
+}
+
 void BrushManager::setOptimizerSnapGrid(float grid) {
     m_optimizerSnapGrid = std::clamp(grid, 1.0f, 30.0f);
 }
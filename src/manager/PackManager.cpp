@@ -96,6 +96,20 @@ bool PackManager::uninstallPack(const std::string& packId) {
         return false;
     }
     
+    // A container in use keeps its file mapped, and Windows will not delete
+    // a mapped file, so the pack stays until its backgrounds are released.
+    // Forgetting the cache entries would not unmap anything.
+    const std::string prefix = packId + "/";
+    for (const auto& [key, container] : m_backgroundContainers) {
+        if (key.starts_with(prefix) && !container.expired()) {
+            log::error("Cannot uninstall pack {}: background {} is still in use", packId, key.substr(prefix.size()));
+            return false;
+        }
+    }
+    std::erase_if(m_backgroundContainers, [&](const auto& entry) {
+        return entry.first.starts_with(prefix);
+    });
+    
     // Deactivate pack first
     deactivatePack(packId);
     
@@ -294,6 +308,30 @@ bool PackManager::isPackActive(const std::string& packId) const {
     return std::find(m_activePacks.begin(), m_activePacks.end(), packId) != m_activePacks.end();
 }
 
+std::shared_ptr<TileContainer> PackManager::openBackground(const std::string& packId, const std::string& background) {
+    if (m_loadedPacks.find(packId) == m_loadedPacks.end()) {
+        log::error("Cannot open background of unknown pack: {}", packId);
+        return nullptr;
+    }
+    
+    const std::string key = packId + "/" + background;
+    if (auto it = m_backgroundContainers.find(key); it != m_backgroundContainers.end()) {
+        if (auto container = it->second.lock()) {
+            return container;
+        }
+    }
+    
+    std::string path = m_packsDirectory + "/" + packId + "/backgrounds/" + background + ".pbtiles";
+    auto container = TileContainer::open(path);
+    if (!container) {
+        IntegrityLogger::get()->logError("PackManager", "Failed to open background container: " + path);
+        return nullptr;
+    }
+    
+    m_backgroundContainers[key] = container;
+    return container;
+}
+
 void PackManager::setPacksDirectory(const std::string& directory) {
     m_packsDirectory = directory;
     if (!std::filesystem::exists(m_packsDirectory)) {
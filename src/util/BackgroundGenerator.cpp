@@ -1,16 +1,191 @@
 #include <util/BackgroundGenerator.hpp>
 #include <manager/BrushManager.hpp>
 #include <util/IntegrityLogger.hpp>
+#include <util/WorkerPool.hpp>
+#include <util/ByteStream.hpp>
 #include <algorithm>
 #include <cmath>
 #include <random>
 #include <chrono>
 #include <iomanip>
 #include <sstream>
+#include <cstring>
 
 using namespace paibot;
 using namespace geode::prelude;
 
+namespace {
+    // Copies scanline `y` of a tile as RGBA8, padding/cropping to `width` pixels.
+    // Tiles created through initWithRawData are RGBA; decoded files may be RGB.
+    void copyTileRow(cocos2d::CCImage* tile, int y, int width, uint8_t* dst) {
+        const size_t rowBytes = static_cast<size_t>(width) * 4;
+        if (!tile || !tile->getData() || y < 0 || y >= tile->getHeight()) {
+            std::memset(dst, 0, rowBytes);
+            return;
+        }
+        
+        const int tileWidth = tile->getWidth();
+        const int channels = tile->hasAlpha() ? 4 : 3;
+        const uint8_t* src = tile->getData() + static_cast<size_t>(y) * tileWidth * channels;
+        const int copyWidth = std::min(width, tileWidth);
+        
+        if (channels == 4) {
+            std::memcpy(dst, src, static_cast<size_t>(copyWidth) * 4);
+        } else {
+            for (int x = 0; x < copyWidth; ++x) {
+                dst[x * 4 + 0] = src[x * 3 + 0];
+                dst[x * 4 + 1] = src[x * 3 + 1];
+                dst[x * 4 + 2] = src[x * 3 + 2];
+                dst[x * 4 + 3] = 255;
+            }
+        }
+        if (copyWidth < width) {
+            std::memset(dst + static_cast<size_t>(copyWidth) * 4, 0, rowBytes - static_cast<size_t>(copyWidth) * 4);
+        }
+    }
+    
+    // Same as above for a tile of a set, falling back to the set's container
+    // when the tile has not been materialized as a CCImage
+    void copyTileRow(const TileSet& tileSet, size_t index, int y, int width, uint8_t* dst) {
+        auto* tile = index < tileSet.tiles.size() ? tileSet.tiles[index] : nullptr;
+        if (tile || !tileSet.container) {
+            copyTileRow(tile, y, width, dst);
+            return;
+        }
+        
+        const size_t rowBytes = static_cast<size_t>(width) * 4;
+        auto pixels = tileSet.container->getTile(index);
+        const auto& entry = tileSet.container->getEntry(index);
+        if (!pixels || y < 0 || y >= static_cast<int>(entry.height)) {
+            std::memset(dst, 0, rowBytes);
+            return;
+        }
+        const size_t copyBytes = std::min(rowBytes, static_cast<size_t>(entry.width) * 4);
+        std::memcpy(dst, pixels->data() + static_cast<size_t>(y) * entry.width * 4, copyBytes);
+        if (copyBytes < rowBytes) {
+            std::memset(dst + copyBytes, 0, rowBytes - copyBytes);
+        }
+    }
+    
+    // Settings blob stored in .pbtiles containers (v2 adds normalStrength)
+    constexpr uint32_t kSettingsBlobVersion = 2;
+    
+    std::vector<uint8_t> encodeSettings(const BackgroundSettings& settings) {
+        std::vector<uint8_t> blob;
+        ByteWriter writer(blob);
+        writer.u32(kSettingsBlobVersion);
+        writer.u32(static_cast<uint32_t>(settings.type));
+        writer.i32(settings.tileSize);
+        writer.f32(settings.continuity);
+        writer.f32(settings.variety);
+        writer.i32(settings.noiseSeed);
+        writer.i32(settings.parallaxLayers);
+        writer.string(std::filesystem::path(settings.sourceImagePath).filename().string());
+        writer.u32(static_cast<uint32_t>(settings.noiseType));
+        writer.f32(settings.noiseScale);
+        writer.i32(settings.octaves);
+        writer.f32(settings.persistence);
+        writer.f32(settings.lacunarity);
+        writer.i32(settings.version);
+        writer.f32(settings.colorTolerance);
+        writer.i32(settings.maxColors);
+        writer.f32(settings.simplificationTolerance);
+        writer.i32(settings.targetResolution);
+        writer.u8(settings.optimizeForTiling ? 1 : 0);
+        writer.f32(settings.normalStrength);
+        return blob;
+    }
+    
+    bool decodeSettings(const std::vector<uint8_t>& blob, BackgroundSettings& settings) {
+        ByteReader reader(blob.data(), blob.size());
+        const uint32_t version = reader.u32();
+        if (version == 0 || version > kSettingsBlobVersion) {
+            return false;
+        }
+        BackgroundSettings decoded;
+        decoded.type = static_cast<BackgroundType>(std::min<uint32_t>(reader.u32(), static_cast<uint32_t>(BackgroundType::Geometrization)));
+        decoded.tileSize = reader.i32();
+        decoded.continuity = reader.f32();
+        decoded.variety = reader.f32();
+        decoded.noiseSeed = reader.i32();
+        decoded.parallaxLayers = reader.i32();
+        decoded.sourceImagePath = reader.string();
+        decoded.noiseType = static_cast<NoiseType>(std::min<uint32_t>(reader.u32(), static_cast<uint32_t>(NoiseType::Worley)));
+        decoded.noiseScale = reader.f32();
+        decoded.octaves = reader.i32();
+        decoded.persistence = reader.f32();
+        decoded.lacunarity = reader.f32();
+        decoded.version = reader.i32();
+        decoded.colorTolerance = reader.f32();
+        decoded.maxColors = reader.i32();
+        decoded.simplificationTolerance = reader.f32();
+        decoded.targetResolution = reader.i32();
+        decoded.optimizeForTiling = reader.u8() != 0;
+        if (version >= 2) {
+            decoded.normalStrength = reader.f32();
+        }
+        if (!reader.ok()) {
+            return false;
+        }
+        settings = decoded;
+        return true;
+    }
+    
+    OctaveNoiseParams octaveParams(const BackgroundSettings& settings, int size, float scale, int octaves) {
+        OctaveNoiseParams params;
+        params.size = size;
+        params.scale = scale;
+        params.octaves = octaves;
+        params.persistence = settings.persistence;
+        params.lacunarity = settings.lacunarity;
+        params.seed = static_cast<uint32_t>(settings.noiseSeed);
+        return params;
+    }
+    
+    cocos2d::CCImage* heightfieldToCCImage(const HeightField& field) {
+        if (field.isEmpty()) {
+            return nullptr;
+        }
+        std::vector<unsigned char> pixels(field.values.size() * 4);
+        for (size_t i = 0; i < field.values.size(); ++i) {
+            const auto channel = static_cast<unsigned char>(field.values[i] * 255.0f);
+            pixels[i * 4 + 0] = channel;
+            pixels[i * 4 + 1] = channel;
+            pixels[i * 4 + 2] = channel;
+            pixels[i * 4 + 3] = 255;
+        }
+        auto image = new cocos2d::CCImage();
+        if (!image->initWithRawData(pixels.data(), static_cast<int>(pixels.size()), field.width, field.height, 8, true)) {
+            delete image;
+            return nullptr;
+        }
+        return image;
+    }
+    
+    // Grayscale RGBA of a heightfield. `coverage` > 0 fades out everything
+    // below that height so front parallax layers only keep their peaks.
+    MipLevel heightfieldToImage(const HeightField& field, float coverage) {
+        MipLevel image;
+        image.width = field.width;
+        image.height = field.height;
+        image.rgba.resize(field.values.size() * 4);
+        constexpr float kFade = 0.15f;
+        for (size_t i = 0; i < field.values.size(); ++i) {
+            const float h = field.values[i];
+            const auto channel = static_cast<uint8_t>(h * 255.0f);
+            float alpha = 1.0f;
+            if (coverage > 0.0f) {
+                alpha = std::clamp((h - coverage) / kFade, 0.0f, 1.0f);
+            }
+            image.rgba[i * 4 + 0] = channel;
+            image.rgba[i * 4 + 1] = channel;
+            image.rgba[i * 4 + 2] = channel;
+            image.rgba[i * 4 + 3] = static_cast<uint8_t>(alpha * 255.0f);
+        }
+        return image;
+    }
+}
+
 BackgroundGenerator* BackgroundGenerator::create() {
     auto ret = new (std::nothrow) BackgroundGenerator();
     if (ret && ret->init()) {
@@ -117,6 +292,9 @@ TileSet BackgroundGenerator::generateBackground() {
             return TileSet{}; // Return empty tile set
         }
         
+        // Fresh mip cache shared by every copy of this tile set (built on first use)
+        tileSet.mipCache = std::make_shared<TileMipCache>();
+        
         // Store as last valid if generation succeeded
         if (tileSet.isValid()) {
             m_lastValidTileSet = tileSet;
@@ -182,22 +360,23 @@ void BackgroundGenerator::exportTileSet(const std::string& path) {
         // Create export directory
         std::filesystem::create_directories(path);
         
-        // 1. Export preset.json with settings and metadata
-        std::string presetPath = path + "/preset.json";
-        exportPresetJson(presetPath);
+        // 1. Binary container (settings, edges, compatibility and tiles in one file)
+        exportTileContainer(path + "/tiles.pbtiles");
         
         // 2. Export spritesheet PNG
         std::string spritesheetPath = path + "/spritesheet.png";
         exportSpritesheet(spritesheetPath);
         
-        // 3. Generate thumbnail
+        // 3. Export individual tiles
+        exportTilePngs(path + "/tiles");
+        
+        // 4. Generate thumbnail
         std::string thumbnailPath = path + "/thumbnail.png";
         generateThumbnail(thumbnailPath);
         
-        // 4. Export compatibility matrix (for Wang tiles)
-        if (m_settings.type == BackgroundType::WangTiles) {
-            std::string matrixPath = path + "/compatibility.json";
-            exportCompatibilityMatrix(matrixPath);
+        // 5. Normal map and parallax layers (procedural only)
+        if (m_currentTileSet.layers) {
+            exportLayers(path);
         }
         
         log::info("Export completed successfully to {}", path);
@@ -207,99 +386,65 @@ void BackgroundGenerator::exportTileSet(const std::string& path) {
     }
 }
 
-void BackgroundGenerator::exportPresetJson(const std::string& path) {
-    std::ofstream file(path);
-    
-    // Export preset in simple key-value format
-    file << "{\n";
-    file << "  \"name\": \"Background Preset\",\n";
-    file << "  \"version\": " << m_settings.version << ",\n";
-    file << "  \"type\": \"" << backgroundTypeToString(m_settings.type) << "\",\n";
-    file << "  \"created\": \"" << getCurrentTimestamp() << "\",\n";
-    file << "  \"hash\": \"" << calculatePresetHash() << "\",\n";
-    file << "  \"settings\": {\n";
-    file << "    \"tileSize\": " << m_settings.tileSize << ",\n";
-    file << "    \"seed\": " << m_settings.noiseSeed << ",\n";
-    file << "    \"continuity\": " << m_settings.continuity << ",\n";
-    file << "    \"variety\": " << m_settings.variety;
-    
-    if (m_settings.type == BackgroundType::Procedural) {
-        file << ",\n    \"noiseType\": \"" << noiseTypeToString(m_settings.noiseType) << "\",\n";
-        file << "    \"noiseScale\": " << m_settings.noiseScale << ",\n";
-        file << "    \"octaves\": " << m_settings.octaves << ",\n";
-        file << "    \"persistence\": " << m_settings.persistence << ",\n";
-        file << "    \"lacunarity\": " << m_settings.lacunarity;
-    } else if (m_settings.type == BackgroundType::Geometrization) {
-        file << ",\n    \"colorTolerance\": " << m_settings.colorTolerance << ",\n";
-        file << "    \"maxColors\": " << m_settings.maxColors << ",\n";
-        file << "    \"simplificationTolerance\": " << m_settings.simplificationTolerance << ",\n";
-        file << "    \"targetResolution\": " << m_settings.targetResolution << ",\n";
-        file << "    \"optimizeForTiling\": " << (m_settings.optimizeForTiling ? "true" : "false");
-        if (!m_settings.sourceImagePath.empty()) {
-            file << ",\n    \"sourceImage\": \"" << std::filesystem::path(m_settings.sourceImagePath).filename().string() << "\"";
-        }
+void BackgroundGenerator::exportSpritesheet(const std::string& path) {
+    if (m_currentTileSet.tiles.empty()) {
+        return;
     }
     
-    file << "\n  },\n";
-    file << "  \"compatibility\": {\n";
-    file << "    \"gameVersion\": \"2.207\",\n";
-    file << "    \"geodeVersion\": \"4.8.0\",\n";
-    file << "    \"paibotVersion\": \"0.1.0\"\n";
-    file << "  },\n";
-    file << "  \"quality\": {\n";
-    file << "    \"deltaE\": " << m_currentTileSet.deltaE << ",\n";
-    file << "    \"seamlessness\": " << calculateSeamlessness(m_currentTileSet.tiles.empty() ? nullptr : m_currentTileSet.tiles[0]) << ",\n";
-    file << "    \"tileCount\": " << m_currentTileSet.tiles.size() << "\n";
-    file << "  }\n";
-    file << "}\n";
+    // Calculate spritesheet dimensions
+    const int tileSize = m_currentTileSet.tileSize;
+    int tileCount = static_cast<int>(m_currentTileSet.tiles.size());
+    int tilesPerRow = static_cast<int>(std::ceil(std::sqrt(tileCount)));
+    int totalWidth = tilesPerRow * tileSize;
+    int totalHeight = ((tileCount + tilesPerRow - 1) / tilesPerRow) * tileSize;
+    
+    // Scanlines are assembled on demand from the tile buffers, so the atlas is
+    // never materialized (a 16-tile 2048px sheet would otherwise be 256 MB)
+    auto rowSource = [&](int y, uint8_t* row) {
+        int tileRow = y / tileSize;
+        int tileY = y % tileSize;
+        for (int col = 0; col < tilesPerRow; ++col) {
+            int index = tileRow * tilesPerRow + col;
+            uint8_t* dst = row + static_cast<size_t>(col) * tileSize * 4;
+            if (index < tileCount) {
+                copyTileRow(m_currentTileSet, static_cast<size_t>(index), tileY, tileSize, dst);
+            } else {
+                std::memset(dst, 0, static_cast<size_t>(tileSize) * 4);
+            }
+        }
+    };
+    
+    PngWriteStats stats;
+    if (!PngWriter::write(path, totalWidth, totalHeight, rowSource, getPngWriteOptions(), &stats)) {
+        IntegrityLogger::get()->logError("BackgroundGenerator", "Failed to write spritesheet: " + path);
+        return;
+    }
     
-    file.close();
+    log::info("Wrote spritesheet: {}x{} with {} tiles ({} KB, {} blocks)", 
+              totalWidth, totalHeight, tileCount, stats.compressedBytes / 1024, stats.blocks);
 }
 
-void BackgroundGenerator::exportSpritesheet(const std::string& path) {
+void BackgroundGenerator::exportTilePngs(const std::string& directory) {
     if (m_currentTileSet.tiles.empty()) {
         return;
     }
     
-    // Calculate spritesheet dimensions
-    int tileCount = static_cast<int>(m_currentTileSet.tiles.size());
-    int tilesPerRow = static_cast<int>(std::ceil(std::sqrt(tileCount)));
-    int totalWidth = tilesPerRow * m_currentTileSet.tileSize;
-    int totalHeight = ((tileCount + tilesPerRow - 1) / tilesPerRow) * m_currentTileSet.tileSize;
-    
-    // Create spritesheet pixel data
-    std::vector<unsigned char> spritesheetPixels(totalWidth * totalHeight * 4, 0);
-    
-    // Copy each tile to the spritesheet
-    for (int i = 0; i < tileCount; ++i) {
-        int row = i / tilesPerRow;
-        int col = i % tilesPerRow;
-        int offsetX = col * m_currentTileSet.tileSize;
-        int offsetY = row * m_currentTileSet.tileSize;
-        
-        // Copy tile pixels (placeholder - would need actual image data access in real implementation)
-        // For now, create a colored rectangle for each tile
-        cocos2d::ccColor3B tileColor = {
-            static_cast<unsigned char>((i * 50) % 255),
-            static_cast<unsigned char>((i * 100) % 255),
-            static_cast<unsigned char>((i * 150) % 255)
-        };
+    std::filesystem::create_directories(directory);
+    
+    const int tileSize = m_currentTileSet.tileSize;
+    auto options = getPngWriteOptions();
+    for (size_t i = 0; i < m_currentTileSet.tiles.size(); ++i) {
+        std::string tilePath = fmt::format("{}/tile_{:03}.png", directory, i);
+        bool written = PngWriter::write(tilePath, tileSize, tileSize, [&](int y, uint8_t* row) {
+            copyTileRow(m_currentTileSet, i, y, tileSize, row);
+        }, options);
         
-        for (int y = 0; y < m_currentTileSet.tileSize; ++y) {
-            for (int x = 0; x < m_currentTileSet.tileSize; ++x) {
-                int pixelIndex = ((offsetY + y) * totalWidth + (offsetX + x)) * 4;
-                if (pixelIndex + 3 < static_cast<int>(spritesheetPixels.size())) {
-                    spritesheetPixels[pixelIndex] = tileColor.r;
-                    spritesheetPixels[pixelIndex + 1] = tileColor.g;
-                    spritesheetPixels[pixelIndex + 2] = tileColor.b;
-                    spritesheetPixels[pixelIndex + 3] = 255;
-                }
-            }
+        if (!written) {
+            IntegrityLogger::get()->logError("BackgroundGenerator", "Failed to write tile: " + tilePath);
         }
     }
     
-    // In real implementation, would save PNG file here
-    log::info("Generated spritesheet: {}x{} with {} tiles", totalWidth, totalHeight, tileCount);
+    log::info("Wrote {} tile PNGs to {}", m_currentTileSet.tiles.size(), directory);
 }
 
 void BackgroundGenerator::generateThumbnail(const std::string& path) {
@@ -309,43 +454,113 @@ void BackgroundGenerator::generateThumbnail(const std::string& path) {
         return;
     }
     
-    // Create thumbnail by scaling down the first tile or a preview
-    std::vector<unsigned char> thumbnailPixels(thumbnailSize * thumbnailSize * 4);
+    // Taken from the first tile's mip chain (exact level for power-of-two tiles)
+    auto thumbnail = getTileImage(m_currentTileSet, 0, thumbnailSize);
+    if (thumbnail.isEmpty()) {
+        IntegrityLogger::get()->logError("BackgroundGenerator", "Thumbnail source tile unavailable");
+        return;
+    }
     
-    // Create a simple thumbnail (placeholder)
-    for (int y = 0; y < thumbnailSize; ++y) {
-        for (int x = 0; x < thumbnailSize; ++x) {
-            int pixelIndex = (y * thumbnailSize + x) * 4;
-            
-            // Create a gradient pattern for the thumbnail
-            thumbnailPixels[pixelIndex] = static_cast<unsigned char>((x * 255) / thumbnailSize);
-            thumbnailPixels[pixelIndex + 1] = static_cast<unsigned char>((y * 255) / thumbnailSize);
-            thumbnailPixels[pixelIndex + 2] = 128;
-            thumbnailPixels[pixelIndex + 3] = 255;
-        }
+    if (!PngWriter::writeRGBA(path, thumbnail.width, thumbnail.height, thumbnail.rgba.data(), getPngWriteOptions())) {
+        IntegrityLogger::get()->logError("BackgroundGenerator", "Failed to write thumbnail: " + path);
+        return;
     }
     
     log::info("Generated thumbnail: {}x{}", thumbnailSize, thumbnailSize);
 }
 
-void BackgroundGenerator::exportCompatibilityMatrix(const std::string& path) {
-    std::ofstream file(path);
+void BackgroundGenerator::exportLayers(const std::string& directory) {
+    auto layers = m_currentTileSet.layers;
+    if (!layers || layers->isEmpty()) {
+        return;
+    }
     
-    // Export edge compatibility information for Wang tiles in simple format
-    file << "# Wang Tile Compatibility Matrix\n";
-    file << "tile_count=" << m_currentTileSet.tiles.size() << "\n";
-    file << "edge_patterns:\n";
+    auto options = getPngWriteOptions();
+    const auto& normal = layers->normalMap;
+    if (!normal.isEmpty() &&
+        !PngWriter::writeRGBA(directory + "/normal.png", normal.width, normal.height, normal.rgba.data(), options)) {
+        IntegrityLogger::get()->logError("BackgroundGenerator", "Failed to write normal map: " + directory);
+    }
     
-    for (size_t i = 0; i < m_currentTileSet.edgePatterns.size(); ++i) {
-        file << "tile_" << i << "=";
-        for (size_t j = 0; j < m_currentTileSet.edgePatterns[i].size(); ++j) {
-            if (j > 0) file << ",";
-            file << m_currentTileSet.edgePatterns[i][j];
+    if (!layers->parallax.empty()) {
+        std::filesystem::create_directories(directory + "/parallax");
+    }
+    for (size_t i = 0; i < layers->parallax.size(); ++i) {
+        const auto& layer = layers->parallax[i];
+        std::string layerPath = fmt::format("{}/parallax/layer_{}.png", directory, i);
+        if (!PngWriter::writeRGBA(layerPath, layer.width, layer.height, layer.rgba.data(), options)) {
+            IntegrityLogger::get()->logError("BackgroundGenerator", "Failed to write parallax layer: " + layerPath);
         }
-        file << "\n";
     }
     
-    file.close();
+    log::info("Wrote normal map and {} parallax layers to {}", layers->parallax.size(), directory);
+}
+
+bool BackgroundGenerator::exportTileContainer(const std::string& path) {
+    if (!m_currentTileSet.isValid()) {
+        return false;
+    }
+    
+    TileContainerSource source;
+    source.tileWidth = m_currentTileSet.tileSize;
+    source.tileHeight = m_currentTileSet.tileSize;
+    source.tileCount = m_currentTileSet.tiles.size();
+    source.deltaE = m_currentTileSet.deltaE;
+    source.settings = encodeSettings(m_settings);
+    source.edgePatterns = m_currentTileSet.edgePatterns;
+    source.readRow = [this](size_t index, int y, uint8_t* rgba) {
+        copyTileRow(m_currentTileSet, index, y, m_currentTileSet.tileSize, rgba);
+    };
+    
+    if (!TileContainerWriter::write(path, source, getPngWriteOptions().level)) {
+        IntegrityLogger::get()->logError("BackgroundGenerator", "Failed to write tile container: " + path);
+        return false;
+    }
+    
+    log::info("Wrote tile container: {} ({} tiles)", path, source.tileCount);
+    return true;
+}
+
+bool BackgroundGenerator::importTileContainer(const std::string& path) {
+    auto container = TileContainer::open(path);
+    if (!container) {
+        IntegrityLogger::get()->logError("BackgroundGenerator", "Invalid tile container: " + path);
+        return false;
+    }
+    return importTileContainer(std::move(container));
+}
+
+bool BackgroundGenerator::importTileContainer(std::shared_ptr<TileContainer> container) {
+    if (!container) {
+        return false;
+    }
+    
+    BackgroundSettings settings = m_settings;
+    if (!decodeSettings(container->getSettings(), settings)) {
+        IntegrityLogger::get()->logWarning("BackgroundGenerator", "Unknown settings blob in " + container->getPath());
+    }
+    
+    // Only the index is read here; pixels stay in the mapping until a tile is used
+    TileSet tileSet;
+    tileSet.tiles.assign(container->getTileCount(), nullptr);
+    tileSet.edgePatterns = container->getEdgePatterns();
+    tileSet.tileSize = container->getTileWidth();
+    tileSet.deltaE = container->getDeltaE();
+    tileSet.mipCache = std::make_shared<TileMipCache>();
+    tileSet.container = std::move(container);
+    
+    if (!validateNonEmptyTileSet(tileSet)) {
+        return false;
+    }
+    
+    settings.tileSize = tileSet.tileSize;
+    m_settings = settings;
+    m_currentTileSet = tileSet;
+    m_lastValidTileSet = tileSet;
+    m_generationValid = true;
+    
+    log::info("Imported {} tiles from {}", tileSet.tiles.size(), tileSet.container->getPath());
+    return true;
 }
 
 std::string BackgroundGenerator::backgroundTypeToString(BackgroundType type) {
@@ -377,6 +592,13 @@ std::string BackgroundGenerator::getCurrentTimestamp() {
     return ss.str();
 }
 
+PngWriteOptions BackgroundGenerator::getPngWriteOptions() const {
+    PngWriteOptions options;
+    options.filter = PngFilter::Adaptive;
+    options.level = m_settings.fastExport ? DeflateLevel::Fast : DeflateLevel::Default;
+    return options;
+}
+
 std::string BackgroundGenerator::calculatePresetHash() {
     // Create hash from settings for reproducibility verification
     std::stringstream ss;
@@ -455,8 +677,31 @@ TileSet BackgroundGenerator::generateProcedural() {
     TileSet tileSet;
     tileSet.tileSize = m_settings.tileSize;
 
-    // Generate a simple procedural noise pattern
-    auto heightmap = generatePerlinNoise(m_settings.tileSize, m_settings.noiseScale, m_settings.octaves);
+    // Octaves are evaluated once; the tile, normal map and every parallax
+    // layer are normalizations of the same running sum. Layer i keeps the
+    // first ceil((i + 1) * octaves / layerCount) octaves, so the back layer
+    // is the smoothest and the front one has full detail. Each layer is
+    // turned into its image as soon as the sum reaches its cutoff.
+    const int octaveCount = std::max(1, m_settings.octaves);
+    const int layerCount = std::clamp(m_settings.parallaxLayers, 1, 8);
+    std::vector<int> cutoffs;
+    if (layerCount > 1) {
+        for (int i = 0; i < layerCount; ++i) {
+            cutoffs.push_back(std::max(1, ((i + 1) * octaveCount + layerCount - 1) / layerCount));
+        }
+    }
+    std::vector<MipLevel> parallax;
+    parallax.reserve(cutoffs.size());
+    OctaveStack octaves;
+    octaves.build(octaveParams(m_settings, m_settings.tileSize, m_settings.noiseScale, octaveCount), cutoffs,
+                  [&](int, HeightField&& field) {
+        const int i = static_cast<int>(parallax.size());
+        const float coverage = i == 0 ? 0.0f : 0.35f + 0.3f * static_cast<float>(i) / (layerCount - 1);
+        parallax.push_back(heightfieldToImage(field, coverage));
+    });
+    HeightField heightfield = octaves.compose();
+    octaves.clear();
+    auto heightmap = heightfieldToCCImage(heightfield);
     
     if (heightmap) {
         // Apply color palette (simplified)
@@ -472,6 +717,7 @@ TileSet BackgroundGenerator::generateProcedural() {
         if (coloredTile) {
             // Re-enable tile population so preview/export receive usable data.
             tileSet.tiles.push_back(coloredTile);
+            tileSet.layers = generateLayers(heightfield, std::move(parallax));
         } else {
             delete heightmap;
         }
@@ -484,6 +730,19 @@ TileSet BackgroundGenerator::generateProcedural() {
     return tileSet;
 }
 
+std::shared_ptr<const TileLayers> BackgroundGenerator::generateLayers(const HeightField& heightfield,
+                                                                      std::vector<MipLevel> parallax) {
+    auto layers = std::make_shared<TileLayers>();
+    
+    layers->normalMap.width = heightfield.width;
+    layers->normalMap.height = heightfield.height;
+    NormalMap::fromHeightField(heightfield, m_settings.normalStrength, true, layers->normalMap.rgba);
+    layers->parallax = std::move(parallax);
+    
+    log::debug("Derived normal map and {} parallax layers", layers->parallax.size());
+    return layers;
+}
+
 cocos2d::CCImage* BackgroundGenerator::generatePerlinNoise(int size, float scale, int octaves) {
     // Simplified Perlin noise implementation
     // In real implementation, would use proper Perlin noise with tileable properties
@@ -491,57 +750,12 @@ cocos2d::CCImage* BackgroundGenerator::generatePerlinNoise(int size, float scale
         return nullptr;
     }
 
-    std::mt19937 rng(m_settings.noiseSeed);
-    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
-
-    const int octaveCount = std::max(1, octaves);
-    std::vector<float> octaveOffsets(octaveCount);
-    for (int i = 0; i < octaveCount; ++i) {
-        octaveOffsets[i] = dist(rng) * 6.28318f; // Random phase per octave
+    OctaveStack stack;
+    stack.build(octaveParams(m_settings, size, scale, octaves));
+    auto image = heightfieldToCCImage(stack.compose());
+    if (image) {
+        log::info("Generated {}x{} Perlin noise with scale {}", size, size, static_cast<double>(scale));
     }
-
-    std::vector<unsigned char> pixels(size * size * 4);
-    for (int y = 0; y < size; ++y) {
-        for (int x = 0; x < size; ++x) {
-            float amplitude = 1.0f;
-            float frequency = std::max(0.01f, scale);
-            float value = 0.0f;
-            float amplitudeSum = 0.0f;
-
-            for (int octave = 0; octave < octaveCount; ++octave) {
-                float sampleX = (static_cast<float>(x) / size) * frequency + octaveOffsets[octave];
-                float sampleY = (static_cast<float>(y) / size) * frequency + octaveOffsets[octave] * 0.5f;
-                float sample = std::sin(sampleX) * std::cos(sampleY);
-
-                value += sample * amplitude;
-                amplitudeSum += amplitude;
-
-                amplitude *= 0.5f;
-                frequency *= 2.0f;
-            }
-
-            if (amplitudeSum > 0.0f) {
-                value /= amplitudeSum;
-            }
-
-            float normalized = std::clamp(0.5f + 0.5f * value, 0.0f, 1.0f);
-            unsigned char channel = static_cast<unsigned char>(normalized * 255.0f);
-            size_t idx = static_cast<size_t>(y) * size * 4 + static_cast<size_t>(x) * 4;
-            pixels[idx + 0] = channel;
-            pixels[idx + 1] = channel;
-            pixels[idx + 2] = channel;
-            pixels[idx + 3] = 255;
-        }
-    }
-
-    auto image = new cocos2d::CCImage();
-    if (!image->initWithRawData(pixels.data(), static_cast<int>(pixels.size()), size, size, 8, true)) {
-        delete image;
-        return nullptr;
-    }
-
-    log::info("Generated {}x{} Perlin noise with scale {}", size, size, static_cast<double>(scale));
-
     return image;
 }
 
@@ -738,19 +952,19 @@ cocos2d::ccColor3B BackgroundGenerator::blendColors(const cocos2d::ccColor3B& c1
     };
 }
 
-std::vector<std::vector<int>> BackgroundGenerator::generateTileLayout(int width, int height) {
+std::vector<std::vector<int>> BackgroundGenerator::generateTileLayout(const TileSet& tileSet, int width, int height) {
     std::vector<std::vector<int>> layout(height, std::vector<int>(width, 0));
     
-    if (m_currentTileSet.tiles.empty() || m_currentTileSet.edgePatterns.empty()) {
+    if (tileSet.tiles.empty() || tileSet.edgePatterns.empty()) {
         log::error("Cannot generate layout: no tiles or edge patterns available");
         return layout;
     }
     
-    int tileCount = static_cast<int>(m_currentTileSet.tiles.size());
+    int tileCount = static_cast<int>(tileSet.tiles.size());
     std::mt19937 rng(m_settings.noiseSeed);
     
     // Use backtracking algorithm to place compatible tiles
-    if (placeTileRecursive(layout, 0, 0, width, height, tileCount, rng)) {
+    if (placeTileRecursive(tileSet, layout, 0, 0, width, height, tileCount, rng)) {
         log::info("Successfully generated {}x{} Wang tile layout", width, height);
     } else {
         log::warn("Failed to generate valid Wang tile layout, using fallback");
@@ -766,7 +980,7 @@ std::vector<std::vector<int>> BackgroundGenerator::generateTileLayout(int width,
     return layout;
 }
 
-bool BackgroundGenerator::placeTileRecursive(std::vector<std::vector<int>>& layout, 
+bool BackgroundGenerator::placeTileRecursive(const TileSet& tileSet, std::vector<std::vector<int>>& layout,
                                            int x, int y, int width, int height, 
                                            int tileCount, std::mt19937& rng) {
     if (y >= height) {
@@ -782,7 +996,7 @@ bool BackgroundGenerator::placeTileRecursive(std::vector<std::vector<int>>& layo
     
     std::vector<int> candidateTiles;
     for (int tileIdx = 0; tileIdx < tileCount; ++tileIdx) {
-        if (isTileCompatibleAtPosition(layout, x, y, width, height, tileIdx)) {
+        if (isTileCompatibleAtPosition(tileSet, layout, x, y, width, height, tileIdx)) {
             candidateTiles.push_back(tileIdx);
         }
     }
@@ -798,7 +1012,7 @@ bool BackgroundGenerator::placeTileRecursive(std::vector<std::vector<int>>& layo
     for (int tileIdx : candidateTiles) {
         layout[y][x] = tileIdx;
         
-        if (placeTileRecursive(layout, nextX, nextY, width, height, tileCount, rng)) {
+        if (placeTileRecursive(tileSet, layout, nextX, nextY, width, height, tileCount, rng)) {
             return true;
         }
     }
@@ -806,22 +1020,23 @@ bool BackgroundGenerator::placeTileRecursive(std::vector<std::vector<int>>& layo
     return false; // Backtrack
 }
 
-bool BackgroundGenerator::isTileCompatibleAtPosition(const std::vector<std::vector<int>>& layout,
+bool BackgroundGenerator::isTileCompatibleAtPosition(const TileSet& tileSet,
+                                                   const std::vector<std::vector<int>>& layout,
                                                    int x, int y, int width, int height,
                                                    int tileIdx) {
-    if (tileIdx >= static_cast<int>(m_currentTileSet.edgePatterns.size())) {
+    if (tileIdx >= static_cast<int>(tileSet.edgePatterns.size())) {
         return false;
     }
     
-    const auto& currentTileEdges = m_currentTileSet.edgePatterns[tileIdx];
+    const auto& currentTileEdges = tileSet.edgePatterns[tileIdx];
     
     // Check compatibility with neighboring tiles
     
     // Check top neighbor
     if (y > 0) {
         int topTileIdx = layout[y - 1][x];
-        if (topTileIdx >= 0 && topTileIdx < static_cast<int>(m_currentTileSet.edgePatterns.size())) {
-            const auto& topTileEdges = m_currentTileSet.edgePatterns[topTileIdx];
+        if (topTileIdx >= 0 && topTileIdx < static_cast<int>(tileSet.edgePatterns.size())) {
+            const auto& topTileEdges = tileSet.edgePatterns[topTileIdx];
             if (currentTileEdges[0] != topTileEdges[2]) { // current top != neighbor bottom
                 return false;
             }
@@ -831,8 +1046,8 @@ bool BackgroundGenerator::isTileCompatibleAtPosition(const std::vector<std::vect
     // Check left neighbor
     if (x > 0) {
         int leftTileIdx = layout[y][x - 1];
-        if (leftTileIdx >= 0 && leftTileIdx < static_cast<int>(m_currentTileSet.edgePatterns.size())) {
-            const auto& leftTileEdges = m_currentTileSet.edgePatterns[leftTileIdx];
+        if (leftTileIdx >= 0 && leftTileIdx < static_cast<int>(tileSet.edgePatterns.size())) {
+            const auto& leftTileEdges = tileSet.edgePatterns[leftTileIdx];
             if (currentTileEdges[3] != leftTileEdges[1]) { // current left != neighbor right
                 return false;
             }
@@ -866,27 +1081,186 @@ cocos2d::CCImage* BackgroundGenerator::mirrorEdges(cocos2d::CCImage* image, int
     return image;
 }
 
+const MipChain* BackgroundGenerator::getMipChain(const TileSet& tileSet, size_t tileIndex) {
+    if (tileSet.isEmpty() || tileIndex >= tileSet.tiles.size()) {
+        return nullptr;
+    }
+    
+    if (!tileSet.mipCache) {
+        tileSet.mipCache = std::make_shared<TileMipCache>();
+    }
+    
+    auto* cache = tileSet.mipCache.get();
+    std::call_once(cache->sized, [&] {
+        cache->count = tileSet.tiles.size();
+        cache->slots = std::make_unique<TileMipCache::Slot[]>(cache->count);
+    });
+    if (tileIndex >= cache->count) {
+        return nullptr;
+    }
+    
+    auto& slot = cache->slots[tileIndex];
+    std::call_once(slot.built, [&] {
+        auto* tile = tileSet.tiles[tileIndex];
+        int width = 0;
+        int height = 0;
+        if (tile) {
+            width = tile->getWidth();
+            height = tile->getHeight();
+        } else if (tileSet.container) {
+            width = static_cast<int>(tileSet.container->getEntry(tileIndex).width);
+            height = static_cast<int>(tileSet.container->getEntry(tileIndex).height);
+        } else {
+            return;
+        }
+        std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+        for (int y = 0; y < height; ++y) {
+            copyTileRow(tileSet, tileIndex, y, width, rgba.data() + static_cast<size_t>(y) * width * 4);
+        }
+        // Tiles are seamless, so the Lanczos filter wraps around the edges
+        slot.chain.build(rgba.data(), width, height, 1, true);
+        if (!tile && tileSet.container) {
+            // The chain's base level now holds the pixels
+            tileSet.container->releaseTile(tileIndex);
+        }
+    });
+    
+    return slot.chain.isEmpty() ? nullptr : &slot.chain;
+}
+
+MipLevel BackgroundGenerator::getTileImage(const TileSet& tileSet, size_t tileIndex, int size) {
+    const auto* chain = getMipChain(tileSet, tileIndex);
+    if (!chain) {
+        return {};
+    }
+    return chain->resampleTo(size, size);
+}
+
+cocos2d::CCTexture2D* BackgroundGenerator::createTileTexture(const TileSet& tileSet, size_t tileIndex, int size) {
+    auto image = getTileImage(tileSet, tileIndex, size);
+    if (image.isEmpty()) {
+        return nullptr;
+    }
+    
+    auto texture = new CCTexture2D();
+    if (!texture->initWithData(image.rgba.data(), kCCTexture2DPixelFormat_RGBA8888,
+                               image.width, image.height,
+                               CCSize(static_cast<float>(image.width), static_cast<float>(image.height)))) {
+        delete texture;
+        return nullptr;
+    }
+    texture->autorelease();
+    return texture;
+}
+
+TileAtlasTexture BackgroundGenerator::createTileAtlas(const TileSet& tileSet, const std::vector<size_t>& tiles,
+                                                      int tileSize) {
+    TileAtlasTexture result;
+    if (tileSet.isEmpty() || tiles.empty()) {
+        return result;
+    }
+    
+    std::vector<MipLevel> images(tiles.size());
+    std::vector<const MipLevel*> inputs;
+    inputs.reserve(images.size());
+    for (size_t i = 0; i < images.size(); ++i) {
+        images[i] = getTileImage(tileSet, tiles[i], tileSize);
+        if (images[i].isEmpty()) {
+            log::warn("Tile {} unavailable for atlas", tiles[i]);
+            return result;
+        }
+        inputs.push_back(&images[i]);
+    }
+    
+    // 1px wrapped gutter keeps linear filtering from bleeding between tiles
+    TextureAtlasImage atlas;
+    GLint maxTextureSize = 2048;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if (!TextureAtlas::build(inputs, 1, static_cast<int>(maxTextureSize), atlas)) {
+        log::warn("Could not pack {} tiles of {}px into one atlas", inputs.size(), tileSize);
+        return result;
+    }
+    
+    auto texture = new CCTexture2D();
+    if (!texture->initWithData(atlas.rgba.data(), kCCTexture2DPixelFormat_RGBA8888,
+                               atlas.width, atlas.height,
+                               CCSize(static_cast<float>(atlas.width), static_cast<float>(atlas.height)))) {
+        delete texture;
+        return result;
+    }
+    texture->autorelease();
+    
+    result.texture = texture;
+    result.frames.reserve(atlas.rects.size());
+    for (const auto& rect : atlas.rects) {
+        result.frames.push_back(CC_RECT_PIXELS_TO_POINTS(CCRect(
+            static_cast<float>(rect.x), static_cast<float>(rect.y),
+            static_cast<float>(rect.width), static_cast<float>(rect.height))));
+    }
+    
+    log::debug("Packed {} tiles into {}x{} atlas", result.frames.size(), atlas.width, atlas.height);
+    return result;
+}
+
 cocos2d::CCNode* BackgroundGenerator::createTilePreview(const TileSet& tileSet, int previewCols, int previewRows) {
-    auto node = CCNode::create();
+    if (tileSet.isEmpty() || previewCols <= 0 || previewRows <= 0) {
+        return nullptr;
+    }
+    
+    const int cellSize = 64;
+    const int tileCount = static_cast<int>(tileSet.tiles.size());
+    
+    // Sets carrying edge patterns for every tile (generated Wang sets and
+    // containers that stored them) follow their edge-compatible layout,
+    // other sets simply cycle
+    const bool hasWangEdges = tileSet.edgePatterns.size() == tileSet.tiles.size() &&
+        std::all_of(tileSet.edgePatterns.begin(), tileSet.edgePatterns.end(),
+                    [](const std::vector<int>& edges) { return edges.size() == 4; });
+    std::vector<std::vector<int>> layout;
+    if (hasWangEdges) {
+        layout = generateTileLayout(tileSet, previewCols, previewRows);
+    } else {
+        layout.assign(previewRows, std::vector<int>(previewCols, 0));
+        for (int y = 0; y < previewRows; ++y) {
+            for (int x = 0; x < previewCols; ++x) {
+                layout[y][x] = (y * previewCols + x) % tileCount;
+            }
+        }
+    }
+    
+    // Only tiles the grid shows are decoded and packed
+    std::vector<size_t> shown;
+    std::vector<int> frameOf(tileCount, -1);
+    for (auto& row : layout) {
+        for (auto& tileIndex : row) {
+            tileIndex = std::clamp(tileIndex, 0, tileCount - 1);
+            if (frameOf[tileIndex] < 0) {
+                frameOf[tileIndex] = static_cast<int>(shown.size());
+                shown.push_back(static_cast<size_t>(tileIndex));
+            }
+        }
+    }
+    auto atlas = createTileAtlas(tileSet, shown, cellSize);
+    if (!atlas.isValid()) {
+        return nullptr;
+    }
     
-    // Create a 3x3 preview grid showing the tileset pattern
-    // In real implementation, would create sprites from the tiles
+    // Every cell is a quad in one batch node sharing the atlas texture, so the
+    // preview is a single draw call regardless of grid size
+    auto batch = CCSpriteBatchNode::createWithTexture(atlas.texture, static_cast<unsigned int>(previewCols * previewRows));
+    const float step = CC_CONTENT_SCALE_FACTOR() > 0.0f ? cellSize / CC_CONTENT_SCALE_FACTOR() : cellSize;
     
     for (int y = 0; y < previewRows; ++y) {
         for (int x = 0; x < previewCols; ++x) {
-            auto placeholder = CCSprite::create();
-            placeholder->setColor({
-                static_cast<GLubyte>(128 + x * 20),
-                static_cast<GLubyte>(128 + y * 20),
-                static_cast<GLubyte>(200)
-            });
-            placeholder->setTextureRect({0, 0, 64, 64});
-            placeholder->setPosition({x * 70.0f, y * 70.0f});
-            node->addChild(placeholder);
+            auto sprite = CCSprite::createWithTexture(atlas.texture, atlas.frames[frameOf[layout[y][x]]]);
+            sprite->setAnchorPoint({0.0f, 0.0f});
+            sprite->setPosition({x * step, y * step});
+            batch->addChild(sprite);
         }
     }
     
-    return node;
+    log::info("Created preview with {}x{} tiles", previewCols, previewRows);
+    return batch;
 }
 
 void BackgroundGenerator::measureDeltaE(const TileSet& tileSet) {
@@ -953,7 +1327,7 @@ bool BackgroundGenerator::validateNonEmptyTileSet(const TileSet& tileSet) {
     
     // Additional validation for tile data
     for (const auto* tile : tileSet.tiles) {
-        if (!tile) {
+        if (!tile && !tileSet.container) {
             IntegrityLogger::get()->logError("BackgroundGenerator", "Null tile in set");
             return false;
         }
@@ -1025,27 +1399,35 @@ std::unique_ptr<cocos2d::CCImage> BackgroundGenerator::generatePreviewInMemory()
         return nullptr;
     }
     
-    // Create a small preview image (e.g., 256x256)
+    // 3x3 grid of tiles in a 256x256 image; each tile is resampled once from
+    // its nearest mip level rather than from full resolution
     const int previewSize = 256;
-    std::vector<unsigned char> pixels(previewSize * previewSize * 4);
+    const int gridSize = 3;
+    const int cellSize = (previewSize + gridSize - 1) / gridSize;
+    const int tileCount = static_cast<int>(m_currentTileSet.tiles.size());
+    
+    std::vector<MipLevel> cells(m_currentTileSet.tiles.size());
+    std::vector<unsigned char> pixels(previewSize * previewSize * 4, 0);
     
-    // Fill with a simple pattern representing the tile set
     for (int y = 0; y < previewSize; ++y) {
+        int tileY = (y * gridSize) / previewSize;
+        int localY = std::min(cellSize - 1, y - (tileY * previewSize) / gridSize);
         for (int x = 0; x < previewSize; ++x) {
-            // Create a checkerboard pattern with tile-based colors
-            int tileX = (x * 3) / previewSize;
-            int tileY = (y * 3) / previewSize;
-            int tileIndex = (tileY * 3 + tileX) % std::max(1, static_cast<int>(m_currentTileSet.tiles.size()));
+            int tileX = (x * gridSize) / previewSize;
+            int localX = std::min(cellSize - 1, x - (tileX * previewSize) / gridSize);
+            int tileIndex = (tileY * gridSize + tileX) % tileCount;
             
-            unsigned char r = 128 + (tileIndex * 20) % 128;
-            unsigned char g = 100 + (tileIndex * 15) % 128;
-            unsigned char b = 150 + (tileIndex * 25) % 128;
+            auto& cell = cells[tileIndex];
+            if (cell.isEmpty()) {
+                cell = getTileImage(m_currentTileSet, tileIndex, cellSize);
+                if (cell.isEmpty()) {
+                    continue;
+                }
+            }
             
+            size_t src = (static_cast<size_t>(localY) * cell.width + localX) * 4;
             size_t idx = static_cast<size_t>(y) * previewSize * 4 + static_cast<size_t>(x) * 4;
-            pixels[idx + 0] = r;
-            pixels[idx + 1] = g;
-            pixels[idx + 2] = b;
-            pixels[idx + 3] = 255;
+            std::memcpy(&pixels[idx], &cell.rgba[src], 4);
         }
     }
     
@@ -1492,7 +1874,7 @@ bool BackgroundGenerator::validateNonEmptyTileSet(const TileSet& tileSet) {
     
     // Check that all tiles are valid
     for (size_t i = 0; i < tileSet.tiles.size(); ++i) {
-        if (!tileSet.tiles[i]) {
+        if (!tileSet.tiles[i] && !tileSet.container) {
             log::error("TileSet contains null tile at index {}", i);
             return false;
         }
@@ -1634,19 +2016,3 @@ std::string BackgroundGenerator::generateExportJSON(const TileSet& tileSet) {
     
     return json.str();
 }
-
-cocos2d::CCNode* BackgroundGenerator::createTilePreview(const TileSet& tileSet, int previewCols, int previewRows) {
-    if (tileSet.isEmpty()) {
-        return nullptr;
-    }
-    
-    // Create a preview node (placeholder implementation)
-    auto previewNode = cocos2d::CCNode::create();
-    
-    // In real implementation, would create a grid of tile sprites
-    // For now, just create a placeholder node
-    
-    log::info("Created preview with {}x{} tiles", previewCols, previewRows);
-    
-    return previewNode;
-}
\ No newline at end of file
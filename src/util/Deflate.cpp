@@ -0,0 +1,826 @@
+#include <util/Deflate.hpp>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <queue>
+
+using namespace paibot;
+
+namespace {
+    constexpr int kWindowSize = 32768;
+    constexpr int kMinMatch = 3;
+    constexpr int kMaxMatch = 258;
+    constexpr int kHashBits = 15;
+    constexpr int kHashSize = 1 << kHashBits;
+    constexpr size_t kTokensPerBlock = 16384;
+    constexpr int kLitLenSymbols = 286;
+    constexpr int kDistSymbols = 30;
+    constexpr int kCodeLengthSymbols = 19;
+
+    constexpr std::array<uint16_t, 29> kLengthBase = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+    constexpr std::array<uint8_t, 29> kLengthExtra = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+    };
+    constexpr std::array<uint16_t, 30> kDistBase = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+    };
+    constexpr std::array<uint8_t, 30> kDistExtra = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+    };
+    constexpr std::array<uint8_t, 19> kCodeLengthOrder = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+    };
+
+    struct SymbolTables {
+        std::array<uint8_t, kMaxMatch + 1> lengthCode{};
+        std::array<uint8_t, kWindowSize + 1> distCode{};
+        std::array<uint32_t, 256> crc{};
+
+        SymbolTables() {
+            for (int code = 0; code < 29; ++code) {
+                int end = code + 1 < 29 ? kLengthBase[code + 1] : kMaxMatch + 1;
+                for (int len = kLengthBase[code]; len < end && len <= kMaxMatch; ++len) {
+                    lengthCode[len] = static_cast<uint8_t>(code);
+                }
+            }
+            lengthCode[kMaxMatch] = 28;
+            for (int code = 0; code < 30; ++code) {
+                int end = code + 1 < 30 ? kDistBase[code + 1] : kWindowSize + 1;
+                for (int dist = kDistBase[code]; dist < end; ++dist) {
+                    distCode[dist] = static_cast<uint8_t>(code);
+                }
+            }
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                crc[i] = c;
+            }
+        }
+    };
+
+    const SymbolTables& tables() {
+        static const SymbolTables s_tables;
+        return s_tables;
+    }
+
+    struct Token {
+        uint16_t litLen;   // literal byte, or match length when dist != 0
+        uint16_t dist;
+    };
+
+    struct MatcherParams {
+        int maxChain;
+        int niceLength;
+        int maxInsertLength;
+    };
+
+    MatcherParams paramsFor(DeflateLevel level) {
+        switch (level) {
+            case DeflateLevel::Fast: return {4, 32, 8};
+            case DeflateLevel::Best: return {512, kMaxMatch, kMaxMatch};
+            case DeflateLevel::Default:
+            default: return {48, 128, kMaxMatch};
+        }
+    }
+
+    class BitWriter {
+        std::vector<uint8_t>& m_out;
+        uint64_t m_bits = 0;
+        int m_count = 0;
+
+    public:
+        explicit BitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+        void put(uint32_t value, int bitCount) {
+            m_bits |= static_cast<uint64_t>(value) << m_count;
+            m_count += bitCount;
+            while (m_count >= 8) {
+                m_out.push_back(static_cast<uint8_t>(m_bits));
+                m_bits >>= 8;
+                m_count -= 8;
+            }
+        }
+
+        void alignToByte() {
+            if (m_count > 0) {
+                m_out.push_back(static_cast<uint8_t>(m_bits));
+                m_bits = 0;
+                m_count = 0;
+            }
+        }
+    };
+
+    inline uint32_t hash3(const uint8_t* p) {
+        return ((static_cast<uint32_t>(p[0]) << 10) ^ (static_cast<uint32_t>(p[1]) << 5) ^ p[2]) & (kHashSize - 1);
+    }
+
+    // Greedy LZ77 with hash chains over a single independent segment
+    void tokenize(const uint8_t* data, size_t size, const MatcherParams& params, std::vector<Token>& tokens) {
+        tokens.clear();
+        tokens.reserve(size / 2 + 16);
+        if (size < kMinMatch) {
+            for (size_t i = 0; i < size; ++i) {
+                tokens.push_back({data[i], 0});
+            }
+            return;
+        }
+
+        std::vector<int32_t> head(kHashSize, -1);
+        std::vector<int32_t> prev(kWindowSize, -1);
+        auto insert = [&](size_t pos) {
+            uint32_t h = hash3(data + pos);
+            prev[pos & (kWindowSize - 1)] = head[h];
+            head[h] = static_cast<int32_t>(pos);
+        };
+
+        size_t pos = 0;
+        const size_t lastHashable = size - kMinMatch;
+        while (pos < size) {
+            int bestLen = 0;
+            int bestDist = 0;
+            if (pos <= lastHashable) {
+                const int maxLen = static_cast<int>(std::min<size_t>(kMaxMatch, size - pos));
+                int32_t candidate = head[hash3(data + pos)];
+                int chain = params.maxChain;
+                while (candidate >= 0 && chain-- > 0) {
+                    size_t dist = pos - static_cast<size_t>(candidate);
+                    if (dist > kWindowSize - 1) {
+                        break;
+                    }
+                    const uint8_t* a = data + candidate;
+                    const uint8_t* b = data + pos;
+                    if (a[bestLen] == b[bestLen] && a[0] == b[0]) {
+                        int len = 0;
+                        while (len < maxLen && a[len] == b[len]) {
+                            ++len;
+                        }
+                        if (len > bestLen) {
+                            bestLen = len;
+                            bestDist = static_cast<int>(dist);
+                            if (len >= params.niceLength || len == maxLen) {
+                                break;
+                            }
+                        }
+                    }
+                    int32_t next = prev[candidate & (kWindowSize - 1)];
+                    if (next >= candidate) {
+                        break;  // stale ring entry
+                    }
+                    candidate = next;
+                }
+                insert(pos);
+            }
+
+            if (bestLen >= kMinMatch) {
+                tokens.push_back({static_cast<uint16_t>(bestLen), static_cast<uint16_t>(bestDist)});
+                if (bestLen <= params.maxInsertLength) {
+                    for (size_t k = pos + 1; k < pos + bestLen && k <= lastHashable; ++k) {
+                        insert(k);
+                    }
+                }
+                pos += bestLen;
+            } else {
+                tokens.push_back({data[pos], 0});
+                ++pos;
+            }
+        }
+    }
+
+    // Length-limited Huffman code lengths. Frequencies are halved and the tree
+    // rebuilt until the depth limit holds, which is plenty for deflate alphabets.
+    void buildLengths(const std::vector<uint32_t>& freq, int maxBits, std::vector<uint8_t>& lengths) {
+        const size_t n = freq.size();
+        lengths.assign(n, 0);
+
+        std::vector<uint32_t> work(freq);
+        while (true) {
+            std::vector<int> used;
+            for (size_t i = 0; i < n; ++i) {
+                if (work[i] > 0) {
+                    used.push_back(static_cast<int>(i));
+                }
+            }
+            if (used.empty()) {
+                return;
+            }
+            if (used.size() == 1) {
+                lengths[used[0]] = 1;
+                // Decoders expect a complete code; add a dummy sibling
+                lengths[used[0] == 0 ? 1 : 0] = 1;
+                return;
+            }
+
+            // Nodes [0, n) are leaves; internal nodes are appended
+            std::vector<int> parent(n + used.size(), -1);
+            using Item = std::pair<uint64_t, int>;
+            std::priority_queue<Item, std::vector<Item>, std::greater<Item>> heap;
+            for (int sym : used) {
+                heap.push({work[sym], sym});
+            }
+            int nextNode = static_cast<int>(n);
+            while (heap.size() > 1) {
+                auto a = heap.top(); heap.pop();
+                auto b = heap.top(); heap.pop();
+                parent[a.second] = nextNode;
+                parent[b.second] = nextNode;
+                heap.push({a.first + b.first, nextNode});
+                ++nextNode;
+            }
+
+            // Depths: parents are always created after their children
+            std::vector<int> depth(nextNode, 0);
+            for (int node = nextNode - 2; node >= static_cast<int>(n); --node) {
+                depth[node] = depth[parent[node]] + 1;
+            }
+            int maxDepth = 0;
+            for (int sym : used) {
+                int d = depth[parent[sym]] + 1;
+                lengths[sym] = static_cast<uint8_t>(std::min(d, 255));
+                maxDepth = std::max(maxDepth, d);
+            }
+            if (maxDepth <= maxBits) {
+                return;
+            }
+            for (int sym : used) {
+                work[sym] = std::max<uint32_t>(1, work[sym] >> 1);
+            }
+        }
+    }
+
+    // Canonical codes, bit-reversed so they can be emitted LSB-first
+    void buildCodes(const std::vector<uint8_t>& lengths, std::vector<uint16_t>& codes) {
+        std::array<uint16_t, 16> count{};
+        for (auto len : lengths) {
+            if (len) {
+                ++count[len];
+            }
+        }
+        std::array<uint16_t, 16> next{};
+        uint16_t code = 0;
+        for (int bits = 1; bits < 16; ++bits) {
+            code = static_cast<uint16_t>((code + count[bits - 1]) << 1);
+            next[bits] = code;
+        }
+        codes.assign(lengths.size(), 0);
+        for (size_t sym = 0; sym < lengths.size(); ++sym) {
+            int len = lengths[sym];
+            if (!len) {
+                continue;
+            }
+            uint16_t c = next[len]++;
+            uint16_t reversed = 0;
+            for (int i = 0; i < len; ++i) {
+                reversed = static_cast<uint16_t>((reversed << 1) | ((c >> i) & 1));
+            }
+            codes[sym] = reversed;
+        }
+    }
+
+    struct CodeLengthOp {
+        uint8_t symbol;
+        uint8_t extra;
+    };
+
+    void runLengthEncode(const std::vector<uint8_t>& lengths, std::vector<CodeLengthOp>& ops) {
+        ops.clear();
+        size_t i = 0;
+        while (i < lengths.size()) {
+            uint8_t value = lengths[i];
+            size_t run = 1;
+            while (i + run < lengths.size() && lengths[i + run] == value) {
+                ++run;
+            }
+            size_t remaining = run;
+            if (value == 0) {
+                while (remaining >= 11) {
+                    size_t take = std::min<size_t>(remaining, 138);
+                    ops.push_back({18, static_cast<uint8_t>(take - 11)});
+                    remaining -= take;
+                }
+                if (remaining >= 3) {
+                    ops.push_back({17, static_cast<uint8_t>(remaining - 3)});
+                    remaining = 0;
+                }
+            } else {
+                ops.push_back({value, 0});
+                --remaining;
+                while (remaining >= 3) {
+                    size_t take = std::min<size_t>(remaining, 6);
+                    ops.push_back({16, static_cast<uint8_t>(take - 3)});
+                    remaining -= take;
+                }
+            }
+            while (remaining-- > 0) {
+                ops.push_back({value, 0});
+            }
+            i += run;
+        }
+    }
+
+    void writeStored(BitWriter& writer, const uint8_t* data, size_t size, bool final) {
+        size_t offset = 0;
+        do {
+            size_t chunk = std::min<size_t>(size - offset, 65535);
+            bool lastChunk = offset + chunk >= size;
+            writer.put(final && lastChunk ? 1 : 0, 1);
+            writer.put(0, 2);
+            writer.alignToByte();
+            writer.put(static_cast<uint32_t>(chunk), 16);
+            writer.put(static_cast<uint32_t>(~chunk & 0xFFFF), 16);
+            for (size_t i = 0; i < chunk; ++i) {
+                writer.put(data[offset + i], 8);
+            }
+            offset += chunk;
+        } while (offset < size);
+    }
+
+    void writeBlock(BitWriter& writer, const Token* tokens, size_t tokenCount,
+                    const uint8_t* raw, size_t rawSize, bool final) {
+        const auto& tab = tables();
+
+        std::vector<uint32_t> litFreq(kLitLenSymbols, 0);
+        std::vector<uint32_t> distFreq(kDistSymbols, 0);
+        for (size_t i = 0; i < tokenCount; ++i) {
+            const auto& t = tokens[i];
+            if (t.dist == 0) {
+                ++litFreq[t.litLen];
+            } else {
+                ++litFreq[257 + tab.lengthCode[t.litLen]];
+                ++distFreq[tab.distCode[t.dist]];
+            }
+        }
+        litFreq[256] = 1;
+
+        std::vector<uint8_t> litLengths, distLengths;
+        buildLengths(litFreq, 15, litLengths);
+        buildLengths(distFreq, 15, distLengths);
+        if (std::all_of(distLengths.begin(), distLengths.end(), [](uint8_t l) { return l == 0; })) {
+            distLengths[0] = 1;
+            distLengths[1] = 1;
+        }
+
+        int hlit = kLitLenSymbols;
+        while (hlit > 257 && litLengths[hlit - 1] == 0) {
+            --hlit;
+        }
+        int hdist = kDistSymbols;
+        while (hdist > 1 && distLengths[hdist - 1] == 0) {
+            --hdist;
+        }
+
+        std::vector<uint8_t> combined(litLengths.begin(), litLengths.begin() + hlit);
+        combined.insert(combined.end(), distLengths.begin(), distLengths.begin() + hdist);
+        std::vector<CodeLengthOp> ops;
+        runLengthEncode(combined, ops);
+
+        std::vector<uint32_t> clFreq(kCodeLengthSymbols, 0);
+        for (const auto& op : ops) {
+            ++clFreq[op.symbol];
+        }
+        std::vector<uint8_t> clLengths;
+        buildLengths(clFreq, 7, clLengths);
+        int hclen = kCodeLengthSymbols;
+        while (hclen > 4 && clLengths[kCodeLengthOrder[hclen - 1]] == 0) {
+            --hclen;
+        }
+
+        // Exact bit cost of the dynamic block, compared against a stored block
+        uint64_t dynamicBits = 3 + 5 + 5 + 4 + 3ull * hclen;
+        for (const auto& op : ops) {
+            dynamicBits += clLengths[op.symbol];
+            dynamicBits += op.symbol == 16 ? 2 : op.symbol == 17 ? 3 : op.symbol == 18 ? 7 : 0;
+        }
+        for (int sym = 0; sym < kLitLenSymbols; ++sym) {
+            dynamicBits += static_cast<uint64_t>(litFreq[sym]) * litLengths[sym];
+            if (sym >= 257 && litFreq[sym]) {
+                dynamicBits += static_cast<uint64_t>(litFreq[sym]) * kLengthExtra[sym - 257];
+            }
+        }
+        for (int sym = 0; sym < kDistSymbols; ++sym) {
+            dynamicBits += static_cast<uint64_t>(distFreq[sym]) * (distLengths[sym] + kDistExtra[sym]);
+        }
+        uint64_t storedBits = (rawSize + 5 * (rawSize / 65535 + 1)) * 8 + 8;
+        if (storedBits <= dynamicBits) {
+            writeStored(writer, raw, rawSize, final);
+            return;
+        }
+
+        std::vector<uint16_t> litCodes, distCodes, clCodes;
+        buildCodes(litLengths, litCodes);
+        buildCodes(distLengths, distCodes);
+        buildCodes(clLengths, clCodes);
+
+        writer.put(final ? 1 : 0, 1);
+        writer.put(2, 2);
+        writer.put(static_cast<uint32_t>(hlit - 257), 5);
+        writer.put(static_cast<uint32_t>(hdist - 1), 5);
+        writer.put(static_cast<uint32_t>(hclen - 4), 4);
+        for (int i = 0; i < hclen; ++i) {
+            writer.put(clLengths[kCodeLengthOrder[i]], 3);
+        }
+        for (const auto& op : ops) {
+            writer.put(clCodes[op.symbol], clLengths[op.symbol]);
+            if (op.symbol == 16) {
+                writer.put(op.extra, 2);
+            } else if (op.symbol == 17) {
+                writer.put(op.extra, 3);
+            } else if (op.symbol == 18) {
+                writer.put(op.extra, 7);
+            }
+        }
+
+        for (size_t i = 0; i < tokenCount; ++i) {
+            const auto& t = tokens[i];
+            if (t.dist == 0) {
+                writer.put(litCodes[t.litLen], litLengths[t.litLen]);
+                continue;
+            }
+            int lcode = tab.lengthCode[t.litLen];
+            writer.put(litCodes[257 + lcode], litLengths[257 + lcode]);
+            if (kLengthExtra[lcode]) {
+                writer.put(t.litLen - kLengthBase[lcode], kLengthExtra[lcode]);
+            }
+            int dcode = tab.distCode[t.dist];
+            writer.put(distCodes[dcode], distLengths[dcode]);
+            if (kDistExtra[dcode]) {
+                writer.put(t.dist - kDistBase[dcode], kDistExtra[dcode]);
+            }
+        }
+        writer.put(litCodes[256], litLengths[256]);
+    }
+}
+
+uint32_t Deflate::crc32(const uint8_t* data, size_t size, uint32_t crc) {
+    const auto& table = tables().crc;
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t Deflate::adler32(const uint8_t* data, size_t size, uint32_t adler) {
+    constexpr uint32_t kMod = 65521;
+    constexpr size_t kNMax = 5552;  // largest n keeping the sums in 32 bits
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (size > 0) {
+        size_t chunk = std::min(size, kNMax);
+        size -= chunk;
+        for (size_t i = 0; i < chunk; ++i) {
+            a += data[i];
+            b += a;
+        }
+        data += chunk;
+        a %= kMod;
+        b %= kMod;
+    }
+    return (b << 16) | a;
+}
+
+uint32_t Deflate::adler32Combine(uint32_t adlerA, uint32_t adlerB, size_t sizeB) {
+    // Same derivation as zlib's adler32_combine
+    constexpr uint32_t kMod = 65521;
+    uint32_t rem = static_cast<uint32_t>(sizeB % kMod);
+    uint32_t sum1 = adlerA & 0xFFFF;
+    uint32_t sum2 = (rem * sum1) % kMod;
+    sum1 += (adlerB & 0xFFFF) + kMod - 1;
+    sum2 += ((adlerA >> 16) & 0xFFFF) + ((adlerB >> 16) & 0xFFFF) + kMod - rem;
+    if (sum1 >= kMod) sum1 -= kMod;
+    if (sum1 >= kMod) sum1 -= kMod;
+    if (sum2 >= (kMod << 1)) sum2 -= (kMod << 1);
+    if (sum2 >= kMod) sum2 -= kMod;
+    return sum1 | (sum2 << 16);
+}
+
+void Deflate::writeZlibHeader(std::vector<uint8_t>& out, DeflateLevel level) {
+    // CMF = deflate, 32K window; FLEVEL hint chosen per level, FCHECK makes it %31
+    uint8_t cmf = 0x78;
+    uint8_t flevel = 0;
+    switch (level) {
+        case DeflateLevel::Store: flevel = 0; break;
+        case DeflateLevel::Fast: flevel = 1; break;
+        case DeflateLevel::Default: flevel = 2; break;
+        case DeflateLevel::Best: flevel = 3; break;
+    }
+    uint8_t flg = static_cast<uint8_t>(flevel << 6);
+    flg = static_cast<uint8_t>(flg + (31 - ((cmf * 256 + flg) % 31)) % 31);
+    out.push_back(cmf);
+    out.push_back(flg);
+}
+
+void Deflate::writeZlibTrailer(std::vector<uint8_t>& out, uint32_t adler) {
+    out.push_back(static_cast<uint8_t>(adler >> 24));
+    out.push_back(static_cast<uint8_t>(adler >> 16));
+    out.push_back(static_cast<uint8_t>(adler >> 8));
+    out.push_back(static_cast<uint8_t>(adler));
+}
+
+void Deflate::compressSegment(const uint8_t* data, size_t size, DeflateLevel level,
+                              bool last, std::vector<uint8_t>& out) {
+    BitWriter writer(out);
+
+    if (size == 0 || level == DeflateLevel::Store) {
+        if (size > 0 || last) {
+            writeStored(writer, data, size, last);
+        }
+    } else {
+        std::vector<Token> tokens;
+        tokenize(data, size, paramsFor(level), tokens);
+
+        size_t tokenIndex = 0;
+        size_t rawOffset = 0;
+        while (tokenIndex < tokens.size()) {
+            size_t count = std::min(kTokensPerBlock, tokens.size() - tokenIndex);
+            size_t rawSize = 0;
+            for (size_t i = 0; i < count; ++i) {
+                const auto& t = tokens[tokenIndex + i];
+                rawSize += t.dist == 0 ? 1 : t.litLen;
+            }
+            bool finalBlock = last && tokenIndex + count == tokens.size();
+            writeBlock(writer, tokens.data() + tokenIndex, count, data + rawOffset, rawSize, finalBlock);
+            tokenIndex += count;
+            rawOffset += rawSize;
+        }
+    }
+
+    if (!last) {
+        // Sync flush: empty non-final stored block leaves the stream byte aligned
+        writer.put(0, 3);
+        writer.alignToByte();
+        writer.put(0x0000, 16);
+        writer.put(0xFFFF, 16);
+    }
+    writer.alignToByte();
+}
+
+std::vector<uint8_t> Deflate::compress(const uint8_t* data, size_t size, DeflateLevel level) {
+    std::vector<uint8_t> out;
+    out.reserve(size / 2 + 64);
+    writeZlibHeader(out, level);
+    compressSegment(data, size, level, true, out);
+    writeZlibTrailer(out, adler32(data, size));
+    return out;
+}
+
+namespace {
+    class BitReader {
+        const uint8_t* m_data;
+        size_t m_size;
+        size_t m_pos = 0;
+        uint64_t m_bits = 0;
+        int m_count = 0;
+
+    public:
+        BitReader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+        void refill() {
+            while (m_count <= 56) {
+                uint64_t byte = m_pos < m_size ? m_data[m_pos] : 0;
+                ++m_pos;
+                m_bits |= byte << m_count;
+                m_count += 8;
+            }
+        }
+
+        uint32_t peek(int bitCount) {
+            if (m_count < bitCount) {
+                refill();
+            }
+            return static_cast<uint32_t>(m_bits & ((1ull << bitCount) - 1));
+        }
+
+        void consume(int bitCount) {
+            m_bits >>= bitCount;
+            m_count -= bitCount;
+        }
+
+        uint32_t take(int bitCount) {
+            if (bitCount == 0) {
+                return 0;
+            }
+            uint32_t value = peek(bitCount);
+            consume(bitCount);
+            return value;
+        }
+
+        void alignToByte() {
+            consume(m_count & 7);
+        }
+
+        // True once more bits were consumed than the input holds (zero padding read)
+        bool overran() const {
+            return m_pos * 8 - static_cast<size_t>(m_count) > m_size * 8;
+        }
+
+        size_t bytePosition() const {
+            return m_pos - static_cast<size_t>(m_count / 8);
+        }
+    };
+
+    // Direct lookup table over the next 15 bits: entry = symbol << 4 | length
+    class HuffmanTable {
+        std::vector<uint16_t> m_entries;
+        int m_bits = 0;
+
+    public:
+        bool build(const uint8_t* lengths, int count) {
+            int maxLen = 0;
+            for (int i = 0; i < count; ++i) {
+                maxLen = std::max(maxLen, static_cast<int>(lengths[i]));
+            }
+            if (maxLen == 0) {
+                m_bits = 0;
+                m_entries.clear();
+                return true;
+            }
+            std::vector<uint8_t> lens(lengths, lengths + count);
+            std::vector<uint16_t> codes;
+            buildCodes(lens, codes);
+
+            m_bits = maxLen;
+            m_entries.assign(size_t{1} << maxLen, 0);
+            for (int sym = 0; sym < count; ++sym) {
+                int len = lengths[sym];
+                if (!len) {
+                    continue;
+                }
+                for (uint32_t fill = codes[sym]; fill < m_entries.size(); fill += 1u << len) {
+                    m_entries[fill] = static_cast<uint16_t>((sym << 4) | len);
+                }
+            }
+            return true;
+        }
+
+        int decode(BitReader& reader) const {
+            if (m_bits == 0) {
+                return -1;
+            }
+            uint16_t entry = m_entries[reader.peek(m_bits)];
+            int len = entry & 0xF;
+            if (len == 0) {
+                return -1;
+            }
+            reader.consume(len);
+            return entry >> 4;
+        }
+    };
+
+    // Fails as soon as `out` would grow past `maxSize` or the input runs out,
+    // so a crafted stream cannot make it allocate more than the caller allows
+    bool inflateBlock(BitReader& reader, const HuffmanTable& lit, const HuffmanTable& dist, std::vector<uint8_t>& out,
+                      size_t maxSize) {
+        while (true) {
+            int sym = lit.decode(reader);
+            if (sym < 0 || reader.overran()) {
+                return false;
+            }
+            if (sym < 256) {
+                if (out.size() >= maxSize) {
+                    return false;
+                }
+                out.push_back(static_cast<uint8_t>(sym));
+                continue;
+            }
+            if (sym == 256) {
+                return true;
+            }
+            sym -= 257;
+            if (sym >= 29) {
+                return false;
+            }
+            size_t length = kLengthBase[sym] + reader.take(kLengthExtra[sym]);
+            int dsym = dist.decode(reader);
+            if (dsym < 0 || dsym >= 30) {
+                return false;
+            }
+            size_t distance = kDistBase[dsym] + reader.take(kDistExtra[dsym]);
+            if (distance > out.size() || length > maxSize - out.size()) {
+                return false;
+            }
+            size_t from = out.size() - distance;
+            for (size_t i = 0; i < length; ++i) {
+                out.push_back(out[from + i]);
+            }
+            if (reader.overran()) {
+                return false;
+            }
+        }
+    }
+}
+
+bool Deflate::decompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t maxSize) {
+    out.clear();
+    if (!data || size < 6) {
+        return false;
+    }
+    const uint8_t cmf = data[0];
+    const uint8_t flg = data[1];
+    if ((cmf & 0x0F) != 8 || ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20)) {
+        return false;
+    }
+    out.reserve(maxSize);
+
+    BitReader reader(data + 2, size - 6);
+    HuffmanTable lit, dist;
+    bool final = false;
+    while (!final) {
+        final = reader.take(1) != 0;
+        uint32_t type = reader.take(2);
+        if (type == 0) {
+            reader.alignToByte();
+            uint32_t len = reader.take(16);
+            uint32_t nlen = reader.take(16);
+            if ((len ^ 0xFFFF) != nlen || len > maxSize - out.size()) {
+                return false;
+            }
+            for (uint32_t i = 0; i < len; ++i) {
+                out.push_back(static_cast<uint8_t>(reader.take(8)));
+                if (reader.overran()) {
+                    return false;
+                }
+            }
+        } else if (type == 1) {
+            std::array<uint8_t, 288> litLengths{};
+            std::fill(litLengths.begin(), litLengths.begin() + 144, 8);
+            std::fill(litLengths.begin() + 144, litLengths.begin() + 256, 9);
+            std::fill(litLengths.begin() + 256, litLengths.begin() + 280, 7);
+            std::fill(litLengths.begin() + 280, litLengths.end(), 8);
+            std::array<uint8_t, 30> distLengths{};
+            distLengths.fill(5);
+            lit.build(litLengths.data(), 288);
+            dist.build(distLengths.data(), 30);
+            if (!inflateBlock(reader, lit, dist, out, maxSize)) {
+                return false;
+            }
+        } else if (type == 2) {
+            int hlit = static_cast<int>(reader.take(5)) + 257;
+            int hdist = static_cast<int>(reader.take(5)) + 1;
+            int hclen = static_cast<int>(reader.take(4)) + 4;
+            std::array<uint8_t, kCodeLengthSymbols> clLengths{};
+            for (int i = 0; i < hclen; ++i) {
+                clLengths[kCodeLengthOrder[i]] = static_cast<uint8_t>(reader.take(3));
+            }
+            HuffmanTable clTable;
+            clTable.build(clLengths.data(), kCodeLengthSymbols);
+
+            std::vector<uint8_t> lengths(static_cast<size_t>(hlit + hdist), 0);
+            int index = 0;
+            while (index < hlit + hdist) {
+                int sym = clTable.decode(reader);
+                if (sym < 0) {
+                    return false;
+                }
+                int repeat = 0;
+                uint8_t value = 0;
+                if (sym < 16) {
+                    lengths[index++] = static_cast<uint8_t>(sym);
+                    continue;
+                } else if (sym == 16) {
+                    if (index == 0) {
+                        return false;
+                    }
+                    value = lengths[index - 1];
+                    repeat = 3 + static_cast<int>(reader.take(2));
+                } else if (sym == 17) {
+                    repeat = 3 + static_cast<int>(reader.take(3));
+                } else {
+                    repeat = 11 + static_cast<int>(reader.take(7));
+                }
+                if (index + repeat > hlit + hdist) {
+                    return false;
+                }
+                std::fill(lengths.begin() + index, lengths.begin() + index + repeat, value);
+                index += repeat;
+            }
+            lit.build(lengths.data(), hlit);
+            dist.build(lengths.data() + hlit, hdist);
+            if (!inflateBlock(reader, lit, dist, out, maxSize)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+        if (reader.overran()) {
+            return false;
+        }
+    }
+
+    // Adler-32 follows the deflate data, byte aligned
+    reader.alignToByte();
+    size_t trailer = 2 + reader.bytePosition();
+    if (trailer + 4 > size) {
+        return false;
+    }
+    uint32_t stored = (static_cast<uint32_t>(data[trailer]) << 24) | (static_cast<uint32_t>(data[trailer + 1]) << 16) |
+                      (static_cast<uint32_t>(data[trailer + 2]) << 8) | data[trailer + 3];
+    return stored == adler32(out.data(), out.size());
+}
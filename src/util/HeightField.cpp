@@ -0,0 +1,213 @@
+#include <util/HeightField.hpp>
+#include <util/WorkerPool.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define PAIBOT_HEIGHT_SSE2 1
+#endif
+
+using namespace paibot;
+
+namespace {
+    constexpr int kRowsPerTask = 16;
+
+    size_t taskCount(int rows) {
+        return static_cast<size_t>((rows + kRowsPerTask - 1) / kRowsPerTask);
+    }
+
+    inline uint8_t encodeComponent(float value) {
+        return static_cast<uint8_t>(std::clamp(std::lround((value * 0.5f + 0.5f) * 255.0f), 0L, 255L));
+    }
+}
+
+void OctaveStack::build(const OctaveNoiseParams& params, const std::vector<int>& cutoffs,
+                        const std::function<void(int, HeightField&&)>& onCutoff) {
+    clear();
+    if (params.size <= 0) {
+        return;
+    }
+    m_size = params.size;
+    const int size = params.size;
+    const int octaveCount = std::max(1, params.octaves);
+
+    // Random phase per octave
+    std::mt19937 rng(params.seed);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    std::vector<float> phases(octaveCount);
+    for (auto& phase : phases) {
+        phase = dist(rng) * 6.28318f;
+    }
+
+    m_sum.assign(static_cast<size_t>(size) * size, 0.0f);
+    m_amplitudeSums.reserve(octaveCount);
+
+    std::vector<float> rowTable(size);
+    std::vector<float> columnTable(size);
+    float amplitude = 1.0f;
+    float frequency = std::max(0.01f, params.scale);
+    float amplitudeSum = 0.0f;
+    size_t nextCutoff = 0;
+    for (int octave = 0; octave < octaveCount; ++octave) {
+        for (int i = 0; i < size; ++i) {
+            const float t = (static_cast<float>(i) / size) * frequency;
+            rowTable[i] = std::sin(t + phases[octave]) * amplitude;
+            columnTable[i] = std::cos(t + phases[octave] * 0.5f);
+        }
+
+        WorkerPool::get()->parallelFor(taskCount(size), [&](size_t task) {
+            const int y0 = static_cast<int>(task) * kRowsPerTask;
+            const int y1 = std::min(size, y0 + kRowsPerTask);
+            for (int y = y0; y < y1; ++y) {
+                const float column = columnTable[y];
+                float* out = m_sum.data() + static_cast<size_t>(y) * size;
+                for (int x = 0; x < size; ++x) {
+                    out[x] += rowTable[x] * column;
+                }
+            }
+        });
+
+        amplitudeSum += amplitude;
+        m_amplitudeSums.push_back(amplitudeSum);
+        amplitude *= params.persistence;
+        frequency *= params.lacunarity;
+
+        // Cutoffs at this octave, or past the last one
+        while (onCutoff && nextCutoff < cutoffs.size() &&
+               (cutoffs[nextCutoff] <= octave + 1 || octave + 1 == octaveCount)) {
+            onCutoff(cutoffs[nextCutoff], normalize(octave + 1));
+            ++nextCutoff;
+        }
+    }
+}
+
+void OctaveStack::clear() {
+    m_size = 0;
+    m_sum.clear();
+    m_sum.shrink_to_fit();
+    m_amplitudeSums.clear();
+}
+
+HeightField OctaveStack::normalize(int octaveCount) const {
+    HeightField field;
+    const float amplitudeSum = m_amplitudeSums[octaveCount - 1];
+    const float norm = amplitudeSum > 0.0f ? 1.0f / amplitudeSum : 1.0f;
+
+    field.width = m_size;
+    field.height = m_size;
+    field.values.resize(m_sum.size());
+    WorkerPool::get()->parallelFor(taskCount(m_size), [&](size_t task) {
+        const size_t begin = task * kRowsPerTask * static_cast<size_t>(m_size);
+        const size_t end = std::min(m_sum.size(), begin + static_cast<size_t>(kRowsPerTask) * m_size);
+        for (size_t i = begin; i < end; ++i) {
+            field.values[i] = std::clamp(0.5f + 0.5f * m_sum[i] * norm, 0.0f, 1.0f);
+        }
+    });
+    return field;
+}
+
+HeightField OctaveStack::compose() const {
+    if (m_amplitudeSums.empty()) {
+        return {};
+    }
+    return normalize(getOctaveCount());
+}
+
+void NormalMap::fromHeightField(const HeightField& field, float strength, bool wrap, std::vector<uint8_t>& rgba) {
+    rgba.clear();
+    if (field.isEmpty()) {
+        return;
+    }
+    const int width = field.width;
+    const int height = field.height;
+    rgba.resize(static_cast<size_t>(width) * height * 4);
+
+    // Sobel sums to 8x the per-pixel slope; convert to slope per field extent
+    const float scaleX = strength * static_cast<float>(width) / 8.0f;
+    const float scaleY = strength * static_cast<float>(height) / 8.0f;
+
+    auto rowIndex = [&](int y) {
+        return wrap ? (y + height) % height : std::clamp(y, 0, height - 1);
+    };
+
+    WorkerPool::get()->parallelFor(taskCount(height), [&](size_t task) {
+        // Rows padded by one texel on each side so the inner loop has no edge cases
+        std::vector<float> padded[3];
+        for (auto& row : padded) {
+            row.resize(static_cast<size_t>(width) + 2);
+        }
+        auto loadRow = [&](int y, std::vector<float>& row) {
+            const float* src = field.values.data() + static_cast<size_t>(rowIndex(y)) * width;
+            std::copy(src, src + width, row.begin() + 1);
+            row[0] = wrap ? src[width - 1] : src[0];
+            row[width + 1] = wrap ? src[0] : src[width - 1];
+        };
+
+        const int y0 = static_cast<int>(task) * kRowsPerTask;
+        const int y1 = std::min(height, y0 + kRowsPerTask);
+        for (int y = y0; y < y1; ++y) {
+            loadRow(y - 1, padded[0]);
+            loadRow(y, padded[1]);
+            loadRow(y + 1, padded[2]);
+            const float* top = padded[0].data();
+            const float* mid = padded[1].data();
+            const float* bot = padded[2].data();
+            uint8_t* out = rgba.data() + static_cast<size_t>(y) * width * 4;
+
+            int x = 0;
+#ifdef PAIBOT_HEIGHT_SSE2
+            const __m128 two = _mm_set1_ps(2.0f);
+            const __m128 half = _mm_set1_ps(0.5f);
+            const __m128 scale255 = _mm_set1_ps(255.0f);
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 sx = _mm_set1_ps(scaleX);
+            const __m128 sy = _mm_set1_ps(scaleY);
+            const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+            for (; x + 4 <= width; x += 4) {
+                const __m128 tl = _mm_loadu_ps(top + x);
+                const __m128 tc = _mm_loadu_ps(top + x + 1);
+                const __m128 tr = _mm_loadu_ps(top + x + 2);
+                const __m128 ml = _mm_loadu_ps(mid + x);
+                const __m128 mr = _mm_loadu_ps(mid + x + 2);
+                const __m128 bl = _mm_loadu_ps(bot + x);
+                const __m128 bc = _mm_loadu_ps(bot + x + 1);
+                const __m128 br = _mm_loadu_ps(bot + x + 2);
+
+                __m128 gx = _mm_sub_ps(_mm_add_ps(_mm_add_ps(tr, br), _mm_mul_ps(two, mr)),
+                                       _mm_add_ps(_mm_add_ps(tl, bl), _mm_mul_ps(two, ml)));
+                __m128 gy = _mm_sub_ps(_mm_add_ps(_mm_add_ps(bl, br), _mm_mul_ps(two, bc)),
+                                       _mm_add_ps(_mm_add_ps(tl, tr), _mm_mul_ps(two, tc)));
+                __m128 nx = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(gx, sx));
+                __m128 ny = _mm_mul_ps(gy, sy);
+                __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), one));
+                __m128 inv = _mm_div_ps(one, length);
+
+                auto encode = [&](__m128 n) {
+                    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(n, inv), half), half), scale255);
+                    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), scale255);
+                    return _mm_cvtps_epi32(v);
+                };
+                __m128i r = encode(nx);
+                __m128i g = encode(ny);
+                __m128i b = encode(one);
+                __m128i pixels = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)),
+                                              _mm_or_si128(_mm_slli_epi32(b, 16), alpha));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), pixels);
+            }
+#endif
+            for (; x < width; ++x) {
+                const float gx = (top[x + 2] + 2.0f * mid[x + 2] + bot[x + 2]) - (top[x] + 2.0f * mid[x] + bot[x]);
+                const float gy = (bot[x] + 2.0f * bot[x + 1] + bot[x + 2]) - (top[x] + 2.0f * top[x + 1] + top[x + 2]);
+                const float nx = -gx * scaleX;
+                const float ny = gy * scaleY;
+                const float inv = 1.0f / std::sqrt(nx * nx + ny * ny + 1.0f);
+                out[x * 4 + 0] = encodeComponent(nx * inv);
+                out[x * 4 + 1] = encodeComponent(ny * inv);
+                out[x * 4 + 2] = encodeComponent(inv);
+                out[x * 4 + 3] = 255;
+            }
+        }
+    });
+}
@@ -0,0 +1,100 @@
+#include <util/LabColor.hpp>
+#include <cmath>
+
+using namespace paibot;
+
+namespace {
+    constexpr float kPi = 3.14159265f;
+    constexpr float kDegrees = 180.0f / kPi;
+    constexpr float kRadians = kPi / 180.0f;
+
+    float linearize(uint8_t value) {
+        const float c = value / 255.0f;
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float labCurve(float t) {
+        return t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116.0f;
+    }
+
+    float hueDegrees(float b, float a) {
+        if (a == 0.0f && b == 0.0f) {
+            return 0.0f;
+        }
+        const float h = std::atan2(b, a) * kDegrees;
+        return h < 0.0f ? h + 360.0f : h;
+    }
+}
+
+LabColor LabColor::fromRgb(uint8_t r, uint8_t g, uint8_t b) {
+    const float lr = linearize(r);
+    const float lg = linearize(g);
+    const float lb = linearize(b);
+
+    // sRGB -> XYZ, normalized by the D65 white point
+    const float x = (0.4124f * lr + 0.3576f * lg + 0.1805f * lb) / 0.95047f;
+    const float y = 0.2126f * lr + 0.7152f * lg + 0.0722f * lb;
+    const float z = (0.0193f * lr + 0.1192f * lg + 0.9505f * lb) / 1.08883f;
+
+    const float fx = labCurve(x);
+    const float fy = labCurve(y);
+    const float fz = labCurve(z);
+    return {116.0f * fy - 16.0f, 500.0f * (fx - fy), 200.0f * (fy - fz)};
+}
+
+float LabColor::deltaE2000(const LabColor& x, const LabColor& y) {
+    // Sharma, Wu & Dalal formulation
+    const float c1 = std::sqrt(x.a * x.a + x.b * x.b);
+    const float c2 = std::sqrt(y.a * y.a + y.b * y.b);
+    const float cMean = (c1 + c2) * 0.5f;
+    const float cMean7 = std::pow(cMean, 7.0f);
+    const float g = 0.5f * (1.0f - std::sqrt(cMean7 / (cMean7 + 6103515625.0f)));  // 25^7
+
+    const float a1 = x.a * (1.0f + g);
+    const float a2 = y.a * (1.0f + g);
+    const float cp1 = std::sqrt(a1 * a1 + x.b * x.b);
+    const float cp2 = std::sqrt(a2 * a2 + y.b * y.b);
+    const float hp1 = hueDegrees(x.b, a1);
+    const float hp2 = hueDegrees(y.b, a2);
+
+    const float dL = y.l - x.l;
+    const float dC = cp2 - cp1;
+    float dh = 0.0f;
+    if (cp1 * cp2 != 0.0f) {
+        dh = hp2 - hp1;
+        if (dh > 180.0f) {
+            dh -= 360.0f;
+        } else if (dh < -180.0f) {
+            dh += 360.0f;
+        }
+    }
+    const float dH = 2.0f * std::sqrt(cp1 * cp2) * std::sin(dh * 0.5f * kRadians);
+
+    const float lMean = (x.l + y.l) * 0.5f;
+    const float cpMean = (cp1 + cp2) * 0.5f;
+    float hMean = hp1 + hp2;
+    if (cp1 * cp2 != 0.0f) {
+        if (std::abs(hp1 - hp2) > 180.0f) {
+            hMean += hMean < 360.0f ? 360.0f : -360.0f;
+        }
+        hMean *= 0.5f;
+    }
+
+    const float t = 1.0f - 0.17f * std::cos((hMean - 30.0f) * kRadians) +
+                    0.24f * std::cos(2.0f * hMean * kRadians) +
+                    0.32f * std::cos((3.0f * hMean + 6.0f) * kRadians) -
+                    0.20f * std::cos((4.0f * hMean - 63.0f) * kRadians);
+    const float dTheta = 30.0f * std::exp(-((hMean - 275.0f) / 25.0f) * ((hMean - 275.0f) / 25.0f));
+    const float cpMean7 = std::pow(cpMean, 7.0f);
+    const float rc = 2.0f * std::sqrt(cpMean7 / (cpMean7 + 6103515625.0f));
+    const float lOffset = (lMean - 50.0f) * (lMean - 50.0f);
+    const float sl = 1.0f + 0.015f * lOffset / std::sqrt(20.0f + lOffset);
+    const float sc = 1.0f + 0.045f * cpMean;
+    const float sh = 1.0f + 0.015f * cpMean * t;
+    const float rt = -std::sin(2.0f * dTheta * kRadians) * rc;
+
+    const float tl = dL / sl;
+    const float tc = dC / sc;
+    const float th = dH / sh;
+    return std::sqrt(tl * tl + tc * tc + th * th + rt * tc * th);
+}
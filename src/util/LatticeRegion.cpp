@@ -0,0 +1,729 @@
+#include <util/LatticeRegion.hpp>
+#include <algorithm>
+#include <climits>
+#include <unordered_map>
+
+using namespace paibot;
+
+namespace {
+    uint64_t pointKey(int32_t x, int32_t y) {
+        return static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32 | static_cast<uint32_t>(y);
+    }
+
+    // Sorted interval endpoints -> disjoint, merged intervals
+    void mergeIntervals(std::vector<std::pair<int32_t, int32_t>>& intervals, std::vector<int32_t>& out) {
+        out.clear();
+        std::sort(intervals.begin(), intervals.end());
+        for (const auto& [x0, x1] : intervals) {
+            if (x0 >= x1) {
+                continue;
+            }
+            if (!out.empty() && x0 <= out.back()) {
+                out.back() = std::max(out.back(), x1);
+            } else {
+                out.push_back(x0);
+                out.push_back(x1);
+            }
+        }
+    }
+
+    int64_t signedArea2(const LatticeRing& ring) {
+        int64_t sum = 0;
+        for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+            sum += static_cast<int64_t>(ring[j].x) * ring[i].y - static_cast<int64_t>(ring[i].x) * ring[j].y;
+        }
+        return sum;
+    }
+
+    // Crossing test in doubled coordinates; (px, py) are odd, so the ray
+    // never passes through a vertex
+    bool ringContains(const LatticeRing& ring, int64_t px, int64_t py) {
+        bool inside = false;
+        for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+            const auto& a = ring[j];
+            const auto& b = ring[i];
+            if (a.x != b.x) {
+                continue;
+            }
+            const int64_t y0 = 2 * static_cast<int64_t>(std::min(a.y, b.y));
+            const int64_t y1 = 2 * static_cast<int64_t>(std::max(a.y, b.y));
+            if (py > y0 && py < y1 && 2 * static_cast<int64_t>(a.x) > px) {
+                inside = !inside;
+            }
+        }
+        return inside;
+    }
+
+    GridRect transposed(const GridRect& rect) {
+        return {rect.y, rect.x, rect.height, rect.width};
+    }
+
+    // Hopcroft-Karp: shortest augmenting paths in phases, a BFS layering from
+    // the free left vertices and DFS augmentation along the layers. False
+    // when the deadline passes between phases.
+    bool maximumMatching(const std::vector<std::vector<uint32_t>>& adjacency, size_t rightCount,
+                         std::vector<int32_t>& matchLeft, std::vector<int32_t>& matchRight,
+                         std::chrono::steady_clock::time_point deadline) {
+        const size_t leftCount = adjacency.size();
+        matchLeft.assign(leftCount, -1);
+        matchRight.assign(rightCount, -1);
+        std::vector<int32_t> dist(leftCount);
+        std::vector<uint32_t> queue, cursor(leftCount);
+        queue.reserve(leftCount);
+
+        auto layer = [&]() {
+            queue.clear();
+            for (size_t u = 0; u < leftCount; ++u) {
+                dist[u] = matchLeft[u] < 0 ? 0 : INT32_MAX;
+                if (matchLeft[u] < 0) {
+                    queue.push_back(static_cast<uint32_t>(u));
+                }
+            }
+            bool found = false;
+            for (size_t head = 0; head < queue.size(); ++head) {
+                const uint32_t u = queue[head];
+                for (uint32_t v : adjacency[u]) {
+                    const int32_t w = matchRight[v];
+                    if (w < 0) {
+                        found = true;
+                    } else if (dist[w] == INT32_MAX) {
+                        dist[w] = dist[u] + 1;
+                        queue.push_back(static_cast<uint32_t>(w));
+                    }
+                }
+            }
+            return found;
+        };
+        auto augment = [&](auto& self, uint32_t u) -> bool {
+            for (; cursor[u] < adjacency[u].size(); ++cursor[u]) {
+                const uint32_t v = adjacency[u][cursor[u]];
+                const int32_t w = matchRight[v];
+                if (w < 0 || (dist[w] == dist[u] + 1 && self(self, static_cast<uint32_t>(w)))) {
+                    matchLeft[u] = static_cast<int32_t>(v);
+                    matchRight[v] = static_cast<int32_t>(u);
+                    return true;
+                }
+            }
+            dist[u] = INT32_MAX;
+            return false;
+        };
+
+        while (layer()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::fill(cursor.begin(), cursor.end(), 0u);
+            for (size_t u = 0; u < leftCount; ++u) {
+                if (matchLeft[u] < 0) {
+                    augment(augment, static_cast<uint32_t>(u));
+                }
+            }
+        }
+        return true;
+    }
+}
+
+void LatticeRegion::pushBand(int32_t y0, int32_t y1, const std::vector<int32_t>& xs) {
+    if (xs.empty() || y0 >= y1) {
+        return;
+    }
+    if (!m_bands.empty()) {
+        auto& last = m_bands.back();
+        if (last.y1 == y0 && last.end - last.begin == xs.size() &&
+            std::equal(xs.begin(), xs.end(), m_xs.begin() + last.begin)) {
+            last.y1 = y1;
+            return;
+        }
+    }
+    const auto begin = static_cast<uint32_t>(m_xs.size());
+    m_xs.insert(m_xs.end(), xs.begin(), xs.end());
+    m_bands.push_back({y0, y1, begin, static_cast<uint32_t>(m_xs.size())});
+}
+
+LatticeRegion LatticeRegion::fromRects(const std::vector<GridRect>& rects) {
+    LatticeRegion region;
+    std::vector<int32_t> ys;
+    ys.reserve(rects.size() * 2);
+    std::vector<uint32_t> order;
+    order.reserve(rects.size());
+    for (size_t i = 0; i < rects.size(); ++i) {
+        if (rects[i].width > 0 && rects[i].height > 0) {
+            ys.push_back(rects[i].y);
+            ys.push_back(rects[i].y + rects[i].height);
+            order.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return rects[a].y < rects[b].y; });
+
+    // Slab sweep: rects enter at their bottom and leave once the slab is above them
+    std::vector<uint32_t> active;
+    std::vector<std::pair<int32_t, int32_t>> intervals;
+    std::vector<int32_t> xs;
+    size_t next = 0;
+    for (size_t k = 0; k + 1 < ys.size(); ++k) {
+        const int32_t y0 = ys[k];
+        while (next < order.size() && rects[order[next]].y <= y0) {
+            active.push_back(order[next++]);
+        }
+        std::erase_if(active, [&](uint32_t i) { return rects[i].y + rects[i].height <= y0; });
+        intervals.clear();
+        for (uint32_t i : active) {
+            intervals.emplace_back(rects[i].x, rects[i].x + rects[i].width);
+        }
+        mergeIntervals(intervals, xs);
+        region.pushBand(y0, ys[k + 1], xs);
+    }
+    return region;
+}
+
+LatticeRegion LatticeRegion::fromRings(const std::vector<LatticeRing>& rings) {
+    // Vertical edges with their winding contribution when crossed left to
+    // right: a downward edge enters a counter-clockwise ring
+    struct Edge {
+        int32_t x, y0, y1, winding;
+    };
+    std::vector<Edge> edges;
+    std::vector<int32_t> ys;
+    for (const auto& ring : rings) {
+        for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+            const auto& a = ring[j];
+            const auto& b = ring[i];
+            if (a.x == b.x && a.y != b.y) {
+                edges.push_back({a.x, std::min(a.y, b.y), std::max(a.y, b.y), a.y > b.y ? 1 : -1});
+                ys.push_back(a.y);
+                ys.push_back(b.y);
+            }
+        }
+    }
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+    std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) { return a.x < b.x; });
+
+    LatticeRegion region;
+    std::vector<int32_t> xs;
+    for (size_t k = 0; k + 1 < ys.size(); ++k) {
+        const int32_t y0 = ys[k];
+        xs.clear();
+        int winding = 0;
+        for (const auto& edge : edges) {
+            if (edge.y0 > y0 || edge.y1 <= y0) {
+                continue;
+            }
+            const bool wasInside = winding != 0;
+            winding += edge.winding;
+            if (wasInside != (winding != 0)) {
+                // Coincident edges cancel instead of leaving an empty interval
+                if (!xs.empty() && xs.back() == edge.x) {
+                    xs.pop_back();
+                } else {
+                    xs.push_back(edge.x);
+                }
+            }
+        }
+        region.pushBand(y0, ys[k + 1], xs);
+    }
+    return region;
+}
+
+int64_t LatticeRegion::area() const {
+    int64_t total = 0;
+    for (const auto& band : m_bands) {
+        int64_t width = 0;
+        for (uint32_t i = band.begin; i < band.end; i += 2) {
+            width += m_xs[i + 1] - m_xs[i];
+        }
+        total += width * (band.y1 - band.y0);
+    }
+    return total;
+}
+
+bool LatticeRegion::operator==(const LatticeRegion& other) const {
+    if (m_bands.size() != other.m_bands.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < m_bands.size(); ++i) {
+        const auto& a = m_bands[i];
+        const auto& b = other.m_bands[i];
+        if (a.y0 != b.y0 || a.y1 != b.y1 || a.end - a.begin != b.end - b.begin ||
+            !std::equal(m_xs.begin() + a.begin, m_xs.begin() + a.end, other.m_xs.begin() + b.begin)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+LatticeRegion LatticeRegion::combine(const LatticeRegion& a, const LatticeRegion& b, Op op) {
+    std::vector<int32_t> ys;
+    ys.reserve((a.m_bands.size() + b.m_bands.size()) * 2);
+    for (const auto* region : {&a, &b}) {
+        for (const auto& band : region->m_bands) {
+            ys.push_back(band.y0);
+            ys.push_back(band.y1);
+        }
+    }
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+    auto keep = [op](bool inA, bool inB) {
+        switch (op) {
+            case Op::Union: return inA || inB;
+            case Op::Difference: return inA && !inB;
+            case Op::Intersection: return inA && inB;
+        }
+        return false;
+    };
+
+    LatticeRegion out;
+    std::vector<int32_t> xs;
+    size_t ia = 0, ib = 0;
+    for (size_t k = 0; k + 1 < ys.size(); ++k) {
+        const int32_t y0 = ys[k];
+        while (ia < a.m_bands.size() && a.m_bands[ia].y1 <= y0) {
+            ++ia;
+        }
+        while (ib < b.m_bands.size() && b.m_bands[ib].y1 <= y0) {
+            ++ib;
+        }
+        // Slabs never straddle a band boundary, so a band either covers the slab or misses it
+        const int32_t* pa = nullptr, *ea = nullptr, *pb = nullptr, *eb = nullptr;
+        if (ia < a.m_bands.size() && a.m_bands[ia].y0 <= y0) {
+            pa = a.m_xs.data() + a.m_bands[ia].begin;
+            ea = a.m_xs.data() + a.m_bands[ia].end;
+        }
+        if (ib < b.m_bands.size() && b.m_bands[ib].y0 <= y0) {
+            pb = b.m_xs.data() + b.m_bands[ib].begin;
+            eb = b.m_xs.data() + b.m_bands[ib].end;
+        }
+
+        // Walk both endpoint lists in x order; parity of the consumed
+        // endpoints says whether x is inside each operand
+        xs.clear();
+        bool inA = false, inB = false, inside = false;
+        while (pa != ea || pb != eb) {
+            const int32_t x = std::min(pa != ea ? *pa : INT32_MAX, pb != eb ? *pb : INT32_MAX);
+            while (pa != ea && *pa == x) {
+                inA = !inA;
+                ++pa;
+            }
+            while (pb != eb && *pb == x) {
+                inB = !inB;
+                ++pb;
+            }
+            if (keep(inA, inB) != inside) {
+                inside = !inside;
+                xs.push_back(x);
+            }
+        }
+        out.pushBand(y0, ys[k + 1], xs);
+    }
+    return out;
+}
+
+std::vector<LatticePolygon> LatticeRegion::polygons() const {
+    // Directed boundary edges with the interior on the left: left sides of
+    // intervals run down, right sides up, tops west and bottoms east
+    std::vector<std::pair<LatticePoint, LatticePoint>> edges;
+    auto horizontal = [&](const Band* lower, const Band* upper, int32_t y) {
+        const int32_t* pl = lower ? m_xs.data() + lower->begin : nullptr;
+        const int32_t* el = lower ? m_xs.data() + lower->end : nullptr;
+        const int32_t* pu = upper ? m_xs.data() + upper->begin : nullptr;
+        const int32_t* eu = upper ? m_xs.data() + upper->end : nullptr;
+        bool inLower = false, inUpper = false;
+        int32_t runStart = 0;
+        int state = 0;   // 1: top edge (only below covered), -1: bottom edge
+        while (pl != el || pu != eu) {
+            const int32_t x = std::min(pl != el ? *pl : INT32_MAX, pu != eu ? *pu : INT32_MAX);
+            while (pl != el && *pl == x) {
+                inLower = !inLower;
+                ++pl;
+            }
+            while (pu != eu && *pu == x) {
+                inUpper = !inUpper;
+                ++pu;
+            }
+            const int next = inLower && !inUpper ? 1 : !inLower && inUpper ? -1 : 0;
+            if (next != state) {
+                if (state == 1) {
+                    edges.push_back({{x, y}, {runStart, y}});
+                } else if (state == -1) {
+                    edges.push_back({{runStart, y}, {x, y}});
+                }
+                state = next;
+                runStart = x;
+            }
+        }
+    };
+    for (size_t i = 0; i < m_bands.size(); ++i) {
+        const auto& band = m_bands[i];
+        for (uint32_t k = band.begin; k < band.end; k += 2) {
+            edges.push_back({{m_xs[k], band.y1}, {m_xs[k], band.y0}});
+            edges.push_back({{m_xs[k + 1], band.y0}, {m_xs[k + 1], band.y1}});
+        }
+        const Band* below = i > 0 && m_bands[i - 1].y1 == band.y0 ? &m_bands[i - 1] : nullptr;
+        horizontal(below, &band, band.y0);
+        if (i + 1 == m_bands.size() || m_bands[i + 1].y0 != band.y1) {
+            horizontal(&band, nullptr, band.y1);
+        }
+    }
+
+    // Link edges into rings. Where two rings touch at a corner, taking the
+    // left turn keeps them apart.
+    std::unordered_map<uint64_t, std::vector<uint32_t>> outgoing;
+    outgoing.reserve(edges.size());
+    for (size_t i = 0; i < edges.size(); ++i) {
+        outgoing[pointKey(edges[i].first.x, edges[i].first.y)].push_back(static_cast<uint32_t>(i));
+    }
+    auto direction = [](const std::pair<LatticePoint, LatticePoint>& edge) {
+        return std::pair<int, int>{(edge.second.x > edge.first.x) - (edge.second.x < edge.first.x),
+                                   (edge.second.y > edge.first.y) - (edge.second.y < edge.first.y)};
+    };
+
+    std::vector<uint8_t> used(edges.size(), 0);
+    std::vector<LatticeRing> outers, holes;
+    LatticeRing ring;
+    for (size_t start = 0; start < edges.size(); ++start) {
+        if (used[start]) {
+            continue;
+        }
+        ring.clear();
+        size_t current = start;
+        while (!used[current]) {
+            used[current] = 1;
+            ring.push_back(edges[current].first);
+            const auto [dx, dy] = direction(edges[current]);
+            const auto& candidates = outgoing[pointKey(edges[current].second.x, edges[current].second.y)];
+            size_t next = candidates.front();
+            for (uint32_t candidate : candidates) {
+                if (used[candidate]) {
+                    continue;
+                }
+                next = candidate;
+                if (direction(edges[candidate]) == std::pair<int, int>{-dy, dx}) {
+                    break;
+                }
+            }
+            current = next;
+        }
+        // Drop the vertices where two bands meet along one side
+        LatticeRing simplified;
+        for (size_t i = 0; i < ring.size(); ++i) {
+            const auto& prev = ring[(i + ring.size() - 1) % ring.size()];
+            const auto& next = ring[(i + 1) % ring.size()];
+            if (!((prev.x == ring[i].x && ring[i].x == next.x) || (prev.y == ring[i].y && ring[i].y == next.y))) {
+                simplified.push_back(ring[i]);
+            }
+        }
+        (signedArea2(simplified) > 0 ? outers : holes).push_back(std::move(simplified));
+    }
+
+    // Each hole goes to the smallest outer ring around a point just inside it
+    std::vector<LatticePolygon> out(outers.size());
+    std::vector<int64_t> areas(outers.size());
+    for (size_t i = 0; i < outers.size(); ++i) {
+        areas[i] = signedArea2(outers[i]);
+        out[i].outer = std::move(outers[i]);
+    }
+    for (auto& hole : holes) {
+        // Hole interior is right of its first edge, half a cell in
+        const auto& a = hole[0];
+        const auto& b = hole[1];
+        const int dx = (b.x > a.x) - (b.x < a.x);
+        const int dy = (b.y > a.y) - (b.y < a.y);
+        const int64_t px = 2 * static_cast<int64_t>(a.x) + dx + dy;
+        const int64_t py = 2 * static_cast<int64_t>(a.y) + dy - dx;
+        size_t owner = out.size();
+        for (size_t i = 0; i < out.size(); ++i) {
+            if ((owner == out.size() || areas[i] < areas[owner]) && ringContains(out[i].outer, px, py)) {
+                owner = i;
+            }
+        }
+        if (owner < out.size()) {
+            out[owner].holes.push_back(std::move(hole));
+        }
+    }
+    return out;
+}
+
+LatticeRegion LatticeRegion::withoutHoles() const {
+    std::vector<LatticeRing> outers;
+    for (auto& polygon : polygons()) {
+        outers.push_back(std::move(polygon.outer));
+    }
+    return fromRings(outers);
+}
+
+std::vector<GridRect> LatticeRegion::bandRects() const {
+    // Open rectangles keyed by their x-interval; an interval that repeats in
+    // the band directly above extends its rectangle
+    std::vector<GridRect> rects;
+    std::unordered_map<uint64_t, size_t> open, stillOpen;
+    for (const auto& band : m_bands) {
+        stillOpen.clear();
+        for (uint32_t k = band.begin; k < band.end; k += 2) {
+            const uint64_t key = pointKey(m_xs[k], m_xs[k + 1]);
+            auto it = open.find(key);
+            if (it != open.end() && rects[it->second].y + rects[it->second].height == band.y0) {
+                rects[it->second].height += band.y1 - band.y0;
+                stillOpen.emplace(key, it->second);
+            } else {
+                stillOpen.emplace(key, rects.size());
+                rects.push_back({m_xs[k], band.y0, m_xs[k + 1] - m_xs[k], band.y1 - band.y0});
+            }
+        }
+        std::swap(open, stillOpen);
+    }
+    return rects;
+}
+
+std::vector<GridRect> LatticeRegion::decompose() const {
+    auto horizontal = bandRects();
+    std::vector<GridRect> flipped;
+    flipped.reserve(horizontal.size());
+    for (const auto& rect : horizontal) {
+        flipped.push_back(transposed(rect));
+    }
+    auto vertical = fromRects(flipped).bandRects();
+    if (vertical.size() >= horizontal.size()) {
+        return horizontal;
+    }
+    for (auto& rect : vertical) {
+        rect = transposed(rect);
+    }
+    return vertical;
+}
+
+bool LatticeRegion::partitionMinimum(std::vector<GridRect>& out, std::chrono::steady_clock::time_point deadline) const {
+    // Compressed grid over every band and interval boundary; each cell is
+    // wholly inside or outside the region
+    std::vector<int32_t> xs(m_xs), ys;
+    for (const auto& band : m_bands) {
+        ys.push_back(band.y0);
+        ys.push_back(band.y1);
+    }
+    std::sort(xs.begin(), xs.end());
+    xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+    if (m_bands.empty()) {
+        out.clear();
+        return true;
+    }
+    const int width = static_cast<int>(xs.size()) - 1;
+    const int height = static_cast<int>(ys.size()) - 1;
+    if (static_cast<int64_t>(width + 1) * (height + 1) > kMaxPartitionCells) {
+        return false;
+    }
+    auto xIndex = [&](int32_t x) { return static_cast<int>(std::lower_bound(xs.begin(), xs.end(), x) - xs.begin()); };
+    auto yIndex = [&](int32_t y) { return static_cast<int>(std::lower_bound(ys.begin(), ys.end(), y) - ys.begin()); };
+
+    std::vector<uint8_t> covered(static_cast<size_t>(width) * height, 0);
+    for (const auto& band : m_bands) {
+        const int cy1 = yIndex(band.y1);
+        for (int cy = yIndex(band.y0); cy < cy1; ++cy) {
+            for (uint32_t k = band.begin; k < band.end; k += 2) {
+                const auto row = covered.begin() + static_cast<ptrdiff_t>(cy) * width;
+                std::fill(row + xIndex(m_xs[k]), row + xIndex(m_xs[k + 1]), uint8_t{1});
+            }
+        }
+    }
+    auto cell = [&](int cx, int cy) {
+        return cx >= 0 && cy >= 0 && cx < width && cy < height && covered[static_cast<size_t>(cy) * width + cx];
+    };
+    // Grid lines between points: horizontal segment (i, j)-(i+1, j) and
+    // vertical segment (i, j)-(i, j+1) lie inside when both sides are covered
+    auto hInside = [&](int i, int j) { return cell(i, j - 1) && cell(i, j); };
+    auto vInside = [&](int i, int j) { return cell(i - 1, j) && cell(i, j); };
+    auto coveredAround = [&](int i, int j) {
+        return cell(i - 1, j - 1) + cell(i, j - 1) + cell(i - 1, j) + cell(i, j);
+    };
+
+    // Concave vertices: three of the four cells around the point covered.
+    // A chord leaves along each line away from the missing cell.
+    struct Concave {
+        int i, j;
+        int dx, dy;
+    };
+    std::vector<Concave> concave;
+    for (int j = 0; j <= height; ++j) {
+        for (int i = 0; i <= width; ++i) {
+            if (coveredAround(i, j) == 3) {
+                const bool missingLeft = !cell(i - 1, j - 1) || !cell(i - 1, j);
+                const bool missingBelow = !cell(i - 1, j - 1) || !cell(i, j - 1);
+                concave.push_back({i, j, missingLeft ? 1 : -1, missingBelow ? 1 : -1});
+            }
+        }
+    }
+
+    // Chords between facing concave vertices, walked from the one facing
+    // +x (+y); the first concave vertex reached through the interior faces back
+    struct Chord {
+        int line, from, to;   // grid line, and point range along it
+        uint32_t a, b;        // concave endpoints
+    };
+    std::unordered_map<uint64_t, uint32_t> concaveAt;
+    for (size_t c = 0; c < concave.size(); ++c) {
+        concaveAt.emplace(pointKey(concave[c].i, concave[c].j), static_cast<uint32_t>(c));
+    }
+    std::vector<Chord> horizontal, vertical;
+    for (size_t c = 0; c < concave.size(); ++c) {
+        const auto& v = concave[c];
+        if (v.dx > 0) {
+            for (int k = v.i; k < width && hInside(k, v.j);) {
+                ++k;
+                if (auto it = concaveAt.find(pointKey(k, v.j)); it != concaveAt.end()) {
+                    horizontal.push_back({v.j, v.i, k, static_cast<uint32_t>(c), it->second});
+                    break;
+                }
+            }
+        }
+        if (v.dy > 0) {
+            for (int k = v.j; k < height && vInside(v.i, k);) {
+                ++k;
+                if (auto it = concaveAt.find(pointKey(v.i, k)); it != concaveAt.end()) {
+                    vertical.push_back({v.i, v.j, k, static_cast<uint32_t>(c), it->second});
+                    break;
+                }
+            }
+        }
+    }
+
+    // Crossing graph; chords sharing an endpoint cross too
+    std::vector<std::vector<uint32_t>> adjacency(horizontal.size());
+    for (size_t h = 0; h < horizontal.size(); ++h) {
+        const auto& hc = horizontal[h];
+        for (size_t v = 0; v < vertical.size(); ++v) {
+            const auto& vc = vertical[v];
+            if (hc.from <= vc.line && vc.line <= hc.to && vc.from <= hc.line && hc.line <= vc.to) {
+                adjacency[h].push_back(static_cast<uint32_t>(v));
+            }
+        }
+        if ((h & 255) == 0 && std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+    }
+    std::vector<int32_t> matchLeft, matchRight;
+    if (!maximumMatching(adjacency, vertical.size(), matchLeft, matchRight, deadline)) {
+        return false;
+    }
+
+    // König: alternating search from the free horizontal chords. Reached
+    // horizontals and unreached verticals form the maximum independent set.
+    std::vector<uint8_t> reachedH(horizontal.size(), 0), reachedV(vertical.size(), 0);
+    std::vector<uint32_t> stack;
+    for (size_t h = 0; h < horizontal.size(); ++h) {
+        if (matchLeft[h] < 0) {
+            reachedH[h] = 1;
+            stack.push_back(static_cast<uint32_t>(h));
+        }
+    }
+    while (!stack.empty()) {
+        const uint32_t h = stack.back();
+        stack.pop_back();
+        for (uint32_t v : adjacency[h]) {
+            if (!reachedV[v]) {
+                reachedV[v] = 1;
+                const int32_t next = matchRight[v];
+                if (next >= 0 && !reachedH[next]) {
+                    reachedH[next] = 1;
+                    stack.push_back(static_cast<uint32_t>(next));
+                }
+            }
+        }
+    }
+
+    // Cuts on grid segments: hCut[j * width + i], vCut[i * height + j]
+    std::vector<uint8_t> hCut(static_cast<size_t>(height + 1) * width, 0);
+    std::vector<uint8_t> vCut(static_cast<size_t>(width + 1) * height, 0);
+    std::vector<uint8_t> resolved(concave.size(), 0);
+    for (size_t h = 0; h < horizontal.size(); ++h) {
+        if (reachedH[h]) {
+            const auto& chord = horizontal[h];
+            std::fill_n(hCut.begin() + static_cast<ptrdiff_t>(chord.line) * width + chord.from, chord.to - chord.from, uint8_t{1});
+            resolved[chord.a] = resolved[chord.b] = 1;
+        }
+    }
+    for (size_t v = 0; v < vertical.size(); ++v) {
+        if (!reachedV[v]) {
+            const auto& chord = vertical[v];
+            std::fill_n(vCut.begin() + static_cast<ptrdiff_t>(chord.line) * height + chord.from, chord.to - chord.from, uint8_t{1});
+            resolved[chord.a] = resolved[chord.b] = 1;
+        }
+    }
+
+    // Every other concave vertex is cut horizontally up to the boundary or
+    // the first vertical cut
+    auto touchesVerticalCut = [&](int i, int j) {
+        return (j > 0 && vCut[static_cast<size_t>(i) * height + j - 1]) || (j < height && vCut[static_cast<size_t>(i) * height + j]);
+    };
+    for (size_t c = 0; c < concave.size(); ++c) {
+        if (resolved[c]) {
+            continue;
+        }
+        const auto& v = concave[c];
+        for (int k = v.i;;) {
+            const int segment = v.dx > 0 ? k : k - 1;
+            if (segment < 0 || segment >= width || !hInside(segment, v.j)) {
+                break;
+            }
+            auto& cut = hCut[static_cast<size_t>(v.j) * width + segment];
+            if (cut) {
+                break;
+            }
+            cut = 1;
+            k += v.dx;
+            if (coveredAround(k, v.j) != 4 || touchesVerticalCut(k, v.j)) {
+                break;
+            }
+        }
+    }
+
+    // Faces between the cuts; each must come out as a full rectangle
+    std::vector<uint8_t> visited(covered.size(), 0);
+    std::vector<GridRect> rects;
+    std::vector<uint32_t> cells;
+    for (int cy = 0; cy < height; ++cy) {
+        for (int cx = 0; cx < width; ++cx) {
+            const size_t start = static_cast<size_t>(cy) * width + cx;
+            if (!covered[start] || visited[start]) {
+                continue;
+            }
+            int x0 = cx, x1 = cx, y0 = cy, y1 = cy;
+            int64_t count = 0;
+            visited[start] = 1;
+            cells.assign(1, static_cast<uint32_t>(start));
+            while (!cells.empty()) {
+                const uint32_t index = cells.back();
+                cells.pop_back();
+                const int x = static_cast<int>(index % width);
+                const int y = static_cast<int>(index / width);
+                x0 = std::min(x0, x);
+                x1 = std::max(x1, x);
+                y0 = std::min(y0, y);
+                y1 = std::max(y1, y);
+                ++count;
+                auto visit = [&](int nx, int ny, bool blocked) {
+                    if (blocked || !cell(nx, ny)) {
+                        return;
+                    }
+                    const size_t next = static_cast<size_t>(ny) * width + nx;
+                    if (!visited[next]) {
+                        visited[next] = 1;
+                        cells.push_back(static_cast<uint32_t>(next));
+                    }
+                };
+                visit(x - 1, y, vCut[static_cast<size_t>(x) * height + y]);
+                visit(x + 1, y, vCut[static_cast<size_t>(x + 1) * height + y]);
+                visit(x, y - 1, hCut[static_cast<size_t>(y) * width + x]);
+                visit(x, y + 1, hCut[static_cast<size_t>(y + 1) * width + x]);
+            }
+            if (count != static_cast<int64_t>(x1 - x0 + 1) * (y1 - y0 + 1)) {
+                return false;
+            }
+            rects.push_back({xs[x0], ys[y0], xs[x1 + 1] - xs[x0], ys[y1 + 1] - ys[y0]});
+        }
+    }
+    out = std::move(rects);
+    return true;
+}
@@ -0,0 +1,297 @@
+#include <util/LevelString.hpp>
+#include <util/ObjectString.hpp>
+#include <util/OptimizerPipeline.hpp>
+#include <algorithm>
+#include <iterator>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+using namespace paibot;
+
+namespace {
+    // Trigger keys beyond the shared object keys in ObjectString.hpp
+    constexpr int32_t kKeyRed = 7;
+    constexpr int32_t kKeyGreen = 8;
+    constexpr int32_t kKeyBlue = 9;
+    constexpr int32_t kKeyDuration = 10;
+    constexpr int32_t kKeyTouchTriggered = 11;
+    constexpr int32_t kKeyBlending = 17;
+    constexpr int32_t kKeyTargetColor = 23;
+    constexpr int32_t kKeyOpacity = 35;
+    constexpr int32_t kKeyCopyColor = 50;
+    constexpr int32_t kKeyTargetGroup = 51;
+    constexpr int32_t kKeyActivateGroup = 56;
+    constexpr int32_t kKeyGroups = 57;
+    constexpr int32_t kKeySpawnTriggered = 62;
+    constexpr int32_t kKeyMultiTriggered = 87;
+    constexpr int32_t kKeyHidden = 135;
+
+    // Trigger object ids as inclusive ranges, sorted. Unknown ids are
+    // treated as geometry.
+    constexpr std::pair<int32_t, int32_t> kTriggerIds[] = {
+        {22, 33}, {55, 59}, {105, 105}, {221, 221}, {717, 718}, {743, 744}, {899, 901}, {915, 915},
+        {1006, 1007}, {1049, 1049}, {1268, 1268}, {1346, 1347}, {1520, 1520}, {1585, 1585}, {1595, 1595},
+        {1611, 1616}, {1811, 1819}, {1912, 1917}, {1931, 1935}, {2015, 2016}, {2062, 2062}, {2066, 2068},
+        {2899, 2925}, {2999, 2999}, {3006, 3033}, {3600, 3661}
+    };
+
+    int32_t toInt(std::string_view text) {
+        int32_t value = 0;
+        std::from_chars(text.data(), text.data() + text.size(), value);
+        return value;
+    }
+
+    // strtof over a bounded copy; from_chars for floats is missing on some
+    // of the standard libraries the mod targets
+    float toFloat(std::string_view text) {
+        char buffer[32];
+        const size_t length = std::min(text.size(), sizeof(buffer) - 1);
+        std::copy_n(text.data(), length, buffer);
+        buffer[length] = '\0';
+        return std::strtof(buffer, nullptr);
+    }
+
+    template <class Fn>
+    void forEachToken(std::string_view text, char separator, Fn&& fn) {
+        size_t start = 0;
+        while (start <= text.size()) {
+            size_t end = text.find(separator, start);
+            if (end == std::string_view::npos) {
+                end = text.size();
+            }
+            if (end > start) {
+                fn(text.substr(start, end - start));
+            }
+            start = end + 1;
+        }
+    }
+
+    struct ChannelInfo {
+        uint32_t color = 0xFFFFFF;
+        bool blending = false;
+        float opacity = 1.0f;
+        int32_t copyChannel = 0;
+    };
+
+    // kS38: "1_r_2_g_3_b_..._6_channel|..." with 5 = blending, 7 = opacity
+    // and 9 = the channel this one copies
+    void parseChannels(std::string_view value, std::unordered_map<int32_t, ChannelInfo>& out) {
+        forEachToken(value, '|', [&](std::string_view entry) {
+            int32_t key = 0;
+            bool haveKey = false;
+            int32_t channel = 0;
+            int32_t red = 255, green = 255, blue = 255;
+            ChannelInfo info;
+            forEachToken(entry, '_', [&](std::string_view token) {
+                if (!haveKey) {
+                    key = toInt(token);
+                    haveKey = true;
+                    return;
+                }
+                haveKey = false;
+                switch (key) {
+                    case 1: red = toInt(token); break;
+                    case 2: green = toInt(token); break;
+                    case 3: blue = toInt(token); break;
+                    case 5: info.blending = toInt(token) != 0; break;
+                    case 6: channel = toInt(token); break;
+                    case 7: info.opacity = toFloat(token); break;
+                    case 9: info.copyChannel = toInt(token); break;
+                    default: break;
+                }
+            });
+            if (channel > 0) {
+                info.color = (static_cast<uint32_t>(red & 0xFF) << 16) | (static_cast<uint32_t>(green & 0xFF) << 8) |
+                             static_cast<uint32_t>(blue & 0xFF);
+                out[channel] = info;
+            }
+        });
+    }
+
+    bool isHeader(std::string_view segment) {
+        // Object strings start with a numeric key; the header with kS/kA keys
+        return !segment.empty() && (segment[0] < '0' || segment[0] > '9');
+    }
+}
+
+bool LevelString::isTriggerId(int32_t objectId) {
+    auto it = std::upper_bound(std::begin(kTriggerIds), std::end(kTriggerIds), objectId,
+                               [](int32_t id, const auto& range) { return id < range.first; });
+    return it != std::begin(kTriggerIds) && objectId <= std::prev(it)->second;
+}
+
+bool LevelString::parse(std::string_view text, ParsedLevel& out) {
+    out.header = {};
+    out.objects.clear();
+    out.records.clear();
+    out.channelColors.clear();
+    out.animatedChannels.clear();
+
+    std::unordered_map<int32_t, ChannelInfo> channels;
+    ObjectFields fields;
+    std::vector<short> groupIds;
+    bool ok = true;
+    bool first = true;
+    forEachToken(text, ';', [&](std::string_view segment) {
+        if (!ok) {
+            return;
+        }
+        if (first && isHeader(segment)) {
+            first = false;
+            out.header = segment;
+            std::string_view key;
+            bool haveKey = false;
+            forEachToken(segment, ',', [&](std::string_view token) {
+                if (!haveKey) {
+                    key = token;
+                    haveKey = true;
+                    return;
+                }
+                haveKey = false;
+                if (key == "kS38") {
+                    parseChannels(token, channels);
+                }
+            });
+            return;
+        }
+        first = false;
+        if (!parseObjectString(segment, fields)) {
+            ok = false;
+            return;
+        }
+
+        ObjectRecord record;
+        float scale = 1.0f;
+        bool haveScaleX = false, haveScaleY = false;
+        bool hidden = false;
+        TriggerParams trigger;
+        int32_t targetColor = 0, targetGroup = 0;
+        int32_t red = 255, green = 255, blue = 255;
+        groupIds.clear();
+        for (const auto& [key, value] : fields) {
+            switch (key) {
+                case ObjectKey::Id: record.objectId = toInt(value); break;
+                case ObjectKey::X: record.x = toFloat(value); break;
+                case ObjectKey::Y: record.y = toFloat(value); break;
+                case ObjectKey::FlipX: record.flags |= toInt(value) ? ObjectFlipX : 0; break;
+                case ObjectKey::FlipY: record.flags |= toInt(value) ? ObjectFlipY : 0; break;
+                case ObjectKey::Rotation: record.rotation = toFloat(value); break;
+                case ObjectKey::EditorLayer: record.editorLayer = static_cast<int16_t>(toInt(value)); break;
+                case ObjectKey::Color: record.colorId = toInt(value); break;
+                case ObjectKey::DetailColor: record.detailColorId = toInt(value); break;
+                case ObjectKey::ZLayer: record.zLayer = static_cast<int16_t>(toInt(value)); break;
+                case ObjectKey::ZOrder: record.zOrder = toInt(value); break;
+                case ObjectKey::Scale: scale = toFloat(value); break;
+                case ObjectKey::ScaleX: record.scaleX = toFloat(value); haveScaleX = true; break;
+                case ObjectKey::ScaleY: record.scaleY = toFloat(value); haveScaleY = true; break;
+                case kKeyRed: red = toInt(value); break;
+                case kKeyGreen: green = toInt(value); break;
+                case kKeyBlue: blue = toInt(value); break;
+                case kKeyDuration: trigger.duration = toFloat(value); break;
+                case kKeyTouchTriggered: trigger.activation |= toInt(value) ? TriggerTouched : 0; break;
+                case kKeyBlending: trigger.blending = toInt(value) != 0; break;
+                case kKeyTargetColor: targetColor = toInt(value); break;
+                case kKeyOpacity: trigger.opacity = toFloat(value); break;
+                case kKeyCopyColor: trigger.copyColorId = toInt(value); break;
+                case kKeyTargetGroup: targetGroup = toInt(value); break;
+                case kKeyActivateGroup: trigger.activate = toInt(value) != 0; break;
+                case kKeyGroups:
+                    forEachToken(value, '.', [&](std::string_view group) {
+                        groupIds.push_back(static_cast<short>(toInt(group)));
+                    });
+                    break;
+                case kKeySpawnTriggered: trigger.activation |= toInt(value) ? TriggerSpawned : 0; break;
+                case kKeyMultiTriggered: trigger.activation |= toInt(value) ? TriggerMulti : 0; break;
+                case kKeyHidden: hidden = toInt(value) != 0; break;
+                default: break;
+            }
+        }
+
+        if (!haveScaleX) {
+            record.scaleX = scale;
+        }
+        if (!haveScaleY) {
+            record.scaleY = scale;
+        }
+        // Hitbox sizes are not in the string; assume a full block
+        record.width = OptimizerPipeline::kBlockSize * std::abs(record.scaleX);
+        record.height = OptimizerPipeline::kBlockSize * std::abs(record.scaleY);
+        record.groups = ObjectRecords::groupSignature(groupIds.data(), groupIds.size());
+        record.flags |= hidden ? ObjectHidden : 0;
+
+        // Without the game's object table only the plain blocks are known to
+        // be full-size solids. Spikes, slopes and the rest stay Other, which
+        // no pass merges or removes.
+        if (isTriggerId(record.objectId)) {
+            record.kind = ObjectKind::Trigger;
+            trigger.target = record.objectId == OptimizerPipeline::kColorTriggerId ? targetColor : targetGroup;
+            trigger.color = (static_cast<uint32_t>(red & 0xFF) << 16) | (static_cast<uint32_t>(green & 0xFF) << 8) |
+                            static_cast<uint32_t>(blue & 0xFF);
+            trigger.order = static_cast<int32_t>(out.objects.size());
+            record.trigger = trigger;
+            for (int32_t channel : {targetColor, trigger.copyColorId}) {
+                if (channel > 0) {
+                    out.animatedChannels.insert(channel);
+                }
+            }
+        } else {
+            record.kind = OptimizerPipeline::isOpaqueSkin(record.objectId) ? ObjectKind::Solid : ObjectKind::Other;
+        }
+
+        if (OptimizerPipeline::isOpaqueSkin(record.objectId)) {
+            auto it = channels.find(record.colorId);
+            if (record.colorId == 0 || it == channels.end() || (!it->second.blending && it->second.opacity >= 1.0f)) {
+                record.flags |= ObjectOpaque;
+            }
+        }
+
+        record.sourceIndex = static_cast<int32_t>(out.objects.size());
+        record.templateIndex = record.sourceIndex;
+        out.objects.push_back(segment);
+        out.records.push(record);
+    });
+
+    for (const auto& [channel, info] : channels) {
+        out.channelColors[channel] = info.color;
+        if (info.copyChannel > 0) {
+            out.animatedChannels.insert(channel);
+        }
+    }
+    return ok;
+}
+
+std::string LevelString::encode(const ParsedLevel& level, const ObjectRecords& records) {
+    std::string out;
+    size_t estimate = level.header.size() + 1;
+    for (size_t i = 0; i < records.size(); ++i) {
+        const int32_t source = records.sourceIndex[i];
+        estimate += (source >= 0 && static_cast<size_t>(source) < level.objects.size() ? level.objects[source].size() : 64) + 1;
+    }
+    out.reserve(estimate);
+    if (!level.header.empty()) {
+        out.append(level.header);
+        out += ';';
+    }
+
+    std::unordered_map<int32_t, ObjectStringTemplate> templates;
+    for (size_t i = 0; i < records.size(); ++i) {
+        const int32_t source = records.sourceIndex[i];
+        if (source >= 0 && static_cast<size_t>(source) < level.objects.size()) {
+            out.append(level.objects[source]);
+        } else {
+            int32_t templ = records.templateIndex[i];
+            if (templ < 0 || static_cast<size_t>(templ) >= level.objects.size()) {
+                templ = -1;
+            }
+            auto it = templates.find(templ);
+            if (it == templates.end()) {
+                it = templates.emplace(templ, templ >= 0 ? ObjectStringTemplate(level.objects[templ]) : ObjectStringTemplate()).first;
+            }
+            it->second.format(records, i, out);
+        }
+        out += ';';
+    }
+    return out;
+}
@@ -0,0 +1,252 @@
+#include <util/MipChain.hpp>
+#include <util/WorkerPool.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define PAIBOT_MIP_SSE2 1
+#endif
+
+using namespace paibot;
+
+namespace {
+    constexpr float kLanczosRadius = 3.0f;
+    constexpr int kRowsPerTask = 16;
+
+    float lanczos3(float x) {
+        x = std::abs(x);
+        if (x < 1e-6f) {
+            return 1.0f;
+        }
+        if (x >= kLanczosRadius) {
+            return 0.0f;
+        }
+        const float pix = std::numbers::pi_v<float> * x;
+        return kLanczosRadius * std::sin(pix) * std::sin(pix / kLanczosRadius) / (pix * pix);
+    }
+
+    // Fixed-tap filter table for one axis: taps * outSize indices and weights
+    struct AxisFilter {
+        int taps = 0;
+        std::vector<int> indices;
+        std::vector<float> weights;
+    };
+
+    AxisFilter buildAxisFilter(int inSize, int outSize, bool wrap) {
+        AxisFilter filter;
+        const float scale = static_cast<float>(inSize) / static_cast<float>(outSize);
+        const float filterScale = std::max(1.0f, scale);
+        const float support = kLanczosRadius * filterScale;
+        filter.taps = static_cast<int>(std::ceil(support)) * 2 + 1;
+        filter.indices.assign(static_cast<size_t>(filter.taps) * outSize, 0);
+        filter.weights.assign(static_cast<size_t>(filter.taps) * outSize, 0.0f);
+
+        for (int i = 0; i < outSize; ++i) {
+            const float center = (static_cast<float>(i) + 0.5f) * scale;
+            const int first = static_cast<int>(std::floor(center - support));
+            float total = 0.0f;
+            for (int t = 0; t < filter.taps; ++t) {
+                const int j = first + t;
+                const float w = lanczos3((static_cast<float>(j) + 0.5f - center) / filterScale);
+                int index = j;
+                if (wrap) {
+                    index = ((j % inSize) + inSize) % inSize;
+                } else {
+                    index = std::clamp(j, 0, inSize - 1);
+                }
+                filter.indices[static_cast<size_t>(i) * filter.taps + t] = index;
+                filter.weights[static_cast<size_t>(i) * filter.taps + t] = w;
+                total += w;
+            }
+            if (std::abs(total) > 1e-6f) {
+                for (int t = 0; t < filter.taps; ++t) {
+                    filter.weights[static_cast<size_t>(i) * filter.taps + t] /= total;
+                }
+            }
+        }
+        return filter;
+    }
+
+    inline void boxPixelScalar(const uint8_t* r0a, const uint8_t* r0b, const uint8_t* r1a, const uint8_t* r1b, uint8_t* out) {
+        for (int c = 0; c < 4; ++c) {
+            out[c] = static_cast<uint8_t>((r0a[c] + r0b[c] + r1a[c] + r1b[c] + 2) >> 2);
+        }
+    }
+}
+
+void MipChain::downsampleBox2x(const MipLevel& src, MipLevel& dst) {
+    dst.width = std::max(1, src.width / 2);
+    dst.height = std::max(1, src.height / 2);
+    dst.rgba.assign(static_cast<size_t>(dst.width) * dst.height * 4, 0);
+
+    const size_t srcStride = static_cast<size_t>(src.width) * 4;
+    const size_t dstStride = static_cast<size_t>(dst.width) * 4;
+
+    for (int y = 0; y < dst.height; ++y) {
+        const uint8_t* row0 = src.rgba.data() + srcStride * std::min(2 * y, src.height - 1);
+        const uint8_t* row1 = src.rgba.data() + srcStride * std::min(2 * y + 1, src.height - 1);
+        uint8_t* out = dst.rgba.data() + dstStride * y;
+
+        int x = 0;
+#ifdef PAIBOT_MIP_SSE2
+        // Four source pixels (16 bytes) per row -> two output pixels
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rounding = _mm_set1_epi16(2);
+        for (; x + 1 < dst.width && 2 * x + 3 < src.width; x += 2) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+            hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+            __m128i sum = _mm_unpacklo_epi64(lo, hi);
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+            __m128i packed = _mm_packus_epi16(sum, zero);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * 4), packed);
+        }
+#endif
+        for (; x < dst.width; ++x) {
+            const int x0 = std::min(2 * x, src.width - 1) * 4;
+            const int x1 = std::min(2 * x + 1, src.width - 1) * 4;
+            boxPixelScalar(row0 + x0, row0 + x1, row1 + x0, row1 + x1, out + x * 4);
+        }
+    }
+}
+
+void MipChain::resampleLanczos3(const MipLevel& src, int width, int height, bool wrap, MipLevel& dst) {
+    dst.width = width;
+    dst.height = height;
+    dst.rgba.assign(static_cast<size_t>(width) * height * 4, 0);
+    if (src.isEmpty() || width <= 0 || height <= 0) {
+        return;
+    }
+
+    const AxisFilter horizontal = buildAxisFilter(src.width, width, wrap);
+    const AxisFilter vertical = buildAxisFilter(src.height, height, wrap);
+    const size_t srcStride = static_cast<size_t>(src.width) * 4;
+
+    // Horizontal pass into a float buffer: src.height x width x 4
+    std::vector<float> temp(static_cast<size_t>(src.height) * width * 4);
+    auto horizontalRows = [&](size_t task) {
+        const int y0 = static_cast<int>(task) * kRowsPerTask;
+        const int y1 = std::min(src.height, y0 + kRowsPerTask);
+        for (int y = y0; y < y1; ++y) {
+            const uint8_t* row = src.rgba.data() + srcStride * y;
+            float* out = temp.data() + static_cast<size_t>(y) * width * 4;
+            for (int x = 0; x < width; ++x) {
+                const int* idx = horizontal.indices.data() + static_cast<size_t>(x) * horizontal.taps;
+                const float* w = horizontal.weights.data() + static_cast<size_t>(x) * horizontal.taps;
+#ifdef PAIBOT_MIP_SSE2
+                const __m128i zero = _mm_setzero_si128();
+                __m128 acc = _mm_setzero_ps();
+                for (int t = 0; t < horizontal.taps; ++t) {
+                    int32_t pixel;
+                    std::memcpy(&pixel, row + idx[t] * 4, 4);
+                    __m128i wide = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel), zero), zero);
+                    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_cvtepi32_ps(wide), _mm_set1_ps(w[t])));
+                }
+                _mm_storeu_ps(out + x * 4, acc);
+#else
+                float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                for (int t = 0; t < horizontal.taps; ++t) {
+                    const uint8_t* p = row + idx[t] * 4;
+                    for (int c = 0; c < 4; ++c) {
+                        acc[c] += static_cast<float>(p[c]) * w[t];
+                    }
+                }
+                std::memcpy(out + x * 4, acc, sizeof(acc));
+#endif
+            }
+        }
+    };
+
+    // Vertical pass back to RGBA8
+    auto verticalRows = [&](size_t task) {
+        const int y0 = static_cast<int>(task) * kRowsPerTask;
+        const int y1 = std::min(height, y0 + kRowsPerTask);
+        for (int y = y0; y < y1; ++y) {
+            const int* idx = vertical.indices.data() + static_cast<size_t>(y) * vertical.taps;
+            const float* w = vertical.weights.data() + static_cast<size_t>(y) * vertical.taps;
+            uint8_t* out = dst.rgba.data() + static_cast<size_t>(y) * width * 4;
+            for (int x = 0; x < width; ++x) {
+#ifdef PAIBOT_MIP_SSE2
+                __m128 acc = _mm_setzero_ps();
+                for (int t = 0; t < vertical.taps; ++t) {
+                    const float* p = temp.data() + (static_cast<size_t>(idx[t]) * width + x) * 4;
+                    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(p), _mm_set1_ps(w[t])));
+                }
+                acc = _mm_min_ps(_mm_max_ps(acc, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+                __m128i ints = _mm_cvtps_epi32(acc);
+                __m128i packed = _mm_packus_epi16(_mm_packs_epi32(ints, ints), ints);
+                int32_t pixel = _mm_cvtsi128_si32(packed);
+                std::memcpy(out + x * 4, &pixel, 4);
+#else
+                float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                for (int t = 0; t < vertical.taps; ++t) {
+                    const float* p = temp.data() + (static_cast<size_t>(idx[t]) * width + x) * 4;
+                    for (int c = 0; c < 4; ++c) {
+                        acc[c] += p[c] * w[t];
+                    }
+                }
+                for (int c = 0; c < 4; ++c) {
+                    out[x * 4 + c] = static_cast<uint8_t>(std::clamp(std::lround(acc[c]), 0L, 255L));
+                }
+#endif
+            }
+        }
+    };
+
+    auto* pool = WorkerPool::get();
+    pool->parallelFor(static_cast<size_t>((src.height + kRowsPerTask - 1) / kRowsPerTask), horizontalRows);
+    pool->parallelFor(static_cast<size_t>((height + kRowsPerTask - 1) / kRowsPerTask), verticalRows);
+}
+
+void MipChain::build(const uint8_t* rgba, int width, int height, int minSize, bool wrap) {
+    m_levels.clear();
+    m_wrap = wrap;
+    if (!rgba || width <= 0 || height <= 0) {
+        return;
+    }
+
+    MipLevel base;
+    base.width = width;
+    base.height = height;
+    base.rgba.assign(rgba, rgba + static_cast<size_t>(width) * height * 4);
+    m_levels.push_back(std::move(base));
+
+    minSize = std::max(1, minSize);
+    while (std::min(m_levels.back().width, m_levels.back().height) / 2 >= minSize) {
+        MipLevel next;
+        downsampleBox2x(m_levels.back(), next);
+        m_levels.push_back(std::move(next));
+    }
+}
+
+const MipLevel& MipChain::nearestLevel(int width, int height) const {
+    static const MipLevel s_empty;
+    if (m_levels.empty()) {
+        return s_empty;
+    }
+    size_t best = 0;
+    for (size_t i = 1; i < m_levels.size(); ++i) {
+        if (m_levels[i].width >= width && m_levels[i].height >= height) {
+            best = i;
+        } else {
+            break;
+        }
+    }
+    return m_levels[best];
+}
+
+MipLevel MipChain::resampleTo(int width, int height) const {
+    const MipLevel& level = nearestLevel(width, height);
+    if (level.width == width && level.height == height) {
+        return level;
+    }
+    MipLevel result;
+    resampleLanczos3(level, width, height, m_wrap, result);
+    return result;
+}
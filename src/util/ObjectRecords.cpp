@@ -0,0 +1,206 @@
+#include <util/ObjectRecords.hpp>
+#include <algorithm>
+#include <cmath>
+
+using namespace paibot;
+
+void ObjectRecords::reserve(size_t count) {
+    x.reserve(count);
+    y.reserve(count);
+    width.reserve(count);
+    height.reserve(count);
+    rotation.reserve(count);
+    scaleX.reserve(count);
+    scaleY.reserve(count);
+    objectId.reserve(count);
+    colorId.reserve(count);
+    detailColorId.reserve(count);
+    zOrder.reserve(count);
+    zLayer.reserve(count);
+    editorLayer.reserve(count);
+    groups.reserve(count);
+    kind.reserve(count);
+    flags.reserve(count);
+    sourceIndex.reserve(count);
+    templateIndex.reserve(count);
+    triggerIndex.reserve(count);
+}
+
+void ObjectRecords::clear() {
+    x.clear();
+    y.clear();
+    width.clear();
+    height.clear();
+    rotation.clear();
+    scaleX.clear();
+    scaleY.clear();
+    objectId.clear();
+    colorId.clear();
+    detailColorId.clear();
+    zOrder.clear();
+    zLayer.clear();
+    editorLayer.clear();
+    groups.clear();
+    kind.clear();
+    flags.clear();
+    sourceIndex.clear();
+    templateIndex.clear();
+    triggerIndex.clear();
+    triggerParams.clear();
+}
+
+void ObjectRecords::push(const ObjectRecord& record) {
+    x.push_back(record.x);
+    y.push_back(record.y);
+    width.push_back(record.width);
+    height.push_back(record.height);
+    rotation.push_back(record.rotation);
+    scaleX.push_back(record.scaleX);
+    scaleY.push_back(record.scaleY);
+    objectId.push_back(record.objectId);
+    colorId.push_back(record.colorId);
+    detailColorId.push_back(record.detailColorId);
+    zOrder.push_back(record.zOrder);
+    zLayer.push_back(record.zLayer);
+    editorLayer.push_back(record.editorLayer);
+    groups.push_back(record.groups);
+    kind.push_back(record.kind);
+    flags.push_back(record.flags);
+    sourceIndex.push_back(record.sourceIndex);
+    templateIndex.push_back(record.templateIndex);
+    if (record.trigger) {
+        triggerIndex.push_back(static_cast<int32_t>(triggerParams.size()));
+        triggerParams.push_back(*record.trigger);
+    } else {
+        triggerIndex.push_back(-1);
+    }
+}
+
+void ObjectRecords::append(const ObjectRecords& other, size_t index) {
+    x.push_back(other.x[index]);
+    y.push_back(other.y[index]);
+    width.push_back(other.width[index]);
+    height.push_back(other.height[index]);
+    rotation.push_back(other.rotation[index]);
+    scaleX.push_back(other.scaleX[index]);
+    scaleY.push_back(other.scaleY[index]);
+    objectId.push_back(other.objectId[index]);
+    colorId.push_back(other.colorId[index]);
+    detailColorId.push_back(other.detailColorId[index]);
+    zOrder.push_back(other.zOrder[index]);
+    zLayer.push_back(other.zLayer[index]);
+    editorLayer.push_back(other.editorLayer[index]);
+    groups.push_back(other.groups[index]);
+    kind.push_back(other.kind[index]);
+    flags.push_back(other.flags[index]);
+    sourceIndex.push_back(other.sourceIndex[index]);
+    templateIndex.push_back(other.templateIndex[index]);
+    if (const auto* trigger = other.getTrigger(index)) {
+        triggerIndex.push_back(static_cast<int32_t>(triggerParams.size()));
+        triggerParams.push_back(*trigger);
+    } else {
+        triggerIndex.push_back(-1);
+    }
+}
+
+void ObjectRecords::append(const ObjectRecords& other) {
+    auto extend = [](auto& to, const auto& from) {
+        to.insert(to.end(), from.begin(), from.end());
+    };
+    extend(x, other.x);
+    extend(y, other.y);
+    extend(width, other.width);
+    extend(height, other.height);
+    extend(rotation, other.rotation);
+    extend(scaleX, other.scaleX);
+    extend(scaleY, other.scaleY);
+    extend(objectId, other.objectId);
+    extend(colorId, other.colorId);
+    extend(detailColorId, other.detailColorId);
+    extend(zOrder, other.zOrder);
+    extend(zLayer, other.zLayer);
+    extend(editorLayer, other.editorLayer);
+    extend(groups, other.groups);
+    extend(kind, other.kind);
+    extend(flags, other.flags);
+    extend(sourceIndex, other.sourceIndex);
+    extend(templateIndex, other.templateIndex);
+
+    // Trigger indices are relative to the pool they came from
+    const auto poolOffset = static_cast<int32_t>(triggerParams.size());
+    for (int32_t index : other.triggerIndex) {
+        triggerIndex.push_back(index >= 0 ? index + poolOffset : -1);
+    }
+    extend(triggerParams, other.triggerParams);
+}
+
+ObjectRecords ObjectRecords::select(const std::vector<uint32_t>& indices) const {
+    ObjectRecords subset;
+    subset.reserve(indices.size());
+    for (uint32_t index : indices) {
+        subset.append(*this, index);
+    }
+    return subset;
+}
+
+ObjectRecord ObjectRecords::get(size_t index) const {
+    ObjectRecord record;
+    record.x = x[index];
+    record.y = y[index];
+    record.width = width[index];
+    record.height = height[index];
+    record.rotation = rotation[index];
+    record.scaleX = scaleX[index];
+    record.scaleY = scaleY[index];
+    record.objectId = objectId[index];
+    record.colorId = colorId[index];
+    record.detailColorId = detailColorId[index];
+    record.zOrder = zOrder[index];
+    record.zLayer = zLayer[index];
+    record.editorLayer = editorLayer[index];
+    record.groups = groups[index];
+    record.kind = kind[index];
+    record.flags = flags[index];
+    record.sourceIndex = sourceIndex[index];
+    record.templateIndex = templateIndex[index];
+    if (const auto* trigger = getTrigger(index)) {
+        record.trigger = *trigger;
+    }
+    return record;
+}
+
+Aabb ObjectRecords::bounds(size_t index) const {
+    float halfW = width[index] * 0.5f;
+    float halfH = height[index] * 0.5f;
+    if (rotation[index] != 0.0f) {
+        const float radians = rotation[index] * 0.017453292f;
+        const float c = std::abs(std::cos(radians));
+        const float s = std::abs(std::sin(radians));
+        const float rotatedW = halfW * c + halfH * s;
+        const float rotatedH = halfW * s + halfH * c;
+        halfW = rotatedW;
+        halfH = rotatedH;
+    }
+    return {x[index] - halfW, y[index] - halfH, x[index] + halfW, y[index] + halfH};
+}
+
+void ObjectRecords::collectBounds(std::vector<Aabb>& out) const {
+    out.resize(size());
+    for (size_t i = 0; i < size(); ++i) {
+        out[i] = bounds(i);
+    }
+}
+
+uint64_t ObjectRecords::groupSignature(const short* groupIds, size_t count) {
+    if (!groupIds || count == 0) {
+        return 0;
+    }
+    std::vector<short> sorted(groupIds, groupIds + count);
+    std::sort(sorted.begin(), sorted.end());
+    uint64_t h = 1469598103934665603ull;
+    for (short group : sorted) {
+        h ^= static_cast<uint16_t>(group);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
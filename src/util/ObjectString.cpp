@@ -0,0 +1,142 @@
+#include <util/ObjectString.hpp>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+
+using namespace paibot;
+
+namespace {
+    bool isRecordField(int32_t key) {
+        switch (key) {
+            case ObjectKey::Id:
+            case ObjectKey::X:
+            case ObjectKey::Y:
+            case ObjectKey::FlipX:
+            case ObjectKey::FlipY:
+            case ObjectKey::Rotation:
+            case ObjectKey::EditorLayer:
+            case ObjectKey::Color:
+            case ObjectKey::DetailColor:
+            case ObjectKey::ZLayer:
+            case ObjectKey::ZOrder:
+            case ObjectKey::Scale:
+            case ObjectKey::ScaleX:
+            case ObjectKey::ScaleY:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void appendField(std::string& out, int32_t key, int64_t value) {
+        if (!out.empty() && out.back() != ';') {
+            out += ',';
+        }
+        out += std::to_string(key);
+        out += ',';
+        out += std::to_string(value);
+    }
+
+    void appendField(std::string& out, int32_t key, float value) {
+        if (!out.empty() && out.back() != ';') {
+            out += ',';
+        }
+        out += std::to_string(key);
+        out += ',';
+        appendNumber(out, value);
+    }
+}
+
+bool paibot::parseObjectString(std::string_view text, ObjectFields& out) {
+    out.clear();
+    while (!text.empty() && text.back() == ';') {
+        text.remove_suffix(1);
+    }
+    size_t pos = 0;
+    while (pos < text.size()) {
+        const size_t keyEnd = text.find(',', pos);
+        if (keyEnd == std::string_view::npos) {
+            return false;
+        }
+        int32_t key = 0;
+        const auto [ptr, ec] = std::from_chars(text.data() + pos, text.data() + keyEnd, key);
+        if (ec != std::errc() || ptr != text.data() + keyEnd) {
+            return false;
+        }
+        const size_t valueStart = keyEnd + 1;
+        size_t valueEnd = text.find(',', valueStart);
+        if (valueEnd == std::string_view::npos) {
+            valueEnd = text.size();
+        }
+        out.emplace_back(key, text.substr(valueStart, valueEnd - valueStart));
+        pos = valueEnd + 1;
+    }
+    return true;
+}
+
+void paibot::appendNumber(std::string& out, float value) {
+    const float rounded = std::round(value * 1000.0f) / 1000.0f;
+    if (rounded == std::trunc(rounded) && std::abs(rounded) < 1e9f) {
+        out += std::to_string(static_cast<int64_t>(rounded));
+        return;
+    }
+    char buffer[32];
+    int length = std::snprintf(buffer, sizeof(buffer), "%.3f", static_cast<double>(rounded));
+    while (length > 0 && buffer[length - 1] == '0') {
+        --length;
+    }
+    out.append(buffer, static_cast<size_t>(length));
+}
+
+ObjectStringTemplate::ObjectStringTemplate(std::string_view text) {
+    ObjectFields fields;
+    if (!parseObjectString(text, fields)) {
+        return;
+    }
+    for (const auto& [key, value] : fields) {
+        if (isRecordField(key)) {
+            continue;
+        }
+        m_tail += ',';
+        m_tail += std::to_string(key);
+        m_tail += ',';
+        m_tail.append(value);
+    }
+}
+
+void ObjectStringTemplate::format(const ObjectRecords& records, size_t index, std::string& out) const {
+    appendField(out, ObjectKey::Id, int64_t{records.objectId[index]});
+    appendField(out, ObjectKey::X, records.x[index]);
+    appendField(out, ObjectKey::Y, records.y[index]);
+    if (records.hasFlag(index, ObjectFlipX)) {
+        appendField(out, ObjectKey::FlipX, int64_t{1});
+    }
+    if (records.hasFlag(index, ObjectFlipY)) {
+        appendField(out, ObjectKey::FlipY, int64_t{1});
+    }
+    if (records.rotation[index] != 0.0f) {
+        appendField(out, ObjectKey::Rotation, records.rotation[index]);
+    }
+    if (records.editorLayer[index] != 0) {
+        appendField(out, ObjectKey::EditorLayer, int64_t{records.editorLayer[index]});
+    }
+    if (records.colorId[index] > 0) {
+        appendField(out, ObjectKey::Color, int64_t{records.colorId[index]});
+    }
+    if (records.detailColorId[index] > 0) {
+        appendField(out, ObjectKey::DetailColor, int64_t{records.detailColorId[index]});
+    }
+    if (records.zLayer[index] != 0) {
+        appendField(out, ObjectKey::ZLayer, int64_t{records.zLayer[index]});
+    }
+    if (records.zOrder[index] != 0) {
+        appendField(out, ObjectKey::ZOrder, int64_t{records.zOrder[index]});
+    }
+    if (records.scaleX[index] != 1.0f) {
+        appendField(out, ObjectKey::ScaleX, records.scaleX[index]);
+    }
+    if (records.scaleY[index] != 1.0f) {
+        appendField(out, ObjectKey::ScaleY, records.scaleY[index]);
+    }
+    out += m_tail;
+}
@@ -0,0 +1,153 @@
+#include <util/OptimizerApplyTask.hpp>
+#include <Geode/binding/EditorUI.hpp>
+#include <Geode/binding/GameObject.hpp>
+#include <Geode/binding/LevelEditorLayer.hpp>
+#include <Geode/ui/Notification.hpp>
+#include <Geode/utils/cocos.hpp>
+#include <algorithm>
+#include <chrono>
+
+using namespace paibot;
+using namespace geode::prelude;
+
+OptimizerApplyTask* OptimizerApplyTask::create(ObjectRecords records, std::vector<WeakRef<GameObject>> sources,
+                                               float budgetMs) {
+    auto ret = new (std::nothrow) OptimizerApplyTask();
+    if (ret && ret->init(std::move(records), std::move(sources), budgetMs)) {
+        ret->autorelease();
+        return ret;
+    }
+    delete ret;
+    return nullptr;
+}
+
+bool OptimizerApplyTask::init(ObjectRecords records, std::vector<WeakRef<GameObject>> sources, float budgetMs) {
+    if (!CCNode::init()) {
+        return false;
+    }
+    m_records = std::move(records);
+    m_sources = std::move(sources);
+    m_budgetMs = std::max(0.5f, budgetMs);
+
+    // Records without a source become new objects; sources no record
+    // points at any more are deleted, unless the user already did
+    std::vector<uint8_t> kept(m_sources.size(), 0);
+    for (size_t i = 0; i < m_records.size(); ++i) {
+        const int32_t source = m_records.sourceIndex[i];
+        if (source >= 0 && static_cast<size_t>(source) < m_sources.size()) {
+            kept[source] = 1;
+        } else {
+            m_creations.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    for (size_t i = 0; i < m_sources.size(); ++i) {
+        if (auto obj = m_sources[i].lock(); !kept[i] && obj) {
+            m_removals.push_back(obj);
+        }
+    }
+    return true;
+}
+
+void OptimizerApplyTask::start(CCNode* host) {
+    if (auto* editor = LevelEditorLayer::get(); editor && editor->m_editorUI) {
+        editor->m_editorUI->deselectAll();
+    }
+    host->addChild(this);
+    m_progress = Notification::create("Applying optimization: 0%", NotificationIcon::Loading, 0.0f);
+    m_progress->show();
+    scheduleUpdate();
+}
+
+void OptimizerApplyTask::update(float) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto budget = std::chrono::duration<float, std::milli>(m_budgetMs);
+
+    // Replacements go in before the originals leave, so nothing flickers
+    do {
+        if (m_nextCreation < m_creations.size()) {
+            createBatch();
+        } else if (m_nextRemoval < m_removals.size()) {
+            removeBatch();
+        } else {
+            break;
+        }
+    } while (std::chrono::steady_clock::now() - start < budget);
+
+    if (isDone()) {
+        finish();
+        return;
+    }
+    const size_t percent = getDoneSteps() * 100 / std::max<size_t>(1, getTotalSteps());
+    m_progress->setString(fmt::format("Applying optimization: {}%", percent));
+}
+
+const ObjectStringTemplate& OptimizerApplyTask::templateFor(int32_t templateIndex) {
+    // A deleted template falls back to the default object string
+    Ref<GameObject> source;
+    if (templateIndex >= 0 && static_cast<size_t>(templateIndex) < m_sources.size()) {
+        source = m_sources[templateIndex].lock();
+    }
+    if (!source) {
+        templateIndex = -1;
+    }
+    auto it = m_templates.find(templateIndex);
+    if (it == m_templates.end()) {
+        ObjectStringTemplate objectTemplate;
+        if (source) {
+            const gd::string saved = source->getSaveString(LevelEditorLayer::get());
+            objectTemplate = ObjectStringTemplate(std::string_view(saved.c_str(), saved.size()));
+        }
+        it = m_templates.emplace(templateIndex, std::move(objectTemplate)).first;
+    }
+    return it->second;
+}
+
+void OptimizerApplyTask::createBatch() {
+    auto* editor = LevelEditorLayer::get();
+    const size_t end = std::min(m_creations.size(), m_nextCreation + kBatchSize);
+    m_batch.clear();
+    for (size_t k = m_nextCreation; k < end; ++k) {
+        const uint32_t index = m_creations[k];
+        if (!m_batch.empty()) {
+            m_batch += ';';
+        }
+        templateFor(m_records.templateIndex[index]).format(m_records, index, m_batch);
+    }
+    m_nextCreation = end;
+
+    if (!editor) {
+        return;
+    }
+    if (auto* created = editor->createObjectsFromString(m_batch, true, true)) {
+        for (auto* obj : CCArrayExt<GameObject*>(created)) {
+            m_created.push_back(obj);
+        }
+    }
+}
+
+void OptimizerApplyTask::removeBatch() {
+    auto* editor = LevelEditorLayer::get();
+    const size_t end = std::min(m_removals.size(), m_nextRemoval + kBatchSize);
+    for (size_t k = m_nextRemoval; k < end; ++k) {
+        // Skip objects the user deleted in the meantime
+        if (editor && m_removals[k]->getParent()) {
+            editor->removeObject(m_removals[k], true);
+        }
+    }
+    m_nextRemoval = end;
+}
+
+void OptimizerApplyTask::finish() {
+    unscheduleUpdate();
+    m_progress->setString(fmt::format("Optimization applied: {} created, {} removed", m_created.size(), m_removals.size()));
+    m_progress->setIcon(NotificationIcon::Success);
+    m_progress->setTime(NOTIFICATION_DEFAULT_TIME);
+
+    log::info("Applied optimization: {} objects created, {} removed", m_created.size(), m_removals.size());
+    if (m_onFinished) {
+        m_onFinished(m_created);
+    }
+    m_removals.clear();
+    m_sources.clear();
+    removeFromParent();
+}
@@ -0,0 +1,1553 @@
+#include <util/OptimizerPipeline.hpp>
+#include <util/LabColor.hpp>
+#include <util/LatticeRegion.hpp>
+#include <util/RectMerge.hpp>
+#include <util/StageTimer.hpp>
+#include <util/WorkerPool.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
+
+using namespace paibot;
+
+namespace {
+    // Objects may only be fused when everything that affects how they draw or
+    // behave matches; the geometry is the only thing a merge changes
+    struct BlockKey {
+        int objectID = 0;
+        int colorID = 0;
+        int detailColorID = 0;
+        int zLayer = 0;
+        int zOrder = 0;
+        int editorLayer = 0;
+        uint64_t groups = 0;
+        uint8_t flip = 0;
+
+        bool operator==(const BlockKey& other) const = default;
+    };
+
+    struct BlockKeyHash {
+        size_t operator()(const BlockKey& key) const {
+            uint64_t h = 1469598103934665603ull;
+            auto mix = [&](uint64_t value) {
+                h ^= value;
+                h *= 1099511628211ull;
+            };
+            mix(static_cast<uint64_t>(key.objectID));
+            mix(static_cast<uint64_t>(key.colorID));
+            mix(static_cast<uint64_t>(key.detailColorID));
+            mix(static_cast<uint64_t>(key.zLayer));
+            mix(static_cast<uint64_t>(key.zOrder));
+            mix(static_cast<uint64_t>(key.editorLayer));
+            mix(key.groups);
+            mix(key.flip);
+            return static_cast<size_t>(h);
+        }
+    };
+
+    // Thin pieces on one line: same appearance, direction, offset and thickness
+    struct LineKey {
+        int32_t objectId = 0;
+        int32_t colorId = 0;
+        int32_t detailColorId = 0;
+        int32_t zOrder = 0;
+        int16_t zLayer = 0;
+        int16_t editorLayer = 0;
+        uint64_t groups = 0;
+        uint8_t flags = 0;
+        ObjectKind kind = ObjectKind::Other;
+        int64_t angle = 0;       // direction bucket
+        int64_t offset = 0;      // perpendicular distance from the origin
+        int64_t thickness = 0;
+
+        auto operator<=>(const LineKey& other) const = default;
+    };
+
+    struct LineEntry {
+        LineKey key;
+        float start = 0.0f;      // interval along the direction
+        float end = 0.0f;
+        float offset = 0.0f;
+        float radians = 0.0f;    // exact direction
+        uint32_t index = 0;
+    };
+
+    // Direction buckets are fine enough that pieces sharing one stay within
+    // the geometry tolerance over any practical length
+    constexpr double kAngleBucketDegrees = 0.1;
+
+    bool isQuarterTurn(float rotation) {
+        const float remainder = std::fmod(std::abs(rotation), 90.0f);
+        return remainder < 1e-3f || remainder > 90.0f - 1e-3f;
+    }
+
+    // Segment tree over compressed y coordinates that tracks how much of the
+    // range is covered by at least one active interval
+    class CoverageTree {
+        const std::vector<float>& m_ys;
+        std::vector<int> m_count;
+        std::vector<float> m_covered;
+
+        void update(size_t node, size_t lo, size_t hi, size_t from, size_t to, int delta) {
+            if (to <= lo || hi <= from) {
+                return;
+            }
+            if (from <= lo && hi <= to) {
+                m_count[node] += delta;
+            } else {
+                const size_t mid = (lo + hi) / 2;
+                update(node * 2, lo, mid, from, to, delta);
+                update(node * 2 + 1, mid, hi, from, to, delta);
+            }
+            if (m_count[node] > 0) {
+                m_covered[node] = m_ys[hi] - m_ys[lo];
+            } else if (hi - lo == 1) {
+                m_covered[node] = 0.0f;
+            } else {
+                m_covered[node] = m_covered[node * 2] + m_covered[node * 2 + 1];
+            }
+        }
+
+    public:
+        explicit CoverageTree(const std::vector<float>& ys)
+            : m_ys(ys), m_count(ys.size() * 4, 0), m_covered(ys.size() * 4, 0.0f) {}
+
+        // Adds (+1) or removes (-1) the interval [ys[from], ys[to])
+        void update(size_t from, size_t to, int delta) {
+            if (from < to) {
+                update(1, 0, m_ys.size() - 1, from, to, delta);
+            }
+        }
+        float covered() const { return m_covered[1]; }
+    };
+
+    // Whether the union of `occluders` contains `target`: sweep over x,
+    // checking the covered length on y between consecutive events
+    bool isCovered(const Aabb& target, const std::vector<Aabb>& occluders) {
+        struct Event {
+            float x;
+            int delta;
+            size_t from;
+            size_t to;
+        };
+        std::vector<float> ys{target.minY, target.maxY};
+        std::vector<Aabb> clipped;
+        clipped.reserve(occluders.size());
+        for (const auto& box : occluders) {
+            const Aabb clip{std::max(box.minX, target.minX), std::max(box.minY, target.minY),
+                            std::min(box.maxX, target.maxX), std::min(box.maxY, target.maxY)};
+            if (clip.minX < clip.maxX && clip.minY < clip.maxY) {
+                clipped.push_back(clip);
+                ys.push_back(clip.minY);
+                ys.push_back(clip.maxY);
+            }
+        }
+        if (clipped.empty()) {
+            return false;
+        }
+        std::sort(ys.begin(), ys.end());
+        ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+        if (ys.size() < 2) {
+            return false;
+        }
+
+        auto yIndex = [&](float y) {
+            return static_cast<size_t>(std::lower_bound(ys.begin(), ys.end(), y) - ys.begin());
+        };
+        std::vector<Event> events;
+        events.reserve(clipped.size() * 2);
+        for (const auto& clip : clipped) {
+            const size_t from = yIndex(clip.minY);
+            const size_t to = yIndex(clip.maxY);
+            events.push_back({clip.minX, 1, from, to});
+            events.push_back({clip.maxX, -1, from, to});
+        }
+        std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+            return a.x != b.x ? a.x < b.x : a.delta > b.delta;
+        });
+
+        CoverageTree tree(ys);
+        const float height = target.maxY - target.minY;
+        const float slack = std::max(1e-4f, height * 1e-5f);
+        float x = target.minX;
+        size_t e = 0;
+        while (true) {
+            while (e < events.size() && events[e].x <= x) {
+                tree.update(events[e].from, events[e].to, events[e].delta);
+                ++e;
+            }
+            if (tree.covered() < height - slack) {
+                return false;
+            }
+            if (e == events.size()) {
+                return false;
+            }
+            if (events[e].x >= target.maxX) {
+                return true;
+            }
+            x = events[e].x;
+        }
+    }
+
+    // Union-find with path halving; the smaller index becomes the root so the
+    // result does not depend on the order pairs are joined in
+    class DisjointSet {
+        std::vector<uint32_t> m_parent;
+
+    public:
+        explicit DisjointSet(size_t count) : m_parent(count) {
+            for (size_t i = 0; i < count; ++i) {
+                m_parent[i] = static_cast<uint32_t>(i);
+            }
+        }
+
+        uint32_t find(uint32_t i) {
+            while (m_parent[i] != i) {
+                m_parent[i] = m_parent[m_parent[i]];
+                i = m_parent[i];
+            }
+            return i;
+        }
+
+        void unite(uint32_t a, uint32_t b) {
+            a = find(a);
+            b = find(b);
+            if (a != b) {
+                m_parent[std::max(a, b)] = std::min(a, b);
+            }
+        }
+    };
+
+    // Footprint in whole grid cells, or false when the object is not aligned
+    bool gridFootprint(const ObjectRecords& records, size_t index, float grid, GridRect& cells) {
+        const Aabb box = records.bounds(index);
+        const float epsilon = grid * 0.01f;
+        auto toCell = [&](float value, int& out) {
+            const float cell = value / grid;
+            out = static_cast<int>(std::lround(cell));
+            return std::abs(cell - static_cast<float>(out)) * grid <= epsilon;
+        };
+        int x0, y0, x1, y1;
+        if (!toCell(box.minX, x0) || !toCell(box.minY, y0) || !toCell(box.maxX, x1) || !toCell(box.maxY, y1)) {
+            return false;
+        }
+        cells = {x0, y0, x1 - x0, y1 - y0};
+        return cells.width > 0 && cells.height > 0;
+    }
+
+    struct BlockMember {
+        uint32_t index;
+        GridRect cells;
+    };
+
+    struct BlockGroup {
+        BlockKey key;
+        std::vector<BlockMember> members;
+    };
+
+    // Grid aligned blocks that may fuse, grouped by everything but geometry
+    // in first-seen order. Other records are copied to `passthrough`.
+    std::vector<BlockGroup> groupBlocks(const ObjectRecords& records, const OptimizeOptions& options,
+                                        int canonicalObjectId, float grid, ObjectRecords& passthrough) {
+        std::vector<BlockGroup> groups;
+        std::unordered_map<BlockKey, size_t, BlockKeyHash> keyIndex;
+        for (size_t i = 0; i < records.size(); ++i) {
+            // Only unrotated, uniformly scaled, grid aligned solids (and decor rects when enabled)
+            const ObjectKind kind = records.kind[i];
+            bool eligible = kind == ObjectKind::Solid ? (options.includeTiles || options.includeWalls)
+                          : kind == ObjectKind::Decoration ? options.includeDecorRects
+                          : false;
+            eligible = eligible && records.rotation[i] == 0.0f;
+            // Pieces generated by an earlier pass (or chunk) are stretched by
+            // construction and stay mergeable
+            eligible = eligible && (options.includeNonUniformScale || records.scaleX[i] == records.scaleY[i] ||
+                                    records.sourceIndex[i] < 0);
+            eligible = eligible && (options.includeHidden || !records.hasFlag(i, ObjectHidden));
+            eligible = eligible && (options.includeLocked || !records.hasFlag(i, ObjectLocked));
+
+            GridRect cells;
+            if (!eligible || !gridFootprint(records, i, grid, cells)) {
+                passthrough.append(records, i);
+                continue;
+            }
+
+            BlockKey key;
+            key.objectID = options.keepExactSkins ? records.objectId[i] : canonicalObjectId;
+            key.colorID = records.colorId[i];
+            key.detailColorID = records.detailColorId[i];
+            key.zLayer = records.zLayer[i];
+            key.zOrder = records.zOrder[i];
+            key.editorLayer = records.editorLayer[i];
+            key.groups = records.groups[i];
+            key.flip = records.flags[i] & (ObjectFlipX | ObjectFlipY);
+
+            auto [it, inserted] = keyIndex.try_emplace(key, groups.size());
+            if (inserted) {
+                groups.push_back({key, {}});
+            }
+            groups[it->second].members.push_back({static_cast<uint32_t>(i), cells});
+        }
+        return groups;
+    }
+
+    // New piece covering `cells`; inherits everything but geometry from
+    // `source`. Scale follows the source's size-to-scale ratio, or the
+    // canonical block size when the skin is replaced.
+    ObjectRecord makePiece(const ObjectRecord& source, int32_t objectId, const GridRect& cells, float grid) {
+        ObjectRecord piece = source;
+        const bool sameSkin = objectId == source.objectId;
+        piece.sourceIndex = -1;
+        piece.objectId = objectId;
+        piece.width = cells.width * grid;
+        piece.height = cells.height * grid;
+        piece.x = (cells.x + cells.width * 0.5f) * grid;
+        piece.y = (cells.y + cells.height * 0.5f) * grid;
+        piece.scaleX = sameSkin ? source.scaleX * piece.width / source.width : piece.width / OptimizerPipeline::kBlockSize;
+        piece.scaleY = sameSkin ? source.scaleY * piece.height / source.height : piece.height / OptimizerPipeline::kBlockSize;
+        return piece;
+    }
+}
+
+OptimizerPipeline::OptimizerPipeline(OptimizerConfig config) : m_config(std::move(config)) {}
+
+bool OptimizerPipeline::isOpaqueSkin(int32_t objectId) {
+    // Default block and the plain square art block
+    return objectId == 1 || objectId == 211;
+}
+
+void OptimizerPipeline::log(OptimizerLogLevel level, const std::string& message) const {
+    if (m_config.logger) {
+        m_config.logger(level, message);
+    }
+}
+
+PipelineResult OptimizerPipeline::run(const ObjectRecords& records) const {
+    PipelineResult output;
+    output.records = optimizeRecords(records, output.triggerRewrites, &output.stages);
+    const StageTimer patterns;
+    output.patterns = findPatterns(output.records);
+    output.instances = createInstances(output.records, output.patterns);
+    addStage(output.stages, patterns.finish("patterns", output.records.size(), output.records.size()));
+    return output;
+}
+
+PipelineResult OptimizerPipeline::runChunked(const ObjectRecords& records) const {
+    const float width = m_config.chunkWidth;
+    if (records.empty() || width <= 0.0f) {
+        return run(records);
+    }
+    const auto [minX, maxX] = std::minmax_element(records.x.begin(), records.x.end());
+    const size_t chunkCount = static_cast<size_t>((*maxX - *minX) / width) + 1;
+    if (chunkCount <= 1) {
+        return run(records);
+    }
+
+    // Chunks own records by centre x; a counting sort keeps input order within a chunk
+    const float origin = *minX;
+    auto chunkOf = [&](size_t i) {
+        return std::min(chunkCount - 1, static_cast<size_t>((records.x[i] - origin) / width));
+    };
+    std::vector<uint32_t> offsets(chunkCount + 1, 0);
+    for (size_t i = 0; i < records.size(); ++i) {
+        ++offsets[chunkOf(i) + 1];
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<uint32_t> order(records.size());
+    {
+        auto next = offsets;
+        for (size_t i = 0; i < records.size(); ++i) {
+            order[next[chunkOf(i)]++] = static_cast<uint32_t>(i);
+        }
+    }
+
+    // Chunks run left to right. Result records reaching into the carried
+    // band at the right border are held back and optimized again with the
+    // next chunk, which stitches pieces that meet across the border. The
+    // band is as wide as the longest merged piece (rotated lines may run
+    // along their height cap), so every record a merge across the border
+    // could still take in is held back. Only one chunk and its carried band
+    // are worked on at a time.
+    const int maxCells = std::max({1, m_config.options.maxWidthCells, m_config.options.maxHeightCells});
+    const float band = std::max(m_config.chunkOverlap, maxCells * std::max(1.0f, m_config.snapGrid));
+    PipelineResult output;
+    ObjectRecords carried;
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        auto input = records.select(std::vector<uint32_t>(order.begin() + offsets[chunk], order.begin() + offsets[chunk + 1]));
+        input.append(carried);
+        carried.clear();
+        if (input.empty()) {
+            continue;
+        }
+
+        auto optimized = optimizeRecords(input, output.triggerRewrites, &output.stages);
+        const float border = origin + (chunk + 1) * width - band;
+        const bool last = chunk + 1 == chunkCount;
+        for (size_t i = 0; i < optimized.size(); ++i) {
+            // Triggers go by position so the carried band stays contiguous in time
+            const float reach = optimized.kind[i] == ObjectKind::Trigger ? optimized.x[i] : optimized.bounds(i).maxX;
+            if (!last && reach >= border) {
+                carried.append(optimized, i);
+            } else {
+                output.records.append(optimized, i);
+            }
+        }
+
+        log(OptimizerLogLevel::Info, "Chunk " + std::to_string(chunk + 1) + "/" + std::to_string(chunkCount) + ": " +
+            std::to_string(input.size()) + " -> " + std::to_string(optimized.size()) + " objects");
+        if (m_config.progress) {
+            m_config.progress(chunk + 1, chunkCount);
+        }
+    }
+
+    const StageTimer patterns;
+    output.patterns = findPatterns(output.records);
+    output.instances = createInstances(output.records, output.patterns);
+    addStage(output.stages, patterns.finish("patterns", output.records.size(), output.records.size()));
+    return output;
+}
+
+PipelineResult OptimizerPipeline::runToTarget(const ObjectRecords& input, TargetReport& report) const {
+    report = {};
+    report.target = std::clamp(m_config.targetReduction, 0.0f, 1.0f);
+    const size_t goal = input.size() - static_cast<size_t>(std::floor(input.size() * report.target));
+
+    // Start in the usual order of cost per saved object: overlap and trigger
+    // removal are near linear, block merging saves the most per millisecond,
+    // the exact partition the least. Relaxed rounds re-sort by what the
+    // passes actually cost and saved so far. Trigger coalescing does not
+    // depend on the tolerances, so it runs in the first round only.
+    enum class Pass { Overlaps, Triggers, Blocks, Lines, Polygons, Exact };
+    struct Candidate {
+        Pass pass;
+        const char* name;
+        bool tolerant;
+        double milliseconds = 0.0;
+        size_t saved = 0;
+    };
+    std::vector<Candidate> passes = {
+        {Pass::Overlaps, "overlaps", true}, {Pass::Triggers, "triggers", false}, {Pass::Blocks, "blocks", true},
+        {Pass::Lines, "lines", true}, {Pass::Polygons, "polygons", true}, {Pass::Exact, "exact partition", true}
+    };
+    auto costPerSaved = [](const Candidate& c) {
+        return c.saved > 0 ? c.milliseconds / static_cast<double>(c.saved) : std::numeric_limits<double>::infinity();
+    };
+
+    PipelineResult output;
+    ObjectRecords current = input;
+    const float baseGeometry = m_config.geometryTolerance;
+    const float baseColor = m_config.options.colorTolerance;
+    const float maxGeometry = std::max(baseGeometry, m_config.maxGeometryTolerance);
+    // Colour classes only exist under allowColorMerging, and buildColorClasses
+    // keeps triggered channels out of them at any tolerance
+    const float maxColor = m_config.rules.allowColorMerging ? std::max(baseColor, m_config.maxColorTolerance) : baseColor;
+    const int rounds = std::max(0, m_config.relaxSteps);
+    bool rejected = false;
+    for (int round = 0; round <= rounds && current.size() > goal && !rejected; ++round) {
+        if (round > 0 && maxGeometry == baseGeometry && maxColor == baseColor) {
+            break;
+        }
+        const float t = rounds > 0 ? static_cast<float>(round) / rounds : 0.0f;
+        OptimizerConfig config = m_config;
+        config.geometryTolerance = baseGeometry + (maxGeometry - baseGeometry) * t;
+        config.options.colorTolerance = baseColor + (maxColor - baseColor) * t;
+        config.colorTolerance = config.options.colorTolerance;
+        config.options.exactPartition = false;
+        const OptimizerPipeline step(config);
+        config.options.exactPartition = true;
+        const OptimizerPipeline exact(config);
+        if (round > 0) {
+            std::stable_sort(passes.begin(), passes.end(), [&](const Candidate& a, const Candidate& b) {
+                return costPerSaved(a) < costPerSaved(b);
+            });
+        }
+
+        for (auto& candidate : passes) {
+            if (current.size() <= goal) {
+                break;
+            }
+            if (round > 0 && !candidate.tolerant) {
+                continue;
+            }
+            const StageTimer timer;
+            std::vector<TriggerRewrite> rewrites;
+            ObjectRecords next;
+            switch (candidate.pass) {
+                case Pass::Overlaps: next = step.mergeOverlaps(current); break;
+                case Pass::Triggers: next = step.coalesceTriggers(current, &rewrites); break;
+                case Pass::Blocks:
+                    next = step.forEachCluster(current, [&step](const ObjectRecords& in, const ObjectCluster& cluster) {
+                        return step.mergeAdjacentBlocks(step.selectCluster(in, cluster));
+                    });
+                    break;
+                case Pass::Lines:
+                    next = step.forEachCluster(current, [&step](const ObjectRecords& in, const ObjectCluster& cluster) {
+                        return step.mergeGeometric(step.selectCluster(in, cluster));
+                    });
+                    break;
+                case Pass::Polygons:
+                case Pass::Exact: {
+                    const auto& pipeline = candidate.pass == Pass::Exact ? exact : step;
+                    next = pipeline.forEachCluster(current, [&pipeline](const ObjectRecords& in, const ObjectCluster& cluster) {
+                        return pipeline.polygonize(pipeline.selectCluster(in, cluster));
+                    });
+                    break;
+                }
+            }
+
+            PassStep applied;
+            applied.pass = candidate.name;
+            applied.geometryTolerance = config.geometryTolerance;
+            applied.colorTolerance = config.options.colorTolerance;
+            applied.objectsBefore = current.size();
+            applied.objectsAfter = next.size();
+            if (next.size() < current.size()) {
+                const auto deltaE = measureDeltaE(input, next);
+                applied.accepted = validateOptimization(input, next, deltaE);
+                if (applied.accepted) {
+                    candidate.saved += current.size() - next.size();
+                    current = std::move(next);
+                    report.deltaE = deltaE;
+                    output.triggerRewrites.insert(output.triggerRewrites.end(), rewrites.begin(), rewrites.end());
+                } else {
+                    // More tolerance will not make this pass any safer
+                    rejected = rejected || round > 0;
+                }
+            }
+            const auto stage = timer.finish(candidate.name, applied.objectsBefore, current.size());
+            applied.milliseconds = stage.milliseconds;
+            candidate.milliseconds += applied.milliseconds;
+            report.steps.push_back(applied);
+            addStage(output.stages, stage);
+        }
+    }
+
+    report.achieved = input.empty() ? 0.0f : 1.0f - static_cast<float>(current.size()) / input.size();
+    report.reached = current.size() <= goal;
+    log(report.reached ? OptimizerLogLevel::Info : OptimizerLogLevel::Warn,
+        "Target reduction " + std::to_string(report.target * 100.0f) + "%: achieved " +
+        std::to_string(report.achieved * 100.0f) + "% in " + std::to_string(report.steps.size()) + " steps");
+
+    output.records = std::move(current);
+    const StageTimer patterns;
+    output.patterns = findPatterns(output.records);
+    output.instances = createInstances(output.records, output.patterns);
+    addStage(output.stages, patterns.finish("patterns", output.records.size(), output.records.size()));
+    return output;
+}
+
+ObjectRecords OptimizerPipeline::optimizeRecords(const ObjectRecords& records,
+                                                 std::vector<TriggerRewrite>& triggerRewrites,
+                                                 std::vector<StageStats>* stages) const {
+    // Whole-selection passes first; hidden objects and redundant triggers
+    // never reach the clusters
+    const StageTimer overlapTimer;
+    const auto visible = mergeOverlaps(records);
+    const auto overlaps = overlapTimer.finish("overlaps", records.size(), visible.size());
+    const StageTimer triggerTimer;
+    const auto input = coalesceTriggers(visible, &triggerRewrites);
+    const auto triggers = triggerTimer.finish("triggers", visible.size(), input.size());
+    if (stages) {
+        addStage(*stages, overlaps);
+        addStage(*stages, triggers);
+    }
+
+    // Cluster passes report per cluster; they are summed under one lock
+    std::mutex stageMutex;
+    std::vector<StageStats> clusterStages;
+    size_t clusters = 0;
+    auto optimized = forEachCluster(input, [&](const ObjectRecords& in, const ObjectCluster& cluster) {
+        if (!stages) {
+            return optimizeCluster(in, cluster);
+        }
+        std::vector<StageStats> local;
+        auto result = optimizeCluster(in, cluster, &local);
+        std::lock_guard lock(stageMutex);
+        for (auto& stage : local) {
+            stage.workerTime = true;
+            addStage(clusterStages, stage);
+        }
+        return result;
+    }, &clusters, stages);
+    if (stages) {
+        for (const auto& stage : clusterStages) {
+            addStage(*stages, stage);
+        }
+    }
+    log(OptimizerLogLevel::Info, "Optimized " + std::to_string(clusters) + " clusters on " +
+        std::to_string(WorkerPool::get()->getThreadCount()) + " threads: " + std::to_string(records.size()) +
+        " -> " + std::to_string(optimized.size()) + " objects");
+    return optimized;
+}
+
+ObjectRecords OptimizerPipeline::forEachCluster(const ObjectRecords& input, const ClusterPass& pass,
+                                                size_t* clusterCount, std::vector<StageStats>* stages) const {
+    const StageTimer timer;
+    const auto clusters = groupByColorAndZGroup(input);
+    if (stages) {
+        addStage(*stages, timer.finish("cluster", input.size(), input.size()));
+    }
+    if (clusterCount) {
+        *clusterCount = clusters.size();
+    }
+
+    // Largest clusters are handed out first so a big one does not start last
+    // and leave the other threads idle
+    std::vector<size_t> order(clusters.size());
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return clusters[a].members.size() > clusters[b].members.size();
+    });
+
+    std::vector<ObjectRecords> results(clusters.size());
+    std::atomic<size_t> failed{0};
+    WorkerPool::get()->parallelFor(order.size(), [&](size_t task) {
+        const auto& cluster = clusters[order[task]];
+        try {
+            results[order[task]] = pass(input, cluster);
+        } catch (const std::exception&) {
+            // Leave the cluster as it was rather than losing the whole run
+            results[order[task]] = input.select(cluster.members);
+            failed.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    // Concatenated in cluster order, so the output does not depend on scheduling
+    size_t total = 0;
+    for (const auto& result : results) {
+        total += result.size();
+    }
+    ObjectRecords output;
+    output.reserve(total);
+    for (const auto& result : results) {
+        output.append(result);
+    }
+
+    if (failed.load() > 0) {
+        log(OptimizerLogLevel::Warn, std::to_string(failed.load()) + " clusters failed and were left unchanged");
+    }
+    return output;
+}
+
+ObjectRecords OptimizerPipeline::selectCluster(const ObjectRecords& input, const ObjectCluster& cluster) const {
+    auto records = input.select(cluster.members);
+
+    // A cluster spanning several channels of one colour class is recoloured
+    // to its lowest channel. Recoloured records no longer match their
+    // originals, so they are re-emitted.
+    const auto [minColor, maxColor] = std::minmax_element(records.colorId.begin(), records.colorId.end());
+    const auto [minDetail, maxDetail] = std::minmax_element(records.detailColorId.begin(), records.detailColorId.end());
+    if (*minColor != *maxColor || *minDetail != *maxDetail) {
+        const int32_t color = *minColor;
+        const int32_t detail = *minDetail;
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (records.colorId[i] != color || records.detailColorId[i] != detail) {
+                records.colorId[i] = color;
+                records.detailColorId[i] = detail;
+                records.sourceIndex[i] = -1;
+            }
+        }
+    }
+    return records;
+}
+
+ObjectRecords OptimizerPipeline::optimizeCluster(const ObjectRecords& input, const ObjectCluster& cluster,
+                                                 std::vector<StageStats>* stages) const {
+    auto records = selectCluster(input, cluster);
+    auto pass = [&](const char* name, auto&& run) {
+        const StageTimer timer;
+        const size_t before = records.size();
+        records = run(records);
+        if (stages) {
+            addStage(*stages, timer.finish(name, before, records.size()));
+        }
+    };
+    pass("blocks", [this](const ObjectRecords& r) { return mergeAdjacentBlocks(r); });
+    pass("lines", [this](const ObjectRecords& r) { return mergeGeometric(r); });
+    pass("polygons", [this](const ObjectRecords& r) { return polygonize(r); });
+    records = normalizeObjects(records);
+    return records;
+}
+
+ObjectRecords OptimizerPipeline::normalizeObjects(const ObjectRecords& records) const {
+    // Placeholder - normalize object transforms, colors, etc.
+    return records;
+}
+
+ObjectRecords OptimizerPipeline::mergeGeometric(const ObjectRecords& records) const {
+    auto merged = mergeSegments(records);
+    merged = mergeLines(merged);
+    return merged;
+}
+
+PatternReport OptimizerPipeline::findPatterns(const ObjectRecords& records) const {
+    // Motifs are connected components of touching non-trigger objects of any
+    // appearance. Each is encoded as its members relative to the anchor,
+    // quantized and sorted, then hashed; equal encodings repeat the motif.
+    // Sorting inside motifs is the only super-linear step.
+    PatternReport report;
+    const size_t count = records.size();
+    if (count < 4) {
+        return report;
+    }
+
+    std::vector<Aabb> boxes;
+    records.collectBounds(boxes);
+    SpatialHash index;
+    index.build(boxes, std::max(1.0f, m_config.snapGrid));
+    DisjointSet sets(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (records.kind[i] == ObjectKind::Trigger) {
+            continue;
+        }
+        const auto self = static_cast<uint32_t>(i);
+        index.forEachInBox(boxes[i].expanded(m_config.geometryTolerance), [&](uint32_t other) {
+            if (other > self && records.kind[other] != ObjectKind::Trigger) {
+                sets.unite(self, other);
+            }
+        });
+    }
+
+    std::vector<std::vector<uint32_t>> motifs;
+    std::unordered_map<uint32_t, size_t> motifOfRoot;
+    for (size_t i = 0; i < count; ++i) {
+        if (records.kind[i] == ObjectKind::Trigger) {
+            continue;
+        }
+        auto [it, inserted] = motifOfRoot.try_emplace(sets.find(static_cast<uint32_t>(i)), motifs.size());
+        if (inserted) {
+            motifs.emplace_back();
+        }
+        motifs[it->second].push_back(static_cast<uint32_t>(i));
+    }
+
+    // Canonical encoding: one row of words per member, rows sorted
+    constexpr size_t kWords = 12;
+    using Row = std::array<int64_t, kWords>;
+    const float quantum = std::max(0.01f, m_config.geometryTolerance);
+    auto quantize = [&](float value) { return static_cast<int64_t>(std::llround(value / quantum)); };
+
+    struct Encoded {
+        std::vector<Row> rows;
+        std::vector<uint32_t> order;   // members in row order
+        uint64_t hash = 0;
+    };
+    std::vector<Encoded> encoded(motifs.size());
+    std::unordered_map<uint64_t, std::vector<size_t>> buckets;
+    for (size_t m = 0; m < motifs.size(); ++m) {
+        const auto& members = motifs[m];
+        if (members.size() < 2) {
+            continue;
+        }
+        float anchorX = records.x[members.front()];
+        float anchorY = records.y[members.front()];
+        for (uint32_t i : members) {
+            anchorX = std::min(anchorX, records.x[i]);
+            anchorY = std::min(anchorY, records.y[i]);
+        }
+
+        auto& enc = encoded[m];
+        std::vector<std::pair<Row, uint32_t>> rows;
+        rows.reserve(members.size());
+        for (uint32_t i : members) {
+            rows.push_back({Row{quantize(records.x[i] - anchorX), quantize(records.y[i] - anchorY),
+                                quantize(records.width[i]), quantize(records.height[i]),
+                                std::llround(records.rotation[i] * 100.0f), records.objectId[i],
+                                records.colorId[i], records.detailColorId[i], records.zLayer[i],
+                                records.zOrder[i], static_cast<int64_t>(records.kind[i]),
+                                records.flags[i] & (ObjectFlipX | ObjectFlipY | ObjectHidden)}, i});
+        }
+        std::sort(rows.begin(), rows.end());
+
+        // Polynomial rolling hash over the row words
+        uint64_t hash = 0;
+        for (const auto& [row, index] : rows) {
+            for (int64_t word : row) {
+                hash = hash * 0x100000001B3ull + static_cast<uint64_t>(word) + 0x9E3779B97F4A7C15ull;
+            }
+            enc.rows.push_back(row);
+            enc.order.push_back(index);
+        }
+        enc.hash = hash;
+        buckets[hash].push_back(m);
+    }
+
+    for (auto& [hash, bucket] : buckets) {
+        if (bucket.size() < 2) {
+            continue;
+        }
+        // Split on the full encoding so hash collisions never pair different motifs
+        std::vector<uint8_t> taken(bucket.size(), 0);
+        for (size_t a = 0; a < bucket.size(); ++a) {
+            if (taken[a]) {
+                continue;
+            }
+            PatternGroup group;
+            group.hash = hash;
+            group.objectsPerInstance = encoded[bucket[a]].order.size();
+            group.instances.push_back(encoded[bucket[a]].order);
+            for (size_t b = a + 1; b < bucket.size(); ++b) {
+                if (!taken[b] && encoded[bucket[b]].rows == encoded[bucket[a]].rows) {
+                    taken[b] = 1;
+                    group.instances.push_back(encoded[bucket[b]].order);
+                }
+            }
+            if (group.instances.size() < 2) {
+                continue;
+            }
+            // Instances in record order so reports do not depend on hashing
+            std::sort(group.instances.begin(), group.instances.end());
+            const size_t k = group.objectsPerInstance;
+            const size_t n = group.instances.size();
+            report.repeatedObjects += (n - 1) * k;
+            report.savedObjects += n * k > k + n ? n * k - k - n : 0;
+            report.groups.push_back(std::move(group));
+        }
+    }
+    report.savedBytes = report.savedObjects * ObjectRecords::kRowBytes;
+
+    auto saving = [](const PatternGroup& group) {
+        return group.instances.size() * group.objectsPerInstance;
+    };
+    std::sort(report.groups.begin(), report.groups.end(), [&](const PatternGroup& a, const PatternGroup& b) {
+        return saving(a) != saving(b) ? saving(a) > saving(b) : a.instances.front() < b.instances.front();
+    });
+
+    if (!report.groups.empty()) {
+        log(OptimizerLogLevel::Info, "Found " + std::to_string(report.groups.size()) + " repeated patterns: " +
+            std::to_string(report.repeatedObjects) + " repeated objects, " + std::to_string(report.savedObjects) +
+            " (" + std::to_string(report.savedBytes / 1024) + " KB) saveable with instancing");
+    }
+    return report;
+}
+
+ObjectRecords OptimizerPipeline::polygonize(const ObjectRecords& records) const {
+    // Blocks of one appearance are united on the snap-grid lattice into
+    // polygons with holes and cut into rectangles again. Runs after the
+    // other merges, so it sees their pieces together, handles overlapping
+    // members exactly and has no bitmap size limit for sparse groups.
+    const auto& options = m_config.options;
+    const float grid = std::max(1.0f, m_config.snapGrid);
+
+    ObjectRecords out;
+    out.reserve(records.size());
+    const auto groups = groupBlocks(records, options, m_config.canonicalObjectId, grid, out);
+
+    // Exact partitions share one budget per call, which is one cluster
+    const auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::microseconds(static_cast<int64_t>(options.exactPartitionBudgetMs * 1000.0f));
+    size_t polygons = 0, holes = 0, replaced = 0, exact = 0, greedy = 0;
+    int64_t filled = 0;
+    std::vector<GridRect> cells;
+    for (const auto& group : groups) {
+        const auto& members = group.members;
+        if (members.size() < 2) {
+            out.append(records, members.front().index);
+            continue;
+        }
+        cells.clear();
+        std::map<std::tuple<int, int, int, int>, uint32_t> originals;
+        for (const auto& member : members) {
+            cells.push_back(member.cells);
+            originals.try_emplace({member.cells.x, member.cells.y, member.cells.width, member.cells.height}, member.index);
+        }
+
+        auto region = LatticeRegion::fromRects(cells);
+        const auto shapes = region.polygons();
+        size_t groupHoles = 0;
+        for (const auto& shape : shapes) {
+            groupHoles += shape.holes.size();
+        }
+        polygons += shapes.size();
+        holes += groupHoles;
+        int64_t groupFilled = 0;
+        if (!options.respectHoles && groupHoles > 0) {
+            const auto solid = region.withoutHoles();
+            groupFilled = solid.subtract(region).area();
+            filled += groupFilled;
+            region = solid;
+        }
+
+        // Pieces are capped like block merging; the cap splits rectangles
+        // into a grid of equal-sized tiles at most
+        std::vector<GridRect> cut;
+        if (options.exactPartition && region.partitionMinimum(cut, deadline)) {
+            ++exact;
+        } else {
+            greedy += options.exactPartition ? 1 : 0;
+            cut = region.decompose();
+        }
+        std::vector<GridRect> rects;
+        const int maxWidth = std::max(1, options.maxWidthCells);
+        const int maxHeight = std::max(1, options.maxHeightCells);
+        for (const auto& rect : cut) {
+            for (int y = 0; y < rect.height; y += maxHeight) {
+                for (int x = 0; x < rect.width; x += maxWidth) {
+                    rects.push_back({rect.x + x, rect.y + y, std::min(maxWidth, rect.width - x),
+                                     std::min(maxHeight, rect.height - y)});
+                }
+            }
+        }
+
+        // Keep the group as it is unless the cut saves objects or fills holes
+        if (rects.size() >= members.size() && groupFilled == 0) {
+            for (const auto& member : members) {
+                out.append(records, member.index);
+            }
+            continue;
+        }
+        const ObjectRecord source = records.get(members.front().index);
+        for (const auto& rect : rects) {
+            if (auto it = originals.find({rect.x, rect.y, rect.width, rect.height}); it != originals.end()) {
+                out.append(records, it->second);
+            } else {
+                out.push(makePiece(source, group.key.objectID, rect, grid));
+            }
+        }
+        replaced += members.size();
+    }
+
+    log(OptimizerLogLevel::Debug, "Polygonized " + std::to_string(groups.size()) + " block groups into " +
+        std::to_string(polygons) + " polygons with " + std::to_string(holes) + " holes: " +
+        std::to_string(records.size()) + " -> " + std::to_string(out.size()) + " objects (" +
+        std::to_string(replaced) + " replaced" + (filled > 0 ? ", " + std::to_string(filled) + " hole cells filled" : "") + ")");
+    if (greedy > 0) {
+        log(OptimizerLogLevel::Info, "Exact partition: " + std::to_string(exact) + " groups exact, " +
+            std::to_string(greedy) + " over size or time budget cut greedily");
+    }
+    return out;
+}
+
+ObjectRecords OptimizerPipeline::coalesceTriggers(const ObjectRecords& records,
+                                                  std::vector<TriggerRewrite>* rewrites) const {
+    // Only triggers that fire exactly once when the player passes them and
+    // that no other trigger can move, toggle or spawn (no groups) are
+    // touched. Triggers at the same x fire in the same frame, in placement
+    // order. Within such a frame:
+    //  - a colour/alpha trigger is overridden by a later one on the same
+    //    target, since the later action replaces it before any time passes.
+    //    An instant earlier trigger still sets the colour the later one
+    //    fades from, so it only goes when the later one is instant too.
+    //  - a trigger repeating the previous surviving one is a no-op.
+    struct TriggerKey {
+        int32_t type;
+        int32_t target;
+        int64_t bucket;
+
+        auto operator<=>(const TriggerKey& other) const = default;
+    };
+    const float bucketSize = std::max(1.0f, m_config.snapGrid);
+    std::map<TriggerKey, std::vector<uint32_t>> index;
+    for (size_t i = 0; i < records.size(); ++i) {
+        const auto* trigger = records.getTrigger(i);
+        const int32_t type = records.objectId[i];
+        if (!trigger || records.kind[i] != ObjectKind::Trigger || trigger->activation != 0 || records.groups[i] != 0 ||
+            (type != kColorTriggerId && type != kAlphaTriggerId && type != kToggleTriggerId)) {
+            continue;
+        }
+        const auto bucket = static_cast<int64_t>(std::floor(records.x[i] / bucketSize));
+        index[{type, trigger->target, bucket}].push_back(static_cast<uint32_t>(i));
+    }
+
+    std::vector<uint8_t> removed(records.size(), 0);
+    size_t removedCount = 0;
+    auto remove = [&](uint32_t victim, uint32_t proof, const char* why) {
+        removed[victim] = 1;
+        ++removedCount;
+        const auto* trigger = records.getTrigger(victim);
+        const std::string reason = std::string(why) + " (type " + std::to_string(records.objectId[victim]) +
+                                   ", target " + std::to_string(trigger->target) + ", x " +
+                                   std::to_string(records.x[victim]) + ")";
+        log(OptimizerLogLevel::Info, "Trigger " + std::to_string(records.sourceIndex[victim]) + " removed: " +
+            reason + ", proven by trigger " + std::to_string(records.sourceIndex[proof]));
+        if (rewrites) {
+            rewrites->push_back({records.sourceIndex[victim], records.sourceIndex[proof], reason});
+        }
+    };
+
+    std::vector<uint32_t> frame;
+    std::vector<uint32_t> survivors;
+    for (auto& [key, members] : index) {
+        std::sort(members.begin(), members.end(), [&](uint32_t a, uint32_t b) {
+            if (records.x[a] != records.x[b]) {
+                return records.x[a] < records.x[b];
+            }
+            const int32_t orderA = records.getTrigger(a)->order;
+            const int32_t orderB = records.getTrigger(b)->order;
+            return orderA != orderB ? orderA < orderB : a < b;
+        });
+
+        for (size_t begin = 0; begin < members.size();) {
+            // Triggers at exactly the same x
+            size_t end = begin + 1;
+            while (end < members.size() && records.x[members[end]] == records.x[members[begin]]) {
+                ++end;
+            }
+            frame.assign(members.begin() + begin, members.begin() + end);
+            begin = end;
+            if (frame.size() < 2) {
+                continue;
+            }
+
+            survivors.clear();
+            const uint32_t last = frame.back();
+            const auto& lastParams = *records.getTrigger(last);
+            const bool fades = key.type != kToggleTriggerId;
+            for (size_t f = 0; f + 1 < frame.size(); ++f) {
+                const auto& params = *records.getTrigger(frame[f]);
+                if (fades && params.copyColorId == 0 && lastParams.copyColorId == 0 &&
+                    (params.duration > 0.0f || lastParams.duration == 0.0f)) {
+                    remove(frame[f], last, "overridden in the same frame");
+                } else {
+                    survivors.push_back(frame[f]);
+                }
+            }
+            survivors.push_back(last);
+
+            for (size_t f = 1; f < survivors.size(); ++f) {
+                const uint32_t previous = survivors[f - 1];
+                if (!removed[previous] && records.getTrigger(survivors[f])->sameEffect(*records.getTrigger(previous))) {
+                    remove(survivors[f], previous, "repeats the previous trigger");
+                    // Keep comparing against the first of the run
+                    survivors[f] = previous;
+                }
+            }
+        }
+    }
+
+    if (removedCount == 0) {
+        return records;
+    }
+    ObjectRecords coalesced;
+    coalesced.reserve(records.size() - removedCount);
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (!removed[i]) {
+            coalesced.append(records, i);
+        }
+    }
+    log(OptimizerLogLevel::Info, "Coalesced triggers: removed " + std::to_string(removedCount));
+    return coalesced;
+}
+
+ObjectRecords OptimizerPipeline::mergeLines(const ObjectRecords& records) const {
+    // Rotated line art; quarter turns are left to mergeSegments
+    if (!m_config.options.includeRotated) {
+        return records;
+    }
+    return mergeCollinear(records, true);
+}
+
+ObjectRecords OptimizerPipeline::mergeMosaics(const ObjectRecords& records) const {
+    // Placeholder - merge tile patterns into larger objects
+    return records;
+}
+
+ObjectRecords OptimizerPipeline::mergeSegments(const ObjectRecords& records) const {
+    return mergeCollinear(records, false);
+}
+
+ObjectRecords OptimizerPipeline::mergeCollinear(const ObjectRecords& records, bool rotated) const {
+    // Key every thin piece by (direction, perpendicular offset, thickness,
+    // appearance), sort by key and start, then join overlapping or abutting
+    // intervals in one pass: O(n log n)
+    const auto& options = m_config.options;
+    const float quantum = std::max(0.01f, m_config.geometryTolerance);
+
+    std::vector<LineEntry> entries;
+    std::vector<uint8_t> isLine(records.size(), 0);
+    entries.reserve(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        // Line art is usually decoration; solids follow the tile/wall options
+        const ObjectKind kind = records.kind[i];
+        bool eligible = kind == ObjectKind::Decoration ||
+                        (kind == ObjectKind::Solid && (options.includeTiles || options.includeWalls));
+        eligible = eligible && isQuarterTurn(records.rotation[i]) != rotated;
+        eligible = eligible && (options.includeHidden || !records.hasFlag(i, ObjectHidden));
+        eligible = eligible && (options.includeLocked || !records.hasFlag(i, ObjectLocked));
+        const float width = records.width[i];
+        const float height = records.height[i];
+        // Squares have no direction
+        if (!eligible || std::abs(width - height) <= quantum || std::min(width, height) <= 0.0f) {
+            continue;
+        }
+
+        // Rotation is clockwise; direction is the long axis, counter-clockwise in [0, 180)
+        const bool alongWidth = width > height;
+        double angle = std::fmod(-static_cast<double>(records.rotation[i]) + (alongWidth ? 0.0 : 90.0), 180.0);
+        if (angle < 0.0) {
+            angle += 180.0;
+        }
+        const double radians = angle * 0.017453292519943295;
+        const double dx = std::cos(radians);
+        const double dy = std::sin(radians);
+        const double along = records.x[i] * dx + records.y[i] * dy;
+        const double across = -records.x[i] * dy + records.y[i] * dx;
+        const float length = std::max(width, height);
+        const float thickness = std::min(width, height);
+
+        LineEntry entry;
+        entry.key.objectId = records.objectId[i];
+        entry.key.colorId = records.colorId[i];
+        entry.key.detailColorId = records.detailColorId[i];
+        entry.key.zOrder = records.zOrder[i];
+        entry.key.zLayer = records.zLayer[i];
+        entry.key.editorLayer = records.editorLayer[i];
+        entry.key.groups = records.groups[i];
+        entry.key.flags = records.flags[i];
+        entry.key.kind = kind;
+        entry.key.angle = std::llround(angle / kAngleBucketDegrees);
+        entry.key.offset = std::llround(across / quantum);
+        entry.key.thickness = std::llround(thickness / quantum);
+        entry.start = static_cast<float>(along - length * 0.5);
+        entry.end = static_cast<float>(along + length * 0.5);
+        entry.offset = static_cast<float>(across);
+        entry.radians = static_cast<float>(radians);
+        entry.index = static_cast<uint32_t>(i);
+        entries.push_back(entry);
+        isLine[i] = 1;
+    }
+    if (entries.size() < 2) {
+        return records;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const LineEntry& a, const LineEntry& b) {
+        if (a.key != b.key) {
+            return a.key < b.key;
+        }
+        return a.start != b.start ? a.start < b.start : a.index < b.index;
+    });
+
+    ObjectRecords merged;
+    merged.reserve(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (!isLine[i]) {
+            merged.append(records, i);
+        }
+    }
+
+    // Runs are capped like block pieces, along the axis they stretch
+    const float grid = std::max(1.0f, m_config.snapGrid);
+    const float maxWidth = std::max(1, options.maxWidthCells) * grid;
+    const float maxHeight = std::max(1, options.maxHeightCells) * grid;
+
+    size_t runs = 0;
+    size_t absorbed = 0;
+    for (size_t begin = 0; begin < entries.size();) {
+        // Extend the run while the next interval overlaps or abuts it
+        const LineEntry& first = entries[begin];
+        const float maxLength = records.width[first.index] > records.height[first.index] ? maxWidth : maxHeight;
+        float runEnd = first.end;
+        size_t end = begin + 1;
+        while (end < entries.size() && entries[end].key == first.key && entries[end].start <= runEnd + quantum &&
+               std::max(runEnd, entries[end].end) - first.start <= maxLength) {
+            runEnd = std::max(runEnd, entries[end].end);
+            ++end;
+        }
+
+        if (end - begin == 1) {
+            merged.append(records, first.index);
+        } else {
+            // One stretched piece along the first member's axis
+            ObjectRecord piece = records.get(first.index);
+            const float length = runEnd - first.start;
+            const double dx = std::cos(static_cast<double>(first.radians));
+            const double dy = std::sin(static_cast<double>(first.radians));
+            const double middle = (first.start + runEnd) * 0.5;
+            piece.sourceIndex = -1;
+            piece.x = static_cast<float>(middle * dx - first.offset * dy);
+            piece.y = static_cast<float>(middle * dy + first.offset * dx);
+            if (piece.width > piece.height) {
+                piece.scaleX *= length / piece.width;
+                piece.width = length;
+            } else {
+                piece.scaleY *= length / piece.height;
+                piece.height = length;
+            }
+            merged.push(piece);
+            ++runs;
+            absorbed += end - begin;
+        }
+        begin = end;
+    }
+
+    if (runs > 0) {
+        log(OptimizerLogLevel::Debug, std::string(rotated ? "Merged lines: " : "Merged segments: ") +
+            std::to_string(absorbed) + " pieces into " + std::to_string(runs) + " runs");
+    }
+    return merged;
+}
+
+ObjectRecords OptimizerPipeline::mergeOverlaps(const ObjectRecords& records) const {
+    // Occluders: opaque, axis aligned, static and visible. Candidates: static
+    // visible objects without gameplay role (or any collider when hitboxes
+    // may change). Group members are skipped on both sides since triggers
+    // can move or toggle them.
+    const auto& options = m_config.options;
+    // Without respectHoles, seams narrower than the tolerance count as covered
+    const float seam = options.respectHoles ? 0.0f : std::max(0.0f, m_config.geometryTolerance);
+
+    std::vector<Aabb> boxes;
+    records.collectBounds(boxes);
+
+    std::vector<uint32_t> occluders;
+    std::vector<Aabb> occluderBoxes;
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (records.hasFlag(i, ObjectOpaque) && !records.hasFlag(i, ObjectHidden) &&
+            records.groups[i] == 0 && isQuarterTurn(records.rotation[i])) {
+            occluders.push_back(static_cast<uint32_t>(i));
+            occluderBoxes.push_back(boxes[i].expanded(seam));
+        }
+    }
+    if (occluders.empty()) {
+        return records;
+    }
+    SpatialHash index;
+    index.build(occluderBoxes, std::max(1.0f, m_config.snapGrid));
+
+    auto drawsAbove = [&](size_t a, size_t b) {
+        return records.zLayer[a] != records.zLayer[b] ? records.zLayer[a] > records.zLayer[b]
+                                                      : records.zOrder[a] > records.zOrder[b];
+    };
+
+    std::vector<uint8_t> hidden(records.size(), 0);
+    std::vector<Aabb> covering;
+    size_t removed = 0;
+    for (size_t i = 0; i < records.size(); ++i) {
+        const ObjectKind kind = records.kind[i];
+        bool candidate = kind == ObjectKind::Decoration ||
+                         (!m_config.preserveHitboxes && (kind == ObjectKind::Solid || kind == ObjectKind::Hazard));
+        candidate = candidate && records.groups[i] == 0 && !records.hasFlag(i, ObjectHidden);
+        candidate = candidate && (options.includeLocked || !records.hasFlag(i, ObjectLocked));
+        if (!candidate) {
+            continue;
+        }
+
+        // Inset by a hair so occluders that only share an edge are ignored
+        const Aabb& box = boxes[i];
+        covering.clear();
+        index.forEachInBox(box.expanded(-1e-3f), [&](uint32_t o) {
+            const uint32_t other = occluders[o];
+            if (other != i && drawsAbove(other, i)) {
+                covering.push_back(occluderBoxes[o]);
+            }
+        });
+        if (!covering.empty() && isCovered(box, covering)) {
+            hidden[i] = 1;
+            ++removed;
+        }
+    }
+    if (removed == 0) {
+        return records;
+    }
+
+    // Occluders are opaque and strictly above, so a hidden occluder's area is
+    // still covered by whatever hid it; all tests can use the original set
+    ObjectRecords visible;
+    visible.reserve(records.size() - removed);
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (!hidden[i]) {
+            visible.append(records, i);
+        }
+    }
+    log(OptimizerLogLevel::Info, "Removed " + std::to_string(removed) + " objects hidden under opaque objects");
+    return visible;
+}
+
+std::vector<InstanceDefinition> OptimizerPipeline::createInstances(const ObjectRecords& records,
+                                                                  const PatternReport& patterns) const {
+    // Vanilla levels have no way to reference a shared definition
+    std::vector<InstanceDefinition> definitions;
+    if (m_config.mode != OptimizationMode::GeodeRuntime) {
+        return definitions;
+    }
+
+    for (const auto& group : patterns.groups) {
+        InstanceDefinition definition;
+        definition.id = static_cast<uint32_t>(definitions.size());
+        for (const auto& instance : group.instances) {
+            float anchorX = records.x[instance.front()];
+            float anchorY = records.y[instance.front()];
+            for (uint32_t i : instance) {
+                anchorX = std::min(anchorX, records.x[i]);
+                anchorY = std::min(anchorY, records.y[i]);
+            }
+            definition.anchors.emplace_back(anchorX, anchorY);
+
+            // Members come from the first occurrence
+            if (definition.members.empty()) {
+                definition.members = records.select(instance);
+                for (size_t m = 0; m < definition.members.size(); ++m) {
+                    definition.members.x[m] -= anchorX;
+                    definition.members.y[m] -= anchorY;
+                }
+            }
+        }
+        definitions.push_back(std::move(definition));
+    }
+    return definitions;
+}
+
+ObjectRecords OptimizerPipeline::createCustomObjects(const ObjectRecords& records) const {
+    // Placeholder - create custom object definitions
+    return records;
+}
+
+std::unordered_map<int32_t, int32_t> OptimizerPipeline::buildColorClasses(const ObjectRecords& records) const {
+    std::vector<int32_t> channels;
+    channels.reserve(records.size() * 2);
+    channels.insert(channels.end(), records.colorId.begin(), records.colorId.end());
+    channels.insert(channels.end(), records.detailColorId.begin(), records.detailColorId.end());
+    std::sort(channels.begin(), channels.end());
+    channels.erase(std::unique(channels.begin(), channels.end()), channels.end());
+
+    std::unordered_map<int32_t, int32_t> classes;
+    classes.reserve(channels.size());
+    for (int32_t channel : channels) {
+        classes.emplace(channel, channel);
+    }
+
+    const float tolerance = m_config.options.colorTolerance;
+    if (!m_config.rules.allowColorMerging || tolerance <= 0.0f) {
+        return classes;
+    }
+
+    // Triggers in this run animate channels too, even when the caller did
+    // not list them
+    std::unordered_set<int32_t> animated = m_config.animatedChannels;
+    for (const auto& trigger : records.triggerParams) {
+        if (trigger.copyColorId > 0) {
+            animated.insert(trigger.copyColorId);
+        }
+    }
+    for (size_t i = 0; i < records.size(); ++i) {
+        const auto* trigger = records.getTrigger(i);
+        if (trigger && records.objectId[i] == kColorTriggerId && trigger->target > 0) {
+            animated.insert(trigger->target);
+        }
+    }
+
+    // Channels whose current colours are within tolerance form one class.
+    // Channel 0 is the object's own default colour and animated channels
+    // change at run time; neither is merged.
+    std::vector<int32_t> known;
+    std::vector<LabColor> colors;
+    for (int32_t channel : channels) {
+        auto it = m_config.channelColors.find(channel);
+        if (channel != 0 && it != m_config.channelColors.end() && !animated.contains(channel)) {
+            known.push_back(channel);
+            colors.push_back(LabColor::fromPacked(it->second));
+        }
+    }
+    DisjointSet sets(known.size());
+    for (size_t i = 0; i < known.size(); ++i) {
+        for (size_t j = i + 1; j < known.size(); ++j) {
+            if (LabColor::deltaE2000(colors[i], colors[j]) <= tolerance) {
+                sets.unite(static_cast<uint32_t>(i), static_cast<uint32_t>(j));
+            }
+        }
+    }
+    // `known` is ascending, so each root is the lowest channel of its class
+    for (size_t i = 0; i < known.size(); ++i) {
+        classes[known[i]] = known[sets.find(static_cast<uint32_t>(i))];
+    }
+    return classes;
+}
+
+std::vector<ObjectCluster> OptimizerPipeline::groupByColorAndZGroup(const ObjectRecords& records) const {
+    // Hash partition by (colour class, z-group, kind), then union-find over
+    // touching members of the same partition
+    const size_t count = records.size();
+    if (count == 0) {
+        return {};
+    }
+
+    const auto classes = buildColorClasses(records);
+    std::vector<ClusterKey> keys(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto& key = keys[i];
+        key.colorId = classes.at(records.colorId[i]);
+        key.detailColorId = classes.at(records.detailColorId[i]);
+        if (!m_config.rules.allowZGroupMerging) {
+            key.zLayer = records.zLayer[i];
+            key.zOrder = records.zOrder[i];
+        }
+        key.kind = records.kind[i];
+    }
+
+    std::vector<Aabb> boxes;
+    records.collectBounds(boxes);
+    SpatialHash index;
+    index.build(boxes, std::max(1.0f, m_config.snapGrid));
+
+    DisjointSet sets(count);
+    std::map<ClusterKey, uint32_t> triggerPartitions;
+    for (size_t i = 0; i < count; ++i) {
+        const auto self = static_cast<uint32_t>(i);
+        // Triggers act by group and position, not by touching; one cluster per partition
+        if (keys[i].kind == ObjectKind::Trigger) {
+            auto [it, inserted] = triggerPartitions.try_emplace(keys[i], self);
+            if (!inserted) {
+                sets.unite(it->second, self);
+            }
+            continue;
+        }
+        index.forEachInBox(boxes[i].expanded(m_config.geometryTolerance), [&](uint32_t other) {
+            if (other > self && keys[other] == keys[i]) {
+                sets.unite(self, other);
+            }
+        });
+    }
+
+    // Visiting records in order keeps every member list ascending
+    std::vector<ObjectCluster> clusters;
+    std::unordered_map<uint32_t, size_t> clusterOfRoot;
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t root = sets.find(static_cast<uint32_t>(i));
+        auto [it, inserted] = clusterOfRoot.try_emplace(root, clusters.size());
+        if (inserted) {
+            clusters.push_back({keys[i], {}});
+        }
+        clusters[it->second].members.push_back(static_cast<uint32_t>(i));
+    }
+    std::sort(clusters.begin(), clusters.end(), [](const ObjectCluster& a, const ObjectCluster& b) {
+        return a.key != b.key ? a.key < b.key : a.members.front() < b.members.front();
+    });
+
+    log(OptimizerLogLevel::Info, "Grouped " + std::to_string(count) + " objects into " +
+        std::to_string(clusters.size()) + " clusters");
+    return clusters;
+}
+
+ObjectRecords OptimizerPipeline::mergeAdjacentBlocks(const ObjectRecords& records) const {
+    // Merge adjacent blocks with same color and z-group
+    // Reject fusions that would create corrupt polygons
+    const auto& options = m_config.options;
+    const float grid = std::max(1.0f, m_config.snapGrid);
+
+    ObjectRecords merged;
+    merged.reserve(records.size());
+    const auto buckets = groupBlocks(records, options, m_config.canonicalObjectId, grid, merged);
+
+    // Bitmaps larger than this are left alone (sparse selections spanning a whole level)
+    constexpr int64_t kMaxGridCells = int64_t{1} << 24;
+
+    size_t created = 0;
+    for (size_t b = 0; b < buckets.size(); ++b) {
+        const auto& members = buckets[b].members;
+        if (members.size() < 2) {
+            merged.append(records, members.front().index);
+            continue;
+        }
+
+        int minX = members.front().cells.x, minY = members.front().cells.y;
+        int maxX = minX, maxY = minY;
+        for (const auto& member : members) {
+            minX = std::min(minX, member.cells.x);
+            minY = std::min(minY, member.cells.y);
+            maxX = std::max(maxX, member.cells.x + member.cells.width);
+            maxY = std::max(maxY, member.cells.y + member.cells.height);
+        }
+        if (static_cast<int64_t>(maxX - minX) * (maxY - minY) > kMaxGridCells) {
+            log(OptimizerLogLevel::Warn, "Block group spans " + std::to_string(maxX - minX) + "x" +
+                std::to_string(maxY - minY) + " cells, skipping merge");
+            for (const auto& member : members) {
+                merged.append(records, member.index);
+            }
+            continue;
+        }
+
+        // Rasterize, remembering which original already covers a given rectangle
+        OccupancyGrid occupancy(maxX - minX, maxY - minY);
+        std::map<std::tuple<int, int, int, int>, uint32_t> exact;
+        for (const auto& member : members) {
+            GridRect local{member.cells.x - minX, member.cells.y - minY, member.cells.width, member.cells.height};
+            occupancy.fill(local, true);
+            exact.try_emplace({local.x, local.y, local.width, local.height}, member.index);
+        }
+
+        auto rects = RectMerge::extractGreedy(occupancy, options.maxWidthCells, options.maxHeightCells);
+        const ObjectRecord source = records.get(members.front().index);
+        for (const auto& rect : rects) {
+            if (auto it = exact.find({rect.x, rect.y, rect.width, rect.height}); it != exact.end()) {
+                merged.append(records, it->second);
+                continue;
+            }
+            merged.push(makePiece(source, buckets[b].key.objectID, {minX + rect.x, minY + rect.y, rect.width, rect.height}, grid));
+            ++created;
+        }
+    }
+
+    log(OptimizerLogLevel::Debug, "Merged adjacent blocks: " + std::to_string(records.size()) + " -> " +
+        std::to_string(merged.size()) + " objects (" + std::to_string(created) + " new pieces, " +
+        std::to_string(buckets.size()) + " groups)");
+    return merged;
+}
+
+DeltaEStats OptimizerPipeline::measureDeltaE(const ObjectRecords& before, const ObjectRecords& after) const {
+    RasterSettings settings;
+    settings.pixelSize = std::max(1.0f, m_config.snapGrid * 0.25f);
+    settings.channelColors = &m_config.channelColors;
+    if (auto it = m_config.channelColors.find(kBackgroundChannel); it != m_config.channelColors.end()) {
+        settings.background = it->second;
+    }
+    return SceneRaster::compare(before, after, settings);
+}
+
+float OptimizerPipeline::calculateDeltaE(const ObjectRecords& before, const ObjectRecords& after) const {
+    return measureDeltaE(before, after).mean;
+}
+
+bool OptimizerPipeline::validateOptimization(const ObjectRecords& original, const ObjectRecords& optimized) const {
+    return validateOptimization(original, optimized, measureDeltaE(original, optimized));
+}
+
+bool OptimizerPipeline::validateOptimization(const ObjectRecords& original, const ObjectRecords& optimized,
+                                             const DeltaEStats& deltaE) const {
+    // Validate that optimization didn't break anything
+    if (optimized.empty() && !original.empty()) {
+        log(OptimizerLogLevel::Error, "Optimization resulted in empty set from non-empty input");
+        return false;
+    }
+
+    // Large solid areas legitimately collapse into a handful of pieces, so a
+    // high ratio is only worth a note in the log
+    const float reductionRatio = 1.0f - static_cast<float>(optimized.size()) / original.size();
+    if (reductionRatio > 0.95f) {
+        log(OptimizerLogLevel::Info, "High reduction ratio: " + std::to_string(reductionRatio * 100.0f) + "%");
+    }
+
+    log(OptimizerLogLevel::Debug, "Visual difference over " + std::to_string(deltaE.pixels) + " changed pixels: mean dE " +
+        std::to_string(deltaE.mean) + ", p99 " + std::to_string(deltaE.p99) + ", max " + std::to_string(deltaE.max));
+
+    // Validate visual difference is acceptable
+    if (deltaE.mean > 5.0f) {  // Threshold for acceptable visual difference
+        log(OptimizerLogLevel::Warn, "Optimization visual difference too high: dE = " + std::to_string(deltaE.mean));
+        return false;
+    }
+
+    return true;
+}
+
+bool OptimizerPipeline::canFuse(const ObjectRecords& records, size_t a, size_t b) const {
+    if (a == b || a >= records.size() || b >= records.size()) {
+        return false;
+    }
+
+    // Same appearance: colour channels always, z-layer unless the rules allow mixing
+    if (records.colorId[a] != records.colorId[b] || records.detailColorId[a] != records.detailColorId[b]) {
+        return false;
+    }
+    if (!m_config.rules.allowZGroupMerging &&
+        (records.zLayer[a] != records.zLayer[b] || records.zOrder[a] != records.zOrder[b])) {
+        return false;
+    }
+
+    return records.bounds(a).touches(records.bounds(b), m_config.geometryTolerance);
+}
@@ -0,0 +1,250 @@
+#include <util/PngWriter.hpp>
+#include <util/WorkerPool.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+using namespace paibot;
+
+namespace {
+    constexpr size_t kBytesPerPixel = 4;
+    constexpr size_t kTargetBlockBytes = 1 << 20;
+    constexpr std::array<uint8_t, 8> kSignature = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    void putU32(std::vector<uint8_t>& out, uint32_t value) {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    bool writeChunk(std::ofstream& file, const char type[4], const uint8_t* data, size_t size) {
+        std::vector<uint8_t> header;
+        putU32(header, static_cast<uint32_t>(size));
+        header.insert(header.end(), type, type + 4);
+        uint32_t crc = Deflate::crc32(header.data() + 4, 4);
+        crc = Deflate::crc32(data, size, crc);
+        std::vector<uint8_t> trailer;
+        putU32(trailer, crc);
+
+        file.write(reinterpret_cast<const char*>(header.data()), header.size());
+        if (size > 0) {
+            file.write(reinterpret_cast<const char*>(data), size);
+        }
+        file.write(reinterpret_cast<const char*>(trailer.data()), trailer.size());
+        return static_cast<bool>(file);
+    }
+
+    inline uint8_t paeth(int a, int b, int c) {
+        int p = a + b - c;
+        int pa = std::abs(p - a);
+        int pb = std::abs(p - b);
+        int pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+        if (pb <= pc) return static_cast<uint8_t>(b);
+        return static_cast<uint8_t>(c);
+    }
+
+    inline uint64_t residualCost(const uint8_t* data, size_t size) {
+        uint64_t cost = 0;
+        for (size_t i = 0; i < size; ++i) {
+            cost += static_cast<uint64_t>(std::abs(static_cast<int>(static_cast<int8_t>(data[i]))));
+        }
+        return cost;
+    }
+
+    struct EncodedBlock {
+        std::vector<uint8_t> compressed;
+        uint32_t adler = 1;
+        size_t rawSize = 0;
+    };
+
+    void encodeBlock(int width, int y0, int y1, const PngWriter::RowSource& source,
+                     const PngWriteOptions& options, bool last, EncodedBlock& result) {
+        const size_t stride = static_cast<size_t>(width) * kBytesPerPixel;
+        std::vector<uint8_t> prev(stride, 0);
+        std::vector<uint8_t> curr(stride, 0);
+        bool hasPrev = false;
+        if (y0 > 0) {
+            source(y0 - 1, prev.data());
+            hasPrev = true;
+        }
+
+        std::vector<uint8_t> filtered((stride + 1) * static_cast<size_t>(y1 - y0));
+        std::vector<uint8_t> scratch(options.filter == PngFilter::Adaptive ? stride : 0);
+
+        for (int y = y0; y < y1; ++y) {
+            source(y, curr.data());
+            uint8_t* out = filtered.data() + (stride + 1) * static_cast<size_t>(y - y0);
+            const uint8_t* prevRow = hasPrev ? prev.data() : nullptr;
+
+            PngFilter chosen = options.filter;
+            if (chosen == PngFilter::Adaptive) {
+                uint64_t bestCost = UINT64_MAX;
+                for (int f = 0; f <= static_cast<int>(PngFilter::Paeth); ++f) {
+                    auto candidate = static_cast<PngFilter>(f);
+                    PngWriter::filterRow(candidate, curr.data(), prevRow, stride, scratch.data());
+                    uint64_t cost = residualCost(scratch.data(), stride);
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        chosen = candidate;
+                        std::memcpy(out + 1, scratch.data(), stride);
+                    }
+                }
+            } else {
+                PngWriter::filterRow(chosen, curr.data(), prevRow, stride, out + 1);
+            }
+            out[0] = static_cast<uint8_t>(chosen);
+
+            std::swap(prev, curr);
+            hasPrev = true;
+        }
+
+        result.rawSize = filtered.size();
+        result.adler = Deflate::adler32(filtered.data(), filtered.size());
+        result.compressed.clear();
+        result.compressed.reserve(filtered.size() / 3 + 64);
+        Deflate::compressSegment(filtered.data(), filtered.size(), options.level, last, result.compressed);
+    }
+}
+
+void PngWriter::filterRow(PngFilter filter, const uint8_t* row, const uint8_t* prev,
+                          size_t stride, uint8_t* out) {
+    const size_t bpp = kBytesPerPixel;
+    switch (filter) {
+        case PngFilter::Sub:
+            for (size_t i = 0; i < stride; ++i) {
+                uint8_t left = i >= bpp ? row[i - bpp] : 0;
+                out[i] = static_cast<uint8_t>(row[i] - left);
+            }
+            break;
+        case PngFilter::Up:
+            for (size_t i = 0; i < stride; ++i) {
+                out[i] = static_cast<uint8_t>(row[i] - (prev ? prev[i] : 0));
+            }
+            break;
+        case PngFilter::Average:
+            for (size_t i = 0; i < stride; ++i) {
+                int left = i >= bpp ? row[i - bpp] : 0;
+                int up = prev ? prev[i] : 0;
+                out[i] = static_cast<uint8_t>(row[i] - ((left + up) >> 1));
+            }
+            break;
+        case PngFilter::Paeth:
+            for (size_t i = 0; i < stride; ++i) {
+                int left = i >= bpp ? row[i - bpp] : 0;
+                int up = prev ? prev[i] : 0;
+                int upLeft = (prev && i >= bpp) ? prev[i - bpp] : 0;
+                out[i] = static_cast<uint8_t>(row[i] - paeth(left, up, upLeft));
+            }
+            break;
+        case PngFilter::None:
+        case PngFilter::Adaptive:
+        default:
+            std::memcpy(out, row, stride);
+            break;
+    }
+}
+
+bool PngWriter::write(const std::string& path, int width, int height, const RowSource& source,
+                      const PngWriteOptions& options, PngWriteStats* stats) {
+    if (width <= 0 || height <= 0 || !source) {
+        return false;
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+
+    const size_t stride = static_cast<size_t>(width) * kBytesPerPixel;
+    const int rowsPerBlock = options.rowsPerBlock > 0
+        ? options.rowsPerBlock
+        : static_cast<int>(std::max<size_t>(1, kTargetBlockBytes / (stride + 1)));
+    const int blockCount = (height + rowsPerBlock - 1) / rowsPerBlock;
+
+    auto* pool = WorkerPool::get();
+    const int inFlight = options.multithreaded ? static_cast<int>(pool->getThreadCount()) : 1;
+
+    file.write(reinterpret_cast<const char*>(kSignature.data()), kSignature.size());
+
+    std::vector<uint8_t> ihdr;
+    putU32(ihdr, static_cast<uint32_t>(width));
+    putU32(ihdr, static_cast<uint32_t>(height));
+    ihdr.push_back(8);  // bit depth
+    ihdr.push_back(6);  // colour type: RGBA
+    ihdr.push_back(0);  // compression
+    ihdr.push_back(0);  // filter method
+    ihdr.push_back(0);  // no interlace
+    if (!writeChunk(file, "IHDR", ihdr.data(), ihdr.size())) {
+        return false;
+    }
+
+    PngWriteStats localStats;
+    uint32_t adler = 1;
+    std::vector<EncodedBlock> wave(static_cast<size_t>(inFlight));
+    std::vector<uint8_t> zlibHeader;
+    Deflate::writeZlibHeader(zlibHeader, options.level);
+    if (!writeChunk(file, "IDAT", zlibHeader.data(), zlibHeader.size())) {
+        return false;
+    }
+
+    // Only `inFlight` row blocks exist at any time; each wave is written in order
+    for (int waveStart = 0; waveStart < blockCount; waveStart += inFlight) {
+        const int waveSize = std::min(inFlight, blockCount - waveStart);
+        auto encode = [&](size_t slot) {
+            int block = waveStart + static_cast<int>(slot);
+            int y0 = block * rowsPerBlock;
+            int y1 = std::min(height, y0 + rowsPerBlock);
+            encodeBlock(width, y0, y1, source, options, block == blockCount - 1, wave[slot]);
+        };
+        if (options.multithreaded) {
+            pool->parallelFor(static_cast<size_t>(waveSize), encode);
+        } else {
+            for (int slot = 0; slot < waveSize; ++slot) {
+                encode(static_cast<size_t>(slot));
+            }
+        }
+
+        for (int slot = 0; slot < waveSize; ++slot) {
+            const auto& encoded = wave[slot];
+            adler = (waveStart + slot == 0)
+                ? encoded.adler
+                : Deflate::adler32Combine(adler, encoded.adler, encoded.rawSize);
+            if (!writeChunk(file, "IDAT", encoded.compressed.data(), encoded.compressed.size())) {
+                return false;
+            }
+            localStats.rawBytes += encoded.rawSize;
+            localStats.compressedBytes += encoded.compressed.size();
+            ++localStats.blocks;
+        }
+    }
+
+    std::vector<uint8_t> zlibTrailer;
+    Deflate::writeZlibTrailer(zlibTrailer, adler);
+    if (!writeChunk(file, "IDAT", zlibTrailer.data(), zlibTrailer.size())) {
+        return false;
+    }
+    if (!writeChunk(file, "IEND", nullptr, 0)) {
+        return false;
+    }
+
+    if (stats) {
+        *stats = localStats;
+    }
+    return static_cast<bool>(file);
+}
+
+bool PngWriter::writeRGBA(const std::string& path, int width, int height, const uint8_t* rgba,
+                          const PngWriteOptions& options, PngWriteStats* stats) {
+    if (!rgba) {
+        return false;
+    }
+    const size_t stride = static_cast<size_t>(width) * kBytesPerPixel;
+    return write(path, width, height, [&](int y, uint8_t* row) {
+        std::memcpy(row, rgba + stride * static_cast<size_t>(y), stride);
+    }, options, stats);
+}
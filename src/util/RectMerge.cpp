@@ -0,0 +1,93 @@
+#include <util/RectMerge.hpp>
+#include <algorithm>
+
+using namespace paibot;
+
+void OccupancyGrid::reset(int width, int height) {
+    m_width = std::max(0, width);
+    m_height = std::max(0, height);
+    m_cells.assign(static_cast<size_t>(m_width) * m_height, 0);
+}
+
+void OccupancyGrid::fill(const GridRect& rect, bool value) {
+    for (int y = rect.y; y < rect.y + rect.height; ++y) {
+        auto row = m_cells.begin() + static_cast<ptrdiff_t>(y) * m_width;
+        std::fill(row + rect.x, row + rect.x + rect.width, value ? 1 : 0);
+    }
+}
+
+bool OccupancyGrid::isFull(const GridRect& rect) const {
+    for (int y = rect.y; y < rect.y + rect.height; ++y) {
+        const uint8_t* row = m_cells.data() + static_cast<size_t>(y) * m_width;
+        for (int x = rect.x; x < rect.x + rect.width; ++x) {
+            if (!row[x]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+size_t OccupancyGrid::count() const {
+    return static_cast<size_t>(std::count(m_cells.begin(), m_cells.end(), uint8_t{1}));
+}
+
+std::vector<GridRect> RectMerge::extractGreedy(OccupancyGrid& grid, int maxWidth, int maxHeight) {
+    std::vector<GridRect> result;
+    const int width = grid.getWidth();
+    const int height = grid.getHeight();
+    maxWidth = std::max(1, maxWidth);
+    maxHeight = std::max(1, maxHeight);
+
+    size_t remaining = grid.count();
+    std::vector<int> runs(static_cast<size_t>(width));
+    std::vector<std::pair<int, int>> stack;  // (start column, run height)
+    std::vector<GridRect> candidates;
+
+    while (remaining > 0) {
+        candidates.clear();
+        std::fill(runs.begin(), runs.end(), 0);
+
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                runs[x] = grid.test(x, y) ? runs[x] + 1 : 0;
+            }
+
+            // Runs are capped at maxHeight: a shorter stack of a full column is still full
+            stack.clear();
+            for (int x = 0; x <= width; ++x) {
+                const int run = x < width ? std::min(runs[x], maxHeight) : 0;
+                int start = x;
+                while (!stack.empty() && stack.back().second > run) {
+                    const auto [left, top] = stack.back();
+                    stack.pop_back();
+                    candidates.push_back({left, y - top + 1, std::min(x - left, maxWidth), top});
+                    start = left;
+                }
+                if (run > 0 && (stack.empty() || stack.back().second < run)) {
+                    stack.emplace_back(start, run);
+                }
+            }
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [](const GridRect& a, const GridRect& b) {
+            if (a.area() != b.area()) {
+                return a.area() > b.area();
+            }
+            if (a.y != b.y) {
+                return a.y < b.y;
+            }
+            return a.x < b.x;
+        });
+
+        // The first candidate always fits, so every round makes progress
+        for (const auto& rect : candidates) {
+            if (grid.isFull(rect)) {
+                grid.fill(rect, false);
+                result.push_back(rect);
+                remaining -= static_cast<size_t>(rect.area());
+            }
+        }
+    }
+    return result;
+}
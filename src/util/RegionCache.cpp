@@ -0,0 +1,193 @@
+#include <util/RegionCache.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace paibot;
+
+namespace {
+    // Region cells are coarser than the snap grid; regions are whole clusters
+    constexpr float kRegionCellSize = OptimizerPipeline::kBlockSize * 8.0f;
+
+    uint64_t mix(uint64_t value) {
+        // splitmix64 finalizer
+        value += 0x9E3779B97F4A7C15ull;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+        return value ^ (value >> 31);
+    }
+
+    // Applied objects come back from the editor at save-string precision
+    uint64_t quantize(float value) {
+        return static_cast<uint64_t>(std::llround(static_cast<double>(value) * 1000.0));
+    }
+
+    Aabb unite(const Aabb& a, const Aabb& b) {
+        return {std::min(a.minX, b.minX), std::min(a.minY, b.minY), std::max(a.maxX, b.maxX), std::max(a.maxY, b.maxY)};
+    }
+}
+
+uint64_t RegionCache::signature(const ObjectRecords& records, const std::vector<uint32_t>& members) {
+    // Sum of per-record hashes, so member order does not matter. Source and
+    // template indices are left out: they change every time the area is read.
+    uint64_t sum = 0;
+    for (uint32_t i : members) {
+        uint64_t h = mix(quantize(records.x[i]));
+        h = mix(h ^ quantize(records.y[i]));
+        h = mix(h ^ quantize(records.width[i]));
+        h = mix(h ^ quantize(records.height[i]));
+        h = mix(h ^ quantize(records.rotation[i]));
+        h = mix(h ^ quantize(records.scaleX[i]));
+        h = mix(h ^ quantize(records.scaleY[i]));
+        h = mix(h ^ static_cast<uint32_t>(records.objectId[i]));
+        h = mix(h ^ (static_cast<uint64_t>(static_cast<uint32_t>(records.colorId[i])) << 32 |
+                     static_cast<uint32_t>(records.detailColorId[i])));
+        h = mix(h ^ (static_cast<uint64_t>(static_cast<uint32_t>(records.zOrder[i])) << 32 |
+                     static_cast<uint64_t>(static_cast<uint16_t>(records.zLayer[i])) << 16 |
+                     static_cast<uint16_t>(records.editorLayer[i])));
+        h = mix(h ^ records.groups[i]);
+        h = mix(h ^ (static_cast<uint64_t>(records.kind[i]) << 8 | records.flags[i]));
+        sum += h;
+    }
+    return mix(sum ^ members.size());
+}
+
+void RegionCache::clear() {
+    m_regions.clear();
+    m_index.clear();
+    m_signatures.clear();
+}
+
+void RegionCache::reset(const OptimizerPipeline& pipeline, const ObjectRecords& optimized) {
+    m_regions.clear();
+    addClusters(pipeline, optimized);
+    reindex();
+}
+
+void RegionCache::addClusters(const OptimizerPipeline& pipeline, const ObjectRecords& records) {
+    for (const auto& cluster : pipeline.groupByColorAndZGroup(records)) {
+        if (cluster.key.kind == ObjectKind::Trigger) {
+            continue;
+        }
+        OptimizedRegion region;
+        region.key = cluster.key;
+        region.bounds = records.bounds(cluster.members.front());
+        for (uint32_t i : cluster.members) {
+            region.bounds = unite(region.bounds, records.bounds(i));
+        }
+        region.signature = signature(records, cluster.members);
+        region.objects = static_cast<uint32_t>(cluster.members.size());
+        m_regions.push_back(region);
+    }
+}
+
+void RegionCache::reindex() {
+    std::vector<Aabb> boxes;
+    boxes.reserve(m_regions.size());
+    m_signatures.clear();
+    for (const auto& region : m_regions) {
+        boxes.push_back(region.bounds);
+        m_signatures.insert(region.signature);
+    }
+    m_index.build(boxes, kRegionCellSize);
+}
+
+std::vector<uint32_t> RegionCache::affected(const std::vector<Aabb>& dirty) const {
+    // Breadth first over overlapping bounds. A record touching the area lies
+    // inside its own region's bounds, so that region is reached too, and an
+    // update sees every member of every region it replaces.
+    std::vector<uint8_t> seen(m_regions.size(), 0);
+    std::vector<uint32_t> out;
+    auto visit = [&](uint32_t index) {
+        if (!seen[index]) {
+            seen[index] = 1;
+            out.push_back(index);
+        }
+    };
+    for (const auto& box : dirty) {
+        m_index.forEachInBox(box, visit);
+    }
+    for (size_t next = 0; next < out.size(); ++next) {
+        m_index.forEachInBox(m_regions[out[next]].bounds, visit);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+std::vector<Aabb> RegionCache::area(const std::vector<Aabb>& dirty) const {
+    std::vector<Aabb> out = dirty;
+    for (uint32_t index : affected(dirty)) {
+        out.push_back(m_regions[index].bounds);
+    }
+    return out;
+}
+
+IncrementalResult RegionCache::update(const OptimizerPipeline& pipeline, const ObjectRecords& records,
+                                      const std::vector<Aabb>& dirty) {
+    IncrementalResult out;
+    const auto stale = affected(dirty);
+    auto boxes = dirty;
+    for (uint32_t index : stale) {
+        boxes.push_back(m_regions[index].bounds);
+    }
+    out.affectedRegions = stale.size();
+
+    // Records touching the area are in play; the rest, and every trigger,
+    // pass through
+    SpatialHash areaIndex;
+    areaIndex.build(boxes, kRegionCellSize);
+    std::vector<uint32_t> inPlay;
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (records.kind[i] == ObjectKind::Trigger) {
+            out.result.records.append(records, i);
+            continue;
+        }
+        bool touched = false;
+        areaIndex.forEachInBox(records.bounds(i), [&](uint32_t) { touched = true; });
+        if (touched) {
+            inPlay.push_back(static_cast<uint32_t>(i));
+        } else {
+            out.result.records.append(records, i);
+        }
+    }
+    out.recordsInPlay = inPlay.size();
+
+    // A cluster that hashes like a cached region is a result already, in
+    // place or moved as a whole; anything else is optimized again
+    const auto local = records.select(inPlay);
+    ObjectRecords unchanged, changed;
+    for (const auto& cluster : pipeline.groupByColorAndZGroup(local)) {
+        if (m_signatures.count(signature(local, cluster.members))) {
+            for (uint32_t i : cluster.members) {
+                unchanged.append(local, i);
+            }
+            ++out.reusedClusters;
+        } else {
+            for (uint32_t i : cluster.members) {
+                changed.append(local, i);
+            }
+            ++out.rerunClusters;
+        }
+    }
+    ObjectRecords optimized;
+    if (!changed.empty()) {
+        optimized = pipeline.optimizeRecords(changed, out.result.triggerRewrites);
+    }
+    ObjectRecords rewritten = std::move(unchanged);
+    rewritten.append(optimized);
+    out.result.records.append(rewritten);
+
+    // The affected regions are replaced by the clusters of what was rewritten
+    size_t kept = 0;
+    for (size_t i = 0, s = 0; i < m_regions.size(); ++i) {
+        if (s < stale.size() && stale[s] == i) {
+            ++s;
+        } else {
+            m_regions[kept++] = m_regions[i];
+        }
+    }
+    m_regions.resize(kept);
+    addClusters(pipeline, rewritten);
+    reindex();
+    return out;
+}
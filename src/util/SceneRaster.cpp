@@ -0,0 +1,498 @@
+#include <util/SceneRaster.hpp>
+#include <util/LabColor.hpp>
+#include <util/SpatialHash.hpp>
+#include <util/WorkerPool.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <set>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define PAIBOT_RASTER_SSE2 1
+#endif
+
+using namespace paibot;
+
+namespace {
+    // Inclusive pixel range of a tile
+    struct PixelRect {
+        int x0 = 0, y0 = 0, x1 = -1, y1 = -1;
+
+        bool isEmpty() const { return x0 > x1 || y0 > y1; }
+        PixelRect clipped(const PixelRect& other) const {
+            return {std::max(x0, other.x0), std::max(y0, other.y0), std::min(x1, other.x1), std::min(y1, other.y1)};
+        }
+        PixelRect united(const PixelRect& other) const {
+            if (isEmpty()) {
+                return other;
+            }
+            return other.isEmpty() ? *this : PixelRect{std::min(x0, other.x0), std::min(y0, other.y0),
+                                                       std::max(x1, other.x1), std::max(y1, other.y1)};
+        }
+    };
+
+    // Pixels of the tile whose centres may lie inside `box`
+    PixelRect pixelsOf(const Aabb& box, const Aabb& tile, float pixelSize, int size) {
+        const float inv = 1.0f / pixelSize;
+        const PixelRect all{0, 0, size - 1, size - 1};
+        return all.clipped({static_cast<int>(std::floor((box.minX - tile.minX) * inv - 0.5f)),
+                            static_cast<int>(std::floor((box.minY - tile.minY) * inv - 0.5f)),
+                            static_cast<int>(std::ceil((box.maxX - tile.minX) * inv - 0.5f)),
+                            static_cast<int>(std::ceil((box.maxY - tile.minY) * inv - 0.5f))});
+    }
+
+    struct LabImage {
+        int width = 0;
+        int height = 0;
+        std::vector<float> l, a, b;
+
+        void resize(int w, int h) {
+            width = w;
+            height = h;
+            const size_t count = static_cast<size_t>(w) * h;
+            l.resize(count);
+            a.resize(count);
+            b.resize(count);
+        }
+        void fill(const PixelRect& rect, const LabColor& color) {
+            for (int y = rect.y0; y <= rect.y1; ++y) {
+                const size_t row = static_cast<size_t>(y) * width;
+                std::fill(l.begin() + row + rect.x0, l.begin() + row + rect.x1 + 1, color.l);
+                std::fill(a.begin() + row + rect.x0, a.begin() + row + rect.x1 + 1, color.a);
+                std::fill(b.begin() + row + rect.x0, b.begin() + row + rect.x1 + 1, color.b);
+            }
+        }
+    };
+
+    // Records prepared for drawing: bounds, colours and back-to-front rank
+    struct Scene {
+        const ObjectRecords* records = nullptr;
+        std::vector<Aabb> boxes;
+        std::vector<LabColor> colors;
+        std::vector<uint32_t> rank;      // draw position, UINT32_MAX = not drawn
+        std::vector<uint8_t> changed;    // set by compare
+        SpatialHash index;
+
+        void prepare(const ObjectRecords& source, const RasterSettings& settings, float cellSize) {
+            records = &source;
+            source.collectBounds(boxes);
+
+            std::unordered_map<int32_t, LabColor> cache;
+            colors.resize(source.size());
+            std::vector<uint32_t> drawable;
+            drawable.reserve(source.size());
+            for (size_t i = 0; i < source.size(); ++i) {
+                const int32_t channel = source.colorId[i];
+                auto it = cache.find(channel);
+                if (it == cache.end()) {
+                    uint32_t rgb = settings.defaultColor;
+                    if (settings.channelColors) {
+                        if (auto known = settings.channelColors->find(channel); known != settings.channelColors->end()) {
+                            rgb = known->second;
+                        }
+                    }
+                    it = cache.emplace(channel, LabColor::fromPacked(rgb)).first;
+                }
+                colors[i] = it->second;
+                // Triggers and hidden objects draw nothing in game
+                if (source.kind[i] != ObjectKind::Trigger && !source.hasFlag(i, ObjectHidden)) {
+                    drawable.push_back(static_cast<uint32_t>(i));
+                }
+            }
+            std::stable_sort(drawable.begin(), drawable.end(), [&](uint32_t x, uint32_t y) {
+                return source.zLayer[x] != source.zLayer[y] ? source.zLayer[x] < source.zLayer[y]
+                                                            : source.zOrder[x] < source.zOrder[y];
+            });
+            rank.assign(source.size(), UINT32_MAX);
+            for (size_t r = 0; r < drawable.size(); ++r) {
+                rank[drawable[r]] = static_cast<uint32_t>(r);
+            }
+            changed.assign(source.size(), 0);
+            index.build(boxes, cellSize);
+        }
+
+        // Drawn records touching `area` that `keep` accepts, back to front
+        template <class Keep>
+        void drawList(const Aabb& area, Keep&& keep, std::vector<uint32_t>& out) const {
+            out.clear();
+            index.forEachInBox(area, [&](uint32_t i) {
+                if (rank[i] != UINT32_MAX && keep(boxes[i])) {
+                    out.push_back(i);
+                }
+            });
+            std::sort(out.begin(), out.end(), [&](uint32_t x, uint32_t y) { return rank[x] < rank[y]; });
+        }
+    };
+
+    // Calls fn(pixel) for every pixel in `clip` whose centre lies inside the
+    // oriented rect of record `i`
+    template <class Fn>
+    void forEachCoveredPixel(const Scene& scene, size_t i, const Aabb& tile, float pixelSize, int width,
+                             const PixelRect& clip, Fn&& fn) {
+        const PixelRect rect = pixelsOf(scene.boxes[i], tile, pixelSize, width).clipped(clip);
+        if (rect.isEmpty()) {
+            return;
+        }
+
+        // Rotation is clockwise; undo it to test against the unrotated rect
+        const ObjectRecords& records = *scene.records;
+        const float radians = records.rotation[i] * 0.017453292f;
+        const float c = std::cos(radians);
+        const float s = std::sin(radians);
+        const float halfW = records.width[i] * 0.5f;
+        const float halfH = records.height[i] * 0.5f;
+        const float cx = records.x[i];
+        const float cy = records.y[i];
+        if (records.rotation[i] == 0.0f) {
+            // Unrotated: the same test, split into one column span and a
+            // per-row check, without the per-pixel rotation
+            int first = rect.x1 + 1, last = rect.x0 - 1;
+            for (int px = rect.x0; px <= rect.x1; ++px) {
+                if (std::abs(tile.minX + (px + 0.5f) * pixelSize - cx) <= halfW) {
+                    first = std::min(first, px);
+                    last = px;
+                }
+            }
+            for (int py = rect.y0; py <= rect.y1 && first <= last; ++py) {
+                if (std::abs(tile.minY + (py + 0.5f) * pixelSize - cy) <= halfH) {
+                    const size_t row = static_cast<size_t>(py) * width;
+                    for (int px = first; px <= last; ++px) {
+                        fn(row + px);
+                    }
+                }
+            }
+            return;
+        }
+        for (int py = rect.y0; py <= rect.y1; ++py) {
+            const float dy = tile.minY + (py + 0.5f) * pixelSize - cy;
+            size_t row = static_cast<size_t>(py) * width;
+            for (int px = rect.x0; px <= rect.x1; ++px) {
+                const float dx = tile.minX + (px + 0.5f) * pixelSize - cx;
+                const float lx = dx * c - dy * s;
+                const float ly = dx * s + dy * c;
+                if (std::abs(lx) <= halfW && std::abs(ly) <= halfH) {
+                    fn(row + px);
+                }
+            }
+        }
+    }
+
+    void render(const Scene& scene, const std::vector<uint32_t>& drawList, const Aabb& tile, const PixelRect& clip,
+                float pixelSize, const LabColor& background, LabImage& image) {
+        image.fill(clip, background);
+        for (uint32_t i : drawList) {
+            const LabColor& color = scene.colors[i];
+            forEachCoveredPixel(scene, i, tile, pixelSize, image.width, clip, [&](size_t p) {
+                image.l[p] = color.l;
+                image.a[p] = color.a;
+                image.b[p] = color.b;
+            });
+        }
+    }
+
+    // Both lists draw the same rects in the same colours and order
+    bool sameDrawing(const Scene& x, const std::vector<uint32_t>& xList, const Scene& y, const std::vector<uint32_t>& yList) {
+        if (xList.size() != yList.size()) {
+            return false;
+        }
+        const ObjectRecords& xr = *x.records;
+        const ObjectRecords& yr = *y.records;
+        for (size_t k = 0; k < xList.size(); ++k) {
+            const uint32_t i = xList[k];
+            const uint32_t j = yList[k];
+            const LabColor& ci = x.colors[i];
+            const LabColor& cj = y.colors[j];
+            if (xr.x[i] != yr.x[j] || xr.y[i] != yr.y[j] || xr.width[i] != yr.width[j] ||
+                xr.height[i] != yr.height[j] || xr.rotation[i] != yr.rotation[j] || ci.l != cj.l || ci.a != cj.a ||
+                ci.b != cj.b) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    struct TileResult {
+        double sum = 0.0;
+        size_t count = 0;
+        float max = 0.0f;
+        std::vector<float> differences;   // non-zero differences only
+    };
+
+    // Coarse cells of a tile, kCellPixels square, for skipping objects far
+    // from every change
+    constexpr int kCellPixels = 8;
+
+    // Buffers one worker reuses for every tile it renders
+    struct TileWork {
+        LabImage before, after;
+        std::vector<uint8_t> mask;
+        std::vector<uint32_t> cellSums;   // summed area table of changed cells
+        std::vector<uint32_t> changedBefore, changedAfter;
+        std::vector<uint32_t> drawBefore, drawAfter;
+    };
+
+    void compareImages(const LabImage& x, const LabImage& y, const std::vector<uint8_t>& mask, const PixelRect& clip,
+                       TileResult& result) {
+        // Flat colours repeat the same pair over many pixels; remember the last one
+        LabColor lastX{-1.0f, 0.0f, 0.0f}, lastY{-1.0f, 0.0f, 0.0f};
+        float lastDelta = 0.0f;
+        auto exact = [&](size_t p) {
+            const LabColor cx{x.l[p], x.a[p], x.b[p]};
+            const LabColor cy{y.l[p], y.a[p], y.b[p]};
+            if (cx.l != lastX.l || cx.a != lastX.a || cx.b != lastX.b || cy.l != lastY.l || cy.a != lastY.a ||
+                cy.b != lastY.b) {
+                lastX = cx;
+                lastY = cy;
+                lastDelta = LabColor::deltaE2000(cx, cy);
+            }
+            const float delta = lastDelta;
+            if (delta > 0.0f) {
+                result.sum += delta;
+                result.max = std::max(result.max, delta);
+                result.differences.push_back(delta);
+            }
+        };
+
+        for (int row = clip.y0; row <= clip.y1; ++row) {
+            size_t p = static_cast<size_t>(row) * x.width + clip.x0;
+            const size_t end = static_cast<size_t>(row) * x.width + clip.x1 + 1;
+#ifdef PAIBOT_RASTER_SSE2
+            // Squared Lab distance four pixels at a time; CIEDE2000 only runs
+            // where the colours differ at all, which is a small part of a tile
+            for (; p + 4 <= end; p += 4) {
+                const __m128 dl = _mm_sub_ps(_mm_loadu_ps(&x.l[p]), _mm_loadu_ps(&y.l[p]));
+                const __m128 da = _mm_sub_ps(_mm_loadu_ps(&x.a[p]), _mm_loadu_ps(&y.a[p]));
+                const __m128 db = _mm_sub_ps(_mm_loadu_ps(&x.b[p]), _mm_loadu_ps(&y.b[p]));
+                const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dl, dl), _mm_mul_ps(da, da)), _mm_mul_ps(db, db));
+                const int differs = _mm_movemask_ps(_mm_cmpgt_ps(d2, _mm_setzero_ps()));
+                for (int k = 0; k < 4; ++k) {
+                    if (mask[p + k]) {
+                        ++result.count;
+                        if (differs & (1 << k)) {
+                            exact(p + k);
+                        }
+                    }
+                }
+            }
+#endif
+            for (; p < end; ++p) {
+                if (mask[p]) {
+                    ++result.count;
+                    if (x.l[p] != y.l[p] || x.a[p] != y.a[p] || x.b[p] != y.b[p]) {
+                        exact(p);
+                    }
+                }
+            }
+        }
+    }
+}
+
+DeltaEStats SceneRaster::compare(const ObjectRecords& before, const ObjectRecords& after, const RasterSettings& settings) {
+    DeltaEStats stats;
+    if (settings.pixelSize <= 0.0f || settings.tilePixels <= 0) {
+        return stats;
+    }
+
+    // Changed records: after-records without a source, before-records whose source was dropped
+    int32_t maxSource = -1;
+    for (int32_t source : after.sourceIndex) {
+        maxSource = std::max(maxSource, source);
+    }
+    std::vector<uint8_t> kept(static_cast<size_t>(maxSource + 1), 0);
+    for (int32_t source : after.sourceIndex) {
+        if (source >= 0) {
+            kept[source] = 1;
+        }
+    }
+    std::vector<uint32_t> removed;
+    for (size_t i = 0; i < before.size(); ++i) {
+        const int32_t source = before.sourceIndex[i];
+        if (source < 0 || source > maxSource || !kept[source]) {
+            removed.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    std::vector<uint32_t> added;
+    for (size_t i = 0; i < after.size(); ++i) {
+        if (after.isGenerated(i)) {
+            added.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    if (removed.empty() && added.empty()) {
+        return stats;
+    }
+
+    // Tiles touched by any change, in a fixed order
+    const float tileSize = settings.pixelSize * settings.tilePixels;
+    std::set<std::pair<int64_t, int64_t>> tileSet;
+    auto addTiles = [&](const Aabb& box) {
+        const auto tx0 = static_cast<int64_t>(std::floor(box.minX / tileSize));
+        const auto ty0 = static_cast<int64_t>(std::floor(box.minY / tileSize));
+        const auto tx1 = static_cast<int64_t>(std::floor(box.maxX / tileSize));
+        const auto ty1 = static_cast<int64_t>(std::floor(box.maxY / tileSize));
+        for (auto ty = ty0; ty <= ty1; ++ty) {
+            for (auto tx = tx0; tx <= tx1; ++tx) {
+                tileSet.emplace(tx, ty);
+            }
+        }
+    };
+    for (uint32_t i : removed) {
+        addTiles(before.bounds(i));
+    }
+    for (uint32_t i : added) {
+        addTiles(after.bounds(i));
+    }
+    const std::vector<std::pair<int64_t, int64_t>> tiles(tileSet.begin(), tileSet.end());
+
+    const float cellSize = tileSize / 8.0f;
+    Scene beforeScene, afterScene;
+    beforeScene.prepare(before, settings, cellSize);
+    afterScene.prepare(after, settings, cellSize);
+    for (uint32_t i : removed) {
+        beforeScene.changed[i] = 1;
+    }
+    for (uint32_t i : added) {
+        afterScene.changed[i] = 1;
+    }
+    const LabColor background = LabColor::fromPacked(settings.background);
+    const int size = settings.tilePixels;
+    const int cells = (size + kCellPixels - 1) / kCellPixels;
+    std::vector<TileResult> results(tiles.size());
+
+    // Only the changed area of a tile is rendered, and only the objects that
+    // overlap it are drawn
+    auto compareTile = [&](size_t t, TileWork& work) {
+        const Aabb tile{tiles[t].first * tileSize, tiles[t].second * tileSize,
+                        (tiles[t].first + 1) * tileSize, (tiles[t].second + 1) * tileSize};
+        auto collectChanged = [&](const Scene& scene, std::vector<uint32_t>& out) {
+            out.clear();
+            scene.index.forEachInBox(tile, [&](uint32_t i) {
+                if (scene.changed[i]) {
+                    out.push_back(i);
+                }
+            });
+        };
+        collectChanged(beforeScene, work.changedBefore);
+        collectChanged(afterScene, work.changedAfter);
+
+        PixelRect area;
+        auto addArea = [&](const Scene& scene, uint32_t i) {
+            area = area.united(pixelsOf(scene.boxes[i], tile, settings.pixelSize, size));
+        };
+        for (uint32_t i : work.changedBefore) {
+            addArea(beforeScene, i);
+        }
+        for (uint32_t i : work.changedAfter) {
+            addArea(afterScene, i);
+        }
+        if (area.isEmpty()) {
+            return;
+        }
+
+        // Compare only where a changed object was or now is
+        for (int y = area.y0; y <= area.y1; ++y) {
+            const size_t row = static_cast<size_t>(y) * size;
+            std::fill(work.mask.begin() + row + area.x0, work.mask.begin() + row + area.x1 + 1, uint8_t{0});
+        }
+        auto markChanges = [&](const Scene& scene, const std::vector<uint32_t>& changed) {
+            for (uint32_t i : changed) {
+                forEachCoveredPixel(scene, i, tile, settings.pixelSize, size, area, [&](size_t p) { work.mask[p] = 1; });
+            }
+        };
+        markChanges(beforeScene, work.changedBefore);
+        markChanges(afterScene, work.changedAfter);
+
+        // Cells under a changed object's pixel rect, as a summed area table
+        // so an object's rect is tested in constant time
+        const int stride = cells + 1;
+        std::fill(work.cellSums.begin(), work.cellSums.end(), 0u);
+        auto markCells = [&](const Scene& scene, const std::vector<uint32_t>& changed) {
+            for (uint32_t i : changed) {
+                const PixelRect rect = pixelsOf(scene.boxes[i], tile, settings.pixelSize, size);
+                for (int cy = rect.y0 / kCellPixels; cy <= rect.y1 / kCellPixels && !rect.isEmpty(); ++cy) {
+                    for (int cx = rect.x0 / kCellPixels; cx <= rect.x1 / kCellPixels; ++cx) {
+                        work.cellSums[static_cast<size_t>(cy + 1) * stride + cx + 1] = 1;
+                    }
+                }
+            }
+        };
+        markCells(beforeScene, work.changedBefore);
+        markCells(afterScene, work.changedAfter);
+        for (int cy = 1; cy <= cells; ++cy) {
+            for (int cx = 1; cx <= cells; ++cx) {
+                const size_t c = static_cast<size_t>(cy) * stride + cx;
+                work.cellSums[c] += work.cellSums[c - 1] + work.cellSums[c - stride] - work.cellSums[c - stride - 1];
+            }
+        }
+        auto nearChange = [&](const Aabb& box) {
+            const PixelRect rect = pixelsOf(box, tile, settings.pixelSize, size);
+            if (rect.isEmpty()) {
+                return false;
+            }
+            const size_t x0 = rect.x0 / kCellPixels, y0 = rect.y0 / kCellPixels;
+            const size_t x1 = rect.x1 / kCellPixels + 1, y1 = rect.y1 / kCellPixels + 1;
+            return work.cellSums[y1 * stride + x1] + work.cellSums[y0 * stride + x0] !=
+                   work.cellSums[y0 * stride + x1] + work.cellSums[y1 * stride + x0];
+        };
+
+        // Everything drawn over the changed area's pixel centres, near a change
+        const Aabb areaBox{tile.minX + (area.x0 + 0.5f) * settings.pixelSize,
+                           tile.minY + (area.y0 + 0.5f) * settings.pixelSize,
+                           tile.minX + (area.x1 + 0.5f) * settings.pixelSize,
+                           tile.minY + (area.y1 + 0.5f) * settings.pixelSize};
+        beforeScene.drawList(areaBox, nearChange, work.drawBefore);
+        afterScene.drawList(areaBox, nearChange, work.drawAfter);
+        if (sameDrawing(beforeScene, work.drawBefore, afterScene, work.drawAfter)) {
+            // Equal renders: every masked pixel is an exact match
+            for (int y = area.y0; y <= area.y1; ++y) {
+                const size_t row = static_cast<size_t>(y) * size;
+                results[t].count += static_cast<size_t>(
+                    std::count(work.mask.begin() + row + area.x0, work.mask.begin() + row + area.x1 + 1, uint8_t{1}));
+            }
+            return;
+        }
+        render(beforeScene, work.drawBefore, tile, area, settings.pixelSize, background, work.before);
+        render(afterScene, work.drawAfter, tile, area, settings.pixelSize, background, work.after);
+        compareImages(work.before, work.after, work.mask, area, results[t]);
+    };
+
+    // One task per worker, each with its own buffers, pulling tiles in order
+    const size_t workers = std::min<size_t>(WorkerPool::get()->getThreadCount(), tiles.size());
+    std::atomic<size_t> nextTile{0};
+    WorkerPool::get()->parallelFor(workers, [&](size_t) {
+        TileWork work;
+        work.before.resize(size, size);
+        work.after.resize(size, size);
+        work.mask.resize(static_cast<size_t>(size) * size);
+        work.cellSums.resize(static_cast<size_t>(cells + 1) * (cells + 1));
+        for (size_t t = nextTile++; t < tiles.size(); t = nextTile++) {
+            compareTile(t, work);
+        }
+    });
+
+    double sum = 0.0;
+    std::vector<float> differences;
+    for (const auto& result : results) {
+        sum += result.sum;
+        stats.pixels += result.count;
+        stats.max = std::max(stats.max, result.max);
+        differences.insert(differences.end(), result.differences.begin(), result.differences.end());
+    }
+    stats.tiles = tiles.size();
+    if (stats.pixels == 0) {
+        return stats;
+    }
+    stats.mean = static_cast<float>(sum / stats.pixels);
+
+    // 99th percentile over all compared pixels; most of them are exact zeros
+    const size_t rank = static_cast<size_t>(std::ceil(0.99 * stats.pixels)) - 1;
+    const size_t zeros = stats.pixels - differences.size();
+    if (rank >= zeros) {
+        auto nth = differences.begin() + static_cast<std::ptrdiff_t>(rank - zeros);
+        std::nth_element(differences.begin(), nth, differences.end());
+        stats.p99 = *nth;
+    }
+    return stats;
+}
@@ -0,0 +1,100 @@
+#include <util/SpatialHash.hpp>
+
+using namespace paibot;
+
+void SpatialHash::clear() {
+    m_boxes.clear();
+    m_cells.clear();
+    m_offsets.clear();
+    m_entries.clear();
+    m_oversized.clear();
+    m_bucketMask = 0;
+}
+
+void SpatialHash::build(const std::vector<Aabb>& boxes, float cellSize) {
+    clear();
+    m_cellSize = std::max(cellSize, 1e-3f);
+    m_invCellSize = 1.0f / m_cellSize;
+    m_boxes = boxes;
+    m_cells.resize(boxes.size());
+
+    size_t entryCount = 0;
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        auto& cells = m_cells[i];
+        cells = {cellOf(boxes[i].minX), cellOf(boxes[i].minY), cellOf(boxes[i].maxX), cellOf(boxes[i].maxY)};
+        const int64_t span = (static_cast<int64_t>(cells.x1) - cells.x0 + 1) * (static_cast<int64_t>(cells.y1) - cells.y0 + 1);
+        if (span > kMaxCellsPerObject) {
+            m_oversized.push_back(static_cast<uint32_t>(i));
+            cells = {1, 1, 0, 0};  // empty range, never matched by the grid
+        } else {
+            entryCount += static_cast<size_t>(span);
+        }
+    }
+    if (entryCount == 0) {
+        return;
+    }
+
+    // Power-of-two table with room for about two entries per bucket
+    uint32_t buckets = 16;
+    while (buckets < entryCount / 2 && buckets < (1u << 30)) {
+        buckets <<= 1;
+    }
+    m_bucketMask = buckets - 1;
+
+    // Counting sort: histogram, exclusive prefix sum, scatter. Two cells of
+    // one object can hash to the same bucket; the object is entered there
+    // once, or a query would report it twice. Objects are visited in index
+    // order, so the bucket's last entry is the only one to check.
+    constexpr uint32_t kNone = ~0u;
+    std::vector<uint32_t> last(buckets, kNone);
+    m_offsets.assign(static_cast<size_t>(buckets) + 1, 0);
+    for (size_t i = 0; i < m_cells.size(); ++i) {
+        const auto& cells = m_cells[i];
+        for (int cy = cells.y0; cy <= cells.y1; ++cy) {
+            for (int cx = cells.x0; cx <= cells.x1; ++cx) {
+                const uint32_t bucket = bucketOf(cx, cy);
+                if (last[bucket] != i) {
+                    last[bucket] = static_cast<uint32_t>(i);
+                    ++m_offsets[bucket + 1];
+                }
+            }
+        }
+    }
+    for (uint32_t b = 0; b < buckets; ++b) {
+        m_offsets[b + 1] += m_offsets[b];
+    }
+    m_entries.resize(m_offsets.back());
+    std::vector<uint32_t> cursor(m_offsets.begin(), m_offsets.end() - 1);
+    std::fill(last.begin(), last.end(), kNone);
+    for (size_t i = 0; i < m_cells.size(); ++i) {
+        const auto& cells = m_cells[i];
+        for (int cy = cells.y0; cy <= cells.y1; ++cy) {
+            for (int cx = cells.x0; cx <= cells.x1; ++cx) {
+                const uint32_t bucket = bucketOf(cx, cy);
+                if (last[bucket] != i) {
+                    last[bucket] = static_cast<uint32_t>(i);
+                    m_entries[cursor[bucket]++] = static_cast<uint32_t>(i);
+                }
+            }
+        }
+    }
+}
+
+void SpatialHash::queryBox(const Aabb& box, std::vector<uint32_t>& out) const {
+    out.clear();
+    forEachInBox(box, [&](uint32_t index) {
+        out.push_back(index);
+    });
+}
+
+void SpatialHash::queryNeighbours(uint32_t index, float margin, std::vector<uint32_t>& out) const {
+    out.clear();
+    if (index >= m_boxes.size()) {
+        return;
+    }
+    forEachInBox(m_boxes[index].expanded(margin), [&](uint32_t other) {
+        if (other != index) {
+            out.push_back(other);
+        }
+    });
+}
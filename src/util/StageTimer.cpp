@@ -0,0 +1,130 @@
+#include <util/StageTimer.hpp>
+#include <util/WorkerPool.hpp>
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+
+using namespace paibot;
+
+namespace {
+    std::atomic<bool> s_enabled{false};
+    std::atomic<uint64_t> s_allocations{0};
+    std::atomic<int64_t> s_bytes{0};
+    std::atomic<int64_t> s_peak{0};
+
+    // Trivial types only: these are touched from operator new
+    thread_local uint64_t t_allocations = 0;
+    thread_local int64_t t_bytes = 0;
+    thread_local int64_t t_peak = 0;
+}
+
+void MemoryCounters::setEnabled(bool enabled) {
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool MemoryCounters::enabled() {
+    return s_enabled.load(std::memory_order_relaxed);
+}
+
+void MemoryCounters::recordAllocation(size_t bytes) {
+    if (!enabled()) {
+        return;
+    }
+    const auto size = static_cast<int64_t>(bytes);
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    const int64_t now = s_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    int64_t peak = s_peak.load(std::memory_order_relaxed);
+    while (now > peak && !s_peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+    ++t_allocations;
+    t_bytes += size;
+    t_peak = std::max(t_peak, t_bytes);
+}
+
+void MemoryCounters::recordFree(size_t bytes) {
+    if (!enabled()) {
+        return;
+    }
+    // Blocks freed on another thread than they came from drive that
+    // thread's count down; peaks are measured against a stage's start, so
+    // that only makes them conservative
+    s_bytes.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+    t_bytes -= static_cast<int64_t>(bytes);
+}
+
+uint64_t MemoryCounters::allocations(bool thread) {
+    return thread ? t_allocations : s_allocations.load(std::memory_order_relaxed);
+}
+
+int64_t MemoryCounters::bytesInUse(bool thread) {
+    return thread ? t_bytes : s_bytes.load(std::memory_order_relaxed);
+}
+
+int64_t MemoryCounters::peakBytes(bool thread) {
+    return thread ? t_peak : s_peak.load(std::memory_order_relaxed);
+}
+
+void MemoryCounters::resetPeak(bool thread) {
+    if (thread) {
+        t_peak = t_bytes;
+    } else {
+        s_peak.store(s_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+StageTimer::StageTimer() : m_thread(WorkerPool::insideJob()) {
+    if (MemoryCounters::enabled()) {
+        MemoryCounters::resetPeak(m_thread);
+        m_allocations = MemoryCounters::allocations(m_thread);
+        m_bytes = MemoryCounters::bytesInUse(m_thread);
+    }
+    m_start = std::chrono::steady_clock::now();
+}
+
+StageStats StageTimer::finish(const char* name, size_t objectsIn, size_t objectsOut) const {
+    StageStats stage;
+    stage.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+    stage.name = name;
+    stage.objectsIn = objectsIn;
+    stage.objectsOut = objectsOut;
+    if (MemoryCounters::enabled()) {
+        stage.memoryCounted = true;
+        stage.allocations = MemoryCounters::allocations(m_thread) - m_allocations;
+        stage.peakBytes = static_cast<uint64_t>(std::max<int64_t>(0, MemoryCounters::peakBytes(m_thread) - m_bytes));
+    }
+    return stage;
+}
+
+void paibot::addStage(std::vector<StageStats>& stages, const StageStats& stage) {
+    auto it = std::find_if(stages.begin(), stages.end(), [&](const StageStats& s) { return s.name == stage.name; });
+    if (it == stages.end()) {
+        stages.push_back(stage);
+        return;
+    }
+    it->milliseconds += stage.milliseconds;
+    it->objectsIn += stage.objectsIn;
+    it->objectsOut += stage.objectsOut;
+    it->allocations += stage.allocations;
+    it->peakBytes = std::max(it->peakBytes, stage.peakBytes);
+    it->workerTime = it->workerTime || stage.workerTime;
+    it->memoryCounted = it->memoryCounted || stage.memoryCounted;
+}
+
+std::string paibot::stagesToJson(const std::vector<StageStats>& stages, const std::string& indent) {
+    std::ostringstream json;
+    json << "[";
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const auto& stage = stages[i];
+        json << (i ? ",\n" : "\n") << indent << "  {\"name\": \"" << stage.name << "\", \"ms\": " << stage.milliseconds
+             << ", \"workerTime\": " << (stage.workerTime ? "true" : "false") << ", \"objectsIn\": " << stage.objectsIn
+             << ", \"objectsOut\": " << stage.objectsOut;
+        if (stage.memoryCounted) {
+            json << ", \"allocations\": " << stage.allocations << ", \"peakBytes\": " << stage.peakBytes;
+        } else {
+            json << ", \"allocations\": null, \"peakBytes\": null";
+        }
+        json << "}";
+    }
+    json << (stages.empty() ? "]" : "\n" + indent + "]");
+    return json.str();
+}
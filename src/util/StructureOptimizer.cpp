@@ -1,14 +1,89 @@
 #include <util/StructureOptimizer.hpp>
 #include <manager/BrushManager.hpp>
+#include <util/StageTimer.hpp>
+#include <Geode/binding/ColorAction.hpp>
+#include <Geode/binding/EffectGameObject.hpp>
+#include <Geode/binding/GJEffectManager.hpp>
 #include <Geode/binding/GameObject.hpp>
 #include <Geode/binding/LevelEditorLayer.hpp>
 #include <Geode/utils/cocos.hpp>
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace paibot;
 using namespace geode::prelude;
 
+namespace {
+    int colorIdOf(GJSpriteColor* color) {
+        return color ? color->m_colorID : 0;
+    }
+    
+    ObjectKind kindOf(GameObject* obj) {
+        if (typeinfo_cast<EffectGameObject*>(obj)) {
+            return ObjectKind::Trigger;
+        }
+        switch (obj->m_objectType) {
+            case GameObjectType::Solid: return ObjectKind::Solid;
+            case GameObjectType::Hazard: return ObjectKind::Hazard;
+            case GameObjectType::Decoration: return ObjectKind::Decoration;
+            default: return ObjectKind::Other;
+        }
+    }
+    
+    // Opaque skin, fully opaque object and a channel that neither blends nor fades
+    bool isOpaque(GameObject* obj, LevelEditorLayer* editor) {
+        if (!OptimizerPipeline::isOpaqueSkin(obj->m_objectID) || obj->getOpacity() < 255) {
+            return false;
+        }
+        const int channel = colorIdOf(obj->m_baseColor);
+        if (channel <= 0 || !editor || !editor->m_effectManager) {
+            return channel == 0;
+        }
+        auto* action = editor->m_effectManager->getColorAction(channel);
+        return action && !action->m_blending && action->m_currentOpacity >= 1.0f;
+    }
+    
+    // Hitbox rect of a record in world space; rotation is clockwise
+    void orientedCorners(const ObjectRecords& records, size_t i, CCPoint* out) {
+        const float radians = records.rotation[i] * 0.017453292f;
+        const float c = std::cos(radians);
+        const float s = std::sin(radians);
+        const float halfW = records.width[i] * 0.5f;
+        const float halfH = records.height[i] * 0.5f;
+        const float local[4][2] = {{-halfW, -halfH}, {halfW, -halfH}, {halfW, halfH}, {-halfW, halfH}};
+        for (int k = 0; k < 4; ++k) {
+            out[k] = {records.x[i] + local[k][0] * c + local[k][1] * s,
+                      records.y[i] - local[k][0] * s + local[k][1] * c};
+        }
+    }
+    
+    void copyObjectProperties(GameObject* from, GameObject* to) {
+        to->m_zLayer = from->m_zLayer;
+        to->m_zOrder = from->m_zOrder;
+        to->m_editorLayer = from->m_editorLayer;
+        to->m_editorLayer2 = from->m_editorLayer2;
+        to->m_isHide = from->m_isHide;
+        to->setFlipX(from->isFlipX());
+        to->setFlipY(from->isFlipY());
+        if (from->m_baseColor && to->m_baseColor) {
+            to->m_baseColor->m_colorID = from->m_baseColor->m_colorID;
+        }
+        if (from->m_detailColor && to->m_detailColor) {
+            to->m_detailColor->m_colorID = from->m_detailColor->m_colorID;
+        }
+        if (from->m_groups) {
+            for (int i = 0; i < from->m_groupCount; ++i) {
+                to->addToGroup((*from->m_groups)[i]);
+            }
+        }
+    }
+}
+
 StructureOptimizer* StructureOptimizer::create() {
     auto ret = new (std::nothrow) StructureOptimizer();
     if (ret && ret->init()) {
@@ -35,6 +110,13 @@ bool StructureOptimizer::init() {
     return true;
 }
 
+StructureOptimizer::~StructureOptimizer() {
+    // A running apply outlives the optimizer; it must not call back into it
+    if (m_applyTask) {
+        m_applyTask->setOnFinished(nullptr);
+    }
+}
+
 void StructureOptimizer::updateFromBrushManager() {
     auto brushManager = BrushManager::get();
     if (brushManager) {
@@ -44,8 +126,12 @@ void StructureOptimizer::updateFromBrushManager() {
         auto snapGrid = brushManager->getOptimizerSnapGrid();
         
         // Update options with current BrushManager values
-        m_options.colorTolerance = geometryTolerance;
+        m_geometryTolerance = geometryTolerance;
         m_options.forceGridSnap = true;
+        m_snapGrid = snapGrid;
+        m_targetReduction = targetReduction;
+        m_maxGeometryTolerance = brushManager->getOptimizerMaxGeometryTolerance();
+        m_maxColorTolerance = brushManager->getOptimizerMaxColorTolerance();
         
         log::info("Updated optimizer settings from BrushManager: target={:.1f}%, tolerance={:.2f}, grid={:.1f}", 
                   targetReduction * 100, geometryTolerance, snapGrid);
@@ -55,19 +141,30 @@ void StructureOptimizer::updateFromBrushManager() {
 }
 
 void StructureOptimizer::createSnapshot(const std::vector<GameObject*>& objects) {
-    m_originalSnapshot.clear();
-    m_originalSnapshot.reserve(objects.size());
+    m_snapshotArena.clear();
+    m_snapshot.clear();
+    m_snapshotAdded.clear();
+    m_snapshot.reserve(objects.size());
     
-    // Create a copy of all objects for potential revert
+    // One save string per object; memory follows the selection, not the level
+    auto* editor = LevelEditorLayer::get();
+    std::unordered_set<GameObject*> seen;
+    seen.reserve(objects.size());
     for (auto obj : objects) {
-        if (obj) {
-            // In a real implementation, we would create deep copies
-            m_originalSnapshot.push_back(obj);
+        if (!obj || !seen.insert(obj).second) {
+            continue;
         }
+        const gd::string saved = obj->getSaveString(editor);
+        SnapshotEntry entry;
+        entry.offset = static_cast<uint32_t>(m_snapshotArena.size());
+        entry.length = static_cast<uint32_t>(saved.size());
+        entry.object = obj;
+        m_snapshotArena.append(saved.c_str(), saved.size());
+        m_snapshot.push_back(std::move(entry));
     }
     
     m_hasSnapshot = true;
-    log::info("Created optimization snapshot with {} objects", m_originalSnapshot.size());
+    log::info("Created optimization snapshot with {} objects ({} KB)", m_snapshot.size(), getSnapshotBytes() / 1024);
 }
 
 void StructureOptimizer::revertToSnapshot() {
@@ -75,14 +172,56 @@ void StructureOptimizer::revertToSnapshot() {
         log::warn("No snapshot available to revert to");
         return;
     }
+    if (isApplying()) {
+        log::warn("Cannot revert while an optimization is being applied");
+        return;
+    }
+    auto* editor = LevelEditorLayer::get();
+    if (!editor) {
+        log::warn("Cannot revert optimization: editor layer unavailable");
+        return;
+    }
     
     log::info("Reverting optimization to previous state");
+    hidePreview();
     
-    // In a real implementation, we would restore the original objects
-    // For now, just log the action
-    log::info("Reverted to snapshot with {} objects", m_originalSnapshot.size());
+    // Objects placed since the snapshot
+    size_t added = 0;
+    for (const auto& weak : m_snapshotAdded) {
+        if (auto obj = weak.lock(); obj && obj->getParent()) {
+            editor->removeObject(obj.data(), true);
+            ++added;
+        }
+    }
     
-    hidePreview();
+    // Deleted objects come back from their string; changed ones are replaced.
+    // Everything is recreated with a single call.
+    std::string restore;
+    size_t removed = 0;
+    size_t modified = 0;
+    for (const auto& entry : m_snapshot) {
+        const auto saved = snapshotString(entry);
+        if (auto obj = entry.object.lock(); obj && obj->getParent()) {
+            const gd::string current = obj->getSaveString(editor);
+            if (std::string_view(current.c_str(), current.size()) == saved) {
+                continue;
+            }
+            editor->removeObject(obj.data(), true);
+            ++modified;
+        } else {
+            ++removed;
+        }
+        if (!restore.empty()) {
+            restore += ';';
+        }
+        restore.append(saved);
+    }
+    if (!restore.empty()) {
+        editor->createObjectsFromString(restore, true, true);
+    }
+    
+    log::info("Reverted snapshot: {} restored, {} reset, {} added objects removed", removed, modified, added);
+    clearSnapshot();
 }
 
 void StructureOptimizer::setOptions(OptimizeOptions const& opts) {
@@ -109,6 +248,10 @@ void StructureOptimizer::setColorTolerance(float deltaE) {
     m_colorTolerance = std::max(0.1f, deltaE);
 }
 
+void StructureOptimizer::setApplyBudget(float milliseconds) {
+    m_applyBudgetMs = std::max(0.5f, milliseconds);
+}
+
 void StructureOptimizer::setPreserveOptions(bool groupIDs, bool zOrder, bool channels, bool hitboxes) {
     m_preserveGroupIDs = groupIDs;
     m_preserveZOrder = zOrder;
@@ -116,6 +259,64 @@ void StructureOptimizer::setPreserveOptions(bool groupIDs, bool zOrder, bool cha
     m_noTouchHitboxes = hitboxes;
 }
 
+OptimizerConfig StructureOptimizer::makePipelineConfig() const {
+    OptimizerConfig config;
+    config.mode = m_mode;
+    config.options = m_options;
+    config.rules = m_fusionRules;
+    config.snapGrid = m_snapGrid;
+    config.geometryTolerance = m_geometryTolerance;
+    config.colorTolerance = m_colorTolerance;
+    config.options.colorTolerance = m_colorTolerance;
+    config.targetReduction = m_targetReduction;
+    config.maxGeometryTolerance = m_maxGeometryTolerance;
+    config.maxColorTolerance = m_maxColorTolerance;
+    config.canonicalObjectId = BrushManager::get() ? BrushManager::get()->getDrawObjectId() : 211;
+    config.preserveHitboxes = m_noTouchHitboxes;
+    
+    // Channel colours are only needed to compare channels
+    auto* editor = LevelEditorLayer::get();
+    if (m_fusionRules.allowColorMerging && editor && editor->m_effectManager) {
+        for (size_t i = 0; i < m_records.size(); ++i) {
+            for (int32_t channel : {m_records.colorId[i], m_records.detailColorId[i]}) {
+                if (channel > 0 && !config.channelColors.contains(channel)) {
+                    const auto color = editor->m_effectManager->activeColorForIndex(channel);
+                    config.channelColors[channel] = (color.r << 16) | (color.g << 8) | color.b;
+                    auto* action = editor->m_effectManager->getColorAction(channel);
+                    if (action && action->m_copyID > 0) {
+                        config.animatedChannels.insert(channel);
+                    }
+                }
+            }
+        }
+        // Colour triggers outside the selection still change its channels
+        if (editor->m_objects) {
+            for (auto* obj : CCArrayExt<GameObject*>(editor->m_objects)) {
+                if (auto* effect = typeinfo_cast<EffectGameObject*>(obj)) {
+                    const int32_t target = obj->m_objectID == OptimizerPipeline::kColorTriggerId ? effect->m_targetColor : 0;
+                    for (int32_t channel : {target, effect->m_copyColorID}) {
+                        if (channel > 0) {
+                            config.animatedChannels.insert(channel);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    config.progress = [](size_t done, size_t total) {
+        log::info("Whole-level optimization: chunk {}/{}", done, total);
+    };
+    config.logger = [](OptimizerLogLevel level, const std::string& message) {
+        switch (level) {
+            case OptimizerLogLevel::Debug: log::debug("{}", message); break;
+            case OptimizerLogLevel::Info: log::info("{}", message); break;
+            case OptimizerLogLevel::Warn: log::warn("{}", message); break;
+            case OptimizerLogLevel::Error: log::error("{}", message); break;
+        }
+    };
+    return config;
+}
+
 OptimizationStats StructureOptimizer::optimizeSelection(const std::vector<GameObject*>& objects) {
     if (objects.empty()) {
         log::info("Structure optimizer: no objects supplied");
@@ -135,38 +336,46 @@ OptimizationStats StructureOptimizer::optimizeSelection(const std::vector<GameOb
     updateFromBrushManager();
     
     // Create snapshot for potential revert
+    const StageTimer extractTimer;
     createSnapshot(objects);
+    const auto& records = extractRecords(objects);
+    buildSpatialIndex(records);
+    stats.stages.push_back(extractTimer.finish("extract", objects.size(), records.size()));
     
     try {
-        // Get target reduction from BrushManager (always use current setting)
-        float targetReduction = 0.6f;
-        if (auto* brushManager = BrushManager::get()) {
-            targetReduction = std::clamp(brushManager->getOptimizerTargetReduction(), 0.1f, 0.9f);
-        }
-
-        auto optimized = objects;
-        
-        // Apply optimization pipeline with validation
-        if (m_fusionRules.allowColorMerging) {
-            optimized = groupByColorAndZGroup(optimized);
-            optimized = mergeAdjacentBlocks(optimized);
-        }
-        
-        optimized = mergeGeometric(optimized);
-        optimized = normalizeObjects(optimized);
+        OptimizerPipeline pipeline(makePipelineConfig());
+        // A selection is optimized towards the target reduction; the whole
+        // level goes through the chunked run, which keeps memory bounded
+        m_lastTarget = {};
+        auto result = m_options.useSelectionOnly ? pipeline.runToTarget(records, m_lastTarget)
+                                                 : pipeline.runChunked(records);
+        auto& optimized = result.records;
+        stats.stages.insert(stats.stages.end(), result.stages.begin(), result.stages.end());
         
         // Validate the optimization
-        if (!validateOptimization(objects, optimized)) {
+        const StageTimer validateTimer;
+        const auto deltaE = pipeline.measureDeltaE(records, optimized);
+        const bool valid = pipeline.validateOptimization(records, optimized, deltaE);
+        stats.stages.push_back(validateTimer.finish("validate", records.size(), optimized.size()));
+        if (!valid) {
             log::error("Optimization validation failed for operation {}", stats.operationId);
             stats.objectsAfter = stats.objectsBefore;
             stats.reductionPercentage = 0.0f;
             return stats;
         }
         
-        // For now, simulate the target reduction
-        stats.objectsAfter = std::max(1, static_cast<int>(std::round(objects.size() * (1.0f - targetReduction))));
+        stats.objectsAfter = static_cast<int>(optimized.size());
         stats.reductionPercentage = (1.0f - static_cast<float>(stats.objectsAfter) / stats.objectsBefore) * 100.0f;
-        stats.deltaE = calculateDeltaE(objects, optimized);
+        stats.deltaE = deltaE.mean;
+        stats.deltaEP99 = deltaE.p99;
+        
+        m_lastPatterns = std::move(result.patterns);
+        m_triggerRewrites = std::move(result.triggerRewrites);
+        m_instanceDefinitions = std::move(result.instances);
+        
+        // Edits from here on are measured against this result
+        m_regionCache.reset(pipeline, optimized);
+        m_dirtyBoxes.clear();
         
         // Show preview of optimized result
         showPreview(optimized);
@@ -185,21 +394,78 @@ OptimizationStats StructureOptimizer::optimizeSelection(const std::vector<GameOb
     log::info("Optimization {} completed: {}/{} objects ({:.1f}% reduction) in {:.2f}s", 
               stats.operationId, stats.objectsAfter, stats.objectsBefore, 
               stats.reductionPercentage, stats.processingTime);
+    if (m_options.verboseLog) {
+        log::info("{}", generateReport());
+        log::info("{}", generateReportJson());
+    }
     
     return stats;
 }
 
-void StructureOptimizer::showPreview(const std::vector<GameObject*>& optimized) {
+void StructureOptimizer::showPreview(const ObjectRecords& optimized) {
     m_isPreviewActive = true;
-    m_previewObjects = optimized;
-    // In real implementation, show visual preview of optimized structure
-    log::info("Showing optimization preview for {} objects", optimized.size());
+    m_previewRecords = optimized;
+    
+    auto* editor = LevelEditorLayer::get();
+    if (!editor || !editor->m_objectLayer) {
+        log::info("Showing optimization preview for {} objects (no editor to draw in)", optimized.size());
+        return;
+    }
+    if (!m_previewNode) {
+        m_previewNode = CCDrawNode::create();
+    }
+    m_previewNode->clear();
+    if (!m_previewNode->getParent()) {
+        editor->m_objectLayer->addChild(m_previewNode, kPreviewZOrder);
+    }
+    
+    std::vector<uint8_t> kept(m_records.size(), 0);
+    for (int32_t source : optimized.sourceIndex) {
+        if (source >= 0 && static_cast<size_t>(source) < kept.size()) {
+            kept[source] = 1;
+        }
+    }
+    
+    // Untouched outlines first, then removed objects, merged pieces on top
+    const ccColor4F untouched = {0.6f, 0.8f, 1.0f, 0.35f};
+    const ccColor4F removed = {1.0f, 0.25f, 0.2f, 0.35f};
+    const ccColor4F merged = {0.2f, 1.0f, 0.4f, 0.35f};
+    const ccColor4F clear = {0.0f, 0.0f, 0.0f, 0.0f};
+    const ccColor4F mergedBorder = {0.2f, 1.0f, 0.4f, 0.9f};
+    CCPoint corners[4];
+    size_t removedCount = 0;
+    size_t mergedCount = 0;
+    for (size_t i = 0; i < optimized.size(); ++i) {
+        if (!optimized.isGenerated(i) && optimized.kind[i] != ObjectKind::Trigger) {
+            orientedCorners(optimized, i, corners);
+            m_previewNode->drawPolygon(corners, 4, clear, 0.5f, untouched);
+        }
+    }
+    for (size_t i = 0; i < m_records.size(); ++i) {
+        if (!kept[i]) {
+            orientedCorners(m_records, i, corners);
+            m_previewNode->drawPolygon(corners, 4, removed, 0.0f, clear);
+            ++removedCount;
+        }
+    }
+    for (size_t i = 0; i < optimized.size(); ++i) {
+        if (optimized.isGenerated(i)) {
+            orientedCorners(optimized, i, corners);
+            m_previewNode->drawPolygon(corners, 4, merged, 1.0f, mergedBorder);
+            ++mergedCount;
+        }
+    }
+    log::info("Showing optimization preview: {} merged, {} removed, {} untouched", mergedCount, removedCount,
+              optimized.size() - mergedCount);
 }
 
 void StructureOptimizer::hidePreview() {
     m_isPreviewActive = false;
-    m_previewObjects.clear();
-    // In real implementation, hide preview overlay
+    m_previewRecords.clear();
+    if (m_previewNode) {
+        m_previewNode->clear();
+        m_previewNode->removeFromParent();
+    }
     log::info("Hiding optimization preview");
 }
 
@@ -208,95 +474,162 @@ void StructureOptimizer::applyOptimization() {
         log::warn("Structure optimizer apply called without active preview");
         return;
     }
+    if (isApplying()) {
+        log::warn("Structure optimizer apply already in progress");
+        return;
+    }
+    auto* editor = LevelEditorLayer::get();
+    if (!editor) {
+        log::warn("Cannot apply optimization: editor layer unavailable");
+        return;
+    }
 
-    // In real implementation, replace original objects with optimized ones
-    log::info("Applying structure optimization");
+    log::info("Applying structure optimization ({} objects, {:.1f} ms per frame)", m_previewRecords.size(), m_applyBudgetMs);
+    m_applyTask = OptimizerApplyTask::create(m_previewRecords, m_sourceObjects, m_applyBudgetMs);
+    if (!m_applyTask) {
+        log::error("Failed to start optimization apply");
+        return;
+    }
+    const StageTimer applyTimer;
+    const size_t applied = m_previewRecords.size();
+    const std::string operationId = m_lastStats.operationId;
+    m_applyTask->setOnFinished([this, applyTimer, applied, operationId](const std::vector<GameObject*>& created) {
+        // Revert deletes these again
+        if (m_hasSnapshot) {
+            for (auto* obj : created) {
+                m_snapshotAdded.emplace_back(obj);
+            }
+        }
+        // Wall time across frames, game frames included
+        const auto stage = applyTimer.finish("apply", applied, created.size());
+        if (m_lastStats.operationId == operationId) {
+            m_lastStats.stages.push_back(stage);
+        }
+        log::info("Optimization {} applied in {:.1f} ms", operationId, stage.milliseconds);
+    });
+    m_applyTask->start(editor);
     hidePreview();
 }
 
-std::vector<GameObject*> StructureOptimizer::normalizeObjects(const std::vector<GameObject*>& objects) {
-    // Placeholder - normalize object transforms, colors, etc.
-    return objects;
-}
-
-std::vector<GameObject*> StructureOptimizer::mergeGeometric(const std::vector<GameObject*>& objects) {
-    // Placeholder - merge lines, segments, overlapping objects
-    return objects;
-}
-
-std::vector<GameObject*> StructureOptimizer::findPatterns(const std::vector<GameObject*>& objects) {
-    // Placeholder - find repeated patterns and create instances
-    return objects;
-}
-
-std::vector<GameObject*> StructureOptimizer::polygonize(const std::vector<GameObject*>& objects) {
-    // Placeholder - convert small objects to polygon representations  
-    return objects;
-}
-
-std::vector<GameObject*> StructureOptimizer::coalesceTriggers(const std::vector<GameObject*>& objects) {
-    // Placeholder - merge compatible triggers
-    return objects;
-}
-
-std::vector<GameObject*> StructureOptimizer::mergeLines(const std::vector<GameObject*>& objects) {
-    // Placeholder - merge collinear line segments
-    return objects;
-}
-
-std::vector<GameObject*> StructureOptimizer::mergeMosaics(const std::vector<GameObject*>& objects) {
-    // Placeholder - merge tile patterns into larger objects
-    return objects;
-}
-
-std::vector<GameObject*> StructureOptimizer::mergeSegments(const std::vector<GameObject*>& objects) {
-    // Placeholder - merge adjacent segments
-    return objects;
-}
-
-std::vector<GameObject*> StructureOptimizer::mergeOverlaps(const std::vector<GameObject*>& objects) {
-    // Placeholder - merge overlapping objects
-    return objects;
-}
-
-std::vector<GameObject*> StructureOptimizer::createInstances(const std::vector<GameObject*>& objects) {
-    // Placeholder - create instances of repeated patterns
-    return objects;
-}
-
-std::vector<GameObject*> StructureOptimizer::createCustomObjects(const std::vector<GameObject*>& objects) {
-    // Placeholder - create custom object definitions
-    return objects;
-}
-
-float StructureOptimizer::calculateDeltaE(const std::vector<GameObject*>& before, const std::vector<GameObject*>& after) {
-    // Placeholder - calculate visual difference using Delta E
-    return 0.5f;
-}
-
-bool StructureOptimizer::validateOptimization(const std::vector<GameObject*>& original, const std::vector<GameObject*>& optimized) {
-    // Validate that optimization didn't break anything
+const ObjectRecords& StructureOptimizer::extractRecords(const std::vector<GameObject*>& objects) {
+    m_records.clear();
+    m_sourceObjects.clear();
+    m_sourceLookup.clear();
+    m_records.reserve(objects.size());
+    m_sourceObjects.reserve(objects.size());
+    m_sourceLookup.reserve(objects.size());
     
-    if (optimized.empty() && !original.empty()) {
-        log::error("Optimization resulted in empty set from non-empty input");
-        return false;
+    auto* editor = LevelEditorLayer::get();
+    for (auto obj : objects) {
+        if (!obj || !m_sourceLookup.try_emplace(obj, static_cast<uint32_t>(m_sourceObjects.size())).second) {
+            continue;
+        }
+        const int32_t index = static_cast<int32_t>(m_sourceObjects.size());
+        m_sourceObjects.emplace_back(obj);
+        
+        ObjectRecord record;
+        const auto rect = obj->getObjectRect();
+        record.x = rect.getMidX();
+        record.y = rect.getMidY();
+        record.rotation = obj->getRotation();
+        record.scaleX = obj->getScaleX();
+        record.scaleY = obj->getScaleY();
+        record.width = rect.size.width;
+        record.height = rect.size.height;
+        if (record.rotation != 0.0f) {
+            // The object rect is axis aligned; recover the unrotated size
+            const float quarterTurns = record.rotation / 90.0f;
+            if (quarterTurns == std::round(quarterTurns)) {
+                if (static_cast<int>(std::abs(quarterTurns)) % 2 == 1) {
+                    std::swap(record.width, record.height);
+                }
+            } else {
+                record.width = obj->getContentSize().width * std::abs(record.scaleX);
+                record.height = obj->getContentSize().height * std::abs(record.scaleY);
+            }
+        }
+        record.objectId = obj->m_objectID;
+        record.colorId = colorIdOf(obj->m_baseColor);
+        record.detailColorId = colorIdOf(obj->m_detailColor);
+        record.zOrder = obj->m_zOrder;
+        record.zLayer = static_cast<int16_t>(obj->m_zLayer);
+        record.editorLayer = static_cast<int16_t>(obj->m_editorLayer);
+        record.groups = obj->m_groups && obj->m_groupCount > 0
+            ? ObjectRecords::groupSignature(obj->m_groups->data(), static_cast<size_t>(obj->m_groupCount))
+            : 0;
+        record.kind = kindOf(obj);
+        record.flags = (obj->m_isHide ? ObjectHidden : 0) |
+                       (editor && editor->isLayerLocked(obj->m_editorLayer) ? ObjectLocked : 0) |
+                       (obj->isFlipX() ? ObjectFlipX : 0) |
+                       (obj->isFlipY() ? ObjectFlipY : 0) |
+                       (isOpaque(obj, editor) ? ObjectOpaque : 0);
+        record.sourceIndex = index;
+        record.templateIndex = index;
+        if (auto* effect = typeinfo_cast<EffectGameObject*>(obj)) {
+            TriggerParams trigger;
+            trigger.target = obj->m_objectID == OptimizerPipeline::kColorTriggerId ? effect->m_targetColor
+                                                                                   : effect->m_targetGroupID;
+            trigger.duration = effect->m_duration;
+            trigger.color = (effect->m_triggerTargetColor.r << 16) | (effect->m_triggerTargetColor.g << 8) |
+                            effect->m_triggerTargetColor.b;
+            trigger.opacity = effect->m_opacity;
+            trigger.copyColorId = effect->m_copyColorID;
+            trigger.blending = effect->m_usesBlending;
+            trigger.activate = effect->m_activateGroup;
+            trigger.activation = (effect->m_isSpawnTriggered ? TriggerSpawned : 0) |
+                                 (effect->m_isTouchTriggered ? TriggerTouched : 0) |
+                                 (effect->m_isMultiTriggered ? TriggerMulti : 0);
+            trigger.order = obj->m_uniqueID;
+            record.trigger = trigger;
+        }
+        m_records.push(record);
     }
     
-    // Check that reduction is within reasonable bounds
-    float reductionRatio = 1.0f - (static_cast<float>(optimized.size()) / original.size());
-    if (reductionRatio > 0.95f) {
-        log::warn("Optimization reduction too aggressive: {:.1f}%", reductionRatio * 100);
-        return false;
-    }
+    log::debug("Extracted {} object records", m_records.size());
+    return m_records;
+}
+
+std::vector<GameObject*> StructureOptimizer::materialize(const ObjectRecords& records) const {
+    std::vector<GameObject*> objects;
+    objects.reserve(records.size());
     
-    // Validate visual difference is acceptable
-    float deltaE = calculateDeltaE(original, optimized);
-    if (deltaE > 5.0f) {  // Threshold for acceptable visual difference
-        log::warn("Optimization visual difference too high: ΔE = {:.2f}", deltaE);
-        return false;
+    for (size_t i = 0; i < records.size(); ++i) {
+        const int32_t source = records.sourceIndex[i];
+        if (source >= 0 && static_cast<size_t>(source) < m_sourceObjects.size()) {
+            // A source deleted since extraction stays deleted
+            if (auto obj = m_sourceObjects[source].lock()) {
+                objects.push_back(obj.data());
+            }
+            continue;
+        }
+        
+        auto* piece = GameObject::createWithKey(records.objectId[i]);
+        if (!piece) {
+            log::warn("Failed to create merged object {}", records.objectId[i]);
+            continue;
+        }
+        const int32_t templ = records.templateIndex[i];
+        if (templ >= 0 && static_cast<size_t>(templ) < m_sourceObjects.size()) {
+            if (auto from = m_sourceObjects[templ].lock()) {
+                copyObjectProperties(from.data(), piece);
+            }
+        }
+        // Records win over the template for everything a pass may have changed
+        if (piece->m_baseColor) {
+            piece->m_baseColor->m_colorID = records.colorId[i];
+        }
+        if (piece->m_detailColor) {
+            piece->m_detailColor->m_colorID = records.detailColorId[i];
+        }
+        piece->m_zLayer = static_cast<ZLayer>(records.zLayer[i]);
+        piece->m_zOrder = records.zOrder[i];
+        piece->setPosition({records.x[i], records.y[i]});
+        piece->setRotation(records.rotation[i]);
+        piece->updateCustomScaleX(records.scaleX[i]);
+        piece->updateCustomScaleY(records.scaleY[i]);
+        objects.push_back(piece);
     }
-    
-    return true;
+    return objects;
 }
 
 OptimizationStats StructureOptimizer::getLastStats() const {
@@ -309,6 +642,9 @@ OptimizationStats StructureOptimizer::optimizeActiveSelection() {
         log::warn("Structure optimizer: editor layer unavailable");
         return {};
     }
+    if (!m_options.useSelectionOnly) {
+        return optimizeLevel();
+    }
 
     std::vector<GameObject*> selection;
     if (auto* selected = editorLayer->m_selectedObjects) {
@@ -328,6 +664,116 @@ OptimizationStats StructureOptimizer::optimizeActiveSelection() {
     return optimizeSelection(selection);
 }
 
+OptimizationStats StructureOptimizer::optimizeLevel() {
+    auto* editorLayer = LevelEditorLayer::get();
+    if (!editorLayer || !editorLayer->m_objects) {
+        log::warn("Structure optimizer: editor layer unavailable");
+        return {};
+    }
+    
+    // Straight from the level's object array; selecting everything first
+    // costs more than the optimization itself on large levels
+    std::vector<GameObject*> objects;
+    objects.reserve(editorLayer->m_objects->count());
+    for (auto* obj : CCArrayExt<GameObject*>(editorLayer->m_objects)) {
+        objects.push_back(obj);
+    }
+    log::info("Structure optimizer: whole level, {} objects", objects.size());
+    return optimizeSelection(objects);
+}
+
+void StructureOptimizer::markDirty(GameObject* obj) {
+    if (obj) {
+        markDirty(obj->getObjectRect());
+    }
+}
+
+void StructureOptimizer::markDirty(const CCRect& rect) {
+    m_dirtyBoxes.push_back({rect.getMinX(), rect.getMinY(), rect.getMaxX(), rect.getMaxY()});
+}
+
+OptimizationStats StructureOptimizer::reoptimizeDirty() {
+    auto* editorLayer = LevelEditorLayer::get();
+    if (!editorLayer || !editorLayer->m_objects) {
+        log::warn("Structure optimizer: editor layer unavailable");
+        return {};
+    }
+    if (m_dirtyBoxes.empty()) {
+        log::info("Structure optimizer: nothing changed since the last optimization");
+        return {};
+    }
+    if (m_regionCache.empty()) {
+        log::info("Structure optimizer: no previous result, optimizing the selection instead");
+        m_dirtyBoxes.clear();
+        return optimizeActiveSelection();
+    }
+    if (isApplying()) {
+        log::warn("Structure optimizer: apply in progress, try again when it finishes");
+        return {};
+    }
+
+    OptimizationStats stats;
+    stats.operationId = generateUniqueOperationId();
+    const auto startTime = std::chrono::high_resolution_clock::now();
+    
+    // One rect test per object; the passes then only see the area
+    const auto area = m_regionCache.area(m_dirtyBoxes);
+    std::vector<GameObject*> objects;
+    for (auto* obj : CCArrayExt<GameObject*>(editorLayer->m_objects)) {
+        const auto rect = obj->getObjectRect();
+        const Aabb box{rect.getMinX(), rect.getMinY(), rect.getMaxX(), rect.getMaxY()};
+        if (std::any_of(area.begin(), area.end(), [&](const Aabb& a) { return a.touches(box); })) {
+            objects.push_back(obj);
+        }
+    }
+    stats.objectsBefore = static_cast<int>(objects.size());
+    
+    const StageTimer extractTimer;
+    createSnapshot(objects);
+    const auto& records = extractRecords(objects);
+    buildSpatialIndex(records);
+    stats.stages.push_back(extractTimer.finish("extract", objects.size(), records.size()));
+    
+    try {
+        OptimizerPipeline pipeline(makePipelineConfig());
+        const StageTimer updateTimer;
+        auto update = m_regionCache.update(pipeline, records, m_dirtyBoxes);
+        m_dirtyBoxes.clear();
+        auto& optimized = update.result.records;
+        stats.stages.push_back(updateTimer.finish("incremental", records.size(), optimized.size()));
+        
+        const StageTimer validateTimer;
+        const auto deltaE = pipeline.measureDeltaE(records, optimized);
+        const bool valid = pipeline.validateOptimization(records, optimized, deltaE);
+        stats.stages.push_back(validateTimer.finish("validate", records.size(), optimized.size()));
+        if (!valid) {
+            log::error("Incremental optimization validation failed for operation {}", stats.operationId);
+            stats.objectsAfter = stats.objectsBefore;
+            m_regionCache.clear();
+            return stats;
+        }
+        stats.objectsAfter = static_cast<int>(optimized.size());
+        stats.reductionPercentage = stats.objectsBefore
+            ? (1.0f - static_cast<float>(stats.objectsAfter) / stats.objectsBefore) * 100.0f : 0.0f;
+        stats.deltaE = deltaE.mean;
+        stats.deltaEP99 = deltaE.p99;
+        m_triggerRewrites = std::move(update.result.triggerRewrites);
+        
+        log::info("Incremental optimization: {} regions affected, {} clusters reused, {} re-run ({} of {} records)",
+                  update.affectedRegions, update.reusedClusters, update.rerunClusters, update.recordsInPlay,
+                  records.size());
+        showPreview(optimized);
+    } catch (const std::exception& e) {
+        log::error("Incremental optimization failed for operation {}: {}", stats.operationId, e.what());
+        stats.objectsAfter = stats.objectsBefore;
+        m_regionCache.clear();
+    }
+    
+    stats.processingTime = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - startTime).count();
+    m_lastStats = stats;
+    return stats;
+}
+
 std::string StructureOptimizer::generateReport() const {
     std::stringstream report;
     report << "=== Structure Optimization Report ===\n";
@@ -335,13 +781,64 @@ std::string StructureOptimizer::generateReport() const {
     report << "Objects Before: " << m_lastStats.objectsBefore << "\n";
     report << "Objects After: " << m_lastStats.objectsAfter << "\n";
     report << "Reduction: " << m_lastStats.reductionPercentage << "%\n";
-    report << "Visual Difference (ΔE): " << m_lastStats.deltaE << "\n";
+    report << "Visual Difference (ΔE2000): mean " << m_lastStats.deltaE << ", p99 " << m_lastStats.deltaEP99 << "\n";
     report << "Processing Time: " << m_lastStats.processingTime << "s\n";
+    for (const auto& stage : m_lastStats.stages) {
+        report << "  " << stage.name << ": " << stage.milliseconds << " ms" << (stage.workerTime ? " (worker time)" : "")
+               << ", " << stage.objectsIn << " -> " << stage.objectsOut << " objects";
+        if (stage.memoryCounted) {
+            report << ", " << stage.allocations << " allocations, peak " << stage.peakBytes / 1024 << " KB";
+        }
+        report << "\n";
+    }
     report << "Mode: " << (m_mode == OptimizationMode::VanillaSafe ? "Vanilla Safe" : "Geode Runtime") << "\n";
-    report << "Snapshot Available: " << (m_hasSnapshot ? "Yes" : "No") << "\n";
+    report << "Snapshot Available: " << (m_hasSnapshot ? "Yes" : "No");
+    if (m_hasSnapshot) {
+        report << " (" << m_snapshot.size() << " objects, " << getSnapshotBytes() / 1024 << " KB)";
+    }
+    report << "\n";
+    report << "Repeated Patterns: " << m_lastPatterns.groups.size()
+           << " (" << m_lastPatterns.repeatedObjects << " repeated objects, "
+           << m_lastPatterns.savedObjects << " saveable, " << m_lastPatterns.savedBytes / 1024 << " KB)\n";
+    for (size_t i = 0; i < m_lastPatterns.groups.size() && i < 5; ++i) {
+        const auto& group = m_lastPatterns.groups[i];
+        report << "  " << group.instances.size() << "x " << group.objectsPerInstance << " objects\n";
+    }
+    if (!m_lastTarget.steps.empty()) {
+        report << "Target Reduction: " << m_lastTarget.target * 100.0f << "%, achieved "
+               << m_lastTarget.achieved * 100.0f << "%" << (m_lastTarget.reached ? "" : " (not reached)") << "\n";
+        for (const auto& step : m_lastTarget.steps) {
+            report << "  " << step.pass << " (geometry " << step.geometryTolerance << ", color "
+                   << step.colorTolerance << "): ";
+            if (!step.accepted) {
+                report << "rejected by ΔE check";
+            } else {
+                report << step.objectsBefore - step.objectsAfter << " objects saved";
+            }
+            report << ", " << step.milliseconds << " ms\n";
+        }
+    }
+    report << "Triggers Coalesced: " << m_triggerRewrites.size() << "\n";
+    if (!m_instanceDefinitions.empty()) {
+        report << "Instance Definitions: " << m_instanceDefinitions.size() << "\n";
+    }
     return report.str();
 }
 
+std::string StructureOptimizer::generateReportJson() const {
+    std::stringstream json;
+    json << "{\n";
+    json << "  \"operationId\": \"" << m_lastStats.operationId << "\",\n";
+    json << "  \"objectsBefore\": " << m_lastStats.objectsBefore << ",\n";
+    json << "  \"objectsAfter\": " << m_lastStats.objectsAfter << ",\n";
+    json << "  \"reductionPercentage\": " << m_lastStats.reductionPercentage << ",\n";
+    json << "  \"deltaE\": {\"mean\": " << m_lastStats.deltaE << ", \"p99\": " << m_lastStats.deltaEP99 << "},\n";
+    json << "  \"processingMs\": " << m_lastStats.processingTime * 1000.0f << ",\n";
+    json << "  \"stages\": " << stagesToJson(m_lastStats.stages, "  ") << "\n";
+    json << "}\n";
+    return json.str();
+}
+
 std::string StructureOptimizer::generateUniqueOperationId() const {
     auto now = std::chrono::system_clock::now();
     auto time_t = std::chrono::system_clock::to_time_t(now);
@@ -355,53 +852,13 @@ std::string StructureOptimizer::generateUniqueOperationId() const {
 }
 
 void StructureOptimizer::clearSnapshot() {
-    m_originalSnapshot.clear();
+    m_snapshotArena.clear();
+    m_snapshot.clear();
+    m_snapshotAdded.clear();
     m_hasSnapshot = false;
     log::info("Optimization snapshot cleared");
 }
 
-std::vector<GameObject*> StructureOptimizer::groupByColorAndZGroup(const std::vector<GameObject*>& objects) {
-    // Group objects by (color_id, z_group) for fusion
-    // Placeholder implementation
-    log::info("Grouping {} objects by color and z-group", objects.size());
-    return objects;
-}
-
-std::vector<GameObject*> StructureOptimizer::mergeAdjacentBlocks(const std::vector<GameObject*>& objects) {
-    // Merge adjacent blocks with same color and z-group
-    // Reject fusions that would create corrupt polygons
-    std::vector<GameObject*> merged;
-    
-    for (auto obj : objects) {
-        if (obj) {
-            // Validate each potential fusion
-            bool canMerge = true;
-            
-            // Check minimum area requirement
-            // In real implementation, we would calculate actual area
-            if (m_fusionRules.minValidArea > 0.0f) {
-                // Placeholder area check
-                canMerge = true;
-            }
-            
-            if (canMerge && !m_fusionRules.rejectCorruptPolygons) {
-                // Validate polygon integrity
-                // In real implementation, check for self-intersections, etc.
-                canMerge = true;
-            }
-            
-            if (canMerge) {
-                merged.push_back(obj);
-            } else {
-                log::warn("Rejecting fusion due to invalid polygon or area");
-            }
-        }
-    }
-    
-    log::info("Merged adjacent blocks: {} -> {} objects", objects.size(), merged.size());
-    return merged;
-}
-
 bool StructureOptimizer::validatePolygon(const std::vector<geode::prelude::CCPoint>& vertices) {
     if (vertices.size() < 3) {
         return false;
@@ -423,12 +880,49 @@ bool StructureOptimizer::validatePolygon(const std::vector<geode::prelude::CCPoi
 }
 
 bool StructureOptimizer::validateFusion(GameObject* obj1, GameObject* obj2) {
-    if (!obj1 || !obj2) {
+    if (!obj1 || !obj2 || obj1 == obj2) {
         return false;
     }
     
-    // Check if objects can be safely fused based on fusion rules
-    // In real implementation, check color, z-group, etc.
-    
-    return m_fusionRules.allowColorMerging;
-}
\ No newline at end of file
+    // Both must be part of the extracted selection
+    auto it1 = m_sourceLookup.find(obj1);
+    auto it2 = m_sourceLookup.find(obj2);
+    if (it1 == m_sourceLookup.end() || it2 == m_sourceLookup.end()) {
+        return false;
+    }
+    return OptimizerPipeline(makePipelineConfig()).canFuse(m_records, it1->second, it2->second);
+}
+
+void StructureOptimizer::buildSpatialIndex(const ObjectRecords& records) {
+    std::vector<Aabb> boxes;
+    records.collectBounds(boxes);
+    m_spatialIndex.build(boxes, std::max(1.0f, m_snapGrid));
+    log::debug("Built spatial index over {} objects", records.size());
+}
+
+std::vector<GameObject*> StructureOptimizer::queryBox(const CCRect& rect) const {
+    std::vector<GameObject*> result;
+    m_spatialIndex.forEachInBox({rect.getMinX(), rect.getMinY(), rect.getMaxX(), rect.getMaxY()}, [&](uint32_t index) {
+        if (auto obj = m_sourceObjects[m_records.sourceIndex[index]].lock()) {
+            result.push_back(obj.data());
+        }
+    });
+    return result;
+}
+
+std::vector<GameObject*> StructureOptimizer::queryNeighbours(GameObject* obj, float margin) const {
+    std::vector<GameObject*> result;
+    auto it = m_sourceLookup.find(obj);
+    if (it == m_sourceLookup.end()) {
+        return result;
+    }
+    m_spatialIndex.forEachInBox(m_spatialIndex.getBox(it->second).expanded(margin), [&](uint32_t index) {
+        if (index == it->second) {
+            return;
+        }
+        if (auto other = m_sourceObjects[m_records.sourceIndex[index]].lock()) {
+            result.push_back(other.data());
+        }
+    });
+    return result;
+}
@@ -0,0 +1,108 @@
+#include <util/TextureAtlas.hpp>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+using namespace paibot;
+
+bool ShelfPacker::pack(int width, int height, AtlasRect& out) {
+    if (width <= 0 || height <= 0 || width > m_width) {
+        return false;
+    }
+
+    if (m_cursorX + width > m_width) {
+        // Close the current shelf and open a new one below it
+        m_shelfY += m_shelfHeight;
+        m_shelfHeight = 0;
+        m_cursorX = 0;
+    }
+    if (m_shelfY + height > m_height) {
+        return false;
+    }
+
+    out = {m_cursorX, m_shelfY, width, height};
+    m_cursorX += width;
+    m_shelfHeight = std::max(m_shelfHeight, height);
+    return true;
+}
+
+bool TextureAtlas::build(const std::vector<const MipLevel*>& images, int padding, int maxSize,
+                         TextureAtlasImage& out) {
+    out = {};
+    if (images.empty()) {
+        return false;
+    }
+    padding = std::max(0, padding);
+
+    // Tallest first keeps shelves tight
+    std::vector<size_t> order(images.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return images[a]->height > images[b]->height;
+    });
+
+    size_t area = 0;
+    for (const auto* image : images) {
+        if (!image || image->isEmpty()) {
+            return false;
+        }
+        area += static_cast<size_t>(image->width + 2 * padding) * (image->height + 2 * padding);
+    }
+
+    int side = 1;
+    while (static_cast<size_t>(side) * side < area) {
+        side <<= 1;
+    }
+
+    // Grow width then height until everything fits
+    std::vector<AtlasRect> placed(images.size());
+    int atlasWidth = side;
+    int atlasHeight = std::max(1, side / 2);
+    bool packed = false;
+    while (!packed && atlasWidth <= maxSize && atlasHeight <= maxSize) {
+        ShelfPacker packer(atlasWidth, atlasHeight);
+        packed = true;
+        for (size_t index : order) {
+            AtlasRect slot;
+            if (!packer.pack(images[index]->width + 2 * padding, images[index]->height + 2 * padding, slot)) {
+                packed = false;
+                break;
+            }
+            placed[index] = {slot.x + padding, slot.y + padding, images[index]->width, images[index]->height};
+        }
+        if (!packed) {
+            if (atlasHeight < atlasWidth) {
+                atlasHeight <<= 1;
+            } else {
+                atlasWidth <<= 1;
+            }
+        }
+    }
+    if (!packed) {
+        return false;
+    }
+
+    out.width = atlasWidth;
+    out.height = atlasHeight;
+    out.rects = std::move(placed);
+    out.rgba.assign(static_cast<size_t>(atlasWidth) * atlasHeight * 4, 0);
+
+    const size_t atlasStride = static_cast<size_t>(atlasWidth) * 4;
+    for (size_t i = 0; i < images.size(); ++i) {
+        const auto& image = *images[i];
+        const auto& rect = out.rects[i];
+        for (int y = -padding; y < image.height + padding; ++y) {
+            const int srcY = ((y % image.height) + image.height) % image.height;
+            const uint8_t* srcRow = image.rgba.data() + static_cast<size_t>(srcY) * image.width * 4;
+            uint8_t* dstRow = out.rgba.data() + atlasStride * (rect.y + y);
+            std::memcpy(dstRow + static_cast<size_t>(rect.x) * 4, srcRow, static_cast<size_t>(image.width) * 4);
+            for (int p = 1; p <= padding; ++p) {
+                const int left = ((image.width - p) % image.width + image.width) % image.width;
+                const int right = (p - 1) % image.width;
+                std::memcpy(dstRow + static_cast<size_t>(rect.x - p) * 4, srcRow + left * 4, 4);
+                std::memcpy(dstRow + static_cast<size_t>(rect.x + image.width + p - 1) * 4, srcRow + right * 4, 4);
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,495 @@
+#include <util/TileContainer.hpp>
+#include <util/ByteStream.hpp>
+#include <util/WorkerPool.hpp>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace paibot;
+
+namespace {
+    constexpr char kMagic[8] = {'P', 'B', 'T', 'I', 'L', 'E', 'S', '\0'};
+    constexpr size_t kHeaderSize = 96;
+    constexpr size_t kHeaderCrcOffset = kHeaderSize - 4;
+    constexpr size_t kIndexEntrySize = 32;
+    constexpr int kEdgeCount = 4;
+    // Sanity bounds so a corrupt header cannot request absurd allocations
+    constexpr uint32_t kMaxTiles = 1u << 16;
+    constexpr uint32_t kMaxTileSide = 1u << 14;
+
+    struct Section {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+    };
+
+    struct Header {
+        uint32_t version = 0;
+        uint32_t tileCount = 0;
+        uint32_t tileWidth = 0;
+        uint32_t tileHeight = 0;
+        float deltaE = 0.0f;
+        Section settings;
+        Section edges;
+        Section compat;
+        uint64_t indexOffset = 0;
+    };
+
+    void encodeHeader(const Header& header, std::vector<uint8_t>& out) {
+        out.clear();
+        ByteWriter writer(out);
+        writer.bytes(kMagic, sizeof(kMagic));
+        writer.u32(header.version);
+        writer.u32(static_cast<uint32_t>(kHeaderSize));
+        writer.u32(header.tileCount);
+        writer.u32(header.tileWidth);
+        writer.u32(header.tileHeight);
+        writer.f32(header.deltaE);
+        for (const Section* section : {&header.settings, &header.edges, &header.compat}) {
+            writer.u64(section->offset);
+            writer.u64(section->size);
+        }
+        writer.u64(header.indexOffset);
+        writer.u32(0);  // flags, reserved
+        writer.u32(Deflate::crc32(out.data(), out.size()));
+    }
+
+    size_t compatWordsFor(size_t tileCount) {
+        return (tileCount + 63) / 64;
+    }
+
+    // Bit j of row (i, edge) is set when tile j may sit on `edge` of tile i.
+    // Edges meet their opposite side: top/bottom and left/right.
+    std::vector<uint64_t> buildCompatibility(const std::vector<std::vector<int>>& patterns, size_t tileCount) {
+        const size_t words = compatWordsFor(tileCount);
+        std::vector<uint64_t> bits(tileCount * kEdgeCount * words, 0);
+        if (patterns.size() != tileCount) {
+            return bits;
+        }
+        for (size_t i = 0; i < tileCount; ++i) {
+            if (patterns[i].size() < kEdgeCount) {
+                continue;
+            }
+            for (int edge = 0; edge < kEdgeCount; ++edge) {
+                uint64_t* row = bits.data() + (i * kEdgeCount + edge) * words;
+                const int opposite = (edge + 2) % kEdgeCount;
+                for (size_t j = 0; j < tileCount; ++j) {
+                    if (patterns[j].size() >= kEdgeCount && patterns[i][edge] == patterns[j][opposite]) {
+                        row[j / 64] |= uint64_t{1} << (j % 64);
+                    }
+                }
+            }
+        }
+        return bits;
+    }
+
+    bool inBounds(const Section& section, size_t fileSize) {
+        return section.offset <= fileSize && section.size <= fileSize - section.offset;
+    }
+}
+
+bool TileContainerWriter::write(const std::string& path, const TileContainerSource& source, DeflateLevel level) {
+    if (source.tileCount == 0 || source.tileCount > kMaxTiles || source.tileWidth <= 0 || source.tileHeight <= 0 ||
+        static_cast<uint32_t>(source.tileWidth) > kMaxTileSide ||
+        static_cast<uint32_t>(source.tileHeight) > kMaxTileSide || !source.readRow) {
+        return false;
+    }
+
+    // Written beside the target and renamed at the end, so a reader that has
+    // the previous file mapped never observes a half-written container. A
+    // leftover from an earlier replacement goes first, if it is free by now.
+    const std::string tempPath = path + ".tmp";
+    const std::string oldPath = path + ".old";
+    std::error_code ignored;
+    std::filesystem::remove(oldPath, ignored);
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+
+    Header header;
+    header.version = kTileContainerVersion;
+    header.tileCount = static_cast<uint32_t>(source.tileCount);
+    header.tileWidth = static_cast<uint32_t>(source.tileWidth);
+    header.tileHeight = static_cast<uint32_t>(source.tileHeight);
+    header.deltaE = source.deltaE;
+
+    uint64_t cursor = kHeaderSize;
+    std::vector<uint8_t> scratch(kHeaderSize, 0);
+    file.write(reinterpret_cast<const char*>(scratch.data()), static_cast<std::streamsize>(scratch.size()));
+
+    auto writeSection = [&](const std::vector<uint8_t>& bytes, Section& section) {
+        section.offset = cursor;
+        section.size = bytes.size();
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        cursor += bytes.size();
+    };
+
+    writeSection(source.settings, header.settings);
+
+    scratch.clear();
+    {
+        ByteWriter writer(scratch);
+        writer.u32(static_cast<uint32_t>(source.edgePatterns.size()));
+        for (const auto& pattern : source.edgePatterns) {
+            writer.u32(static_cast<uint32_t>(pattern.size()));
+            for (int value : pattern) {
+                writer.i32(value);
+            }
+        }
+    }
+    writeSection(scratch, header.edges);
+
+    scratch.clear();
+    {
+        ByteWriter writer(scratch);
+        for (uint64_t word : buildCompatibility(source.edgePatterns, source.tileCount)) {
+            writer.u64(word);
+        }
+    }
+    writeSection(scratch, header.compat);
+
+    // Tile chunks, one wave of threadCount tiles at a time
+    const size_t rowBytes = static_cast<size_t>(source.tileWidth) * 4;
+    const size_t rawSize = rowBytes * source.tileHeight;
+    auto* pool = WorkerPool::get();
+    const size_t wave = std::max<size_t>(1, pool->getThreadCount());
+    std::vector<TileContainer::TileEntry> entries(source.tileCount);
+    std::vector<std::vector<uint8_t>> chunks(wave);
+
+    for (size_t first = 0; first < source.tileCount; first += wave) {
+        const size_t count = std::min(wave, source.tileCount - first);
+        pool->parallelFor(count, [&](size_t k) {
+            const size_t index = first + k;
+            std::vector<uint8_t> raw(rawSize);
+            for (int y = 0; y < source.tileHeight; ++y) {
+                source.readRow(index, y, raw.data() + rowBytes * y);
+            }
+            chunks[k] = Deflate::compress(raw.data(), raw.size(), level);
+        });
+        for (size_t k = 0; k < count; ++k) {
+            auto& entry = entries[first + k];
+            entry.offset = cursor;
+            entry.compressedSize = static_cast<uint32_t>(chunks[k].size());
+            entry.rawSize = static_cast<uint32_t>(rawSize);
+            entry.crc = Deflate::crc32(chunks[k].data(), chunks[k].size());
+            entry.width = header.tileWidth;
+            entry.height = header.tileHeight;
+            file.write(reinterpret_cast<const char*>(chunks[k].data()), static_cast<std::streamsize>(chunks[k].size()));
+            cursor += chunks[k].size();
+            std::vector<uint8_t>().swap(chunks[k]);
+        }
+    }
+
+    header.indexOffset = cursor;
+    scratch.clear();
+    {
+        ByteWriter writer(scratch);
+        for (const auto& entry : entries) {
+            writer.u64(entry.offset);
+            writer.u32(entry.compressedSize);
+            writer.u32(entry.rawSize);
+            writer.u32(entry.crc);
+            writer.u32(entry.width);
+            writer.u32(entry.height);
+            writer.u32(0);
+        }
+    }
+    file.write(reinterpret_cast<const char*>(scratch.data()), static_cast<std::streamsize>(scratch.size()));
+
+    encodeHeader(header, scratch);
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(scratch.data()), static_cast<std::streamsize>(scratch.size()));
+    file.close();
+    if (!file) {
+        std::error_code ec;
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec) {
+        // Windows cannot replace a file that is still mapped, but it can move
+        // it aside (containers open with FILE_SHARE_DELETE). The old file
+        // stays valid for its readers and is removed once they let go, at
+        // the latest by the next write to this path.
+        ec.clear();
+        std::filesystem::rename(path, oldPath, ec);
+        if (!ec) {
+            std::filesystem::rename(tempPath, path, ec);
+        }
+        if (ec) {
+            std::filesystem::remove(tempPath, ignored);
+            return false;
+        }
+        std::filesystem::remove(oldPath, ignored);
+    }
+    return true;
+}
+
+#ifdef _WIN32
+namespace {
+    struct WinMapping {
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+    };
+}
+
+bool TileContainer::map(const std::string& path) {
+    auto* handles = new WinMapping();
+    m_mapping = handles;
+    // Sharing delete lets writers move a mapped container aside
+    handles->file = CreateFileW(std::filesystem::path(path).wstring().c_str(), GENERIC_READ,
+                                FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                                nullptr);
+    LARGE_INTEGER size{};
+    if (handles->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(handles->file, &size) || size.QuadPart <= 0) {
+        return false;
+    }
+    handles->mapping = CreateFileMappingW(handles->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!handles->mapping) {
+        return false;
+    }
+    m_data = static_cast<const uint8_t*>(MapViewOfFile(handles->mapping, FILE_MAP_READ, 0, 0, 0));
+    m_size = m_data ? static_cast<size_t>(size.QuadPart) : 0;
+    return m_data != nullptr;
+}
+
+void TileContainer::unmap() {
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+    }
+    if (auto* handles = static_cast<WinMapping*>(m_mapping)) {
+        if (handles->mapping) {
+            CloseHandle(handles->mapping);
+        }
+        if (handles->file != INVALID_HANDLE_VALUE) {
+            CloseHandle(handles->file);
+        }
+        delete handles;
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+}
+#else
+bool TileContainer::map(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info {};
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    m_data = static_cast<const uint8_t*>(address);
+    m_size = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void TileContainer::unmap() {
+    if (m_data) {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+}
+#endif
+
+std::shared_ptr<TileContainer> TileContainer::open(const std::string& path) {
+    std::shared_ptr<TileContainer> container(new TileContainer());
+    container->m_path = path;
+    if (!container->map(path) || !container->parse()) {
+        return nullptr;
+    }
+    return container;
+}
+
+TileContainer::~TileContainer() {
+    unmap();
+}
+
+bool TileContainer::parse() {
+    if (m_size < kHeaderSize || std::memcmp(m_data, kMagic, sizeof(kMagic)) != 0) {
+        return false;
+    }
+
+    ByteReader reader(m_data, kHeaderSize);
+    reader.seek(kHeaderCrcOffset);
+    if (reader.u32() != Deflate::crc32(m_data, kHeaderCrcOffset)) {
+        return false;
+    }
+
+    reader.seek(sizeof(kMagic));
+    Header header;
+    header.version = reader.u32();
+    const uint32_t headerSize = reader.u32();
+    header.tileCount = reader.u32();
+    header.tileWidth = reader.u32();
+    header.tileHeight = reader.u32();
+    header.deltaE = reader.f32();
+    for (Section* section : {&header.settings, &header.edges, &header.compat}) {
+        section->offset = reader.u64();
+        section->size = reader.u64();
+    }
+    header.indexOffset = reader.u64();
+
+    if (!reader.ok() || header.version != kTileContainerVersion || headerSize != kHeaderSize ||
+        header.tileCount == 0 || header.tileCount > kMaxTiles ||
+        header.tileWidth == 0 || header.tileWidth > kMaxTileSide ||
+        header.tileHeight == 0 || header.tileHeight > kMaxTileSide) {
+        return false;
+    }
+    const Section index{header.indexOffset, static_cast<uint64_t>(header.tileCount) * kIndexEntrySize};
+    for (const Section& section : {header.settings, header.edges, header.compat, index}) {
+        if (!inBounds(section, m_size)) {
+            return false;
+        }
+    }
+
+    m_tileWidth = static_cast<int>(header.tileWidth);
+    m_tileHeight = static_cast<int>(header.tileHeight);
+    m_deltaE = header.deltaE;
+    m_settings.assign(m_data + header.settings.offset, m_data + header.settings.offset + header.settings.size);
+
+    ByteReader edges(m_data + header.edges.offset, header.edges.size);
+    const uint32_t patternCount = edges.u32();
+    if (patternCount > header.tileCount) {
+        return false;
+    }
+    m_edgePatterns.resize(patternCount);
+    for (auto& pattern : m_edgePatterns) {
+        const uint32_t count = edges.u32();
+        if (count > edges.remaining() / 4) {
+            return false;
+        }
+        pattern.resize(count);
+        for (auto& value : pattern) {
+            value = edges.i32();
+        }
+    }
+    if (!edges.ok()) {
+        return false;
+    }
+
+    m_compatWords = compatWordsFor(header.tileCount);
+    const size_t compatCount = static_cast<size_t>(header.tileCount) * kEdgeCount * m_compatWords;
+    if (header.compat.size != compatCount * 8) {
+        return false;
+    }
+    ByteReader compat(m_data + header.compat.offset, header.compat.size);
+    m_compatibility.resize(compatCount);
+    for (auto& word : m_compatibility) {
+        word = compat.u64();
+    }
+
+    ByteReader entries(m_data + index.offset, index.size);
+    m_entries.resize(header.tileCount);
+    for (auto& entry : m_entries) {
+        entry.offset = entries.u64();
+        entry.compressedSize = entries.u32();
+        entry.rawSize = entries.u32();
+        entry.crc = entries.u32();
+        entry.width = entries.u32();
+        entry.height = entries.u32();
+        entries.u32();
+        if (!inBounds({entry.offset, entry.compressedSize}, m_size) ||
+            entry.width > kMaxTileSide || entry.height > kMaxTileSide ||
+            entry.rawSize != static_cast<uint64_t>(entry.width) * entry.height * 4) {
+            return false;
+        }
+    }
+    if (!compat.ok() || !entries.ok()) {
+        return false;
+    }
+
+    m_slots = std::make_unique<TileSlot[]>(m_entries.size());
+    return true;
+}
+
+bool TileContainer::isCompatible(size_t tile, int edge, size_t other) const {
+    if (tile >= m_entries.size() || other >= m_entries.size() || edge < 0 || edge >= kEdgeCount) {
+        return false;
+    }
+    const uint64_t word = m_compatibility[(tile * kEdgeCount + edge) * m_compatWords + other / 64];
+    return (word >> (other % 64)) & 1;
+}
+
+TileContainer::TilePixels TileContainer::getTile(size_t index) {
+    if (index >= m_entries.size()) {
+        return nullptr;
+    }
+    auto& slot = m_slots[index];
+    std::lock_guard lock(slot.mutex);
+    if (slot.pixels) {
+        return slot.pixels;
+    }
+
+    const auto& entry = m_entries[index];
+    const uint8_t* chunk = m_data + entry.offset;
+    if (Deflate::crc32(chunk, entry.compressedSize) != entry.crc) {
+        return nullptr;
+    }
+    auto pixels = std::make_shared<std::vector<uint8_t>>();
+    if (!Deflate::decompress(chunk, entry.compressedSize, *pixels, entry.rawSize) || pixels->size() != entry.rawSize) {
+        return nullptr;
+    }
+    slot.pixels = std::move(pixels);
+    return slot.pixels;
+}
+
+void TileContainer::releaseTile(size_t index) {
+    if (index >= m_entries.size()) {
+        return;
+    }
+    std::lock_guard lock(m_slots[index].mutex);
+    m_slots[index].pixels.reset();
+}
+
+void TileContainer::releaseAll() {
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        releaseTile(i);
+    }
+}
+
+bool TileContainer::isResident(size_t index) const {
+    if (index >= m_entries.size()) {
+        return false;
+    }
+    std::lock_guard lock(m_slots[index].mutex);
+    return m_slots[index].pixels != nullptr;
+}
+
+size_t TileContainer::getResidentBytes() const {
+    size_t total = 0;
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        std::lock_guard lock(m_slots[i].mutex);
+        if (m_slots[i].pixels) {
+            total += m_slots[i].pixels->size();
+        }
+    }
+    return total;
+}
@@ -0,0 +1,121 @@
+#include <util/WorkerPool.hpp>
+#include <algorithm>
+
+using namespace paibot;
+
+namespace {
+    thread_local bool t_insideJob = false;
+}
+
+WorkerPool* WorkerPool::s_instance = nullptr;
+
+WorkerPool* WorkerPool::get() {
+    if (!s_instance) {
+        // Leave one core to the game's main/render thread
+        unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+        s_instance = new WorkerPool(hardware > 1 ? hardware - 1 : 0);
+    }
+    return s_instance;
+}
+
+void WorkerPool::destroy() {
+    if (s_instance) {
+        delete s_instance;
+        s_instance = nullptr;
+    }
+}
+
+WorkerPool::WorkerPool(unsigned threadCount) {
+    m_threads.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; ++i) {
+        m_threads.emplace_back([this] { workerLoop(); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto& thread : m_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+bool WorkerPool::insideJob() {
+    return t_insideJob;
+}
+
+void WorkerPool::drainJob(const std::function<void(size_t)>& job, size_t count) {
+    t_insideJob = true;
+    for (size_t i = m_nextIndex.fetch_add(1); i < count; i = m_nextIndex.fetch_add(1)) {
+        job(i);
+    }
+    t_insideJob = false;
+}
+
+void WorkerPool::workerLoop() {
+    uint64_t seenGeneration = 0;
+    while (true) {
+        const std::function<void(size_t)>* job = nullptr;
+        size_t count = 0;
+        {
+            std::unique_lock lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stopping || m_generation != seenGeneration; });
+            if (m_stopping) {
+                return;
+            }
+            seenGeneration = m_generation;
+            if (!m_job) {
+                // Woke up after the job was already drained by others
+                continue;
+            }
+            job = m_job;
+            count = m_jobCount;
+            ++m_activeWorkers;
+        }
+
+        drainJob(*job, count);
+
+        {
+            std::lock_guard lock(m_mutex);
+            --m_activeWorkers;
+        }
+        m_done.notify_all();
+    }
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
+
+    // Serial fallback: no workers, a single item, or a nested call from a job
+    if (m_threads.empty() || count == 1 || t_insideJob) {
+        for (size_t i = 0; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+
+    std::lock_guard submitLock(m_submitMutex);
+    {
+        std::lock_guard lock(m_mutex);
+        m_job = &fn;
+        m_jobCount = count;
+        m_nextIndex.store(0);
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    // The caller works too instead of idling on the condition variable
+    drainJob(fn, count);
+
+    std::unique_lock lock(m_mutex);
+    m_done.wait(lock, [&] { return m_activeWorkers == 0; });
+    m_job = nullptr;
+    m_jobCount = 0;
+}
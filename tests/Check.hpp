@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal assertions for the test executables: failures are printed and
+// counted, and main returns the count so ctest sees them.
+namespace paibot::test {
+    inline int& failures() {
+        static int count = 0;
+        return count;
+    }
+}
+
+#define PAIBOT_CHECK(condition)                                                              \
+    do {                                                                                      \
+        if (!(condition)) {                                                                   \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++paibot::test::failures();                                                       \
+        }                                                                                     \
+    } while (false)
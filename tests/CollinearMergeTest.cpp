@@ -0,0 +1,104 @@
+#include <Check.hpp>
+#include <util/OptimizerPipeline.hpp>
+#include <cmath>
+
+using namespace paibot;
+
+namespace {
+    ObjectRecord segment(float x, float y, float length, float thickness, float rotation = 0.0f) {
+        ObjectRecord piece;
+        piece.objectId = 211;
+        piece.kind = ObjectKind::Decoration;
+        piece.x = x;
+        piece.y = y;
+        piece.width = length;
+        piece.height = thickness;
+        piece.rotation = rotation;
+        return piece;
+    }
+
+    ObjectRecords row(float middleY, float middleThickness) {
+        ObjectRecords records;
+        records.push(segment(15.0f, 10.0f, 30.0f, 4.0f));
+        records.push(segment(45.0f, middleY, 30.0f, middleThickness));
+        records.push(segment(75.0f, 10.0f, 30.0f, 4.0f));
+        return records;
+    }
+
+    // Abutting pieces on one line become one stretched piece
+    void sameLineJoins() {
+        OptimizerPipeline pipeline(OptimizerConfig{});
+        const auto merged = pipeline.mergeSegments(row(10.0f, 4.0f));
+        PAIBOT_CHECK(merged.size() == 1);
+        if (merged.size() == 1) {
+            PAIBOT_CHECK(std::abs(merged.x[0] - 45.0f) < 1e-3f);
+            PAIBOT_CHECK(std::abs(merged.y[0] - 10.0f) < 1e-3f);
+            PAIBOT_CHECK(std::abs(merged.width[0] - 90.0f) < 1e-3f);
+            PAIBOT_CHECK(merged.height[0] == 4.0f);
+        }
+    }
+
+    // A middle piece off the line or of another thickness breaks the run,
+    // and the outer pieces are too far apart to join on their own
+    void offsetOrThicknessSeparates() {
+        OptimizerPipeline pipeline(OptimizerConfig{});
+        PAIBOT_CHECK(pipeline.mergeSegments(row(12.0f, 4.0f)).size() == 3);
+        PAIBOT_CHECK(pipeline.mergeSegments(row(10.0f, 6.0f)).size() == 3);
+        // Within the geometry tolerance the offset still matches
+        PAIBOT_CHECK(pipeline.mergeSegments(row(10.02f, 4.0f)).size() == 1);
+    }
+
+    // Runs stop at the piece size cap: with 4 cells of 15 units, seven
+    // 30-unit pieces in a row become 60, 60, 60 and 30
+    void runsAreCapped() {
+        OptimizerConfig config;
+        config.options.maxWidthCells = 4;
+        OptimizerPipeline pipeline(config);
+        ObjectRecords records;
+        for (int i = 0; i < 7; ++i) {
+            records.push(segment(15.0f + 30.0f * i, 10.0f, 30.0f, 4.0f));
+        }
+        const auto merged = pipeline.mergeSegments(records);
+        PAIBOT_CHECK(merged.size() == 4);
+        float length = 0.0f;
+        for (size_t i = 0; i < merged.size(); ++i) {
+            PAIBOT_CHECK(merged.width[i] <= 60.0f + 1e-3f);
+            length += merged.width[i];
+        }
+        PAIBOT_CHECK(std::abs(length - 210.0f) < 1e-3f);
+    }
+
+    // Rotated line art joins along its own axis only
+    void rotatedLinesJoinOnTheirAxis() {
+        OptimizerConfig config;
+        config.options.includeRotated = true;
+        OptimizerPipeline pipeline(config);
+        const float step = 30.0f * std::sqrt(0.5f);
+
+        ObjectRecords onLine;
+        onLine.push(segment(0.0f, 0.0f, 30.0f, 4.0f, 45.0f));
+        onLine.push(segment(step, -step, 30.0f, 4.0f, 45.0f));
+        const auto merged = pipeline.mergeLines(onLine);
+        PAIBOT_CHECK(merged.size() == 1);
+        if (merged.size() == 1) {
+            PAIBOT_CHECK(std::abs(merged.width[0] - 60.0f) < 1e-3f);
+            PAIBOT_CHECK(std::abs(merged.x[0] - step * 0.5f) < 1e-3f);
+            PAIBOT_CHECK(std::abs(merged.y[0] + step * 0.5f) < 1e-3f);
+        }
+
+        // Shifted across the line by 5 units
+        const float shift = 5.0f * std::sqrt(0.5f);
+        ObjectRecords parallel;
+        parallel.push(segment(0.0f, 0.0f, 30.0f, 4.0f, 45.0f));
+        parallel.push(segment(step + shift, -step + shift, 30.0f, 4.0f, 45.0f));
+        PAIBOT_CHECK(pipeline.mergeLines(parallel).size() == 2);
+    }
+}
+
+int main() {
+    sameLineJoins();
+    offsetOrThicknessSeparates();
+    runsAreCapped();
+    rotatedLinesJoinOnTheirAxis();
+    return paibot::test::failures();
+}
@@ -0,0 +1,91 @@
+#include <Check.hpp>
+#include <util/LevelString.hpp>
+#include <util/OptimizerPipeline.hpp>
+#include <string>
+
+using namespace paibot;
+
+namespace {
+    // Two touching blocks on channels 1 and 2, both red
+    constexpr const char* kLevel = "kS38,1_255_2_0_3_0_6_1|1_255_2_0_3_0_6_2,kA2,0;"
+                                   "1,1,2,15,3,15,21,1;1,1,2,45,3,15,21,2;";
+
+    size_t optimize(const std::string& text, bool withLevelChannels) {
+        ParsedLevel level;
+        PAIBOT_CHECK(LevelString::parse(text, level));
+        OptimizerConfig config;
+        config.rules.allowColorMerging = true;
+        config.options.colorTolerance = 1.0f;
+        config.channelColors = level.channelColors;
+        if (withLevelChannels) {
+            config.animatedChannels = level.animatedChannels;
+        }
+        return OptimizerPipeline(config).run(level.records).records.size();
+    }
+
+    void equalChannelsMerge() {
+        PAIBOT_CHECK(optimize(kLevel, true) == 1);
+    }
+
+    // A colour trigger on channel 2 keeps the blocks apart, whether it is in
+    // the optimized records or only listed by the caller
+    void triggeredChannelsStay() {
+        const std::string trigger = "1,899,2,-100,3,15,23,2;";
+        PAIBOT_CHECK(optimize(std::string(kLevel) + trigger, false) == 3);
+
+        ParsedLevel level;
+        PAIBOT_CHECK(LevelString::parse(std::string(kLevel) + trigger, level));
+        PAIBOT_CHECK(level.animatedChannels.contains(2));
+        OptimizerConfig config;
+        config.rules.allowColorMerging = true;
+        config.options.colorTolerance = 1.0f;
+        config.channelColors = level.channelColors;
+        config.animatedChannels = level.animatedChannels;
+        ParsedLevel blocks;
+        PAIBOT_CHECK(LevelString::parse(kLevel, blocks));
+        PAIBOT_CHECK(OptimizerPipeline(config).run(blocks.records).records.size() == 2);
+    }
+
+    // Copy triggers read their source channel, and kS38 copies follow theirs
+    void copiedChannelsStay() {
+        PAIBOT_CHECK(optimize(std::string(kLevel) + "1,899,2,-100,3,15,23,5,50,1;", true) == 3);
+        const std::string copying = "kS38,1_255_2_0_3_0_6_1|1_255_2_0_3_0_6_2_9_7,kA2,0;"
+                                    "1,1,2,15,3,15,21,1;1,1,2,45,3,15,21,2;";
+        PAIBOT_CHECK(optimize(copying, true) == 2);
+    }
+
+    // runToTarget may relax the colour tolerance only under colour merging,
+    // and never into a triggered channel
+    void relaxedColors() {
+        const std::string close = "kS38,1_255_2_0_3_0_6_1|1_250_2_0_3_0_6_2,kA2,0;"
+                                  "1,1,2,15,3,15,21,1;1,1,2,45,3,15,21,2;";
+        auto runToTarget = [&](const std::string& text, bool merge) {
+            ParsedLevel level;
+            PAIBOT_CHECK(LevelString::parse(text, level));
+            OptimizerConfig config;
+            config.rules.allowColorMerging = merge;
+            config.options.colorTolerance = 0.1f;
+            config.maxColorTolerance = 5.0f;
+            config.targetReduction = 0.9f;
+            config.channelColors = level.channelColors;
+            config.animatedChannels = level.animatedChannels;
+            TargetReport report;
+            const size_t count = OptimizerPipeline(config).runToTarget(level.records, report).records.size();
+            for (const auto& step : report.steps) {
+                PAIBOT_CHECK(merge || step.colorTolerance == 0.1f);
+            }
+            return count;
+        };
+        PAIBOT_CHECK(runToTarget(close, true) == 1);
+        PAIBOT_CHECK(runToTarget(close, false) == 2);
+        PAIBOT_CHECK(runToTarget(close + "1,899,2,-100,3,15,23,2;", true) == 3);
+    }
+}
+
+int main() {
+    equalChannelsMerge();
+    triggeredChannelsStay();
+    copiedChannelsStay();
+    relaxedColors();
+    return paibot::test::failures();
+}
@@ -0,0 +1,41 @@
+#include <Check.hpp>
+#include <util/HeightField.hpp>
+#include <algorithm>
+#include <vector>
+
+using namespace paibot;
+
+namespace {
+    // A cutoff at k octaves matches a build that stops at k octaves
+    void cutoffsMatchShorterBuilds() {
+        OctaveNoiseParams params;
+        params.size = 48;
+        params.scale = 0.3f;
+        params.octaves = 6;
+        params.seed = 7;
+        const std::vector<int> cutoffs = {1, 2, 2, 4, 6, 9};
+
+        std::vector<int> seen;
+        OctaveStack stack;
+        stack.build(params, cutoffs, [&](int octaves, HeightField&& field) {
+            seen.push_back(octaves);
+            OctaveNoiseParams shorter = params;
+            shorter.octaves = std::min(octaves, params.octaves);
+            OctaveStack reference;
+            reference.build(shorter);
+            PAIBOT_CHECK(field.width == params.size && field.height == params.size);
+            PAIBOT_CHECK(field.values == reference.compose().values);
+        });
+        PAIBOT_CHECK(seen == cutoffs);
+        PAIBOT_CHECK(stack.getOctaveCount() == params.octaves);
+        PAIBOT_CHECK(stack.compose().values.size() == static_cast<size_t>(params.size) * params.size);
+
+        stack.clear();
+        PAIBOT_CHECK(stack.compose().isEmpty());
+    }
+}
+
+int main() {
+    cutoffsMatchShorterBuilds();
+    return paibot::test::failures();
+}
@@ -0,0 +1,136 @@
+#include <Check.hpp>
+#include <util/LatticeRegion.hpp>
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using namespace paibot;
+
+namespace {
+    constexpr int kSide = 6;
+
+    using Cells = std::vector<uint8_t>;
+
+    Cells randomShape(std::mt19937& rng, float density) {
+        std::uniform_real_distribution<float> coin(0.0f, 1.0f);
+        Cells cells(kSide * kSide);
+        for (auto& cell : cells) {
+            cell = coin(rng) < density ? 1 : 0;
+        }
+        return cells;
+    }
+
+    LatticeRegion regionOf(const Cells& cells) {
+        std::vector<GridRect> rects;
+        for (int y = 0; y < kSide; ++y) {
+            for (int x = 0; x < kSide; ++x) {
+                if (cells[y * kSide + x]) {
+                    rects.push_back({x, y, 1, 1});
+                }
+            }
+        }
+        return LatticeRegion::fromRects(rects);
+    }
+
+    // Every cell of the shape covered once, nothing else
+    bool coversExactly(const Cells& cells, const std::vector<GridRect>& rects) {
+        Cells covered(cells.size(), 0);
+        for (const auto& rect : rects) {
+            if (rect.width < 1 || rect.height < 1 || rect.x < 0 || rect.y < 0 ||
+                rect.x + rect.width > kSide || rect.y + rect.height > kSide) {
+                return false;
+            }
+            for (int y = rect.y; y < rect.y + rect.height; ++y) {
+                for (int x = rect.x; x < rect.x + rect.width; ++x) {
+                    if (!cells[y * kSide + x] || covered[y * kSide + x]++) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return covered == cells;
+    }
+
+    // Exhaustive search over the open cells as a bit set. The lowest,
+    // leftmost open cell is the lower left corner of some rectangle of every
+    // partition, so branching over those rectangles visits all partitions.
+    int search(uint64_t open, std::unordered_map<uint64_t, int>& memo) {
+        if (open == 0) {
+            return 0;
+        }
+        if (auto it = memo.find(open); it != memo.end()) {
+            return it->second;
+        }
+        const int first = std::countr_zero(open);
+        const int x0 = first % kSide;
+        const int y0 = first / kSide;
+        auto bit = [](int x, int y) { return uint64_t{1} << (y * kSide + x); };
+        int best = INT32_MAX;
+        int maxWidth = kSide - x0;
+        for (int y = y0; y < kSide && (open & bit(x0, y)); ++y) {
+            int width = 0;
+            while (width < maxWidth && (open & bit(x0 + width, y))) {
+                ++width;
+            }
+            maxWidth = width;
+            for (int w = 1; w <= maxWidth; ++w) {
+                uint64_t rect = 0;
+                for (int yy = y0; yy <= y; ++yy) {
+                    for (int xx = x0; xx < x0 + w; ++xx) {
+                        rect |= bit(xx, yy);
+                    }
+                }
+                best = std::min(best, 1 + search(open & ~rect, memo));
+            }
+        }
+        memo.emplace(open, best);
+        return best;
+    }
+
+    int bruteForceMinimum(const Cells& cells) {
+        uint64_t open = 0;
+        for (size_t i = 0; i < cells.size(); ++i) {
+            open |= uint64_t{cells[i]} << i;
+        }
+        std::unordered_map<uint64_t, int> memo;
+        return search(open, memo);
+    }
+
+    // The exact partition must be a partition and as small as exhaustive
+    // search finds; the sweep decomposition must be a partition no smaller
+    void partitionMatchesBruteForce() {
+        std::mt19937 rng(2024);
+        const auto never = std::chrono::steady_clock::time_point::max();
+        for (int round = 0; round < 1500; ++round) {
+            const auto cells = randomShape(rng, 0.45f + 0.05f * (round % 10));
+            const auto region = regionOf(cells);
+            const int minimum = bruteForceMinimum(cells);
+
+            std::vector<GridRect> exact;
+            PAIBOT_CHECK(region.partitionMinimum(exact, never));
+            PAIBOT_CHECK(coversExactly(cells, exact));
+            PAIBOT_CHECK(static_cast<int>(exact.size()) == minimum);
+
+            const auto sweep = region.decompose();
+            PAIBOT_CHECK(coversExactly(cells, sweep));
+            PAIBOT_CHECK(static_cast<int>(sweep.size()) >= minimum);
+        }
+    }
+
+    // A passed deadline leaves the output alone; a plus has chords to match
+    void deadlineRefuses() {
+        const auto region = LatticeRegion::fromRects({{1, 0, 1, 3}, {0, 1, 3, 1}});
+        std::vector<GridRect> out{{7, 7, 1, 1}};
+        PAIBOT_CHECK(!region.partitionMinimum(out, std::chrono::steady_clock::now() - std::chrono::seconds(1)));
+        PAIBOT_CHECK(out.size() == 1 && out[0] == (GridRect{7, 7, 1, 1}));
+    }
+}
+
+int main() {
+    partitionMatchesBruteForce();
+    deadlineRefuses();
+    return paibot::test::failures();
+}
@@ -0,0 +1,45 @@
+#include <Check.hpp>
+#include <util/LevelString.hpp>
+#include <util/OptimizerPipeline.hpp>
+#include <string>
+
+using namespace paibot;
+
+namespace {
+    // A row of `count` touching objects of one id
+    std::string row(int objectId, int count) {
+        std::string text = "kA2,0;";
+        for (int i = 0; i < count; ++i) {
+            text += "1," + std::to_string(objectId) + ",2," + std::to_string(15 + 30 * i) + ",3,15;";
+        }
+        return text;
+    }
+
+    size_t optimize(const std::string& text) {
+        ParsedLevel level;
+        PAIBOT_CHECK(LevelString::parse(text, level));
+        return OptimizerPipeline(OptimizerConfig{}).run(level.records).records.size();
+    }
+
+    void kinds() {
+        ParsedLevel level;
+        PAIBOT_CHECK(LevelString::parse("kA2,0;1,1,2,15,3,15;1,211,2,45,3,15;1,8,2,75,3,15;1,899,2,105,3,15;", level));
+        PAIBOT_CHECK(level.records.size() == 4);
+        PAIBOT_CHECK(level.records.kind[0] == ObjectKind::Solid);
+        PAIBOT_CHECK(level.records.kind[1] == ObjectKind::Solid);
+        PAIBOT_CHECK(level.records.kind[2] == ObjectKind::Other);
+        PAIBOT_CHECK(level.records.kind[3] == ObjectKind::Trigger);
+    }
+
+    // Plain blocks fuse; spikes (id 8) keep their own hitboxes
+    void onlyBlocksMerge() {
+        PAIBOT_CHECK(optimize(row(1, 10)) == 1);
+        PAIBOT_CHECK(optimize(row(8, 10)) == 10);
+    }
+}
+
+int main() {
+    kinds();
+    onlyBlocksMerge();
+    return paibot::test::failures();
+}
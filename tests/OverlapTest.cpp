@@ -0,0 +1,91 @@
+#include <Check.hpp>
+#include <util/OptimizerPipeline.hpp>
+
+using namespace paibot;
+
+namespace {
+    ObjectRecord box(ObjectKind kind, float x, float y, float width, float height, int32_t zOrder, bool opaque) {
+        ObjectRecord object;
+        object.objectId = kind == ObjectKind::Solid ? 1 : 211;
+        object.kind = kind;
+        object.x = x;
+        object.y = y;
+        object.width = width;
+        object.height = height;
+        object.zOrder = zOrder;
+        object.flags = opaque ? ObjectOpaque : 0;
+        return object;
+    }
+
+    // A decoration under `covers`, returns how many records survive
+    size_t survivors(std::initializer_list<ObjectRecord> covers, bool respectHoles = true) {
+        ObjectRecords records;
+        records.push(box(ObjectKind::Decoration, 0.0f, 0.0f, 30.0f, 30.0f, 0, false));
+        for (const auto& cover : covers) {
+            records.push(cover);
+        }
+        OptimizerConfig config;
+        config.options.respectHoles = respectHoles;
+        return OptimizerPipeline(config).mergeOverlaps(records).size();
+    }
+
+    void fullOpaqueCoverAboveRemoves() {
+        PAIBOT_CHECK(survivors({box(ObjectKind::Solid, 0.0f, 0.0f, 30.0f, 30.0f, 1, true)}) == 1);
+        PAIBOT_CHECK(survivors({box(ObjectKind::Solid, 2.0f, -3.0f, 60.0f, 60.0f, 1, true)}) == 1);
+        // Two halves together
+        PAIBOT_CHECK(survivors({box(ObjectKind::Solid, -7.5f, 0.0f, 15.0f, 30.0f, 1, true),
+                                box(ObjectKind::Solid, 7.5f, 0.0f, 15.0f, 30.0f, 1, true)}) == 2);
+    }
+
+    void partialCoverKeeps() {
+        PAIBOT_CHECK(survivors({box(ObjectKind::Solid, 1.0f, 0.0f, 30.0f, 30.0f, 1, true)}) == 2);
+        PAIBOT_CHECK(survivors({box(ObjectKind::Solid, -7.5f, 0.0f, 15.0f, 30.0f, 1, true)}) == 2);
+    }
+
+    void transparentCoverKeeps() {
+        PAIBOT_CHECK(survivors({box(ObjectKind::Solid, 0.0f, 0.0f, 30.0f, 30.0f, 1, false)}) == 2);
+    }
+
+    void lowerOrEqualZKeeps() {
+        PAIBOT_CHECK(survivors({box(ObjectKind::Solid, 0.0f, 0.0f, 30.0f, 30.0f, 0, true)}) == 2);
+        PAIBOT_CHECK(survivors({box(ObjectKind::Solid, 0.0f, 0.0f, 30.0f, 30.0f, -1, true)}) == 2);
+
+        // The z layer decides before the z order
+        auto below = box(ObjectKind::Solid, 0.0f, 0.0f, 30.0f, 30.0f, 5, true);
+        below.zLayer = -1;
+        PAIBOT_CHECK(survivors({below}) == 2);
+        auto above = box(ObjectKind::Solid, 0.0f, 0.0f, 30.0f, 30.0f, -5, true);
+        above.zLayer = 1;
+        PAIBOT_CHECK(survivors({above}) == 1);
+    }
+
+    // A hairline seam between two covers only counts as covered when holes
+    // may be ignored
+    void seamsFollowRespectHoles() {
+        const auto left = box(ObjectKind::Solid, -7.525f, 0.0f, 15.0f, 30.0f, 1, true);
+        const auto right = box(ObjectKind::Solid, 7.525f, 0.0f, 15.0f, 30.0f, 1, true);
+        PAIBOT_CHECK(survivors({left, right}, true) == 3);
+        PAIBOT_CHECK(survivors({left, right}, false) == 2);
+    }
+
+    // Colliders keep their hitboxes unless told otherwise
+    void hitboxesArePreserved() {
+        ObjectRecords records;
+        records.push(box(ObjectKind::Hazard, 0.0f, 0.0f, 30.0f, 30.0f, 0, false));
+        records.push(box(ObjectKind::Solid, 0.0f, 0.0f, 30.0f, 30.0f, 1, true));
+        PAIBOT_CHECK(OptimizerPipeline(OptimizerConfig{}).mergeOverlaps(records).size() == 2);
+        OptimizerConfig config;
+        config.preserveHitboxes = false;
+        PAIBOT_CHECK(OptimizerPipeline(config).mergeOverlaps(records).size() == 1);
+    }
+}
+
+int main() {
+    fullOpaqueCoverAboveRemoves();
+    partialCoverKeeps();
+    transparentCoverKeeps();
+    lowerOrEqualZKeeps();
+    seamsFollowRespectHoles();
+    hitboxesArePreserved();
+    return paibot::test::failures();
+}
@@ -0,0 +1,252 @@
+#include <Check.hpp>
+#include <util/LatticeRegion.hpp>
+#include <util/OptimizerPipeline.hpp>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace paibot;
+
+namespace {
+    constexpr int kSide = 10;
+
+    using Cells = std::vector<uint8_t>;
+
+    Cells randomCells(std::mt19937& rng, float density) {
+        std::uniform_real_distribution<float> coin(0.0f, 1.0f);
+        Cells cells(kSide * kSide);
+        for (auto& cell : cells) {
+            cell = coin(rng) < density ? 1 : 0;
+        }
+        return cells;
+    }
+
+    std::vector<GridRect> randomRects(std::mt19937& rng) {
+        std::uniform_int_distribution<int> count(0, 6);
+        std::uniform_int_distribution<int> corner(0, kSide - 1);
+        std::vector<GridRect> rects(count(rng));
+        for (auto& rect : rects) {
+            rect.x = corner(rng);
+            rect.y = corner(rng);
+            rect.width = std::uniform_int_distribution<int>(1, kSide - rect.x)(rng);
+            rect.height = std::uniform_int_distribution<int>(1, kSide - rect.y)(rng);
+        }
+        return rects;
+    }
+
+    Cells cellsOf(const std::vector<GridRect>& rects) {
+        Cells cells(kSide * kSide, 0);
+        for (const auto& rect : rects) {
+            for (int y = rect.y; y < rect.y + rect.height; ++y) {
+                for (int x = rect.x; x < rect.x + rect.width; ++x) {
+                    cells[y * kSide + x] = 1;
+                }
+            }
+        }
+        return cells;
+    }
+
+    LatticeRegion regionOf(const Cells& cells) {
+        std::vector<GridRect> rects;
+        for (int y = 0; y < kSide; ++y) {
+            for (int x = 0; x < kSide; ++x) {
+                if (cells[y * kSide + x]) {
+                    rects.push_back({x, y, 1, 1});
+                }
+            }
+        }
+        return LatticeRegion::fromRects(rects);
+    }
+
+    int64_t countOf(const Cells& cells) {
+        return std::count(cells.begin(), cells.end(), uint8_t{1});
+    }
+
+    // Empty cells that cannot reach the border through empty cells are
+    // holes. Rings touching at a corner stay separate, so empty space
+    // escapes diagonally through a corner pinch.
+    Cells filled(const Cells& cells) {
+        Cells outside(cells.size(), 0);
+        std::vector<int> stack;
+        for (int y = 0; y < kSide; ++y) {
+            for (int x = 0; x < kSide; ++x) {
+                if ((x == 0 || y == 0 || x == kSide - 1 || y == kSide - 1) && !cells[y * kSide + x]) {
+                    outside[y * kSide + x] = 1;
+                    stack.push_back(y * kSide + x);
+                }
+            }
+        }
+        while (!stack.empty()) {
+            const int at = stack.back();
+            stack.pop_back();
+            const int x = at % kSide;
+            const int y = at / kSide;
+            const int next[8][2] = {{x - 1, y}, {x + 1, y}, {x, y - 1}, {x, y + 1},
+                                    {x - 1, y - 1}, {x + 1, y - 1}, {x - 1, y + 1}, {x + 1, y + 1}};
+            for (const auto& [nx, ny] : next) {
+                const int n = ny * kSide + nx;
+                if (nx >= 0 && ny >= 0 && nx < kSide && ny < kSide && !cells[n] && !outside[n]) {
+                    outside[n] = 1;
+                    stack.push_back(n);
+                }
+            }
+        }
+        Cells out(cells.size());
+        for (size_t i = 0; i < cells.size(); ++i) {
+            out[i] = outside[i] ? 0 : 1;
+        }
+        return out;
+    }
+
+    int64_t signedArea2(const LatticeRing& ring) {
+        int64_t area = 0;
+        for (size_t i = 0; i < ring.size(); ++i) {
+            const auto& a = ring[i];
+            const auto& b = ring[(i + 1) % ring.size()];
+            area += static_cast<int64_t>(a.x) * b.y - static_cast<int64_t>(b.x) * a.y;
+        }
+        return area;
+    }
+
+    // Alternating horizontal and vertical edges, no zero-length ones
+    bool rectilinear(const LatticeRing& ring) {
+        if (ring.size() < 4 || ring.size() % 2 != 0) {
+            return false;
+        }
+        for (size_t i = 0; i < ring.size(); ++i) {
+            const auto& a = ring[i];
+            const auto& b = ring[(i + 1) % ring.size()];
+            const auto& c = ring[(i + 2) % ring.size()];
+            const bool firstHorizontal = a.y == b.y && a.x != b.x;
+            const bool firstVertical = a.x == b.x && a.y != b.y;
+            const bool secondHorizontal = b.y == c.y && b.x != c.x;
+            const bool secondVertical = b.x == c.x && b.y != c.y;
+            if (!((firstHorizontal && secondVertical) || (firstVertical && secondHorizontal))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Union, difference and intersection against the same operations on
+    // cell bitmaps; equal sets must compare equal however they were built
+    void booleansMatchCells() {
+        std::mt19937 rng(77);
+        for (int round = 0; round < 2000; ++round) {
+            const auto rectsA = randomRects(rng);
+            const auto rectsB = randomRects(rng);
+            const auto a = LatticeRegion::fromRects(rectsA);
+            const auto b = LatticeRegion::fromRects(rectsB);
+            const auto cellsA = cellsOf(rectsA);
+            const auto cellsB = cellsOf(rectsB);
+
+            Cells unite(cellsA.size()), subtract(cellsA.size()), intersect(cellsA.size());
+            for (size_t i = 0; i < cellsA.size(); ++i) {
+                unite[i] = cellsA[i] | cellsB[i];
+                subtract[i] = cellsA[i] & !cellsB[i];
+                intersect[i] = cellsA[i] & cellsB[i];
+            }
+            const std::pair<LatticeRegion, const Cells*> results[] = {
+                {a.unite(b), &unite}, {a.subtract(b), &subtract}, {a.intersect(b), &intersect}};
+            for (const auto& [region, expected] : results) {
+                PAIBOT_CHECK(region.area() == countOf(*expected));
+                PAIBOT_CHECK(cellsOf(region.decompose()) == *expected);
+                PAIBOT_CHECK(region == regionOf(*expected));
+            }
+        }
+    }
+
+    // Traced rings are simple rectilinear loops, outer counter-clockwise and
+    // holes clockwise, that rebuild the region and its hole-free version
+    void polygonsMatchCells() {
+        std::mt19937 rng(99);
+        for (int round = 0; round < 2000; ++round) {
+            const auto cells = randomCells(rng, 0.3f + 0.05f * (round % 10));
+            const auto region = regionOf(cells);
+            const auto shapes = region.polygons();
+
+            std::vector<LatticeRing> rings, outers;
+            int64_t area2 = 0;
+            for (const auto& shape : shapes) {
+                PAIBOT_CHECK(rectilinear(shape.outer));
+                PAIBOT_CHECK(signedArea2(shape.outer) > 0);
+                area2 += signedArea2(shape.outer);
+                rings.push_back(shape.outer);
+                outers.push_back(shape.outer);
+                for (const auto& hole : shape.holes) {
+                    PAIBOT_CHECK(rectilinear(hole));
+                    PAIBOT_CHECK(signedArea2(hole) < 0);
+                    area2 += signedArea2(hole);
+                    rings.push_back(hole);
+                }
+            }
+            PAIBOT_CHECK(area2 == 2 * countOf(cells));
+            PAIBOT_CHECK(LatticeRegion::fromRings(rings) == region);
+            PAIBOT_CHECK(LatticeRegion::fromRings(outers) == regionOf(filled(cells)));
+            PAIBOT_CHECK(region.withoutHoles() == regionOf(filled(cells)));
+        }
+    }
+
+    // Through the pipeline: blocks on a 30-unit grid come back covering the
+    // same cells in no more pieces, or the filled cells when holes may go
+    void polygonizeKeepsCells() {
+        std::mt19937 rng(5);
+        for (int round = 0; round < 300; ++round) {
+            const auto cells = randomCells(rng, 0.4f + 0.05f * (round % 10));
+            ObjectRecords records;
+            for (int y = 0; y < kSide; ++y) {
+                for (int x = 0; x < kSide; ++x) {
+                    if (cells[y * kSide + x]) {
+                        ObjectRecord block;
+                        block.objectId = 1;
+                        block.kind = ObjectKind::Solid;
+                        block.x = 15.0f + 30.0f * x;
+                        block.y = 15.0f + 30.0f * y;
+                        block.width = OptimizerPipeline::kBlockSize;
+                        block.height = OptimizerPipeline::kBlockSize;
+                        records.push(block);
+                    }
+                }
+            }
+
+            for (bool respectHoles : {true, false}) {
+                OptimizerConfig config;
+                config.options.respectHoles = respectHoles;
+                const auto out = OptimizerPipeline(config).polygonize(records);
+                PAIBOT_CHECK(respectHoles ? out.size() <= records.size() : true);
+
+                // Back to whole blocks; every piece must sit on the block grid
+                std::vector<GridRect> rects;
+                bool aligned = true;
+                for (size_t i = 0; i < out.size(); ++i) {
+                    const float left = (out.x[i] - out.width[i] * 0.5f) / 30.0f;
+                    const float bottom = (out.y[i] - out.height[i] * 0.5f) / 30.0f;
+                    const float width = out.width[i] / 30.0f;
+                    const float height = out.height[i] / 30.0f;
+                    aligned = aligned && left == std::round(left) && bottom == std::round(bottom) &&
+                              width == std::round(width) && height == std::round(height);
+                    rects.push_back({static_cast<int>(left), static_cast<int>(bottom), static_cast<int>(width),
+                                     static_cast<int>(height)});
+                }
+                PAIBOT_CHECK(aligned);
+                if (!aligned) {
+                    continue;
+                }
+                int64_t area = 0;
+                for (const auto& rect : rects) {
+                    area += rect.area();
+                }
+                const auto expected = respectHoles ? cells : filled(cells);
+                PAIBOT_CHECK(cellsOf(rects) == expected);
+                PAIBOT_CHECK(area == countOf(expected));
+            }
+        }
+    }
+}
+
+int main() {
+    booleansMatchCells();
+    polygonsMatchCells();
+    polygonizeKeepsCells();
+    return paibot::test::failures();
+}
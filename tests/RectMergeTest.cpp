@@ -0,0 +1,105 @@
+#include <Check.hpp>
+#include <util/OptimizerPipeline.hpp>
+#include <util/RectMerge.hpp>
+#include <random>
+#include <vector>
+
+using namespace paibot;
+
+namespace {
+    // The rectangles must stay inside the caps, lie on set cells only and
+    // cover every set cell exactly once; the grid is consumed.
+    void coversExactlyTheOccupiedCells() {
+        std::mt19937 rng(4242);
+        std::uniform_int_distribution<int> side(1, 40);
+        std::uniform_int_distribution<int> cap(1, 8);
+        std::uniform_real_distribution<float> density(0.1f, 1.0f);
+        std::uniform_real_distribution<float> coin(0.0f, 1.0f);
+        for (int round = 0; round < 300; ++round) {
+            const int width = side(rng);
+            const int height = side(rng);
+            const int maxWidth = cap(rng);
+            const int maxHeight = cap(rng);
+            const float fill = density(rng);
+
+            OccupancyGrid grid(width, height);
+            for (int y = 0; y < height; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    if (coin(rng) < fill) {
+                        grid.set(x, y);
+                    }
+                }
+            }
+            const OccupancyGrid original = grid;
+
+            const auto rects = RectMerge::extractGreedy(grid, maxWidth, maxHeight);
+            PAIBOT_CHECK(grid.count() == 0);
+
+            std::vector<int> covered(static_cast<size_t>(width) * height, 0);
+            for (const auto& rect : rects) {
+                PAIBOT_CHECK(rect.width >= 1 && rect.width <= maxWidth);
+                PAIBOT_CHECK(rect.height >= 1 && rect.height <= maxHeight);
+                PAIBOT_CHECK(rect.x >= 0 && rect.y >= 0 && rect.x + rect.width <= width && rect.y + rect.height <= height);
+                if (rect.x < 0 || rect.y < 0 || rect.x + rect.width > width || rect.y + rect.height > height) {
+                    continue;
+                }
+                for (int y = rect.y; y < rect.y + rect.height; ++y) {
+                    for (int x = rect.x; x < rect.x + rect.width; ++x) {
+                        ++covered[static_cast<size_t>(y) * width + x];
+                    }
+                }
+            }
+            for (int y = 0; y < height; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    PAIBOT_CHECK(covered[static_cast<size_t>(y) * width + x] == (original.test(x, y) ? 1 : 0));
+                }
+            }
+        }
+    }
+
+    // A full grid splits into cap-sized tiles and nothing smaller
+    void fullGridUsesWholeTiles() {
+        OccupancyGrid grid(12, 9);
+        grid.fill({0, 0, 12, 9}, true);
+        const auto rects = RectMerge::extractGreedy(grid, 4, 3);
+        PAIBOT_CHECK(rects.size() == 9);
+        for (const auto& rect : rects) {
+            PAIBOT_CHECK(rect.width == 4 && rect.height == 3);
+        }
+    }
+
+    // A row of ten blocks (two 15-unit cells each) under a four-cell cap
+    // becomes five 60-unit pieces with the same total area.
+    void blocksMergeWithinCaps() {
+        ObjectRecords records;
+        for (int i = 0; i < 10; ++i) {
+            ObjectRecord block;
+            block.objectId = 1;
+            block.kind = ObjectKind::Solid;
+            block.x = 15.0f + 30.0f * i;
+            block.y = 15.0f;
+            block.width = OptimizerPipeline::kBlockSize;
+            block.height = OptimizerPipeline::kBlockSize;
+            records.push(block);
+        }
+        OptimizerConfig config;
+        config.options.maxWidthCells = 4;
+        OptimizerPipeline pipeline(config);
+        const auto merged = pipeline.mergeAdjacentBlocks(records);
+        PAIBOT_CHECK(merged.size() == 5);
+        float area = 0.0f;
+        for (size_t i = 0; i < merged.size(); ++i) {
+            PAIBOT_CHECK(merged.width[i] <= 60.0f);
+            PAIBOT_CHECK(merged.height[i] == 30.0f);
+            area += merged.width[i] * merged.height[i];
+        }
+        PAIBOT_CHECK(area == 10.0f * 30.0f * 30.0f);
+    }
+}
+
+int main() {
+    coversExactlyTheOccupiedCells();
+    fullGridUsesWholeTiles();
+    blocksMergeWithinCaps();
+    return paibot::test::failures();
+}
@@ -0,0 +1,122 @@
+#include <Check.hpp>
+#include <util/LevelString.hpp>
+#include <util/RegionCache.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace paibot;
+
+namespace {
+    size_t countTriggers(const ObjectRecords& records) {
+        size_t count = 0;
+        for (size_t i = 0; i < records.size(); ++i) {
+            count += records.kind[i] == ObjectKind::Trigger ? 1 : 0;
+        }
+        return count;
+    }
+
+    // Six blocks and a colour trigger are optimized and cached; a seventh
+    // block is then placed next to them. The update re-runs the row and
+    // must hand the trigger back with it.
+    void updateKeepsTriggers() {
+        std::string text = "kA2,0;1,899,2,45,3,75,23,1;";
+        for (int i = 0; i < 6; ++i) {
+            text += "1,1,2," + std::to_string(15 + 30 * i) + ",3,15;";
+        }
+        ParsedLevel level;
+        PAIBOT_CHECK(LevelString::parse(text, level));
+
+        OptimizerPipeline pipeline(OptimizerConfig{});
+        auto result = pipeline.run(level.records);
+        PAIBOT_CHECK(countTriggers(result.records) == 1);
+        RegionCache cache;
+        cache.reset(pipeline, result.records);
+        PAIBOT_CHECK(!cache.empty());
+
+        ObjectRecord block;
+        block.objectId = 1;
+        block.kind = ObjectKind::Solid;
+        block.x = 195.0f;
+        block.y = 15.0f;
+        block.width = OptimizerPipeline::kBlockSize;
+        block.height = OptimizerPipeline::kBlockSize;
+        auto edited = result.records;
+        edited.push(block);
+
+        const auto update = cache.update(pipeline, edited, {edited.bounds(edited.size() - 1)});
+        PAIBOT_CHECK(countTriggers(update.result.records) == 1);
+        PAIBOT_CHECK(update.result.records.size() <= edited.size());
+    }
+
+    std::vector<uint64_t> signatures(const RegionCache& cache) {
+        std::vector<uint64_t> out;
+        for (const auto& region : cache.getRegions()) {
+            out.push_back(region.signature);
+        }
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+
+    // Red blocks form an L whose bounds reach into a blue shape that runs on
+    // far past them; a block added right of the red one touches only the red
+    // bounds. The update must see all of the blue region, reuse it whole and
+    // leave the cache as a fresh reset of the result would be.
+    void updateKeepsNeighbours() {
+        std::string text = "kS38,1_255_2_0_3_0_6_1|1_0_2_0_3_255_6_2,kA2,0;";
+        auto block = [&](int x, int y, int channel) {
+            text += "1,1,2," + std::to_string(x) + ",3," + std::to_string(y) + ",21," + std::to_string(channel) + ";";
+        };
+        for (int x = 15; x <= 165; x += 30) {
+            block(x, 15, 1);
+        }
+        block(165, 45, 1);
+        block(165, 75, 1);
+        for (int x = 15; x <= 135; x += 30) {
+            block(x, 75, 2);
+        }
+        for (int y = 105; y <= 285; y += 30) {
+            block(15, y, 2);
+        }
+        for (int x = 45; x <= 585; x += 30) {
+            block(x, 285, 2);
+        }
+        ParsedLevel level;
+        PAIBOT_CHECK(LevelString::parse(text, level));
+
+        OptimizerConfig config;
+        config.channelColors = level.channelColors;
+        OptimizerPipeline pipeline(config);
+        auto result = pipeline.run(level.records);
+        RegionCache cache;
+        cache.reset(pipeline, result.records);
+        PAIBOT_CHECK(cache.size() == 2);
+
+        ObjectRecord added;
+        added.objectId = 1;
+        added.colorId = 1;
+        added.kind = ObjectKind::Solid;
+        added.flags = ObjectOpaque;
+        added.x = 195.0f;
+        added.y = 15.0f;
+        added.width = OptimizerPipeline::kBlockSize;
+        added.height = OptimizerPipeline::kBlockSize;
+        auto edited = result.records;
+        edited.push(added);
+
+        const auto update = cache.update(pipeline, edited, {edited.bounds(edited.size() - 1)});
+        PAIBOT_CHECK(update.affectedRegions == 2);
+        PAIBOT_CHECK(update.reusedClusters == 1);
+        PAIBOT_CHECK(update.rerunClusters == 1);
+
+        RegionCache fresh;
+        fresh.reset(pipeline, update.result.records);
+        PAIBOT_CHECK(signatures(cache) == signatures(fresh));
+    }
+}
+
+int main() {
+    updateKeepsTriggers();
+    updateKeepsNeighbours();
+    return paibot::test::failures();
+}
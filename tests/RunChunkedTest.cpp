@@ -0,0 +1,49 @@
+#include <Check.hpp>
+#include <util/LevelString.hpp>
+#include <util/OptimizerPipeline.hpp>
+#include <string>
+
+using namespace paibot;
+
+namespace {
+    ParsedLevel blocks(int columns, int rows) {
+        std::string text = "kA2,0;";
+        for (int y = 0; y < rows; ++y) {
+            for (int x = 0; x < columns; ++x) {
+                text += "1,1,2," + std::to_string(15 + 30 * x) + ",3," + std::to_string(15 + 30 * y) + ";";
+            }
+        }
+        ParsedLevel level;
+        PAIBOT_CHECK(LevelString::parse(text, level));
+        return level;
+    }
+
+    // Fields of blocks over several chunks come out as in a single run: the
+    // stretched pieces carried out of a chunk merge again in the next one,
+    // up to the caps
+    void stitchesAcrossBorders() {
+        OptimizerConfig config;
+        config.chunkWidth = 1000.0f;
+        config.options.maxWidthCells = 20;
+        config.options.maxHeightCells = 20;
+        const OptimizerPipeline pipeline(config);
+        for (int rows : {1, 4, 9}) {
+            const auto level = blocks(95, rows);
+            const auto single = pipeline.run(level.records).records;
+            const auto chunked = pipeline.runChunked(level.records).records;
+            PAIBOT_CHECK(single.size() == 10);
+            PAIBOT_CHECK(chunked.size() == single.size());
+            float area = 0.0f;
+            for (size_t i = 0; i < chunked.size(); ++i) {
+                PAIBOT_CHECK(chunked.width[i] <= 300.0f && chunked.height[i] <= 300.0f);
+                area += chunked.width[i] * chunked.height[i];
+            }
+            PAIBOT_CHECK(area == 95.0f * rows * 900.0f);
+        }
+    }
+}
+
+int main() {
+    stitchesAcrossBorders();
+    return paibot::test::failures();
+}
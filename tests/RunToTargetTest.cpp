@@ -0,0 +1,95 @@
+#include <Check.hpp>
+#include <util/LevelString.hpp>
+#include <util/OptimizerPipeline.hpp>
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+using namespace paibot;
+
+namespace {
+    bool sameRecords(const ObjectRecords& a, const ObjectRecords& b) {
+        return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height && a.objectId == b.objectId &&
+               a.colorId == b.colorId && a.sourceIndex == b.sourceIndex;
+    }
+
+    // Red and blue blocks alternate, so nothing merges at the base tolerance.
+    // The relaxed round puts both channels in one colour class; the merge
+    // recolours half the row, the ΔE check rejects it and the records stay.
+    void rejectedStepRollsBack() {
+        std::string text = "kS38,1_255_2_0_3_0_6_1|1_0_2_0_3_255_6_2,kA2,0;";
+        for (int i = 0; i < 6; ++i) {
+            text += "1,1,2," + std::to_string(15 + 30 * i) + ",3,15,21," + std::to_string(1 + i % 2) + ";";
+        }
+        ParsedLevel level;
+        PAIBOT_CHECK(LevelString::parse(text, level));
+        OptimizerConfig config;
+        config.rules.allowColorMerging = true;
+        config.maxColorTolerance = 500.0f;
+        config.relaxSteps = 1;
+        config.targetReduction = 0.5f;
+        config.channelColors = level.channelColors;
+
+        TargetReport report;
+        const auto result = OptimizerPipeline(config).runToTarget(level.records, report);
+        PAIBOT_CHECK(sameRecords(result.records, level.records));
+        PAIBOT_CHECK(!report.reached);
+        PAIBOT_CHECK(report.achieved == 0.0f);
+
+        const auto rejected = std::find_if(report.steps.begin(), report.steps.end(), [](const PassStep& step) {
+            return step.objectsAfter < step.objectsBefore;
+        });
+        PAIBOT_CHECK(rejected != report.steps.end());
+        if (rejected != report.steps.end()) {
+            PAIBOT_CHECK(!rejected->accepted);
+            PAIBOT_CHECK(rejected->colorTolerance == 500.0f);
+        }
+        for (const auto& step : report.steps) {
+            PAIBOT_CHECK(step.objectsAfter == step.objectsBefore || !step.accepted);
+        }
+    }
+
+    // Ten blocks and three abutting segments; merging the blocks alone
+    // reaches half, so the segments are never joined
+    void stopsAtTarget() {
+        std::string text = "kA2,0;";
+        for (int i = 0; i < 10; ++i) {
+            text += "1,1,2," + std::to_string(15 + 30 * i) + ",3,15;";
+        }
+        ParsedLevel level;
+        PAIBOT_CHECK(LevelString::parse(text, level));
+        for (int i = 0; i < 3; ++i) {
+            ObjectRecord segment;
+            segment.objectId = 211;
+            segment.kind = ObjectKind::Decoration;
+            segment.x = 15.0f + 30.0f * i;
+            segment.y = 200.0f;
+            segment.width = 30.0f;
+            segment.height = 4.0f;
+            level.records.push(segment);
+        }
+        OptimizerConfig config;
+        config.targetReduction = 0.5f;
+        config.maxGeometryTolerance = 2.0f;
+
+        TargetReport report;
+        const auto result = OptimizerPipeline(config).runToTarget(level.records, report);
+        PAIBOT_CHECK(report.reached);
+        PAIBOT_CHECK(result.records.size() == 4);
+        PAIBOT_CHECK(!report.steps.empty() && report.steps.back().pass == "blocks");
+        for (const auto& step : report.steps) {
+            PAIBOT_CHECK(step.pass != "lines" && step.pass != "polygons");
+            PAIBOT_CHECK(step.geometryTolerance == config.geometryTolerance);
+        }
+        for (const auto& stage : result.stages) {
+            PAIBOT_CHECK(stage.name != "lines");
+        }
+        PAIBOT_CHECK(std::abs(report.achieved - 9.0f / 13.0f) < 1e-6f);
+    }
+}
+
+int main() {
+    rejectedStepRollsBack();
+    stopsAtTarget();
+    return paibot::test::failures();
+}
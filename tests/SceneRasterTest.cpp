@@ -0,0 +1,90 @@
+#include <Check.hpp>
+#include <util/LabColor.hpp>
+#include <util/SceneRaster.hpp>
+#include <cmath>
+#include <unordered_map>
+
+using namespace paibot;
+
+namespace {
+    ObjectRecord block(float x, float y, float width, float height, int32_t channel, int32_t source, int32_t zOrder = 0) {
+        ObjectRecord record;
+        record.objectId = 1;
+        record.kind = ObjectKind::Solid;
+        record.x = x;
+        record.y = y;
+        record.width = width;
+        record.height = height;
+        record.colorId = channel;
+        record.zOrder = zOrder;
+        record.sourceIndex = source;
+        return record;
+    }
+
+    const std::unordered_map<int32_t, uint32_t> kColors = {{1, 0xFF0000}, {2, 0x00FF00}};
+
+    RasterSettings settings() {
+        RasterSettings raster;
+        raster.pixelSize = 3.75f;
+        raster.channelColors = &kColors;
+        return raster;
+    }
+
+    // Two blocks fused into one rect of the same colour draw the same pixels
+    void mergeIsExact() {
+        ObjectRecords before, after;
+        before.push(block(15.0f, 15.0f, 30.0f, 30.0f, 1, 0));
+        before.push(block(45.0f, 15.0f, 30.0f, 30.0f, 1, 1));
+        after.push(block(30.0f, 15.0f, 60.0f, 30.0f, 1, -1));
+        const auto stats = SceneRaster::compare(before, after, settings());
+        PAIBOT_CHECK(stats.pixels == 16 * 8);
+        PAIBOT_CHECK(stats.mean == 0.0f && stats.max == 0.0f);
+        PAIBOT_CHECK(stats.tiles == 1);
+    }
+
+    // A recoloured merge differs by the colour pair's distance everywhere
+    void recolourIsMeasured() {
+        ObjectRecords before, after;
+        before.push(block(15.0f, 15.0f, 30.0f, 30.0f, 1, 0));
+        after.push(block(15.0f, 15.0f, 30.0f, 30.0f, 2, -1));
+        const auto stats = SceneRaster::compare(before, after, settings());
+        const float expected = LabColor::deltaE2000(LabColor::fromPacked(0xFF0000), LabColor::fromPacked(0x00FF00));
+        PAIBOT_CHECK(stats.pixels == 8 * 8);
+        PAIBOT_CHECK(std::abs(stats.mean - expected) < 1e-3f);
+        PAIBOT_CHECK(stats.p99 == stats.max);
+    }
+
+    // An unchanged object drawn on top hides a change under it, also across
+    // a tile border
+    void unchangedCoverHides() {
+        const float border = 3.75f * 256.0f;
+        ObjectRecords before, after;
+        before.push(block(border, 15.0f, 30.0f, 30.0f, 1, 0));
+        before.push(block(border, 15.0f, 60.0f, 60.0f, 2, 1, 5));
+        after.push(block(border, 15.0f, 30.0f, 30.0f, 2, -1));
+        after.push(block(border, 15.0f, 60.0f, 60.0f, 2, 1, 5));
+        const auto stats = SceneRaster::compare(before, after, settings());
+        PAIBOT_CHECK(stats.tiles == 2);
+        PAIBOT_CHECK(stats.pixels == 8 * 8);
+        PAIBOT_CHECK(stats.max == 0.0f);
+    }
+
+    // Rotated objects are compared too
+    void rotatedChange() {
+        ObjectRecords before, after;
+        auto rotated = block(100.0f, 100.0f, 30.0f, 30.0f, 1, 0);
+        rotated.rotation = 45.0f;
+        before.push(rotated);
+        const auto stats = SceneRaster::compare(before, after, settings());
+        PAIBOT_CHECK(stats.pixels > 0);
+        PAIBOT_CHECK(stats.mean > 0.0f);
+    }
+}
+
+int main() {
+    mergeIsExact();
+    recolourIsMeasured();
+    unchangedCoverHides();
+    rotatedChange();
+    return paibot::test::failures();
+}
@@ -0,0 +1,80 @@
+#include <Check.hpp>
+#include <util/SpatialHash.hpp>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace paibot;
+
+namespace {
+    std::vector<uint32_t> bruteForce(const std::vector<Aabb>& boxes, const Aabb& query) {
+        std::vector<uint32_t> out;
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            if (boxes[i].touches(query)) {
+                out.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        return out;
+    }
+
+    Aabb randomBox(std::mt19937& rng, float extent, float maxSize) {
+        std::uniform_real_distribution<float> position(-extent, extent);
+        std::uniform_real_distribution<float> size(0.0f, maxSize);
+        const float x = position(rng);
+        const float y = position(rng);
+        return {x, y, x + size(rng), y + size(rng)};
+    }
+
+    // Every query must report exactly the brute-force set, each object once.
+    // Few buckets and boxes spanning many cells make colliding cells of one
+    // object common.
+    void queriesMatchBruteForce() {
+        std::mt19937 rng(12345);
+        for (int round = 0; round < 200; ++round) {
+            const float cellSize = 1.0f + static_cast<float>(round % 7);
+            std::vector<Aabb> boxes(1 + round % 50);
+            for (auto& box : boxes) {
+                box = randomBox(rng, 40.0f, cellSize * 9.0f);
+            }
+            SpatialHash hash;
+            hash.build(boxes, cellSize);
+
+            std::vector<uint32_t> found;
+            for (int q = 0; q < 100; ++q) {
+                const auto query = randomBox(rng, 50.0f, 30.0f);
+                hash.queryBox(query, found);
+                auto expected = bruteForce(boxes, query);
+                std::sort(found.begin(), found.end());
+                PAIBOT_CHECK(found == expected);
+            }
+            for (uint32_t i = 0; i < boxes.size(); ++i) {
+                hash.queryNeighbours(i, 0.5f, found);
+                auto expected = bruteForce(boxes, boxes[i].expanded(0.5f));
+                expected.erase(std::remove(expected.begin(), expected.end(), i), expected.end());
+                std::sort(found.begin(), found.end());
+                PAIBOT_CHECK(found == expected);
+            }
+        }
+    }
+
+    void emptyAndOversized() {
+        SpatialHash hash;
+        std::vector<uint32_t> found;
+        hash.queryBox({0.0f, 0.0f, 10.0f, 10.0f}, found);
+        PAIBOT_CHECK(found.empty());
+
+        // Spans far more than kMaxCellsPerObject cells
+        hash.build({{0.0f, 0.0f, 1000.0f, 1000.0f}, {5.0f, 5.0f, 6.0f, 6.0f}}, 1.0f);
+        hash.queryBox({500.0f, 500.0f, 501.0f, 501.0f}, found);
+        PAIBOT_CHECK(found == std::vector<uint32_t>{0});
+        hash.queryBox({5.5f, 5.5f, 5.5f, 5.5f}, found);
+        std::sort(found.begin(), found.end());
+        PAIBOT_CHECK((found == std::vector<uint32_t>{0, 1}));
+    }
+}
+
+int main() {
+    queriesMatchBruteForce();
+    emptyAndOversized();
+    return paibot::test::failures();
+}
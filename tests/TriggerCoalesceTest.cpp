@@ -0,0 +1,104 @@
+#include <Check.hpp>
+#include <util/OptimizerPipeline.hpp>
+#include <vector>
+
+using namespace paibot;
+
+namespace {
+    ObjectRecord colorTrigger(float x, int32_t target, uint32_t color, float duration, int32_t order) {
+        ObjectRecord object;
+        object.objectId = OptimizerPipeline::kColorTriggerId;
+        object.kind = ObjectKind::Trigger;
+        object.x = x;
+        object.y = 105.0f;
+        object.sourceIndex = order;
+        TriggerParams params;
+        params.target = target;
+        params.color = color;
+        params.duration = duration;
+        params.order = order;
+        object.trigger = params;
+        return object;
+    }
+
+    std::vector<TriggerRewrite> coalesce(const ObjectRecords& records, size_t& kept) {
+        std::vector<TriggerRewrite> rewrites;
+        kept = OptimizerPipeline(OptimizerConfig{}).coalesceTriggers(records, &rewrites).size();
+        return rewrites;
+    }
+
+    // The later of two instant triggers on one channel at the same x wins,
+    // by placement order rather than position in the list
+    void sameXIsOverridden() {
+        ObjectRecords records;
+        records.push(colorTrigger(100.0f, 5, 0xff0000, 0.0f, 2));
+        records.push(colorTrigger(100.0f, 5, 0x00ff00, 0.0f, 1));
+        size_t kept = 0;
+        const auto rewrites = coalesce(records, kept);
+        PAIBOT_CHECK(kept == 1);
+        PAIBOT_CHECK(rewrites.size() == 1);
+        if (rewrites.size() == 1) {
+            PAIBOT_CHECK(rewrites[0].removed == 1);
+            PAIBOT_CHECK(rewrites[0].provenBy == 2);
+        }
+    }
+
+    // A frame apart, even inside one snap bucket, the earlier colour is
+    // visible for a moment; other channels never interact
+    void acrossXOrChannelsIsKept() {
+        size_t kept = 0;
+        ObjectRecords nearby;
+        nearby.push(colorTrigger(100.0f, 5, 0xff0000, 0.0f, 1));
+        nearby.push(colorTrigger(101.0f, 5, 0x00ff00, 0.0f, 2));
+        PAIBOT_CHECK(coalesce(nearby, kept).empty() && kept == 2);
+
+        ObjectRecords repeated;
+        repeated.push(colorTrigger(100.0f, 5, 0xff0000, 0.0f, 1));
+        repeated.push(colorTrigger(101.0f, 5, 0xff0000, 0.0f, 2));
+        PAIBOT_CHECK(coalesce(repeated, kept).empty() && kept == 2);
+
+        ObjectRecords channels;
+        channels.push(colorTrigger(100.0f, 5, 0xff0000, 0.0f, 1));
+        channels.push(colorTrigger(100.0f, 6, 0x00ff00, 0.0f, 2));
+        PAIBOT_CHECK(coalesce(channels, kept).empty() && kept == 2);
+    }
+
+    // An instant trigger sets the colour a later fade starts from
+    void fadeStartIsKept() {
+        size_t kept = 0;
+        ObjectRecords instantThenFade;
+        instantThenFade.push(colorTrigger(100.0f, 5, 0xff0000, 0.0f, 1));
+        instantThenFade.push(colorTrigger(100.0f, 5, 0x00ff00, 0.5f, 2));
+        PAIBOT_CHECK(coalesce(instantThenFade, kept).empty() && kept == 2);
+
+        ObjectRecords fadeThenInstant;
+        fadeThenInstant.push(colorTrigger(100.0f, 5, 0xff0000, 0.5f, 1));
+        fadeThenInstant.push(colorTrigger(100.0f, 5, 0x00ff00, 0.0f, 2));
+        PAIBOT_CHECK(coalesce(fadeThenInstant, kept).size() == 1 && kept == 1);
+    }
+
+    // Grouped or touch/spawn triggers may fire at other times
+    void movableTriggersAreKept() {
+        size_t kept = 0;
+        ObjectRecords grouped;
+        grouped.push(colorTrigger(100.0f, 5, 0xff0000, 0.0f, 1));
+        grouped.push(colorTrigger(100.0f, 5, 0x00ff00, 0.0f, 2));
+        grouped.groups[0] = 1;
+        PAIBOT_CHECK(coalesce(grouped, kept).empty() && kept == 2);
+
+        auto spawned = colorTrigger(100.0f, 5, 0xff0000, 0.0f, 1);
+        spawned.trigger->activation = 1;
+        ObjectRecords activated;
+        activated.push(spawned);
+        activated.push(colorTrigger(100.0f, 5, 0x00ff00, 0.0f, 2));
+        PAIBOT_CHECK(coalesce(activated, kept).empty() && kept == 2);
+    }
+}
+
+int main() {
+    sameXIsOverridden();
+    acrossXOrChannelsIsKept();
+    fadeStartIsKept();
+    movableTriggersAreKept();
+    return paibot::test::failures();
+}
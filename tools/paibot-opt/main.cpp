@@ -0,0 +1,352 @@
+#include <util/LevelString.hpp>
+#include <util/OptimizerPipeline.hpp>
+#include <util/StageTimer.hpp>
+#include <util/WorkerPool.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace paibot;
+
+// Counting allocation functions for the per-stage memory figures. Each
+// block carries its size in a header one max_align_t wide, so alignment
+// is what malloc gives.
+namespace {
+    constexpr size_t kAllocHeader = alignof(std::max_align_t);
+
+    void* countedAlloc(size_t size) noexcept {
+        auto* block = static_cast<unsigned char*>(std::malloc(size + kAllocHeader));
+        if (!block) {
+            return nullptr;
+        }
+        *reinterpret_cast<size_t*>(block) = size;
+        MemoryCounters::recordAllocation(size);
+        return block + kAllocHeader;
+    }
+
+    void countedFree(void* ptr) noexcept {
+        if (!ptr) {
+            return;
+        }
+        auto* block = static_cast<unsigned char*>(ptr) - kAllocHeader;
+        MemoryCounters::recordFree(*reinterpret_cast<size_t*>(block));
+        std::free(block);
+    }
+
+    void* countedAllocOrThrow(size_t size) {
+        if (void* ptr = countedAlloc(size)) {
+            return ptr;
+        }
+        throw std::bad_alloc();
+    }
+}
+
+void* operator new(size_t size) { return countedAllocOrThrow(size); }
+void* operator new[](size_t size) { return countedAllocOrThrow(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void operator delete(void* ptr) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr) noexcept { countedFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { countedFree(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { countedFree(ptr); }
+
+/**
+ * paibot-opt: runs the structure optimizer on exported level strings
+ * (decompressed object lists) without the game.
+ *
+ *   paibot-opt [options] <level.txt>...
+ *
+ * Writes <name>.opt.txt and <name>.report.json per level. Several levels are
+ * optimized at once on the worker pool; a single level uses the pool for
+ * its clusters instead.
+ */
+namespace {
+    struct CliOptions {
+        std::filesystem::path outputDir;
+        std::vector<std::filesystem::path> inputs;
+        bool chunked = false;
+        bool mergeColors = false;
+        bool exact = false;
+        float snapGrid = 15.0f;
+        float colorTolerance = 1.0f;
+        float target = 0.0f;   // > 0: runToTarget
+        float maxGeometryTolerance = 1.0f;
+        float maxColorTolerance = 2.0f;
+        bool quiet = false;
+    };
+
+    struct StageTimes {
+        double read = 0.0;
+        double parse = 0.0;
+        double optimize = 0.0;
+        double validate = 0.0;
+        double encode = 0.0;
+        double write = 0.0;
+    };
+
+    struct LevelResult {
+        std::string name;
+        bool ok = false;
+        std::string error;
+        size_t objectsBefore = 0;
+        size_t objectsAfter = 0;
+        size_t triggersCoalesced = 0;
+        size_t patternGroups = 0;
+        DeltaEStats deltaE;
+        bool valid = false;
+        TargetReport target;
+        std::vector<StageStats> stages;
+        StageTimes times;
+    };
+
+    std::mutex s_outputMutex;
+
+    void printUsage() {
+        std::fprintf(stderr,
+            "usage: paibot-opt [options] <level.txt>...\n"
+            "  -o <dir>               output directory (default: next to each input)\n"
+            "  --chunked              whole-level mode: optimize in x-chunks\n"
+            "  --merge-colors         merge channels within the colour tolerance\n"
+            "  --exact                fewest rectangles per block group (slower)\n"
+            "  --snap <units>         snap grid (default 15)\n"
+            "  --color-tolerance <dE> CIEDE2000 tolerance for --merge-colors (default 1)\n"
+            "  --target <fraction>    pass by pass until this fraction of objects is gone,\n"
+            "                         relaxing tolerances up to the caps below\n"
+            "  --max-geometry <units> geometry tolerance cap for --target (default 1)\n"
+            "  --max-color <dE>       colour tolerance cap for --target --merge-colors (default 2)\n"
+            "  -q                     no per-level lines on stdout\n");
+    }
+
+    bool parseArgs(int argc, char** argv, CliOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+            if (arg == "-o") {
+                const char* dir = value();
+                if (!dir) {
+                    return false;
+                }
+                options.outputDir = dir;
+            } else if (arg == "--chunked") {
+                options.chunked = true;
+            } else if (arg == "--merge-colors") {
+                options.mergeColors = true;
+            } else if (arg == "--exact") {
+                options.exact = true;
+            } else if (arg == "--snap" || arg == "--color-tolerance" || arg == "--target" ||
+                       arg == "--max-geometry" || arg == "--max-color") {
+                const char* number = value();
+                if (!number) {
+                    return false;
+                }
+                float& field = arg == "--snap" ? options.snapGrid
+                             : arg == "--color-tolerance" ? options.colorTolerance
+                             : arg == "--target" ? options.target
+                             : arg == "--max-geometry" ? options.maxGeometryTolerance
+                             : options.maxColorTolerance;
+                field = std::strtof(number, nullptr);
+            } else if (arg == "-q") {
+                options.quiet = true;
+            } else if (arg == "-h" || arg == "--help" || (!arg.empty() && arg[0] == '-')) {
+                return false;
+            } else {
+                options.inputs.emplace_back(arg);
+            }
+        }
+        return !options.inputs.empty();
+    }
+
+    std::string escapeJson(const std::string& text) {
+        std::string out;
+        out.reserve(text.size());
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+            }
+            out += c;
+        }
+        return out;
+    }
+
+    std::string toJson(const LevelResult& result) {
+        std::ostringstream json;
+        json << "{\n";
+        json << "  \"level\": \"" << escapeJson(result.name) << "\",\n";
+        json << "  \"ok\": " << (result.ok ? "true" : "false") << ",\n";
+        if (!result.ok) {
+            json << "  \"error\": \"" << escapeJson(result.error) << "\"\n}\n";
+            return json.str();
+        }
+        const double reduction = result.objectsBefore
+            ? 100.0 * (1.0 - static_cast<double>(result.objectsAfter) / result.objectsBefore) : 0.0;
+        json << "  \"objectsBefore\": " << result.objectsBefore << ",\n";
+        json << "  \"objectsAfter\": " << result.objectsAfter << ",\n";
+        json << "  \"reductionPercentage\": " << reduction << ",\n";
+        json << "  \"triggersCoalesced\": " << result.triggersCoalesced << ",\n";
+        json << "  \"patternGroups\": " << result.patternGroups << ",\n";
+        json << "  \"deltaE\": {\"mean\": " << result.deltaE.mean << ", \"p99\": " << result.deltaE.p99
+             << ", \"max\": " << result.deltaE.max << ", \"pixels\": " << result.deltaE.pixels << "},\n";
+        json << "  \"valid\": " << (result.valid ? "true" : "false") << ",\n";
+        if (!result.target.steps.empty()) {
+            json << "  \"target\": {\"reduction\": " << result.target.target << ", \"achieved\": "
+                 << result.target.achieved << ", \"reached\": " << (result.target.reached ? "true" : "false")
+                 << ", \"steps\": [\n";
+            for (size_t i = 0; i < result.target.steps.size(); ++i) {
+                const auto& step = result.target.steps[i];
+                json << "    {\"pass\": \"" << escapeJson(step.pass) << "\", \"geometryTolerance\": "
+                     << step.geometryTolerance << ", \"colorTolerance\": " << step.colorTolerance
+                     << ", \"objectsBefore\": " << step.objectsBefore << ", \"objectsAfter\": " << step.objectsAfter
+                     << ", \"ms\": " << step.milliseconds << ", \"accepted\": " << (step.accepted ? "true" : "false")
+                     << "}" << (i + 1 < result.target.steps.size() ? "," : "") << "\n";
+            }
+            json << "  ]},\n";
+        }
+        json << "  \"timingsMs\": {\"read\": " << result.times.read << ", \"parse\": " << result.times.parse
+             << ", \"optimize\": " << result.times.optimize << ", \"validate\": " << result.times.validate
+             << ", \"encode\": " << result.times.encode << ", \"write\": " << result.times.write << "},\n";
+        json << "  \"stages\": " << stagesToJson(result.stages, "  ") << "\n";
+        json << "}\n";
+        return json.str();
+    }
+
+    double elapsedMs(std::chrono::steady_clock::time_point& since) {
+        const auto now = std::chrono::steady_clock::now();
+        const double ms = std::chrono::duration<double, std::milli>(now - since).count();
+        since = now;
+        return ms;
+    }
+
+    bool writeFile(const std::filesystem::path& path, const std::string& contents) {
+        std::ofstream file(path, std::ios::binary);
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        return static_cast<bool>(file);
+    }
+
+    LevelResult optimizeLevel(const CliOptions& options, const std::filesystem::path& input) {
+        LevelResult result;
+        result.name = input.filename().string();
+        auto clock = std::chrono::steady_clock::now();
+
+        std::ifstream file(input, std::ios::binary);
+        if (!file) {
+            result.error = "cannot open " + input.string();
+            return result;
+        }
+        const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        result.times.read = elapsedMs(clock);
+
+        // Records and object strings are views into `text`
+        ParsedLevel level;
+        const StageTimer parseTimer;
+        if (!LevelString::parse(text, level)) {
+            result.error = "malformed object string after " + std::to_string(level.objects.size()) + " objects";
+            return result;
+        }
+        result.objectsBefore = level.records.size();
+        const auto parseStage = parseTimer.finish("extract", level.objects.size(), level.records.size());
+        result.times.parse = elapsedMs(clock);
+
+        OptimizerConfig config;
+        config.snapGrid = options.snapGrid;
+        config.colorTolerance = options.colorTolerance;
+        config.options.colorTolerance = options.colorTolerance;
+        config.rules.allowColorMerging = options.mergeColors;
+        config.options.exactPartition = options.exact;
+        config.channelColors = level.channelColors;
+        config.animatedChannels = level.animatedChannels;
+        config.targetReduction = options.target;
+        config.maxGeometryTolerance = options.maxGeometryTolerance;
+        config.maxColorTolerance = options.maxColorTolerance;
+        OptimizerPipeline pipeline(config);
+        auto optimized = options.target > 0.0f ? pipeline.runToTarget(level.records, result.target)
+                       : options.chunked ? pipeline.runChunked(level.records)
+                       : pipeline.run(level.records);
+        result.objectsAfter = optimized.records.size();
+        result.triggersCoalesced = optimized.triggerRewrites.size();
+        result.patternGroups = optimized.patterns.groups.size();
+        result.stages = std::move(optimized.stages);
+        result.stages.insert(result.stages.begin(), parseStage);
+        result.times.optimize = elapsedMs(clock);
+
+        const StageTimer validateTimer;
+        result.deltaE = pipeline.measureDeltaE(level.records, optimized.records);
+        result.valid = pipeline.validateOptimization(level.records, optimized.records, result.deltaE);
+        result.stages.push_back(validateTimer.finish("validate", level.records.size(), optimized.records.size()));
+        result.times.validate = elapsedMs(clock);
+
+        // An invalid result is reported but the level is written unchanged
+        const std::string encoded = LevelString::encode(level, result.valid ? optimized.records : level.records);
+        result.times.encode = elapsedMs(clock);
+
+        const auto dir = options.outputDir.empty() ? input.parent_path() : options.outputDir;
+        const auto stem = input.stem().string();
+        if (!writeFile(dir / (stem + ".opt.txt"), encoded)) {
+            result.error = "cannot write " + (dir / (stem + ".opt.txt")).string();
+            return result;
+        }
+        result.times.write = elapsedMs(clock);
+        result.ok = true;
+        if (!writeFile(dir / (stem + ".report.json"), toJson(result))) {
+            result.ok = false;
+            result.error = "cannot write report";
+        }
+        return result;
+    }
+}
+
+int main(int argc, char** argv) {
+    CliOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+    MemoryCounters::setEnabled(true);
+    if (!options.outputDir.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(options.outputDir, error);
+    }
+
+    // One level per job; the passes inside a job then run serially, which
+    // keeps every core busy on a batch without oversubscribing
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<LevelResult> results(options.inputs.size());
+    WorkerPool::get()->parallelFor(options.inputs.size(), [&](size_t i) {
+        results[i] = optimizeLevel(options, options.inputs[i]);
+        if (!options.quiet) {
+            const auto& r = results[i];
+            std::lock_guard lock(s_outputMutex);
+            if (r.ok) {
+                std::printf("%s: %zu -> %zu objects, dE mean %.3f p99 %.3f%s (parse %.1f ms, optimize %.1f ms, "
+                            "validate %.1f ms, encode %.1f ms)\n",
+                            r.name.c_str(), r.objectsBefore, r.objectsAfter, r.deltaE.mean, r.deltaE.p99,
+                            r.valid ? "" : " [rejected]", r.times.parse, r.times.optimize, r.times.validate,
+                            r.times.encode);
+            } else {
+                std::printf("%s: error: %s\n", r.name.c_str(), r.error.c_str());
+            }
+        }
+    });
+
+    size_t failed = 0, before = 0, after = 0;
+    for (const auto& result : results) {
+        failed += result.ok ? 0 : 1;
+        before += result.objectsBefore;
+        after += result.valid ? result.objectsAfter : result.objectsBefore;
+    }
+    const double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%zu levels (%zu failed): %zu -> %zu objects in %.1f ms on %u threads\n", results.size(), failed, before,
+                after, totalMs, WorkerPool::get()->getThreadCount());
+    WorkerPool::destroy();
+    return failed ? 1 : 0;
+}